@@ -67,7 +67,7 @@
 #endif
 
 
-static const char * ddpt_version_str = "0.96 20171106 [svn: r333]";
+static const char * ddpt_version_str = "0.97 20261014 [svn: r334]";
 
 #ifdef SG_LIB_LINUX
 #include <sys/ioctl.h>
@@ -82,6 +82,9 @@ static const char * ddpt_version_str = "0.96 20171106 [svn: r333]";
 #include <sys/types.h>
 #endif
 #include <linux/major.h>
+#include <linux/fiemap.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 #ifdef HAVE_FALLOCATE
 #include <linux/falloc.h>
@@ -111,6 +114,11 @@ static const char * ddpt_version_str = "0.96 20171106 [svn: r333]";
 #endif
 #endif
 
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#include <time.h>
+#endif
+
 #include "ddpt.h"
 #include "sg_lib.h"
 #include "sg_pr2serr.h"
@@ -278,8 +286,11 @@ open_of(struct opts_t * op)
             pr2serr("Cannot create a regular file called %s as a pt\n", ofn);
             goto other_err;
         }
-        flags = ofp->sparing ? O_RDWR : O_WRONLY;
-        if (! outf_exists)
+        if (op->do_compare)
+            flags = O_RDONLY;   /* --compare only reads OFILE */
+        else
+            flags = (ofp->sparing || ofp->mmap) ? O_RDWR : O_WRONLY;
+        if ((! outf_exists) && (! op->do_compare))
             flags |= O_CREAT;
         if (ofp->direct)
             flags |= O_DIRECT;
@@ -290,7 +301,7 @@ open_of(struct opts_t * op)
         if (ofp->append)
             flags |= O_APPEND;
         if ((FT_REG & odip->d_type) && outf_exists && ofp->trunc &&
-            (! ofp->nowrite)) {
+            (! ofp->nowrite) && (! op->do_compare)) {
             if (op->seek > 0) {
                 offset = op->seek * op->obs;
                 if (st.st_size > offset)
@@ -299,7 +310,8 @@ open_of(struct opts_t * op)
                 flags |= O_TRUNC;
         }
         if ((fd = open(ofn, flags, 0666)) < 0) {
-            pr2serr("could not open %s for writing: %s\n", ofn,
+            pr2serr("could not open %s for %s: %s\n", ofn,
+                    (op->do_compare ? "reading" : "writing"),
                     safe_strerror(errno));
             goto file_err;
         }
@@ -586,16 +598,132 @@ calc_count(struct opts_t * op, int64_t * in_num_blksp,
 }
 
 #ifdef HAVE_POSIX_FADVISE
+
+/* cache=WIN[,DIRTY]: starts writeback of OFILE bytes [lo, hi) and, when
+ * wait is set, waits for it to finish. Returns 0 on success. */
+static int
+cw_writeback(struct opts_t * op, int64_t lo, int64_t hi, bool wait)
+{
+    int fd = op->odip->fd;
+
+    if (hi <= lo)
+        return 0;
+#if defined(SG_LIB_LINUX) && defined(HAVE_SYNC_FILE_RANGE)
+    return sync_file_range(fd, lo, hi - lo, wait ?
+                           (SYNC_FILE_RANGE_WAIT_BEFORE |
+                            SYNC_FILE_RANGE_WRITE |
+                            SYNC_FILE_RANGE_WAIT_AFTER) :
+                           SYNC_FILE_RANGE_WRITE);
+#elif defined(HAVE_FDATASYNC)
+    return wait ? fdatasync(fd) : 0;
+#else
+    if (fd && wait) { ; }       /* suppress warning */
+    return 0;
+#endif
+}
+
+/* cache=WIN[,DIRTY]: a sliding page cache window for buffered copies much
+ * larger than memory, in place of the nocache DONTNEEDs. IFILE gets
+ * WILLNEED on the next WIN bytes (renewed each time half of them have been
+ * read) and DONTNEED on what has been read. OFILE has writeback started
+ * each time DIRTY/2 bytes have been written, then waits for the previous
+ * DIRTY/2 bytes and drops them, so no more than DIRTY bytes are dirty and
+ * the kernel doesn't stall the copy with a large flush. Errors ignored. */
+static void
+cache_window(struct opts_t * op, int bytes_if, int bytes_of)
+{
+    int rt;
+    int64_t lo, hi, lim;
+    int id_type = op->idip->d_type;
+    int od_type = op->odip->d_type;
+
+    if ((bytes_if > 0) && ((FT_REG == id_type) || (FT_BLOCK == id_type)) &&
+        (! op->iflagp->direct)) {
+        lo = op->skip * op->ibs;
+        hi = lo + bytes_if;
+        if (op->cw_in_lo < 0)
+            op->cw_in_lo = op->cw_in_ra = lo;
+        if ((op->cw_in_ra - hi) < (op->cw_win / 2)) {
+            lim = hi + op->cw_win;
+            if (op->dd_count > 0)
+                lim = (lim < ((op->skip + op->dd_count) * op->ibs)) ? lim :
+                      ((op->skip + op->dd_count) * op->ibs);
+            if (op->cw_in_ra < hi)
+                op->cw_in_ra = hi;
+            if (lim > op->cw_in_ra) {
+                rt = posix_fadvise(op->idip->fd, op->cw_in_ra,
+                                   lim - op->cw_in_ra, POSIX_FADV_WILLNEED);
+                if (rt && op->verbose)
+                    pr2serr("posix_fadvise(WILLNEED) on read, err=%d\n", rt);
+                op->cw_in_ra = lim;
+            }
+        }
+        /* drop in quarter windows to keep the system calls few */
+        if ((hi - op->cw_in_lo) >= (op->cw_win / 4)) {
+            rt = posix_fadvise(op->idip->fd, op->cw_in_lo, hi - op->cw_in_lo,
+                               POSIX_FADV_DONTNEED);
+            if (rt && op->verbose)
+                pr2serr("posix_fadvise(DONTNEED) on read, err=%d\n", rt);
+            op->cw_in_lo = hi;
+        }
+    }
+    if ((bytes_of > 0) && ((FT_REG == od_type) || (FT_BLOCK == od_type)) &&
+        (! op->oflagp->direct) && (! op->oflagp->nowrite)) {
+        lo = op->seek * op->obs;
+        hi = lo + bytes_of;
+        if (op->cw_out_hi < 0)
+            op->cw_out_lo = op->cw_out_wb = lo;
+        if (hi > op->cw_out_hi)
+            op->cw_out_hi = hi;
+        if ((op->cw_out_hi - op->cw_out_wb) >= (op->cw_dirty / 2)) {
+            if (cw_writeback(op, op->cw_out_wb, op->cw_out_hi, false) ||
+                cw_writeback(op, op->cw_out_lo, op->cw_out_wb, true)) {
+                if (op->verbose)
+                    pr2serr("cache=: writeback of output: %s\n",
+                            safe_strerror(errno));
+            } else if (op->cw_out_wb > op->cw_out_lo)
+                posix_fadvise(op->odip->fd, op->cw_out_lo,
+                              op->cw_out_wb - op->cw_out_lo,
+                              POSIX_FADV_DONTNEED);
+            op->cw_out_lo = op->cw_out_wb;
+            op->cw_out_wb = op->cw_out_hi;
+        }
+    }
+}
+
+/* cache=WIN[,DIRTY]: at the end of the copy writes back and drops what the
+ * window still holds */
+static void
+cache_window_end(struct opts_t * op)
+{
+    if ((op->cw_in_lo >= 0) && (op->cw_in_ra > op->cw_in_lo))
+        posix_fadvise(op->idip->fd, op->cw_in_lo,
+                      op->cw_in_ra - op->cw_in_lo, POSIX_FADV_DONTNEED);
+    if ((op->cw_out_hi > op->cw_out_lo) &&
+        (0 == cw_writeback(op, op->cw_out_lo, op->cw_out_hi, true)))
+        posix_fadvise(op->odip->fd, op->cw_out_lo,
+                      op->cw_out_hi - op->cw_out_lo, POSIX_FADV_DONTNEED);
+    op->cw_in_lo = -1;
+    op->cw_out_hi = -1;
+}
+
 /* Used by iflag=nocache and oflag=nocache to suggest (via posix_fadvise()
  * system call) that the OS doesn't cache data it has just read or written
  * since it is unlikely to be used again in the short term. iflag=nocache
- * additionally increases the read-ahead. Errors ignored. */
+ * additionally increases the read-ahead. With cache=WIN the window in
+ * cache_window() is used for IFILE and OFILE instead. Errors ignored. */
 static void
 do_fadvise(struct opts_t * op, int bytes_if, int bytes_of, int bytes_of2)
 {
     bool in_valid, out2_valid, out_valid;
     int rt, id_type, od_type, o2d_type;
 
+    if (op->cw_win > 0) {
+        cache_window(op, bytes_if, bytes_of);
+        bytes_if = 0;
+        bytes_of = 0;
+    }
+
     id_type = op->idip->d_type;
     od_type = op->odip->d_type;
     o2d_type = op->o2dip->d_type;
@@ -639,7 +767,12 @@ cp_read_pt(struct opts_t * op, struct cp_state_t * csp, unsigned char * bp)
     int res;
     int blks_read = 0;
 
-    res = pt_read(op, 0, bp, csp->icbpt, &blks_read);
+#ifdef SG_LIB_LINUX
+    if (op->iflagp->async)
+        res = pt_read_async(op, 0, bp, csp->icbpt, &blks_read);
+    else
+#endif
+        res = pt_read(op, 0, bp, csp->icbpt, &blks_read);
     if (res) {
         if (0 == blks_read) {
             pr2serr("pt_read failed,%s at or after lba=%" PRId64 " "
@@ -662,6 +795,7 @@ cp_read_pt(struct opts_t * op, struct cp_state_t * csp, unsigned char * bp)
         /* round down since don't do partial writes from pt reads */
         csp->ocbpt = (blks_read * op->ibs) / op->obs;
     }
+    csp->bytes_read = csp->icbpt * op->ibs_pi;
     op->in_full += csp->icbpt;
     return 0;
 }
@@ -787,7 +921,9 @@ static int
 cp_read_block_reg(struct opts_t * op, struct cp_state_t * csp,
                   unsigned char * bp)
 {
+    bool uring_in = false;
     int res, res2, in_type;
+    int64_t t0;
     int64_t offset = op->skip * op->ibs_pi;
     int numbytes = csp->icbpt * op->ibs_pi;
     int ibs = op->ibs_pi;
@@ -807,7 +943,11 @@ cp_read_block_reg(struct opts_t * op, struct cp_state_t * csp,
         return 0;
     }
 #endif
-    if (offset != csp->if_filepos) {
+#ifdef DDPT_HAVE_URING
+    /* io_uring reads are positional, csp->if_filepos is left alone */
+    uring_in = (op->urp && op->iflagp->uring);
+#endif
+    if ((! uring_in) && (offset != csp->if_filepos)) {
         int64_t off_res;
 
         if (op->verbose > 2)
@@ -822,12 +962,22 @@ cp_read_block_reg(struct opts_t * op, struct cp_state_t * csp,
         }
         csp->if_filepos = offset;
     }
-    while (((res = read(op->idip->fd, bp, numbytes)) < 0) &&
-           (EINTR == errno))
-        ++op->interrupted_retries;
+    t0 = lat_start(op);
+#ifdef DDPT_HAVE_URING
+    if (uring_in)
+        res = uring_rw(op, DDPT_ARG_IN, false, bp, numbytes, offset, ibs);
+    else
+#endif
+    {
+        while (((res = read(op->idip->fd, bp, numbytes)) < 0) &&
+               (EINTR == errno))
+            ++op->interrupted_retries;
+    }
+    lat_end(op, DDPT_PH_READ, t0);
 
     if (op->verbose > 2)
-        pr2serr("read(unix): requested bytes=%d, res=%d\n", numbytes, res);
+        pr2serr("read(%s): requested bytes=%d, res=%d\n",
+                (uring_in ? "io_uring" : "unix"), numbytes, res);
     if ((op->iflagp->coe) && (res < numbytes)) {
         res2 = (res >= 0) ? res : -errno;
         if ((res < 0) && op->verbose) {
@@ -836,7 +986,7 @@ cp_read_block_reg(struct opts_t * op, struct cp_state_t * csp,
         } else if (op->verbose)
             pr2serr("reading, skip=%" PRId64 " : short read, go to coe\n",
                     op->skip);
-        if (res2 > 0)
+        if ((res2 > 0) && (! uring_in))
             csp->if_filepos += res2;
         return coe_cp_read_block_reg(op, csp, bp, res2);
     }
@@ -869,7 +1019,10 @@ cp_read_block_reg(struct opts_t * op, struct cp_state_t * csp,
         res2 = 0;
         if ((res >= ibs) && (res <= (numbytes - ibs))) {
             /* Want to check for a EIO lurking */
-            while (((res2 = read(op->idip->fd, bp + res, ibs)) < 0) &&
+            while (((res2 = (uring_in ?
+                             pread(op->idip->fd, bp + res, ibs,
+                                   offset + res) :
+                             read(op->idip->fd, bp + res, ibs))) < 0) &&
                    (EINTR == errno))
                 ++op->interrupted_retries;
             if (res2 < 0) {
@@ -883,7 +1036,8 @@ cp_read_block_reg(struct opts_t * op, struct cp_state_t * csp,
                             ": %s\n", op->skip + csp->icbpt,
                             safe_strerror(errno));
             } else {    /* actually expect 0==res2 indicating EOF */
-                csp->if_filepos += res2;   /* could have moved filepos */
+                if (! uring_in)
+                    csp->if_filepos += res2;   /* could have moved filepos */
                 if (op->verbose > 1)
                     pr2serr("extra read after short read, res=%d\n", res2);
             }
@@ -893,7 +1047,8 @@ cp_read_block_reg(struct opts_t * op, struct cp_state_t * csp,
         else if ((res % op->obs) > 0) /* else if extra bytes bump obpt */
             ++csp->ocbpt;
     }
-    csp->if_filepos += res;
+    if (! uring_in)
+        csp->if_filepos += res;
     csp->bytes_read = res;
     op->in_full += csp->icbpt;
     return 0;
@@ -1195,7 +1350,12 @@ cp_write_pt(struct opts_t * op, struct cp_state_t * csp, int seek_delta,
             pr2serr(">>> ignore partial write of %d bytes to pt "
                     "(unless oflag=pad given)\n", csp->partial_write_bytes);
     }
-    res = pt_write(op, bp, blks, aseek);
+#ifdef SG_LIB_LINUX
+    if (op->oflagp->async)
+        res = pt_write_async(op, bp, blks, aseek);
+    else
+#endif
+        res = pt_write(op, bp, blks, aseek);
     if (0 != res) {
         pr2serr("%s: failed,%s seek=%" PRId64 "\n", __func__,
                 ((-2 == res) ? " try reducing bpt," : ""), aseek);
@@ -1310,6 +1470,231 @@ ew_retry:
 
 #endif /* SG_LIB_LINUX */
 
+#ifdef SG_LIB_LINUX
+
+/* iflag=mmap and oflag=mmap: a window of a regular file, from byte offset
+ * lo for len bytes, mapped at base. The window moves along the file with
+ * the copy (see mm_map()). */
+struct mm_win_t {
+    bool active;        /* false: not given or given up on this file */
+    int fd;
+    int prot;           /* PROT_READ, or with PROT_WRITE for OFILE */
+    int64_t lo;
+    size_t len;
+    int64_t size;       /* of the file (OFILE: as extended so far) */
+    int64_t orig_size;  /* OFILE: before the copy */
+    int64_t cap;        /* OFILE: expected end of copy, 0 if unknown */
+    int64_t hi;         /* OFILE: end of the highest byte written */
+    unsigned char * base;       /* NULL if nothing mapped */
+};
+
+struct mm_ctl_t {
+    size_t win;         /* bytes in a window, a multiple of psz */
+    size_t psz;         /* page size */
+    struct mm_win_t in;
+    struct mm_win_t out;
+};
+
+/* oflag=mmap: allocates len bytes of OFILE at off (extending it if need
+ * be) so a store into the mapping can't then fail with SIGBUS for lack of
+ * space. Returns 0 on success, else -1 with errno set. */
+static int
+mm_alloc(int fd, int64_t off, int64_t len)
+{
+#ifdef HAVE_FALLOCATE
+    if (fallocate(fd, 0, (off_t)off, (off_t)len) < 0)
+        return -1;
+    return 0;
+#else
+    if (fd || off || len) { ; }         /* suppress warning */
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/* Returns a pointer to byte offset off of the file in window wp, moving
+ * the window first if [off, off + len) is not wholly in it. IFILE windows
+ * are prefaulted (MAP_POPULATE) and stop at its end; OFILE is allocated
+ * (with fallocate()) to the end of its window but not much past where the
+ * copy should stop. With oflag=sparse OFILE is only extended (with
+ * ftruncate()), cp_write_mmap() allocates what it writes. Returns NULL if
+ * that fails. */
+static unsigned char *
+mm_map(struct opts_t * op, struct mm_win_t * wp, int64_t off, int len)
+{
+    int flags = MAP_SHARED;
+    int64_t lo, want;
+    struct mm_ctl_t * mmp = op->mmp;
+    void * p;
+
+    if (wp->base && (off >= wp->lo) &&
+        ((off + len) <= (wp->lo + (int64_t)wp->len)))
+        return wp->base + (off - wp->lo);
+    if (wp->base) {
+        munmap(wp->base, wp->len);
+        wp->base = NULL;
+    }
+    lo = off - (off % mmp->psz);
+    want = lo + mmp->win;
+    if (PROT_WRITE & wp->prot) {
+        if ((wp->cap > 0) && (want > wp->cap))
+            want = wp->cap;
+        if (want < (off + len))
+            want = off + len;
+        if (! op->oflagp->sparse) {
+            if (mm_alloc(wp->fd, lo, want - lo) < 0) {
+                pr2serr("%s: fallocate: %s\n", __func__,
+                        safe_strerror(errno));
+                return NULL;
+            }
+            if (want > wp->size)
+                wp->size = want;
+        } else if (want > wp->size) {
+            if (ftruncate(wp->fd, want) < 0) {
+                pr2serr("%s: ftruncate: %s\n", __func__,
+                        safe_strerror(errno));
+                return NULL;
+            }
+            wp->size = want;
+        }
+    } else {
+        if (want > wp->size)
+            want = wp->size;
+        flags |= MAP_POPULATE;
+    }
+    wp->len = (size_t)(want - lo);
+    p = mmap(NULL, wp->len, wp->prot, flags, wp->fd, lo);
+    if (MAP_FAILED == p) {
+        pr2serr("%s: mmap: %s\n", __func__, safe_strerror(errno));
+        return NULL;
+    }
+    madvise(p, wp->len, MADV_SEQUENTIAL);
+    wp->base = (unsigned char *)p;
+    wp->lo = lo;
+    if (op->verbose > 2)
+        pr2serr("%s: %s window at offset %" PRId64 ", %zu bytes\n",
+                __func__, (PROT_WRITE & wp->prot) ? "OFILE" : "IFILE", lo,
+                wp->len);
+    return wp->base + (off - lo);
+}
+
+/* oflag=mmap: writes back and unmaps the OFILE window, then cuts OFILE
+ * back to where the copy stopped writing as it may have been extended to
+ * the end of the window. Returns 0 on success, else SG_LIB_FILE_ERROR. */
+static int
+mm_out_close(struct opts_t * op, struct mm_win_t * wp)
+{
+    int ret = 0;
+
+    if (wp->base) {
+        if (msync(wp->base, wp->len, MS_SYNC) < 0) {
+            pr2serr("oflag=mmap: msync of %s: %s\n", op->odip->fn,
+                    safe_strerror(errno));
+            ret = SG_LIB_FILE_ERROR;
+        }
+        munmap(wp->base, wp->len);
+        wp->base = NULL;
+    }
+    if (wp->size > wp->hi) {
+        if (ftruncate(wp->fd, wp->hi) < 0) {
+            pr2serr("oflag=mmap: could not ftruncate %s: %s\n",
+                    op->odip->fn, safe_strerror(errno));
+            ret = SG_LIB_FILE_ERROR;
+        } else
+            wp->size = wp->hi;
+    }
+    return ret;
+}
+
+/* iflag=mmap: points csp->mm_bp at the segment in the mapping of IFILE
+ * rather than reading it into the work buffer. Only a segment that lies
+ * within IFILE and fills whole OBS blocks is done this way; returns false
+ * for others (e.g. the last) which are then read as usual. */
+static bool
+cp_read_mmap(struct opts_t * op, struct cp_state_t * csp)
+{
+    int numbytes = csp->icbpt * op->ibs_pi;
+    int64_t off = op->skip * op->ibs_pi;
+    struct mm_win_t * wp = &op->mmp->in;
+    unsigned char * p;
+
+    if (((off + numbytes) > wp->size) || (numbytes % op->obs_pi))
+        return false;
+    if (NULL == (p = mm_map(op, wp, off, numbytes))) {
+        pr2serr("iflag=mmap: reading the rest of %s instead\n",
+                op->idip->fn);
+        wp->active = false;
+        return false;
+    }
+    if (op->verbose > 4)
+        pr2serr("%s: offset=0x%" PRIx64 ", numbytes=%d\n", __func__, off,
+                numbytes);
+    csp->mm_bp = p;
+    csp->bytes_read = numbytes;
+    op->in_full += csp->icbpt;
+    return true;
+}
+
+/* oflag=mmap: copies numbytes from bp to byte offset off of OFILE through
+ * its mapping. With oflag=sparse, pages of zeros past the original end of
+ * OFILE are not touched so they stay holes; runs of other pages are
+ * allocated just before they are copied. Returns 0 on success, -1 if
+ * mapping or allocating fails (the rest of OFILE is then written as
+ * usual). */
+static int
+cp_write_mmap(struct opts_t * op, int64_t off, int numbytes,
+              const unsigned char * bp)
+{
+    bool use;
+    int k, n, r;
+    int psz = (int)op->mmp->psz;
+    int64_t t0;
+    struct mm_win_t * wp = &op->mmp->out;
+    unsigned char * p;
+
+    if (NULL == (p = mm_map(op, wp, off, numbytes)))
+        goto give_up;
+    t0 = lat_start(op);
+    if (op->oflagp->sparse && ((off + numbytes) > wp->orig_size)) {
+        /* r is the start of a run of pages to copy, -1 if none */
+        for (k = 0, r = -1; k < numbytes; k += n) {
+            n = psz - (int)((off + k) % psz);   /* to end of this page */
+            if (n > (numbytes - k))
+                n = numbytes - k;
+            use = (((off + k) < wp->orig_size) ||
+                   (first_nonzero(bp + k, n) < n));
+            if (use && (r < 0))
+                r = k;
+            if ((r >= 0) && ((! use) || ((k + n) == numbytes))) {
+                if (mm_alloc(wp->fd, off + r, (use ? k + n : k) - r) < 0) {
+                    lat_end(op, DDPT_PH_WRITE, t0);
+                    pr2serr("%s: fallocate: %s\n", __func__,
+                            safe_strerror(errno));
+                    goto give_up;
+                }
+                memcpy(p + r, bp + r, (use ? k + n : k) - r);
+                r = -1;
+            }
+        }
+    } else
+        memcpy(p, bp, numbytes);
+    lat_end(op, DDPT_PH_WRITE, t0);
+    if ((off + numbytes) > wp->hi)
+        wp->hi = off + numbytes;
+    if (op->verbose > 2)
+        pr2serr("%s: offset=0x%" PRIx64 ", numbytes=%d\n", __func__, off,
+                numbytes);
+    return 0;
+
+give_up:
+    pr2serr("oflag=mmap: writing the rest of %s instead\n", op->odip->fn);
+    wp->active = false;
+    mm_out_close(op, wp);
+    return -1;
+}
+
+#endif  /* SG_LIB_LINUX */
+
 /* Main copy loop's write (output (of)) for block device fifo or regular
  * file. Returns 0 on success, else SG_LIB_FILE_ERROR,
  * SG_LIB_CAT_MEDIUM_HARD or -1 . */
@@ -1318,7 +1703,8 @@ cp_write_block_reg(struct opts_t * op, struct cp_state_t * csp,
                    int seek_delta, int blks, const unsigned char * bp)
 {
     bool got_part = false;
-    int64_t offset;
+    bool uring_out = false;
+    int64_t offset, t0;
     int64_t aseek = op->seek + seek_delta;
     int res, off, out_type, err;
     int numbytes = blks * op->obs_pi;
@@ -1404,7 +1790,20 @@ cp_write_block_reg(struct opts_t * op, struct cp_state_t * csp,
                 }
             }
         }
-        if ((offset != csp->of_filepos) &&
+#ifdef SG_LIB_LINUX
+        /* so are writes through a mapping */
+        if (op->mmp && op->mmp->out.active &&
+            (0 == cp_write_mmap(op, offset, numbytes, bp))) {
+            csp->bytes_of = numbytes;
+            op->out_full += blks;
+            return 0;
+        }
+#endif
+#ifdef DDPT_HAVE_URING
+        /* io_uring writes are positional, csp->of_filepos is left alone */
+        uring_out = (op->urp && op->oflagp->uring);
+#endif
+        if ((! uring_out) && (offset != csp->of_filepos) &&
             (! (REASON_TAPE_SHORT_READ == csp->leave_reason))) {
             int64_t off_res;
 
@@ -1423,15 +1822,27 @@ cp_write_block_reg(struct opts_t * op, struct cp_state_t * csp,
         // write to fifo (reg file ?) is non-atomic so loop if making progress
         off = 0;
         got_part = false;
-        do {
-            while (((res = write(op->odip->fd, bp + off,
-                                 numbytes - off)) < 0) && (EINTR == errno))
-                ++op->interrupted_retries;
+        t0 = lat_start(op);
+#ifdef DDPT_HAVE_URING
+        if (uring_out) {
+            res = uring_rw(op, DDPT_ARG_OUT, true, (unsigned char *)bp,
+                           numbytes, offset, obs);
             err = errno;
-            if ((res > 0) && (res < (numbytes - off)))
-                got_part = true;
-        } while ((FT_FIFO & out_type) && (res > 0) &&
-                 ((off += res) < numbytes));
+        } else
+#endif
+        {
+            do {
+                while (((res = write(op->odip->fd, bp + off,
+                                     numbytes - off)) < 0) &&
+                       (EINTR == errno))
+                    ++op->interrupted_retries;
+                err = errno;
+                if ((res > 0) && (res < (numbytes - off)))
+                    got_part = true;
+            } while ((FT_FIFO & out_type) && (res > 0) &&
+                     ((off += res) < numbytes));
+        }
+        lat_end(op, DDPT_PH_WRITE, t0);
         if (off >= numbytes) {
             res = numbytes;
             if (got_part && op->verbose)
@@ -1440,8 +1851,8 @@ cp_write_block_reg(struct opts_t * op, struct cp_state_t * csp,
             pr2serr("write to of fifo problem: count=%d, off=%d, "
                     "res=%d\n", numbytes, off, res);
         if ((op->verbose > 2) && (0 == off))
-            pr2serr("write(unix): requested bytes=%d, res=%d\n", numbytes,
-                    res);
+            pr2serr("write(%s): requested bytes=%d, res=%d\n",
+                    (uring_out ? "io_uring" : "unix"), numbytes, res);
         if (res < 0) {
             pr2serr("writing, seek=%" PRId64 " : %s\n", aseek,
                     safe_strerror(err));
@@ -1451,7 +1862,8 @@ cp_write_block_reg(struct opts_t * op, struct cp_state_t * csp,
                 return SG_LIB_CAT_OTHER;
         } else if (res < numbytes) {
             pr2serr("output file probably full, seek=%" PRId64 "\n", aseek);
-            csp->of_filepos += res;
+            if (! uring_out)
+                csp->of_filepos += res;
             csp->bytes_of = res;
             op->out_full += res / obs;
             /* can get a partial write due to a short write */
@@ -1461,7 +1873,8 @@ cp_write_block_reg(struct opts_t * op, struct cp_state_t * csp,
             }
             return -1;
         } else {    /* successful write */
-            csp->of_filepos += numbytes;
+            if (! uring_out)
+                csp->of_filepos += numbytes;
             csp->bytes_of = numbytes;
             op->out_full += blks;
         }
@@ -1523,21 +1936,364 @@ cp_sparse_cleanup(struct opts_t * op, struct cp_state_t * csp)
         pr2serr("%s: bypass as output_offset <= output_filepos\n", __func__);
 }
 
+/* True when zero runs may be trimmed on OFILE: oflag=trim and OFILE is
+ * pt (UNMAP or WRITE SAME(16)), a block device (BLKZEROOUT) or a regular
+ * file (punching holes) */
+static bool
+cp_trim_capable(const struct opts_t * op)
+{
+    int d_type = op->odip->d_type;
+
+    if (! op->oflagp->wsame16)
+        return false;
+    if (FT_PT & d_type)
+        return true;
+#if defined(SG_LIB_LINUX) && defined(BLKZEROOUT)
+    if (FT_BLOCK & d_type)
+        return true;
+#endif
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_PUNCH_HOLE)
+    if (FT_REG & d_type)
+        return true;
+#endif
+    return false;
+}
+
+/* Largest number of blocks in one trim command, for UNMAP the total over
+ * all its ranges. If a pass-through OFILE doesn't report its maximum WRITE
+ * SAME length then trims are not merged beyond one segment (the earlier
+ * behaviour) */
+static int64_t
+cp_trim_max_blks(struct opts_t * op)
+{
+    const struct dev_info_t * dip = op->odip;
+
+    if (! (FT_PT & dip->d_type))
+        return DDPT_TRIM_MAX_BYTES / op->obs;
+    if (dip->max_unmap_descs > 0)
+        return (dip->max_unmap_blks > INT_MAX) ? INT_MAX :
+                                                 dip->max_unmap_blks;
+    if (dip->max_ws_blks > INT_MAX)     /* pt_write_same16() limit */
+        return INT_MAX;
+    else if (dip->max_ws_blks > 0)
+        return dip->max_ws_blks;
+    return ((int64_t)op->ibs * op->bpt_i) / op->obs;
+}
+
+/* Number of ranges that can be queued for one trim command: more than one
+ * only when a pt OFILE takes UNMAP */
+static int
+cp_trim_max_descs(const struct opts_t * op)
+{
+    uint32_t n = op->odip->max_unmap_descs;
+
+    if (! (FT_PT & op->odip->d_type) || (0 == n))
+        return 1;
+    return (n > DDPT_TRIM_MAX_DESCS) ? DDPT_TRIM_MAX_DESCS : (int)n;
+}
+
+/* Trims one range of a non-pt OFILE. Returns 0 on success. */
+static int
+cp_trim_file(struct opts_t * op, const struct trim_rng_t * rp)
+{
+    int fd = op->odip->fd;
+
+#if defined(SG_LIB_LINUX) && defined(BLKZEROOUT)
+    if (FT_BLOCK & op->odip->d_type) {
+        uint64_t rng[2];
+
+        /* unlike BLKDISCARD this leaves the blocks reading as zeros */
+        rng[0] = (uint64_t)rp->lba * op->obs;
+        rng[1] = (uint64_t)rp->num * op->obs;
+        if (ioctl(fd, BLKZEROOUT, rng) < 0) {
+            if (op->verbose)
+                pr2serr("%s: BLKZEROOUT: %s\n", op->odip->fn,
+                        safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+        return 0;
+    }
+#endif
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_PUNCH_HOLE)
+    if (FT_REG & op->odip->d_type) {
+        if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      (off_t)rp->lba * op->obs,
+                      (off_t)rp->num * op->obs) < 0) {
+            if (op->verbose)
+                pr2serr("%s: fallocate(PUNCH_HOLE): %s\n", op->odip->fn,
+                        safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+        return 0;
+    }
+#endif
+    if (fd) { ; }       /* suppress warning */
+    return SG_LIB_CAT_OTHER;
+}
+
+/* Trims part bytes (less than one OBS block) of a regular OFILE starting
+ * at block lba: the partial last block of the copy, which a block sized
+ * trim range can't hold. A hole is punched if possible, else zeros are
+ * written. Returns true if those bytes now read as zeros; a tail that
+ * isn't cleared (e.g. OFILE not a regular file) is counted in trim_errs. */
+static bool
+cp_trim_tail(struct opts_t * op, int64_t lba, int part)
+{
+    off_t off = (off_t)lba * op->obs;
+    ssize_t n;
+
+    if (part <= 0)
+        return false;
+    if (! (FT_REG & op->odip->d_type)) {
+        ++op->trim_errs;
+        return false;
+    }
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_PUNCH_HOLE)
+    if (0 == fallocate(op->odip->fd, FALLOC_FL_PUNCH_HOLE |
+                       FALLOC_FL_KEEP_SIZE, off, part))
+        return true;
+#endif
+    signals_process_delay(op, DELAY_WRITE);
+    while (((n = pwrite(op->odip->fd, op->zeros_buff, part, off)) < 0) &&
+           (EINTR == errno))
+        ++op->interrupted_retries;
+    if (n == part)
+        return true;
+    if (op->verbose)
+        pr2serr("%s: writing %d byte tail of zeros: %s\n", op->odip->fn,
+                part, (n < 0) ? safe_strerror(errno) : "short write");
+    ++op->trim_errs;
+    return false;
+}
+
+/* Sends the queued trim ranges: as one UNMAP when a pt OFILE takes it,
+ * else a WRITE SAME(16), BLKZEROOUT or hole punch per range. Trim errors
+ * are counted, then ignored. */
+static void
+cp_trim_send(struct opts_t * op, struct cp_state_t * csp)
+{
+    int k, n, res;
+    int64_t max_ws;
+    struct trim_rng_t r;
+    const struct trim_rng_t * rp;
+
+    if (0 == csp->trim_qn)
+        return;
+    signals_process_delay(op, DELAY_WRITE);
+    if (op->verbose > 2)
+        pr2serr("%s: %d ranges, %" PRId64 " blocks\n", __func__,
+                csp->trim_qn, csp->trim_q_blks);
+    res = -1;
+    if ((FT_PT & op->odip->d_type) && (op->odip->max_unmap_descs > 0)) {
+        res = pt_unmap(op, csp->trim_q, csp->trim_qn);
+        if (res && (op->odip->max_unmap_descs > 0))
+            ++op->trim_errs;
+    }
+    if ((FT_PT & op->odip->d_type) && (0 == op->odip->max_unmap_descs)) {
+        /* UNMAP rejected, WRITE SAME's limit may be lower */
+        max_ws = (op->odip->max_ws_blks > 0) ? op->odip->max_ws_blks :
+                 (((int64_t)op->ibs * op->bpt_i) / op->obs);
+        if (max_ws > INT_MAX)
+            max_ws = INT_MAX;
+        for (k = 0, rp = csp->trim_q; k < csp->trim_qn; ++k, ++rp) {
+            for (r = *rp; r.num > 0; r.lba += n, r.num -= n) {
+                n = (r.num > max_ws) ? (int)max_ws : (int)r.num;
+                if (pt_write_same16(op, op->zeros_buff, op->obs, n, r.lba))
+                    ++op->trim_errs;
+            }
+        }
+    } else if (! (FT_PT & op->odip->d_type)) {
+        for (k = 0, rp = csp->trim_q; k < csp->trim_qn; ++k, ++rp) {
+            if (cp_trim_file(op, rp))
+                ++op->trim_errs;
+        }
+    }
+    csp->trim_qn = 0;
+    csp->trim_q_blks = 0;
+}
+
+/* Moves up to max_blks blocks from the front of the pending trim to the
+ * queue, sending the queue first if that would overfill it */
+static void
+cp_trim_queue(struct opts_t * op, struct cp_state_t * csp, int64_t max_blks)
+{
+    int64_t n;
+    struct trim_rng_t * rp;
+
+    n = (csp->trim_blks > max_blks) ? max_blks : csp->trim_blks;
+    if ((csp->trim_qn >= cp_trim_max_descs(op)) ||
+        ((csp->trim_q_blks + n) > max_blks))
+        cp_trim_send(op, csp);
+    rp = csp->trim_q + csp->trim_qn++;
+    rp->lba = csp->trim_lba;
+    rp->num = (uint32_t)n;
+    csp->trim_q_blks += n;
+    csp->trim_lba += n;
+    csp->trim_blks -= n;
+}
+
+/* Sends all of the pending and queued trims. Called before a checkpoint
+ * and at the end of the copy. */
+static void
+cp_trim_flush(struct opts_t * op, struct cp_state_t * csp)
+{
+    int64_t max_blks = cp_trim_max_blks(op);
+
+    while (csp->trim_blks > 0)
+        cp_trim_queue(op, csp, max_blks);
+    cp_trim_send(op, csp);
+}
+
+/* journal=: checkpoints a single threaded copy when one is due. Any
+ * pending trim is sent first as the journal must not get ahead of OFILE.
+ * Returns 0 on success. */
+static int
+cp_jrnl_check(struct opts_t * op, struct cp_state_t * csp)
+{
+    if ((NULL == op->jrnlp) || (! jrnl_due(op)))
+        return 0;
+    if ((csp->trim_blks > 0) || (csp->trim_qn > 0))
+        cp_trim_flush(op, csp);
+    return jrnl_checkpoint(op, op->skip - op->jrnl_skip0, false);
+}
+
+/* Number of bytes of IFILE data in the work buffer after the segment has
+ * been read. Blocks in a hole of IFILE and iflag=ff blocks are there
+ * though they were not read. */
+static int
+cp_bytes_in(const struct opts_t * op, const struct cp_state_t * csp)
+{
+    if (csp->in_hole || (FT_ALL_FF & op->idip->d_type))
+        return csp->icbpt * op->ibs_pi;
+    return csp->bytes_read;
+}
+
+/* hash=: adds the segment just read (starting at op->skip) to the digests.
+ * Returns 0 on success. */
+static int
+cp_hash_segment(struct opts_t * op, struct cp_state_t * csp,
+                const unsigned char * bp)
+{
+    return hash_segment(op, bp, cp_bytes_in(op, csp), op->skip,
+                        csp->icbpt);
+}
+
+/* Adds blks zero blocks starting at lba in OFILE to the pending trim.
+ * Contiguous ranges, including those from later segments, are merged.
+ * Each range that ends is queued; queued ranges are sent together (as an
+ * UNMAP with many block descriptors) once the device's Block Limits VPD
+ * page says a command can take no more. */
+static void
+cp_trim_add(struct opts_t * op, struct cp_state_t * csp, int64_t lba,
+            int64_t blks)
+{
+    int64_t max_blks = cp_trim_max_blks(op);
+
+    if ((csp->trim_blks > 0) && ((csp->trim_lba + csp->trim_blks) != lba)) {
+        while (csp->trim_blks > 0)
+            cp_trim_queue(op, csp, max_blks);
+    }
+    if (0 == csp->trim_blks)
+        csp->trim_lba = lba;
+    csp->trim_blks += blks;
+    while (csp->trim_blks >= max_blks)
+        cp_trim_queue(op, csp, max_blks);
+}
+
+/* Equal runs (and with oflag=coalesce, zero runs) shorter than this
+ * between two runs to be written are written as well, so a small OBPC
+ * doesn't become a storm of tiny IOs */
+#define CP_MIN_SKIP_BYTES (32 * 1024)
+
+/* Builds the extent map of a segment in csp->ext_map: each OBPC chunk of
+ * b1p is compared with b2p or, if b2p is NULL, checked for being all
+ * zeros (with manifest= its digest is checked against MF); adjacent chunks
+ * of the same kind form one run. Short runs between writes are then
+ * folded into the writes, except zero runs unless oflag=coalesce is given
+ * so holes stay exact. Returns the number of runs or -1 if out of
+ * memory. */
+static int
+cp_build_ext_map(struct opts_t * op, struct cp_state_t * csp,
+                 const unsigned char * b1p, const unsigned char * b2p,
+                 int numbytes, bool trim)
+{
+    bool same;
+    bool fold = (b2p || op->mfp || op->oflagp->coalesce);
+    int k, n, j, kind, num;
+    int chunk = op->obpch * op->obs;
+    int nz_off = -1;    /* offset of next non-zero byte in b1p */
+    struct cp_extent_t * ep = NULL;
+    struct cp_extent_t * map;
+
+    n = (numbytes + chunk - 1) / chunk;
+    if (n > csp->ext_max) {
+        map = (struct cp_extent_t *)realloc(csp->ext_map, n * sizeof(*map));
+        if (NULL == map) {
+            pr2serr("%s: out of memory\n", __func__);
+            return -1;
+        }
+        csp->ext_map = map;
+        csp->ext_max = n;
+    }
+    map = csp->ext_map;
+    for (k = 0, num = 0; k < numbytes; k += chunk) {
+        n = ((k + chunk) < numbytes) ? chunk : (numbytes - k);
+        if (op->mfp)
+            same = mf_chunk_same(op, op->seek + (k / op->obs), b1p + k, n);
+        else if (b2p)
+            same = (0 == memcmp(b1p + k, b2p + k, n));
+        else {
+            /* one pass: zero chunks before nz_off need no rescan */
+            if (nz_off < k)
+                nz_off = k + first_nonzero(b1p + k, numbytes - k);
+            same = (nz_off >= (k + n));
+        }
+        kind = same ? (trim ? CP_EXT_TRIM : CP_EXT_SAME) : CP_EXT_WRITE;
+        if (ep && (kind == ep->kind))
+            ep->len += n;
+        else {
+            ep = map + num++;
+            ep->kind = kind;
+            ep->off = k;
+            ep->len = n;
+        }
+    }
+    /* runs alternate between write and one other kind, so a short run
+     * with a write on each side can be merged with both */
+    for (k = 0, j = 0; k < num; ++k) {
+        if (fold && (j > 0) && (CP_EXT_WRITE == map[j - 1].kind) &&
+            (CP_EXT_WRITE != map[k].kind) && ((k + 1) < num) &&
+            (map[k].len < CP_MIN_SKIP_BYTES)) {
+            map[j - 1].len += map[k].len + map[k + 1].len;
+            ++k;
+        } else
+            map[j++] = map[k];
+    }
+    if (op->verbose > 3)
+        pr2serr("%s: %d chunks gave %d runs\n", __func__,
+                (numbytes + chunk - 1) / chunk, j);
+    return j;
+}
+
 /* Main copy loop's finer grain comparison and possible write (to OFILE)
- * for all file types. Returns 0 on success. */
+ * for all file types. Each OBPC chunk of b1p is compared with b2p or, if
+ * b2p is NULL (sparse), checked for being all zeros. The resulting runs
+ * are written, skipped or (sparse with trim) added to the pending trim.
+ * Returns 0 on success. */
 static int
 cp_finer_comp_wr(struct opts_t * op, struct cp_state_t * csp,
                  const unsigned char * b1p, const unsigned char * b2p)
 {
     bool done_sigs_delay = false;
-    bool need_wr, trim_check, need_tr;
-    int res, k, n, oblks, numbytes, chunk, wr_len, wr_k, obs;
-    int tr_len, tr_k, out_type;
+    bool trim;
+    int res, k, num, oblks, numbytes, obs, out_type;
+    int64_t t0;
+    struct cp_extent_t * ep;
 
     oblks = csp->ocbpt;
     obs = op->obs;
     out_type = op->odip->d_type;
-    if (op->obpch >= oblks) {
+    if ((op->obpch >= oblks) && (NULL == op->mfp)) {
         if (FT_DEV_NULL & out_type)
             ;
         else if (FT_PT & out_type) {
@@ -1554,103 +2310,46 @@ cp_finer_comp_wr(struct opts_t * op, struct cp_state_t * csp,
     numbytes = oblks * obs;
     if ((FT_REG & out_type) && (csp->partial_write_bytes > 0))
         numbytes += csp->partial_write_bytes;
-    chunk = op->obpch * obs;
-    trim_check = (op->oflagp->sparse && op->oflagp->wsame16 &&
-                  (FT_PT & out_type));
-    need_tr = false;
-    tr_len = 0;
-    tr_k = 0;
-    for (k = 0, need_wr = false, wr_len = 0, wr_k = 0; k < numbytes;
-         k += chunk) {
-        n = ((k + chunk) < numbytes) ? chunk : (numbytes - k);
-        if (0 == memcmp(b1p + k, b2p + k, n)) {
-            if (need_wr) {
-                if (FT_DEV_NULL & out_type)
-                    ;
-                else if (FT_PT & out_type) {
-                    if (! done_sigs_delay) {
-                        done_sigs_delay = true;
-                        signals_process_delay(op, DELAY_WRITE);
-                    }
-                    if ((res = cp_write_pt(op, csp, wr_k / obs,
-                                           wr_len / obs, b1p + wr_k)))
-                        return res;
-                } else {
-                    if (! done_sigs_delay) {
-                        done_sigs_delay = true;
-                        signals_process_delay(op, DELAY_WRITE);
-                    }
-                    if ((res = cp_write_block_reg(op, csp, wr_k / obs,
-                                                  wr_len / obs, b1p + wr_k)))
-                        return res;
-                }
-                need_wr = false;
-            }
-            if (need_tr)
-                tr_len += n;
-            else if (trim_check) {
-                need_tr = true;
-                tr_len = n;
-                tr_k = k;
-            }
-            op->out_sparse += (n / obs);
-        } else {   /* look for a sequence of unequals */
-            if (need_wr)
-                wr_len += n;
-            else {
-                need_wr = true;
-                wr_len = n;
-                wr_k = k;
-            }
-            if (need_tr) {
-                    if (! done_sigs_delay) {
-                        done_sigs_delay = true;
-                        signals_process_delay(op, DELAY_WRITE);
-                    }
-                res = pt_write_same16(op, b2p, obs, tr_len / obs,
-                                      op->seek + (tr_k / obs));
-                if (res)
-                    ++op->trim_errs;
-                /* continue past trim errors */
-                need_tr = false;
+    trim = ((NULL == b2p) && op->oflagp->sparse && cp_trim_capable(op));
+    t0 = lat_start(op);
+    num = cp_build_ext_map(op, csp, b1p, b2p, numbytes, trim);
+    lat_end(op, DDPT_PH_COMP, t0);
+    if (num < 0)
+        return SG_LIB_CAT_OTHER;
+
+    for (k = 0, ep = csp->ext_map; k < num; ++k, ++ep) {
+        if (CP_EXT_WRITE != ep->kind) {
+            op->out_sparse += (ep->len / obs);
+            if (CP_EXT_TRIM == ep->kind) {
+                cp_trim_add(op, csp, op->seek + (ep->off / obs),
+                            ep->len / obs);
+                if ((ep->len % obs) &&
+                    cp_trim_tail(op, op->seek + ((ep->off + ep->len) / obs),
+                                 ep->len % obs))
+                    ++op->out_sparse_partial;
             }
+            continue;
         }
-    }
-    if (need_wr) {
         if (FT_DEV_NULL & out_type)
-            ;
-        else if (FT_PT & out_type) {
-            if (! done_sigs_delay) {
-                done_sigs_delay = true;
-                signals_process_delay(op, DELAY_WRITE);
-            }
-            if ((res = cp_write_pt(op, csp, wr_k / obs, wr_len / obs,
-                                   b1p + wr_k)))
-                return res;
-        } else {
-            if (! done_sigs_delay) {
-                done_sigs_delay = true;
-                signals_process_delay(op, DELAY_WRITE);
-            }
-            if ((res = cp_write_block_reg(op, csp, wr_k / obs, wr_len / obs,
-                                          b1p + wr_k)))
-                return res;
-        }
-    }
-    if (need_tr) {
-        if (! done_sigs_delay)
+            continue;
+        if (! done_sigs_delay) {
+            done_sigs_delay = true;
             signals_process_delay(op, DELAY_WRITE);
-        res = pt_write_same16(op, b2p, obs, tr_len / obs,
-                              op->seek + (tr_k / obs));
+        }
+        if (FT_PT & out_type)
+            res = cp_write_pt(op, csp, ep->off / obs, ep->len / obs,
+                              b1p + ep->off);
+        else
+            res = cp_write_block_reg(op, csp, ep->off / obs, ep->len / obs,
+                                     b1p + ep->off);
         if (res)
-            ++op->trim_errs;
-        /* continue past trim errors */
+            return res;
     }
     return 0;
 }
 
 static int
-cp_construct_pt_zero_buff(struct opts_t * op, int obpt)
+cp_construct_pt_zero_buff(struct opts_t * op)
 {
     if ((FT_PT & op->idip->d_type) && (NULL == op->idip->ptvp)) {
         op->idip->ptvp = (struct sg_pt_base *)pt_construct_obj();
@@ -1662,8 +2361,11 @@ cp_construct_pt_zero_buff(struct opts_t * op, int obpt)
         if (NULL == op->odip->ptvp)
             return -1;
     }
+    /* Zero detection doesn't need this buffer, it is the data-out for
+     * WRITE SAME and the last block written by cp_sparse_cleanup(). The
+     * latter may be a block plus a partial block. */
     if ((op->oflagp->sparse) && (NULL == op->zeros_buff)) {
-        op->zeros_buff = (unsigned char *)calloc(obpt * op->obs, 1);
+        op->zeros_buff = (unsigned char *)calloc(2 * op->obs_pi, 1);
         if (NULL == op->zeros_buff) {
             pr2serr("zeros_buff calloc failed\n");
             return -1;
@@ -1762,723 +2464,4334 @@ count_calculate(struct opts_t * op)
     return 0;
 }
 
-/* This is the main copy loop (unless an offloaded copy is requested).
- * Attempts to copy 'dd_count' blocks (size given by bs or ibs) in chunks
- * of op->bpt_i blocks. Returns 0 if successful.  */
+/* journal=JFILE: moves skip, seek and count (and the OFILE2 position) past
+ * what earlier runs of this copy have done. Returns 0 to copy what is left,
+ * -1 if the copy is already complete, else an error. */
 static int
-do_rw_copy(struct opts_t * op)
+jrnl_resume_rw(struct opts_t * op)
 {
-    bool sparse_skip, sparing_skip, continual_read;
-    bool first_time = true;
-    bool first_time_ff = true;
-    int ibpt, obpt, res, n;
-    int ret = 0;
-    int id_type = op->idip->d_type;
-    int od_type = op->odip->d_type;
-    struct cp_state_t * csp;
-    unsigned char * wPos = op->wrkPos;
-    struct cp_state_t cp_st;
+    int res;
+    int64_t done;
 
-    continual_read = (op->reading_fifo && (op->dd_count < 0));
-    if (op->verbose > 3) {
-        if (continual_read)
-            pr2serr("do_rw_copy: reading fifo continually\n");
-        else
-            pr2serr("do_rw_copy: dd_count=%" PRId64 "\n", op->dd_count);
-    }
-    if ((op->dd_count <= 0) && (! op->reading_fifo))
+    if ((res = jrnl_start(op, &done)))
+        return res;
+    if (0 == done)
         return 0;
-    csp = &cp_st;
-    memset(csp, 0, sizeof(struct cp_state_t));
-    ibpt = op->bpt_i;
-    obpt = (op->ibs * op->bpt_i) / op->obs;
-    if ((ret = cp_construct_pt_zero_buff(op, obpt)))
-        goto copy_end;
-    /* Both csp->if_filepos and csp->of_filepos are 0 */
+    if (done >= op->dd_count) {
+        pr2serr("journal finds copy complete, exiting\n");
+        op->dd_count = 0;
+        return -1;
+    }
+    if ((op->o2dip->fd >= 0) &&
+        (lseek(op->o2dip->fd, done * op->ibs_pi, SEEK_SET) < 0)) {
+        pr2serr("journal: could not seek on %s: %s\n", op->o2dip->fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    op->skip += done;
+    op->seek += (done * op->ibs) / op->obs;
+    op->dd_count -= done;
+    pr2serr("journal resuming at skip=%" PRId64 ", seek=%" PRId64 ", and "
+            "count=%" PRId64 "\n", op->skip, op->seek, op->dd_count);
+    return 0;
+}
 
-    /* <<< main loop that does the copy >>> */
-    while ((op->dd_count > 0) || continual_read) {
-        if (first_time)
-            first_time = false;
-        else
-            signals_process_delay(op, DELAY_COPY_SEGMENT);
-        csp->bytes_read = 0;
-        csp->bytes_of = 0;
-        csp->bytes_of2 = 0;
-        sparing_skip = false;
-        sparse_skip = false;
-        if ((op->dd_count >= ibpt) || continual_read) {
-            csp->icbpt = ibpt;
-            csp->ocbpt = obpt;
-        } else {
-            csp->icbpt = op->dd_count;
-            res = op->dd_count;
-            n = res * op->ibs;
-            csp->ocbpt = n / op->obs;
-            if (n % op->obs) {
-                ++csp->ocbpt;
-                memset(wPos, 0, op->ibs * ibpt);
-            }
+/* Sets up csp for the next copy segment: the number of input and output
+ * blocks for this transfer given what remains of dd_count. */
+static void
+cp_segment_init(struct opts_t * op, struct cp_state_t * csp,
+                unsigned char * bp, bool continual_read)
+{
+    int n;
+    int ibpt = op->bpt_i;
+
+    csp->in_hole = false;
+    csp->mm_bp = NULL;
+    csp->bytes_read = 0;
+    csp->bytes_of = 0;
+    csp->bytes_of2 = 0;
+    if ((op->dd_count >= ibpt) || continual_read) {
+        csp->icbpt = ibpt;
+        csp->ocbpt = (op->ibs * ibpt) / op->obs;
+    } else {
+        csp->icbpt = op->dd_count;
+        n = csp->icbpt * op->ibs;
+        csp->ocbpt = n / op->obs;
+        if (n % op->obs) {
+            ++csp->ocbpt;
+            memset(bp, ((FT_ALL_FF & op->idip->d_type) ? 0xff : 0),
+                   op->ibs * ibpt);
         }
+    }
+}
 
-        /* Start of reading section */
-        if (FT_PT & id_type) {
-            if ((ret = cp_read_pt(op, csp, wPos)))
-                break;
-        } else if (FT_FIFO & id_type) {
-             if ((ret = cp_read_fifo(op, csp, wPos)))
-                break;
-        } else if (FT_TAPE & id_type) {
-#ifdef SG_LIB_LINUX
-             if ((ret = cp_read_tape(op, csp, wPos)))
-                break;
-#else
-            pr2serr("reading from tape not supported in this OS\n");
-            ret = SG_LIB_CAT_OTHER;
-            break;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+
+#ifdef FS_IOC_FIEMAP
+/* Fallback when lseek(SEEK_DATA) isn't supported. Returns the byte offset
+ * of the first mapped extent of fd in [start, end), end if there is none
+ * or -1 if the FIEMAP ioctl fails. */
+static int64_t
+cp_fiemap_data(int fd, int64_t start, int64_t end)
+{
+    int64_t off;
+    uint64_t b[(sizeof(struct fiemap) + sizeof(struct fiemap_extent)) /
+               sizeof(uint64_t) + 1];
+    struct fiemap * fmp = (struct fiemap *)b;
+
+    memset(b, 0, sizeof(b));
+    fmp->fm_start = start;
+    fmp->fm_length = end - start;
+    fmp->fm_flags = FIEMAP_FLAG_SYNC;
+    fmp->fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, fmp) < 0)
+        return -1;
+    if (0 == fmp->fm_mapped_extents)
+        return end;
+    off = fmp->fm_extents[0].fe_logical;
+    return (off < start) ? start : off;
+}
 #endif
-        } else if (FT_ALL_FF & id_type) {
-            if (first_time_ff) {
-                first_time_ff = false;
-                memset(wPos, 0xff, op->ibs * ibpt);
-            }
-            op->in_full += csp->icbpt;
-        } else {
-             if ((ret = cp_read_block_reg(op, csp, wPos)))
-                break;
-        }
-        if (0 == csp->icbpt)
-            break;      /* nothing read so leave loop */
 
-        if ((op->o2dip->fd >= 0) &&
-            ((ret = cp_write_of2(op, csp, wPos))))
-            break;
+/* Checks whether the next segment of a regular IFILE lies wholly in a
+ * hole, in which case reading it can be skipped. The data and hole ranges
+ * found are cached in csp to save a lseek() on most segments. If the
+ * filesystem can't tell, in_sparse_active is cleared so the whole file is
+ * read as before. */
+static bool
+cp_in_hole(struct opts_t * op, struct cp_state_t * csp)
+{
+    int err;
+    int64_t off, hole;
+    int64_t start = op->skip * op->ibs_pi;
+    int64_t end = start + ((int64_t)csp->icbpt * op->ibs_pi);
+    int fd = op->idip->fd;
+    struct stat a_st;
 
-        if (op->oflagp->sparse) {
-            n = (csp->ocbpt * op->obs) + csp->partial_write_bytes;
-            if (0 == memcmp(wPos, op->zeros_buff, n)) {
-                sparse_skip = true;
-                if (op->oflagp->wsame16 && (FT_PT & od_type)) {
-                    signals_process_delay(op, DELAY_WRITE);
-                    res = pt_write_same16(op, op->zeros_buff, op->obs,
-                                          csp->ocbpt, op->seek);
-                    if (res)
-                        ++op->trim_errs;
-                }
-            } else if (op->obpch) {
-                ret = cp_finer_comp_wr(op, csp, wPos, op->zeros_buff);
-                if (ret)
-                    break;
-                goto bypass_write;
-            }
-        }
-        if (op->oflagp->sparing && (! sparse_skip)) {
-            /* In write sparing, we read from the output */
-            if (FT_PT & od_type)
-                res = cp_read_of_pt(op, csp, op->wrkPos2);
-            else
-                res = cp_read_of_block_reg(op, csp, op->wrkPos2);
-            if (0 == res) {
-                n = (csp->ocbpt * op->obs) + csp->partial_write_bytes;
-                if (0 == memcmp(wPos, op->wrkPos2, n))
-                    sparing_skip = true;
-                else if (op->obpch) {
-                    ret = cp_finer_comp_wr(op, csp, wPos, op->wrkPos2);
-                    if (ret)
-                        break;
-                    goto bypass_write;
-                }
-            } else {
-                ret = res;
-                break;
-            }
+    if ((start >= csp->in_data_lo) && (end <= csp->in_data_hi))
+        return false;
+    if ((start >= csp->in_hole_lo) && (end <= csp->in_hole_hi))
+        return true;
+    off = lseek(fd, start, SEEK_DATA);
+    err = errno;
+    csp->if_filepos = -1;       /* file position has changed */
+    if (off < 0) {
+        if (ENXIO == err) {     /* no data from start to EOF */
+            if (fstat(fd, &a_st) < 0)
+                goto give_up;
+            csp->in_hole_lo = start;
+            csp->in_hole_hi = a_st.st_size;
+            return (end <= csp->in_hole_hi);
         }
+#ifdef FS_IOC_FIEMAP
+        off = cp_fiemap_data(fd, start, end);
+        if (off < 0)
+            goto give_up;
+        return (off >= end);
+#else
+        goto give_up;
+#endif
+    }
+    if (off >= end) {
+        csp->in_hole_lo = start;
+        csp->in_hole_hi = off;
+        return true;
+    }
+    hole = lseek(fd, off, SEEK_HOLE);
+    if (hole > off) {
+        csp->in_data_lo = off;
+        csp->in_data_hi = hole;
+    }
+    return false;
 
-        /* Start of writing section */
-        if (sparing_skip || sparse_skip) {
-            op->out_sparse += csp->ocbpt;
-            if (csp->partial_write_bytes > 0)
-                ++op->out_sparse_partial;
-        } else {
-            if (FT_DEV_NULL & od_type)
-                ;  /* don't bump out_full (earlier revs did) */
-            else {
-                signals_process_delay(op, DELAY_WRITE);
-                if (FT_PT & od_type) {
-                    if ((ret = cp_write_pt(op, csp, 0, csp->ocbpt, wPos)))
-                        break;
-                } else if (FT_TAPE & od_type) {
-#ifdef SG_LIB_LINUX
-                    bool could_be_last;
+give_up:
+    if (op->verbose)
+        pr2serr("%s: can't find holes in %s: %s\n", __func__, op->idip->fn,
+                safe_strerror(err));
+    op->in_sparse_active = false;
+    return false;
+}
+
+#endif  /* SEEK_DATA && SEEK_HOLE */
+
+/* Reading half of a copy segment: reads csp->icbpt blocks from IFILE (at
+ * op->skip) into bp. When nothing is read csp->icbpt is set to 0. Only
+ * touches IFILE so it may run ahead of the writing half (see bufs=BUFS).
+ * Returns 0 on success. */
+static int
+cp_read_segment(struct opts_t * op, struct cp_state_t * csp,
+                unsigned char * bp)
+{
+    int ret = 0;
+    int id_type = op->idip->d_type;
 
-                    could_be_last = ((! continual_read) &&
-                                     (csp->icbpt >= op->dd_count));
-                    if ((ret = cp_write_tape(op, csp, wPos, could_be_last)))
-                        break;
+    if (FT_PT & id_type) {
+        if ((ret = cp_read_pt(op, csp, bp)))
+            return ret;
+    } else if (FT_FIFO & id_type) {
+         if ((ret = cp_read_fifo(op, csp, bp)))
+            return ret;
+    } else if (FT_TAPE & id_type) {
+#ifdef SG_LIB_LINUX
+         if ((ret = cp_read_tape(op, csp, bp)))
+            return ret;
 #else
-                    pr2serr("writing to tape not supported in this OS\n");
-                    ret = SG_LIB_CAT_OTHER;
-                    break;
+        pr2serr("reading from tape not supported in this OS\n");
+        return SG_LIB_CAT_OTHER;
 #endif
-                } else if ((ret = cp_write_block_reg(op, csp, 0, csp->ocbpt,
-                                                     wPos))) /* plus fifo */
-                    break;
-            }
-        }
-bypass_write:
-#ifdef HAVE_POSIX_FADVISE
-        do_fadvise(op, csp->bytes_read, csp->bytes_of, csp->bytes_of2);
+    } else if (FT_ALL_FF & id_type)
+        op->in_full += csp->icbpt;      /* bp pre-filled with 0xff bytes */
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    else if (op->in_sparse_active && cp_in_hole(op, csp)) {
+        /* zeros only needed by OFILE2, hash= and --compare, OFILE will
+         * be sparse */
+        if (op->verbose > 3)
+            pr2serr("%s: skip=%" PRId64 " is in a hole, not read\n",
+                    __func__, op->skip);
+        csp->in_hole = true;
+        op->in_full += csp->icbpt;
+        if ((op->o2dip->fd >= 0) || op->hashp || op->do_compare)
+            memset(bp, 0, csp->icbpt * op->ibs_pi);
+    }
 #endif
-        if (op->dd_count > 0)
-            op->dd_count -= csp->icbpt;
-        op->skip += csp->icbpt;
-        op->seek += csp->ocbpt;
-        if (csp->leave_after_write) {
-            if (REASON_TAPE_SHORT_READ == csp->leave_reason) {
-                /* allow multiple partial writes for tape */
-                csp->partial_write_bytes = 0;
-                csp->leave_after_write = false;
-            } else {
-                /* other cases: stop copy after partial write */
-                ret = csp->leave_reason;
-                break;
-            }
-        }
-    } /* end of main loop that does the copy ... */
+#ifdef SG_LIB_LINUX
+    else if (op->mmp && op->mmp->in.active && cp_read_mmap(op, csp))
+        ;       /* csp->mm_bp points at the segment */
+#endif
+    else {
+         if ((ret = cp_read_block_reg(op, csp, bp)))
+            return ret;
+    }
+    return 0;
+}
 
-    /* sparse: clean up ofile length when last block(s) were not written */
-    if ((FT_REG & od_type) && (! op->oflagp->nowrite) &&
-        op->oflagp->sparse)
-        cp_sparse_cleanup(op, csp);
+/* Writing half of a copy segment: unless sparse, sparing or manifest=
+ * logic bypasses it, writes csp->ocbpt blocks held in bp to OFILE (at
+ * op->seek), plus OFILE2 if given. bp2 is only used by sparing. Returns 0
+ * on success. */
+static int
+cp_write_segment(struct opts_t * op, struct cp_state_t * csp,
+                 unsigned char * bp, unsigned char * bp2, bool continual_read)
+{
+    bool same;
+    bool sparse_skip = false;
+    bool sparing_skip = false;
+    bool tail_lost = false;
+    int res, n;
+    int ret = 0;
+    int od_type = op->odip->d_type;
+    int64_t t0;
 
-#ifdef HAVE_FDATASYNC
-    else if (op->oflagp->fdatasync) {
-        if (fdatasync(op->odip->fd) < 0)
-            perror("fdatasync() error");
-        if (op->verbose)
-            pr2serr("Called fdatasync() on %s successfully\n", op->odip->fn);
+    if ((op->o2dip->fd >= 0) &&
+        ((ret = cp_write_of2(op, csp, bp))))
+        return ret;
+
+    if (op->mfp) {
+        /* only chunks whose digest differs from MF are written */
+        ret = cp_finer_comp_wr(op, csp, bp, NULL);
+        if (ret)
+            mf_invalidate(op, op->seek, csp->ocbpt + 1);
+        return ret;
     }
-#endif
-#ifdef HAVE_FSYNC
-    else if (op->oflagp->fsync) {
-        if (fsync(op->odip->fd) < 0)
-            perror("fsync() error");
-        if (op->verbose)
-            pr2serr("Called fsync() on %s successfully\n", op->odip->fn);
+    if (op->oflagp->sparse) {
+        n = (csp->ocbpt * op->obs) + csp->partial_write_bytes;
+        t0 = lat_start(op);
+        same = csp->in_hole || (first_nonzero(bp, n) >= n);
+        lat_end(op, DDPT_PH_COMP, t0);
+        if (same) {
+            sparse_skip = true;
+            if (cp_trim_capable(op)) {
+                cp_trim_add(op, csp, op->seek, csp->ocbpt);
+                if ((csp->partial_write_bytes > 0) &&
+                    (! cp_trim_tail(op, op->seek + csp->ocbpt,
+                                    csp->partial_write_bytes)))
+                    tail_lost = true;   /* counted in trim_errs */
+            }
+        } else if (op->obpch)
+            return cp_finer_comp_wr(op, csp, bp, NULL);
+    }
+    if (op->oflagp->sparing && (! sparse_skip)) {
+        /* In write sparing, we read from the output */
+        if (FT_PT & od_type)
+            res = cp_read_of_pt(op, csp, bp2);
+        else
+            res = cp_read_of_block_reg(op, csp, bp2);
+        if (0 == res) {
+            n = (csp->ocbpt * op->obs) + csp->partial_write_bytes;
+            t0 = lat_start(op);
+            same = (0 == memcmp(bp, bp2, n));
+            lat_end(op, DDPT_PH_COMP, t0);
+            if (same)
+                sparing_skip = true;
+            else if (op->obpch)
+                return cp_finer_comp_wr(op, csp, bp, bp2);
+        } else
+            return res;
     }
-#endif
 
-copy_end:
-    if (op->idip->ptvp) {
-        pt_destruct_obj(op->idip->ptvp);
-        op->idip->ptvp = NULL;
+    /* Start of writing section */
+    if (sparing_skip || sparse_skip) {
+        op->out_sparse += csp->ocbpt;
+        if ((csp->partial_write_bytes > 0) && (! tail_lost))
+            ++op->out_sparse_partial;
+    } else {
+        if (FT_DEV_NULL & od_type)
+            ;  /* don't bump out_full (earlier revs did) */
+        else {
+            signals_process_delay(op, DELAY_WRITE);
+            if (FT_PT & od_type) {
+                if ((ret = cp_write_pt(op, csp, 0, csp->ocbpt, bp)))
+                    return ret;
+            } else if (FT_TAPE & od_type) {
+#ifdef SG_LIB_LINUX
+                bool could_be_last;
+
+                could_be_last = ((! continual_read) &&
+                                 (csp->icbpt >= op->dd_count));
+                if ((ret = cp_write_tape(op, csp, bp, could_be_last)))
+                    return ret;
+#else
+                pr2serr("writing to tape not supported in this OS\n");
+                return SG_LIB_CAT_OTHER;
+#endif
+            } else if ((ret = cp_write_block_reg(op, csp, 0, csp->ocbpt,
+                                                 bp))) /* plus fifo */
+                return ret;
+        }
     }
-    if (op->odip->ptvp) {
-        pt_destruct_obj(op->odip->ptvp);
-        op->odip->ptvp = NULL;
+    return 0;
+}
+
+#if defined(HAVE_COPY_FILE_RANGE) || defined(HAVE_SPLICE)
+
+/* Book-keeping after a segment has been copied within the kernel: done
+ * bytes of the len requested. A short copy is treated like a short read
+ * (EOF) followed by its write. */
+static void
+cp_kernel_copy_done(struct opts_t * op, struct cp_state_t * csp,
+                    int64_t done, int64_t len)
+{
+    csp->bytes_read = (int)done;
+    csp->bytes_of = (int)done;
+    if (done < len) {
+        csp->icbpt = (int)(done / op->ibs);
+        if ((done % op->ibs) > 0) {
+            ++csp->icbpt;
+            ++op->in_partial;
+            --op->in_full;
+        }
+        csp->ocbpt = (int)(done / op->obs);
+        csp->partial_write_bytes = (int)(done % op->obs);
+        if (csp->partial_write_bytes > 0)
+            ++op->out_partial;
+        csp->leave_after_write = true;
+        csp->leave_reason = 0;
     }
-    return ret;
+    op->in_full += csp->icbpt;
+    op->out_full += csp->ocbpt;
 }
 
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+
+/* Copies one segment between regular files without it passing through
+ * user space: a reflink (FICLONERANGE) if the filesystem supports it,
+ * else copy_file_range(). Both use explicit offsets so csp->if_filepos and
+ * csp->of_filepos are unaffected. Returns 0 on success, -1 if the kernel
+ * can't do this (caller should read() and write() instead), else an
+ * SG_LIB_CAT_* value. */
 static int
-prepare_pi(struct opts_t * op)
+cp_cfr_segment(struct opts_t * op, struct cp_state_t * csp)
 {
-#define PI_WORK 1       /* Protection Information */
-#ifdef PI_WORK
-    int res;
-
-    op->ibs_pi = op->ibs;
-    op->obs_pi = op->obs;
-    if (op->rdprotect) {
-        if ((0 == op->idip->prot_type) || (! (FT_PT & op->idip->d_type))) {
-            pr2serr("IFILE is not a pt device or doesn't have "
-                    "protection information\n");
-            return SG_LIB_CAT_OTHER;
-        }
-        if (op->ibs != op->obs) {
-            pr2serr("protect: don't support IFILE and OFILE "
-                    "with different block sizes\n");
-            return SG_LIB_CAT_OTHER;
-        }
-        if (op->wrprotect) {
-            if (op->idip->p_i_exp != op->odip->p_i_exp) {
-                pr2serr("Don't support IFILE and OFILE with "
-                        "different P_I_EXP fields\n");
-                return SG_LIB_CAT_OTHER;
+    int err;
+    int ifd = op->idip->fd;
+    int ofd = op->odip->fd;
+    int64_t len = (int64_t)csp->icbpt * op->ibs;
+    int64_t done = 0;
+    loff_t off_in = op->skip * op->ibs;
+    loff_t off_out = op->seek * op->obs;
+    ssize_t res;
+
+#ifdef FICLONERANGE
+    /* clone only ranges within IFILE, the kernel decides on alignment */
+    if (op->reflink_active && ((off_in + len) <= op->cfr_in_size)) {
+        struct file_clone_range fcr;
+
+        fcr.src_fd = ifd;
+        fcr.src_offset = off_in;
+        fcr.src_length = len;
+        fcr.dest_offset = off_out;
+        if (0 == ioctl(ofd, FICLONERANGE, &fcr))
+            done = len;
+        else {
+            err = errno;
+            if (EINVAL != err) {        /* EINVAL: misaligned, this time */
+                op->reflink_active = false;
+                if (op->verbose)
+                    pr2serr("FICLONERANGE: %s, use copy_file_range\n",
+                            safe_strerror(err));
             }
         }
-        res = (op->idip->p_i_exp ? (1 << op->idip->p_i_exp) : 1) * 8;
-        op->ibs_pi += res;
-        op->obs_pi += res;
     }
-    if (op->wrprotect) {
-        if ((0 == op->odip->prot_type) || (! (FT_PT & op->odip->d_type))) {
-            pr2serr("OFILE is not a pt device or doesn't have "
-                    "protection information\n");
-            return SG_LIB_CAT_OTHER;
-        }
-        if (op->ibs != op->obs) {
-            pr2serr("protect: don't support IFILE and OFILE "
-                    "with different block sizes\n");
-            return SG_LIB_CAT_OTHER;
+#endif
+    while (done < len) {
+        res = copy_file_range(ifd, &off_in, ofd, &off_out, len - done, 0);
+        if (res < 0) {
+            err = errno;
+            if (EINTR == err) {
+                ++op->interrupted_retries;
+                continue;
+            }
+            if ((0 == done) && ((ENOSYS == err) || (EXDEV == err) ||
+                                (EOPNOTSUPP == err) || (EINVAL == err))) {
+                if (op->verbose)
+                    pr2serr("copy_file_range: %s, use read and write\n",
+                            safe_strerror(err));
+                return -1;
+            }
+            pr2serr("copy_file_range, skip=%" PRId64 ", seek=%" PRId64
+                    " : %s\n", op->skip, op->seek, safe_strerror(err));
+            if ((EIO == err) || (EREMOTEIO == err))
+                return SG_LIB_CAT_MEDIUM_HARD;
+            return (ENOSPC == err) ? SG_LIB_FILE_ERROR : SG_LIB_CAT_OTHER;
         }
-        res = (op->odip->p_i_exp ? (1 << op->odip->p_i_exp) : 1) * 8;
-        op->ibs_pi += res;
-        op->obs_pi += res;
+        if (0 == res)
+            break;      /* EOF on IFILE */
+        done += res;
     }
-#else
-    if (op) { ; }       /* suppress warning */
-#endif  /* PI_WORK */
+    if (op->verbose > 2)
+        pr2serr("%s: skip=%" PRId64 ", requested bytes=%" PRId64 ", done=%"
+                PRId64 "\n", __func__, op->skip, len, done);
+    cp_kernel_copy_done(op, csp, done, len);
     return 0;
 }
 
+#endif  /* HAVE_COPY_FILE_RANGE */
+
+#ifdef HAVE_SPLICE
+
+/* Copies one segment with splice() when IFILE or OFILE (or both) is a
+ * pipe, so the data moves between the pipe and the other side without a
+ * copy into bp. The non-pipe side uses an explicit offset so its filepos is
+ * unaffected. Returns 0 on success, -1 if the kernel can't do this (caller
+ * should read() and write() instead), else an SG_LIB_CAT_* value. */
 static int
-open_files_devices(struct opts_t * op)
+cp_splice_segment(struct opts_t * op, struct cp_state_t * csp)
 {
-    int fd, ret;
-    struct dev_info_t * idip = op->idip;
-    struct dev_info_t * odip = op->odip;
-    struct dev_info_t * o2dip = op->o2dip;
-
-#ifdef SG_LIB_WIN32
-    win32_adjust_fns_pt(op);
-#endif
-    if (idip->fn[0]) {
-        if (('-' == idip->fn[0]) && ('\0' == idip->fn[1])) {
-            fd = STDIN_FILENO;
-            idip->d_type = FT_FIFO;
-            op->reading_fifo = true;
+    bool in_pipe = !! (FT_FIFO & op->idip->d_type);
+    bool out_pipe = !! (FT_FIFO & op->odip->d_type);
+    int err;
+    int64_t len = (int64_t)csp->icbpt * op->ibs;
+    int64_t done = 0;
+    loff_t off_in = op->skip * op->ibs;
+    loff_t off_out = op->seek * op->obs;
+    ssize_t res;
+
+    while (done < len) {
+        res = splice(op->idip->fd, (in_pipe ? NULL : &off_in),
+                     op->odip->fd, (out_pipe ? NULL : &off_out),
+                     (size_t)(len - done), SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (res < 0) {
+            err = errno;
+            if (EINTR == err) {
+                ++op->interrupted_retries;
+                continue;
+            }
+            if ((0 == done) && ((ENOSYS == err) || (EINVAL == err))) {
+                if (op->verbose)
+                    pr2serr("splice: %s, use read and write\n",
+                            safe_strerror(err));
+                return -1;
+            }
+            pr2serr("splice, skip=%" PRId64 ", seek=%" PRId64 " : %s\n",
+                    op->skip, op->seek, safe_strerror(err));
+            if ((EIO == err) || (EREMOTEIO == err))
+                return SG_LIB_CAT_MEDIUM_HARD;
+            return (ENOSPC == err) ? SG_LIB_FILE_ERROR : SG_LIB_CAT_OTHER;
+        }
+        if (0 == res)
+            break;      /* EOF on IFILE */
+        done += res;
+    }
+    if (op->verbose > 2)
+        pr2serr("%s: skip=%" PRId64 ", requested bytes=%" PRId64 ", done=%"
+                PRId64 "\n", __func__, op->skip, len, done);
+    /* pipe side filepos is notional, keep it as read() and write() do */
+    if (in_pipe)
+        csp->if_filepos = (op->skip * op->ibs) + done;
+    if (out_pipe)
+        csp->of_filepos += done;
+    cp_kernel_copy_done(op, csp, done, len);
+    return 0;
+}
+
+#endif  /* HAVE_SPLICE */
+
+static size_t
+page_size(void)
+{
+#if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
+    return sysconf(_SC_PAGESIZE); /* POSIX.1 (was getpagesize()) */
+#elif defined(SG_LIB_WIN32)
+    return win32_pagesize();
+#else
+    return 4096;        /* give up, pick likely figure */
+#endif
+}
+
+#ifdef SG_LIB_LINUX
+
+/* iflag=mmap and oflag=mmap: sets up op->mmp before the main copy loop.
+ * Windows are at least DDPT_MM_WIN_BYTES and hold two segments so one
+ * that straddles a window boundary can be mapped whole. */
+static void
+mm_begin(struct opts_t * op)
+{
+    size_t seg = (size_t)op->ibs_pi * op->bpt_i;
+    struct mm_ctl_t * mmp;
+    struct stat a_st;
+
+    mmp = (struct mm_ctl_t *)calloc(1, sizeof(*mmp));
+    if (NULL == mmp) {
+        pr2serr("mmap flag: out of memory, ignored\n");
+        return;
+    }
+    mmp->psz = page_size();
+    mmp->win = DDPT_MM_WIN_BYTES;
+    if (mmp->win < (2 * (seg + mmp->psz)))
+        mmp->win = 2 * (seg + mmp->psz);
+    mmp->win -= mmp->win % mmp->psz;
+    if (op->iflagp->mmap && (0 == fstat(op->idip->fd, &a_st))) {
+        mmp->in.active = true;
+        mmp->in.fd = op->idip->fd;
+        mmp->in.prot = PROT_READ;
+        mmp->in.size = a_st.st_size;
+    }
+    if (op->oflagp->mmap && (0 == fstat(op->odip->fd, &a_st))) {
+        mmp->out.active = true;
+        mmp->out.fd = op->odip->fd;
+        mmp->out.prot = PROT_READ | PROT_WRITE;
+        mmp->out.size = a_st.st_size;
+        mmp->out.orig_size = a_st.st_size;
+        mmp->out.hi = a_st.st_size;
+        if (op->dd_count > 0)
+            mmp->out.cap = (op->seek * op->obs_pi) +
+                           (op->dd_count * op->ibs_pi);
+    }
+    op->mmp = mmp;
+    if (op->verbose > 1)
+        pr2serr("mmap flag: %s%s%s through %zu byte windows\n",
+                mmp->in.active ? "IFILE" : "",
+                (mmp->in.active && mmp->out.active) ? " and " : "",
+                mmp->out.active ? "OFILE" : "", mmp->win);
+}
+
+/* Unmaps the windows, see mm_out_close() for OFILE. Returns 0 on success,
+ * else SG_LIB_FILE_ERROR if OFILE's data may not have been written. */
+static int
+mm_end(struct opts_t * op)
+{
+    int ret;
+    struct mm_ctl_t * mmp = op->mmp;
+
+    if (NULL == mmp)
+        return 0;
+    if (mmp->in.base)
+        munmap(mmp->in.base, mmp->in.len);
+    ret = mm_out_close(op, &mmp->out);
+    free(mmp);
+    op->mmp = NULL;
+    return ret;
+}
+
+#endif  /* SG_LIB_LINUX */
+
+#ifdef SG_LIB_LINUX
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#define WB_THP_SZ (2 * 1024 * 1024)
+
+/* mem=: placed just below the position handed out so wrk_buff_free() can
+ * unmap the whole mapping */
+struct wb_map_t {
+    void * base;
+    size_t len;
+};
+
+/* Returns the NUMA node of the controller serving the block or char device
+ * open on fd, found by walking up its sysfs device path to the first
+ * numa_node attribute. Returns -1 if none or unknown. */
+static int
+dev_numa_node(int fd)
+{
+    int node = -1;
+    size_t k;
+    struct stat a_st;
+    FILE * fp;
+    char * cp;
+    char b[128];
+    char rp[PATH_MAX + 16];
+
+    if ((fstat(fd, &a_st) < 0) ||
+        (! (S_ISBLK(a_st.st_mode) || S_ISCHR(a_st.st_mode))))
+        return -1;
+    snprintf(b, sizeof(b), "/sys/dev/%s/%u:%u",
+             S_ISBLK(a_st.st_mode) ? "block" : "char",
+             major(a_st.st_rdev), minor(a_st.st_rdev));
+    if (NULL == realpath(b, rp))
+        return -1;
+    while ((k = strlen(rp)) > strlen("/sys/devices/")) {
+        snprintf(rp + k, sizeof(rp) - k, "/numa_node");
+        fp = fopen(rp, "r");
+        rp[k] = '\0';
+        if (fp) {
+            if (1 != fscanf(fp, "%d", &node))
+                node = -1;
+            fclose(fp);
+            break;
+        }
+        if (NULL == (cp = strrchr(rp, '/')))
+            break;
+        *cp = '\0';
+    }
+    return node;
+}
+
+/* mem=MEM[,auto]: binds work buffers to the NUMA node of IFILE, or of
+ * OFILE if IFILE doesn't say. They are both served by the same memory. */
+static void
+mem_node_check(struct opts_t * op)
+{
+    if (DDPT_MEM_AUTO_NODE != op->mem_node)
+        return;
+    op->mem_node = DDPT_MEM_NO_NODE;
+    if ((FT_PT | FT_BLOCK) & op->idip->d_type)
+        op->mem_node = dev_numa_node(op->idip->fd);
+    if ((op->mem_node < 0) && ((FT_PT | FT_BLOCK) & op->odip->d_type))
+        op->mem_node = dev_numa_node(op->odip->fd);
+    if (op->verbose) {
+        if (op->mem_node < 0)
+            pr2serr("mem=,auto: no NUMA node found, buffers not bound\n");
+        else
+            pr2serr("mem=,auto: buffers on NUMA node %d\n", op->mem_node);
+    }
+}
+
+/* mem=MEM: work buffer of len bytes from an anonymous mapping, zeroed by
+ * the kernel as each page is first touched (so no memset). With huge or
+ * huge1g hugetlb pages are tried first; if none are reserved, or with thp,
+ * the mapping is advised to use transparent hugepages and the buffer
+ * starts on a 2 MB boundary. With a NUMA node the mapping is bound to it
+ * (preferred, so a full node falls back) before any page is touched. */
+static unsigned char *
+wrk_buff_map(struct opts_t * op, int len, size_t psz)
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    size_t hsz, align, mlen;
+    uintptr_t up;
+    void * base = MAP_FAILED;
+    struct wb_map_t * wmp;
+
+    if (op->mem_type >= DDPT_MEM_HUGE) {
+#ifdef MAP_HUGETLB
+        if (DDPT_MEM_HUGE1G == op->mem_type) {
+            hsz = 1024 * 1024 * 1024;
+            flags |= (30 << MAP_HUGE_SHIFT);
+        } else {
+            hsz = WB_THP_SZ;
+            flags |= (21 << MAP_HUGE_SHIFT);
+        }
+        mlen = ((len + psz + hsz - 1) / hsz) * hsz;
+        base = mmap(NULL, mlen, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB,
+                    -1, 0);
+        flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+        if ((MAP_FAILED == base) && op->verbose)
+            pr2serr("mem=%s: no hugetlb pages, trying transparent ones\n",
+                    (DDPT_MEM_HUGE1G == op->mem_type) ? "huge1g" : "huge");
+    }
+    align = psz;
+    if (MAP_FAILED == base) {
+        if (op->mem_type >= DDPT_MEM_THP)
+            align = WB_THP_SZ;
+        mlen = (((len + psz - 1) / psz) * psz) + align;
+        base = mmap(NULL, mlen, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (MAP_FAILED == base) {
+            pr2serr("mmap: %s, out of memory?\n", safe_strerror(errno));
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        if ((op->mem_type >= DDPT_MEM_THP) &&
+            (madvise(base, mlen, MADV_HUGEPAGE) < 0) && op->verbose)
+            pr2serr("madvise(MADV_HUGEPAGE): %s\n", safe_strerror(errno));
+#endif
+    }
+#ifdef SYS_mbind
+    if (op->mem_node >= 0) {
+        unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+
+        memset(mask, 0, sizeof(mask));
+        mask[op->mem_node / (8 * sizeof(unsigned long))] =
+                1UL << (op->mem_node % (8 * sizeof(unsigned long)));
+        if ((syscall(SYS_mbind, base, mlen, MPOL_PREFERRED, mask,
+                     (unsigned long)(8 * sizeof(mask)), 0) < 0) &&
+            op->verbose)
+            pr2serr("mbind(node=%d): %s\n", op->mem_node,
+                    safe_strerror(errno));
+    }
+#endif
+    up = ((uintptr_t)base + sizeof(struct wb_map_t) + align - 1) &
+         (~((uintptr_t)align - 1));
+    wmp = (struct wb_map_t *)up - 1;
+    wmp->base = base;
+    wmp->len = mlen;
+    if (op->verbose > 1)
+        pr2serr("%s: %d byte buffer in a %zu byte mapping\n", __func__, len,
+                mlen);
+    return (unsigned char *)up;
+}
+
+#endif  /* SG_LIB_LINUX */
+
+/* Frees a work buffer, given what wrk_buff_alloc() placed in *buffp */
+static void
+wrk_buff_free(const struct opts_t * op, unsigned char * buffp)
+{
+    if (NULL == buffp)
+        return;
+#ifdef SG_LIB_LINUX
+    if (DDPT_MEM_HEAP != op->mem_type) {
+        struct wb_map_t * wmp = (struct wb_map_t *)buffp - 1;
+
+        munmap(wmp->base, wmp->len);
+        return;
+    }
+#else
+    if (op) { ; }       /* suppress warning */
+#endif
+    free(buffp);
+}
+
+/* Allocates a zeroed work buffer of len bytes. When O_DIRECT is requested
+ * on IFILE or OFILE the buffer is page aligned; with mem=MEM it is always
+ * (at least) page aligned and comes from wrk_buff_map(). The pointer to
+ * give to wrk_buff_free() is placed in *buffp. Returns the (aligned)
+ * position to use or NULL if out of memory. */
+static unsigned char *
+wrk_buff_alloc(struct opts_t * op, int len, unsigned char ** buffp)
+{
+    unsigned char * bp;
+
+    *buffp = NULL;
+#ifdef SG_LIB_LINUX
+    if (DDPT_MEM_HEAP != op->mem_type) {
+        *buffp = wrk_buff_map(op, len, page_size());
+        return *buffp;
+    }
+#endif
+    if (op->iflagp->direct || op->oflagp->direct) {
+        size_t psz = page_size();
+
+#ifdef HAVE_POSIX_MEMALIGN
+        {
+            int err;
+            void * wp = NULL;
+
+            err = posix_memalign(&wp, psz, len);
+            if (err) {
+                pr2serr("posix_memalign: error [%d] out of memory?\n", err);
+                return NULL;
+            }
+            bp = (unsigned char *)wp;
+            memset(bp, 0, len);
+            *buffp = bp;
+            return bp;
+        }
+#else   /* do not HAVE_POSIX_MEMALIGN */
+        bp = (unsigned char*)calloc(len + psz, 1);
+        if (NULL == bp) {
+            pr2serr("Not enough user memory for aligned usage\n");
+            return NULL;
+        }
+        *buffp = bp;
+        return (unsigned char *)(((uintptr_t)bp + psz - 1) &
+                                 (~((uintptr_t)psz - 1)));
+#endif  /* HAVE_POSIX_MEMALIGN */
+    }
+    bp = (unsigned char*)calloc(len, 1);
+    if (NULL == bp) {
+        pr2serr("Not enough user memory\n");
+        return NULL;
+    }
+    *buffp = bp;
+    return bp;
+}
+
+/* Zeroes the counters of a copy of the main opts_t, as used by worker
+ * threads and by the outputs other than OFILE */
+static void
+mt_zero_stats(struct opts_t * wop)
+{
+    wop->in_full = 0;
+    wop->out_full = 0;
+    wop->out_sparse = 0;
+    wop->in_partial = 0;
+    wop->out_partial = 0;
+    wop->out_sparse_partial = 0;
+    wop->recovered_errs = 0;
+    wop->unrecovered_errs = 0;
+    wop->wr_recovered_errs = 0;
+    wop->wr_unrecovered_errs = 0;
+    wop->trim_errs = 0;
+    wop->num_retries = 0;
+    wop->sum_of_resids = 0;
+    wop->interrupted_retries = 0;
+    wop->io_eagains = 0;
+    wop->err_to_report = 0;
+    wop->lowest_unrecovered = 0;
+    wop->highest_unrecovered = -1;
+    memset(&wop->lat, 0, sizeof(wop->lat));
+}
+
+/* of=OFILE given more than once: OFILE (the first) and up to
+ * DDPT_MAX_OUTS-1 other outputs all written from the same work buffer, so
+ * IFILE is only read once. Each other output gets its own copy of the main
+ * opts_t (so its own odip, flags handling and counters), its own cp_state_t
+ * and, with sparing, its own buffer to read back into. With pthreads each
+ * one is written by its own thread while the main thread writes OFILE, so
+ * a segment takes as long as the slowest output. An error on one of the
+ * other outputs only stops writes to that output. */
+struct fo_out_t {
+    bool failed;                /* no more writes after an error */
+    bool begun;                 /* fo_begin() done for this output */
+    int res;                    /* result of its last (or failed) write */
+    bool continual_read;
+    unsigned char * bp;         /* segment to write */
+    struct opts_t w_op;
+    struct dev_info_t w_ods;
+    struct cp_state_t w_cs;
+    struct fo_ctl_t * fcp;
+#ifdef HAVE_LIBPTHREAD
+    pthread_t tid;
+#endif
+};
+
+struct fo_ctl_t {
+    bool stop;          /* threads should exit */
+    bool sync_init;     /* mtx and condition variables initialized */
+    int num;            /* outputs other than OFILE */
+    int started;        /* threads running */
+    int pending;        /* outputs still writing this segment */
+    int64_t gen;        /* bumped when a segment is ready to write */
+    struct dev_info_t no_of2;   /* of2= is only written once */
+    struct fo_out_t outs[DDPT_MAX_OUTS - 1];
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;          /* main thread to outputs */
+    pthread_cond_t done_cv;     /* outputs to main thread */
+#endif
+};
+
+/* Opens the outputs given after the first of=OFILE with the same oflags,
+ * each must be a pt device, block device or regular file as is OFILE.
+ * Returns 0 on success. */
+static int
+fo_open(struct opts_t * op)
+{
+    int k, fd, res, blk_sz;
+    int64_t num_blks;
+    struct fo_ctl_t * fcp;
+    struct fo_out_t * outp;
+    struct opts_t t_op;
+
+    if (! ((FT_PT | FT_BLOCK | FT_REG) & op->odip->d_type)) {
+        pr2serr("with several of= each must be a pt device, block device "
+                "or regular file\n");
+        return SG_LIB_FILE_ERROR;
+    }
+    fcp = (struct fo_ctl_t *)calloc(1, sizeof(struct fo_ctl_t));
+    if (NULL == fcp) {
+        pr2serr("%s: calloc failed\n", __func__);
+        return SG_LIB_CAT_OTHER;
+    }
+    op->fop = fcp;
+    fcp->no_of2.fd = -1;
+    fcp->no_of2.d_type = FT_OTHER;
+    for (k = 0; k < op->num_xof; ++k) {
+        outp = fcp->outs + k;
+        outp->fcp = fcp;
+        outp->w_ods.fd = -1;
+        outp->w_ods.d_type = FT_OTHER;
+        strcpy(outp->w_ods.fn, op->xof_fn[k]);
+        ++fcp->num;
+        t_op = *op;
+        t_op.odip = &outp->w_ods;
+        if (('-' == outp->w_ods.fn[0]) && ('\0' == outp->w_ods.fn[1]))
+            fd = -1;    /* stdout */
+        else
+            fd = open_of(&t_op);
+        if (fd >= 0)
+            outp->w_ods.fd = fd;
+        if ((fd < 0) || (! ((FT_PT | FT_BLOCK | FT_REG) &
+                            outp->w_ods.d_type))) {
+            if (fd >= -1)
+                pr2serr("%s: must be a pt device, block device or regular "
+                        "file\n", outp->w_ods.fn);
+            return (fd < -1) ? -fd : SG_LIB_FILE_ERROR;
+        }
+        if ((FT_PT & outp->w_ods.d_type) && (! op->oflagp->norcap)) {
+            /* pt LBAs are in device blocks so OBS must match */
+            res = pt_read_capacity(&t_op, DDPT_ARG_OUT, &num_blks, &blk_sz);
+            if (res)
+                pr2serr("Unable to read capacity on %s\n", outp->w_ods.fn);
+            else if ((num_blks > 0) && (blk_sz != op->obs)) {
+                pr2serr(">> warning: %s block size confusion: obs=%d, "
+                        "device claims=%d\n", outp->w_ods.fn, op->obs,
+                        blk_sz);
+                if (0 == op->oflagp->force) {
+                    pr2serr(">> abort copy, use oflag=force to override\n");
+                    return SG_LIB_CAT_OTHER;
+                }
+            }
+        }
+    }
+    if (op->verbose)
+        pr2serr("writing to %d outputs\n", fcp->num + 1);
+    return 0;
+}
+
+/* Writes the current segment to one of the other outputs */
+static void
+fo_write_out(struct fo_out_t * outp)
+{
+    if (outp->failed)
+        return;
+    outp->res = cp_write_segment(&outp->w_op, &outp->w_cs, outp->bp,
+                                 outp->w_op.wrkPos2, outp->continual_read);
+}
+
+#ifdef HAVE_LIBPTHREAD
+
+static void *
+fo_out_thread(void * vp)
+{
+    int64_t gen = 0;
+    struct fo_out_t * outp = (struct fo_out_t *)vp;
+    struct fo_ctl_t * fcp = outp->fcp;
+
+    pthread_mutex_lock(&fcp->mtx);
+    while (true) {
+        while ((! fcp->stop) && (gen == fcp->gen))
+            pthread_cond_wait(&fcp->cv, &fcp->mtx);
+        if (fcp->stop)
+            break;
+        gen = fcp->gen;
+        pthread_mutex_unlock(&fcp->mtx);
+        fo_write_out(outp);
+        pthread_mutex_lock(&fcp->mtx);
+        if (0 == --fcp->pending)
+            pthread_cond_signal(&fcp->done_cv);
+    }
+    pthread_mutex_unlock(&fcp->mtx);
+    return NULL;
+}
+
+#endif  /* HAVE_LIBPTHREAD */
+
+/* Called by do_rw_copy() before the first segment: gives each other output
+ * its copy of opts_t, pt object and sparing buffer, then starts the
+ * threads. Returns 0 on success. */
+static int
+fo_begin(struct opts_t * op)
+{
+    int k;
+    int len = op->ibs_pi * op->bpt_i;
+    struct fo_ctl_t * fcp = op->fop;
+    struct fo_out_t * outp;
+    struct opts_t * wop;
+#ifdef HAVE_LIBPTHREAD
+    int res;
+    sigset_t orig_set;
+#endif
+
+    for (k = 0; k < fcp->num; ++k) {
+        outp = fcp->outs + k;
+        wop = &outp->w_op;
+        *wop = *op;
+        wop->mt_worker = true;
+        wop->odip = &outp->w_ods;
+        wop->o2dip = &fcp->no_of2;
+        wop->fop = NULL;
+        wop->urp = NULL;
+        wop->wrkBuff = NULL;
+        wop->wrkPos = NULL;
+        wop->wrkBuff2 = NULL;
+        wop->wrkPos2 = NULL;
+        mt_zero_stats(wop);
+        outp->begun = true;
+        if (FT_PT & outp->w_ods.d_type) {
+            outp->w_ods.ptvp = (struct sg_pt_base *)pt_construct_obj();
+            if (NULL == outp->w_ods.ptvp)
+                return SG_LIB_CAT_OTHER;
+        }
+        if (op->oflagp->sparing) {
+            wop->wrkPos2 = wrk_buff_alloc(op, len, &wop->wrkBuff2);
+            if (NULL == wop->wrkPos2)
+                return SG_LIB_CAT_OTHER;
+        }
+    }
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_init(&fcp->mtx, NULL);
+    pthread_cond_init(&fcp->cv, NULL);
+    pthread_cond_init(&fcp->done_cv, NULL);
+    fcp->sync_init = true;
+#if SA_NOCLDSTOP
+    /* only the main thread processes signals */
+    pthread_sigmask(SIG_BLOCK, &op->caught_signals, &orig_set);
+#endif
+    for (k = 0; k < fcp->num; ++k) {
+        outp = fcp->outs + k;
+        res = pthread_create(&outp->tid, NULL, fo_out_thread, outp);
+        if (res) {
+            pr2serr("%s: pthread_create: %s\n", __func__,
+                    safe_strerror(res));
+            break;
+        }
+        ++fcp->started;
+    }
+#if SA_NOCLDSTOP
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+#endif
+    if (fcp->started < fcp->num)
+        return SG_LIB_CAT_OTHER;
+#endif
+    return 0;
+}
+
+/* Hands the segment in bp (described by csp) to the other outputs. Without
+ * pthreads they are written here, one after the other. */
+static void
+fo_start(struct opts_t * op, const struct cp_state_t * csp,
+         unsigned char * bp, bool continual_read)
+{
+    int k;
+    struct fo_ctl_t * fcp = op->fop;
+    struct fo_out_t * outp;
+    struct cp_state_t * wcsp;
+
+    for (k = 0; k < fcp->num; ++k) {
+        outp = fcp->outs + k;
+        outp->w_op.seek = op->seek;
+        outp->w_op.dd_count = op->dd_count;
+        wcsp = &outp->w_cs;
+        wcsp->in_hole = csp->in_hole;
+        wcsp->icbpt = csp->icbpt;
+        wcsp->ocbpt = csp->ocbpt;
+        wcsp->bytes_read = csp->bytes_read;
+        wcsp->bytes_of = 0;
+        wcsp->partial_write_bytes = csp->partial_write_bytes;
+        outp->bp = bp;
+        outp->continual_read = continual_read;
+        if (! outp->failed)
+            outp->res = 0;
+    }
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&fcp->mtx);
+    fcp->pending = fcp->num;
+    ++fcp->gen;
+    pthread_cond_broadcast(&fcp->cv);
+    pthread_mutex_unlock(&fcp->mtx);
+#else
+    for (k = 0; k < fcp->num; ++k)
+        fo_write_out(fcp->outs + k);
+#endif
+}
+
+/* Waits until the other outputs have written the segment, stopping writes
+ * to any that failed. */
+static void
+fo_wait(struct opts_t * op)
+{
+    int k;
+    struct fo_ctl_t * fcp = op->fop;
+    struct fo_out_t * outp;
+
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&fcp->mtx);
+    while (fcp->pending > 0)
+        pthread_cond_wait(&fcp->done_cv, &fcp->mtx);
+    pthread_mutex_unlock(&fcp->mtx);
+#endif
+    for (k = 0; k < fcp->num; ++k) {
+        outp = fcp->outs + k;
+        if (outp->res && (! outp->failed)) {
+            outp->failed = true;
+            pr2serr("%s: write failed at seek=%" PRId64 ", no more writes "
+                    "to it\n", outp->w_ods.fn, op->seek);
+        }
+    }
+}
+
+/* Writing half of a copy segment for all outputs: OFILE, plus the others
+ * when of= was given more than once. Returns the result for OFILE. */
+static int
+cp_write_outputs(struct opts_t * op, struct cp_state_t * csp,
+                 unsigned char * bp, unsigned char * bp2, bool continual_read)
+{
+    int ret;
+
+    if (NULL == op->fop)
+        return cp_write_segment(op, csp, bp, bp2, continual_read);
+    fo_start(op, csp, bp, continual_read);
+    ret = cp_write_segment(op, csp, bp, bp2, continual_read);
+    fo_wait(op);
+    return ret;
+}
+
+/* Called by do_rw_copy() at the end of the copy: stops the threads, then
+ * does for each other output what is done for OFILE (length of a sparse
+ * regular file, pending trim, fdatasync and fsync). The first error on
+ * any of them is left in op->err_to_report. */
+static void
+fo_end(struct opts_t * op)
+{
+    int k;
+    struct fo_ctl_t * fcp = op->fop;
+    struct fo_out_t * outp;
+    struct opts_t * wop;
+
+#ifdef HAVE_LIBPTHREAD
+    if (fcp->started > 0) {
+        pthread_mutex_lock(&fcp->mtx);
+        fcp->stop = true;
+        pthread_cond_broadcast(&fcp->cv);
+        pthread_mutex_unlock(&fcp->mtx);
+        for (k = 0; k < fcp->started; ++k)
+            pthread_join(fcp->outs[k].tid, NULL);
+        fcp->started = 0;
+    }
+#endif
+    for (k = 0; k < fcp->num; ++k) {
+        outp = fcp->outs + k;
+        if (! outp->begun)
+            continue;
+        outp->begun = false;
+        wop = &outp->w_op;
+        wop->seek = op->seek;
+        wop->dd_count = 0;
+        if (! outp->failed) {
+            if ((outp->w_cs.trim_blks > 0) || (outp->w_cs.trim_qn > 0))
+                cp_trim_flush(wop, &outp->w_cs);
+            if ((FT_REG & outp->w_ods.d_type) && (! op->oflagp->nowrite) &&
+                op->oflagp->sparse)
+                cp_sparse_cleanup(wop, &outp->w_cs);
+#ifdef HAVE_FDATASYNC
+            else if (op->oflagp->fdatasync &&
+                     (fdatasync(outp->w_ods.fd) < 0))
+                perror("fdatasync() error");
+#endif
+#ifdef HAVE_FSYNC
+            else if (op->oflagp->fsync && (fsync(outp->w_ods.fd) < 0))
+                perror("fsync() error");
+#endif
+        } else if (0 == op->err_to_report)
+            op->err_to_report = outp->res;
+        if (outp->w_cs.ext_map) {
+            free(outp->w_cs.ext_map);
+            outp->w_cs.ext_map = NULL;
+        }
+        if (outp->w_ods.ptvp) {
+            pt_destruct_obj(outp->w_ods.ptvp);
+            outp->w_ods.ptvp = NULL;
+        }
+        if (wop->wrkBuff2) {
+            wrk_buff_free(op, wop->wrkBuff2);
+            wop->wrkBuff2 = NULL;
+        }
+    }
+#ifdef HAVE_LIBPTHREAD
+    if (fcp->sync_init) {
+        fcp->sync_init = false;
+        pthread_cond_destroy(&fcp->done_cv);
+        pthread_cond_destroy(&fcp->cv);
+        pthread_mutex_destroy(&fcp->mtx);
+    }
+#endif
+}
+
+/* Final statistics of the outputs other than OFILE */
+static void
+fo_report(struct opts_t * op)
+{
+    int k;
+    struct fo_out_t * outp;
+    char b[INOUTF_SZ + 8];
+
+    for (k = 0; k < op->fop->num; ++k) {
+        outp = op->fop->outs + k;
+        snprintf(b, sizeof(b), "%s: ", outp->w_ods.fn);
+        print_stats(b, &outp->w_op, 2 /* out only */);
+        if (outp->failed)
+            pr2serr("%swrites stopped after an error\n", b);
+    }
+}
+
+/* Closes the outputs other than OFILE */
+static void
+fo_free(struct opts_t * op)
+{
+    int k;
+    struct fo_out_t * outp;
+
+    if (NULL == op->fop)
+        return;
+    for (k = 0; k < op->fop->num; ++k) {
+        outp = op->fop->outs + k;
+        if (outp->w_ods.fd < 0)
+            continue;
+        if (FT_PT & outp->w_ods.d_type)
+            pt_close(outp->w_ods.fd);
+        else
+            close(outp->w_ods.fd);
+    }
+    free(op->fop);
+    op->fop = NULL;
+}
+
+/* Copies one segment: reads csp->icbpt blocks from IFILE (at op->skip)
+ * into bp, then unless sparse or sparing logic bypasses it, writes
+ * csp->ocbpt blocks to OFILE (at op->seek). bp2 is only used by sparing.
+ * When nothing is read csp->icbpt is set to 0. Returns 0 on success. */
+static int
+cp_rw_segment(struct opts_t * op, struct cp_state_t * csp,
+              unsigned char * bp, unsigned char * bp2, bool continual_read)
+{
+    int ret;
+
+#ifdef HAVE_COPY_FILE_RANGE
+    if (op->cfr_active) {
+        ret = cp_cfr_segment(op, csp);
+        if (ret >= 0)
+            return ret;
+        op->cfr_active = false;         /* fall back for rest of copy */
+    }
+#endif
+#ifdef HAVE_SPLICE
+    if (op->splice_active) {
+        ret = cp_splice_segment(op, csp);
+        if (ret >= 0)
+            return ret;
+        op->splice_active = false;
+    }
+#endif
+    if ((ret = cp_read_segment(op, csp, bp)))
+        return ret;
+    if (0 == csp->icbpt)
+        return 0;       /* nothing read so caller should leave loop */
+    if (csp->mm_bp)
+        bp = csp->mm_bp;        /* iflag=mmap */
+    return cp_write_outputs(op, csp, bp, bp2, continual_read);
+}
+
+#ifdef HAVE_LIBPTHREAD
+
+#define MT_POLL_MS 100  /* main thread checks signals this often */
+
+/* State shared by the worker threads of a multi-threaded (thr=THR) copy.
+ * Workers claim the next segment under mtx, copy it using their own
+ * cp_state_t, work buffer(s), file descriptors and pt objects, then fold
+ * their counters into the main opts_t, also under mtx. With thr=THR,shard
+ * each worker instead claims the next segment of its own contiguous part
+ * (shard) of the copy. */
+struct mt_ctl_t {
+    bool stop;          /* set on error or when the end of IFILE is found */
+    bool shard;         /* thr=THR,shard */
+    int ret;            /* first non-zero result from a worker */
+    int active;         /* number of workers still running */
+    int part_wr_bytes;  /* partial_write_bytes of last segment */
+    int64_t next_skip;  /* start of next unclaimed segment (IFILE) */
+    int64_t next_seek;  /* start of next unclaimed segment (OFILE) */
+    int64_t unclaimed;  /* input blocks not yet claimed by a worker */
+    int64_t hi_skip;    /* highest skip+icbpt of a completed segment */
+    int64_t hi_seek;    /* highest seek+ocbpt of a completed segment */
+    int64_t hi_of_filepos;
+    int64_t skip0;      /* skip and seek when the workers started */
+    int64_t seek0;
+    int64_t pend_blks;  /* copied blocks not yet taken off op->dd_count */
+    struct opts_t * op;
+    struct opts_t pend; /* worker statistics not yet folded into op */
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+};
+
+struct mt_worker_t {
+    int id;
+    int64_t cur_skip;           /* segment being copied, -1: none */
+    int64_t shard_next;         /* thr=THR,shard: next segment to claim */
+    int64_t shard_end;          /*   and the end of this worker's shard */
+    pthread_t tid;
+    struct mt_ctl_t * mcp;
+    struct opts_t w_op;         /* private copy of main opts_t */
+    struct dev_info_t w_ids;
+    struct dev_info_t w_ods;
+    struct cp_state_t w_cs;
+};
+
+/* Adds a worker's statistics into those of the main opts_t, then zeroes
+ * the worker's copy. Caller should hold mtx. */
+static void
+mt_fold_stats(struct opts_t * op, struct opts_t * wop)
+{
+    op->in_full += wop->in_full;
+    op->out_full += wop->out_full;
+    op->out_sparse += wop->out_sparse;
+    op->in_partial += wop->in_partial;
+    op->out_partial += wop->out_partial;
+    op->out_sparse_partial += wop->out_sparse_partial;
+    op->recovered_errs += wop->recovered_errs;
+    op->unrecovered_errs += wop->unrecovered_errs;
+    op->wr_recovered_errs += wop->wr_recovered_errs;
+    op->wr_unrecovered_errs += wop->wr_unrecovered_errs;
+    op->trim_errs += wop->trim_errs;
+    op->num_retries += wop->num_retries;
+    op->sum_of_resids += wop->sum_of_resids;
+    op->interrupted_retries += wop->interrupted_retries;
+    op->io_eagains += wop->io_eagains;
+    lat_stats_fold(&op->lat, &wop->lat);
+    if ((0 == op->err_to_report) && wop->err_to_report)
+        op->err_to_report = wop->err_to_report;
+    if (wop->highest_unrecovered >= 0) {
+        if (op->highest_unrecovered < 0) {
+            op->lowest_unrecovered = wop->lowest_unrecovered;
+            op->highest_unrecovered = wop->highest_unrecovered;
+        } else {
+            if (wop->lowest_unrecovered < op->lowest_unrecovered)
+                op->lowest_unrecovered = wop->lowest_unrecovered;
+            if (wop->highest_unrecovered > op->highest_unrecovered)
+                op->highest_unrecovered = wop->highest_unrecovered;
+        }
+    }
+    mt_zero_stats(wop);
+}
+
+/* Each worker needs its own file position on non-pt IFILE and OFILE so
+ * the file is re-opened (by name) with the same status flags. pt devices
+ * share the file descriptor but each worker gets its own pt object.
+ * Returns 0 on success. */
+static int
+mt_worker_open(struct opts_t * op, struct dev_info_t * dip,
+               const struct dev_info_t * main_dip)
+{
+    int flags, fd;
+
+    *dip = *main_dip;
+    dip->ptvp = NULL;
+    if (FT_PT & dip->d_type) {
+        dip->ptvp = (struct sg_pt_base *)pt_construct_obj();
+        if (NULL == dip->ptvp)
+            return SG_LIB_CAT_OTHER;
+    } else if ((FT_REG | FT_BLOCK) & dip->d_type) {
+        flags = fcntl(main_dip->fd, F_GETFL);
+        if (flags < 0) {
+            pr2serr("%s: fcntl(F_GETFL) on %s: %s\n", __func__, dip->fn,
+                    safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+        flags &= ~(O_CREAT | O_EXCL | O_TRUNC | O_APPEND);
+        fd = open(dip->fn, flags);
+        if (fd < 0) {
+            pr2serr("%s: could not re-open %s: %s\n", __func__, dip->fn,
+                    safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+        dip->fd = fd;
+        if (op->verbose > 3)
+            pr2serr("%s: re-opened %s, fd=%d, flags=0x%x\n", __func__,
+                    dip->fn, fd, flags);
+    }
+    return 0;
+}
+
+static void
+mt_worker_close(struct dev_info_t * dip, const struct dev_info_t * main_dip)
+{
+    if (dip->ptvp) {
+        pt_destruct_obj(dip->ptvp);
+        dip->ptvp = NULL;
+    }
+    if ((dip->fd >= 0) && (dip->fd != main_dip->fd))
+        close(dip->fd);
+    dip->fd = -1;
+}
+
+static void *
+mt_worker_thread(void * vp)
+{
+    int res, n;
+    int64_t blks;
+    struct mt_worker_t * wp = (struct mt_worker_t *)vp;
+    struct mt_ctl_t * mcp = wp->mcp;
+    struct opts_t * op = mcp->op;
+    struct opts_t * wop = &wp->w_op;
+    struct cp_state_t * csp = &wp->w_cs;
+
+    while (true) {
+        pthread_mutex_lock(&mcp->mtx);
+        if (mcp->stop || (mcp->unclaimed <= 0)) {
+            pthread_mutex_unlock(&mcp->mtx);
+            break;
+        }
+        if (mcp->shard) {
+            blks = wp->shard_end - wp->shard_next;
+            if (blks <= 0) {
+                pthread_mutex_unlock(&mcp->mtx);
+                break;
+            }
+            if (blks > op->bpt_i)
+                blks = op->bpt_i;
+            /* shards start on a segment boundary so this is exact */
+            wop->skip = wp->shard_next;
+            wop->seek = mcp->seek0 +
+                        ((wp->shard_next - mcp->skip0) * op->ibs) / op->obs;
+            wp->shard_next += blks;
+        } else {
+            blks = (mcp->unclaimed < op->bpt_i) ? mcp->unclaimed :
+                                                  op->bpt_i;
+            wop->skip = mcp->next_skip;
+            wop->seek = mcp->next_seek;
+            n = (int)blks * op->ibs;
+            mcp->next_skip += blks;
+            mcp->next_seek += (n / op->obs) + ((n % op->obs) ? 1 : 0);
+        }
+        wop->dd_count = blks;
+        wp->cur_skip = wop->skip;
+        mcp->unclaimed -= blks;
+        pthread_mutex_unlock(&mcp->mtx);
+
+        /* like do_rw_copy(), no delay before the first segment */
+        if (wop->skip != mcp->skip0)
+            signals_process_delay(wop, DELAY_COPY_SEGMENT);
+        cp_segment_init(wop, csp, wop->wrkPos, false);
+        if (wop->ratep)
+            rate_limit(wop, (int64_t)csp->icbpt * wop->ibs);
+        res = cp_rw_segment(wop, csp, wop->wrkPos, wop->wrkPos2, false);
+        /* journal=: the main thread can't see a worker's pending trim */
+        if (wop->jrnlp && ((csp->trim_blks > 0) || (csp->trim_qn > 0)))
+            cp_trim_flush(wop, csp);
+#ifdef HAVE_POSIX_FADVISE
+        if ((0 == res) && (csp->icbpt > 0))
+            do_fadvise(wop, csp->bytes_read, csp->bytes_of,
+                       csp->bytes_of2);
+#endif
+        if (wop->verbose > 3)
+            pr2serr("thread %d: skip=%" PRId64 ", seek=%" PRId64 ", "
+                    "icbpt=%d, res=%d\n", wp->id, wop->skip, wop->seek,
+                    csp->icbpt, res);
+
+        pthread_mutex_lock(&mcp->mtx);
+        mt_fold_stats(&mcp->pend, wop);
+        if (res) {
+            if (0 == mcp->ret)
+                mcp->ret = res;
+            mcp->stop = true;
+        } else if (0 == csp->icbpt)
+            mcp->stop = true;   /* nothing read, assume EOF */
+        else {
+            mcp->pend_blks += csp->icbpt;
+            wp->cur_skip = -1;  /* failed segments hold the journal back */
+            if ((wop->skip + csp->icbpt) > mcp->hi_skip)
+                mcp->hi_skip = wop->skip + csp->icbpt;
+            if ((wop->seek + csp->ocbpt) > mcp->hi_seek) {
+                mcp->hi_seek = wop->seek + csp->ocbpt;
+                mcp->part_wr_bytes = csp->partial_write_bytes;
+            }
+            if (csp->of_filepos > mcp->hi_of_filepos)
+                mcp->hi_of_filepos = csp->of_filepos;
+            if (csp->leave_after_write) {
+                if ((0 == mcp->ret) && csp->leave_reason)
+                    mcp->ret = csp->leave_reason;
+                /* other shards go on after the last segment of the copy */
+                if ((0 != mcp->ret) || (! mcp->shard) ||
+                    ((wop->skip + blks) < mcp->next_skip))
+                    mcp->stop = true;
+            }
+        }
+        pthread_mutex_unlock(&mcp->mtx);
+    }
+    if ((csp->trim_blks > 0) || (csp->trim_qn > 0)) {
+        cp_trim_flush(wop, csp);
+        pthread_mutex_lock(&mcp->mtx);
+        mt_fold_stats(&mcp->pend, wop);
+        pthread_mutex_unlock(&mcp->mtx);
+    }
+    if (csp->ext_map) {
+        free(csp->ext_map);
+        csp->ext_map = NULL;
+    }
+    pthread_mutex_lock(&mcp->mtx);
+    --mcp->active;
+    pthread_cond_signal(&mcp->cv);
+    pthread_mutex_unlock(&mcp->mtx);
+    return NULL;
+}
+
+/* journal=: input blocks, from the start of the copy as first started,
+ * below the lowest segment a worker is still copying (or failed on) or,
+ * with shards, has yet to claim. Caller should hold mtx. */
+static int64_t
+mt_jrnl_done(const struct mt_ctl_t * mcp, const struct mt_worker_t * warr,
+             int nthr)
+{
+    int k;
+    int64_t lo = mcp->next_skip;
+
+    for (k = 0; k < nthr; ++k) {
+        if ((warr[k].cur_skip >= 0) && (warr[k].cur_skip < lo))
+            lo = warr[k].cur_skip;
+        else if (mcp->shard && (warr[k].shard_next < warr[k].shard_end) &&
+                 (warr[k].shard_next < lo))
+            lo = warr[k].shard_next;
+    }
+    return lo - mcp->op->jrnl_skip0;
+}
+
+/* Multi-threaded version of the main copy loop, called when thr=THR is
+ * greater than 1. The main thread waits for the workers, processing
+ * signals (e.g. progress reports) meanwhile. On return csp holds what
+ * cp_sparse_cleanup() needs. Returns 0 if successful. */
+static int
+mt_rw_copy(struct opts_t * op, struct cp_state_t * csp)
+{
+    int k, res;
+    int ret = 0;
+    int started = 0;
+    int len = op->ibs_pi * op->bpt_i;
+    int64_t done, per;
+    struct mt_worker_t * wp;
+    struct mt_worker_t * warr;
+    struct mt_ctl_t mc;
+    struct timespec ts;
+    sigset_t orig_set;
+
+    warr = (struct mt_worker_t *)calloc(op->num_threads,
+                                        sizeof(struct mt_worker_t));
+    if (NULL == warr) {
+        pr2serr("%s: calloc for %d threads failed\n", __func__,
+                op->num_threads);
+        return SG_LIB_CAT_OTHER;
+    }
+    memset(&mc, 0, sizeof(mc));
+    mc.op = op;
+    mc.next_skip = op->skip;
+    mc.next_seek = op->seek;
+    mc.unclaimed = op->dd_count;
+    mc.hi_skip = op->skip;
+    mc.hi_seek = op->seek;
+    mc.skip0 = op->skip;
+    mc.seek0 = op->seek;
+    mc.shard = op->thr_shard;
+    if (mc.shard) {
+        /* all claims come from the shards, next_skip marks the end */
+        mc.next_skip = op->skip + op->dd_count;
+        per = (op->dd_count + op->num_threads - 1) / op->num_threads;
+        per = ((per + op->bpt_i - 1) / op->bpt_i) * op->bpt_i;
+    } else
+        per = 0;
+    mc.pend = *op;
+    mt_zero_stats(&mc.pend);
+    pthread_mutex_init(&mc.mtx, NULL);
+    pthread_cond_init(&mc.cv, NULL);
+
+    for (k = 0; k < op->num_threads; ++k) {
+        warr[k].cur_skip = -1;
+        warr[k].w_ids.fd = -1;
+        warr[k].w_ods.fd = -1;
+        if (mc.shard) {
+            warr[k].shard_next = op->skip + (k * per);
+            warr[k].shard_end = warr[k].shard_next + per;
+            if (warr[k].shard_end > mc.next_skip)
+                warr[k].shard_end = mc.next_skip;
+            if (op->verbose > 1)
+                pr2serr("%s: thread %d shard: skip=%" PRId64 " for %" PRId64
+                        " blocks\n", __func__, k, warr[k].shard_next,
+                        (warr[k].shard_end > warr[k].shard_next) ?
+                        (warr[k].shard_end - warr[k].shard_next) : 0);
+        }
+    }
+    for (k = 0; k < op->num_threads; ++k) {
+        wp = warr + k;
+        wp->id = k;
+        wp->mcp = &mc;
+        wp->w_op = *op;
+        wp->w_op.mt_worker = true;
+        wp->w_op.idip = &wp->w_ids;
+        wp->w_op.odip = &wp->w_ods;
+        wp->w_op.wrkBuff = NULL;
+        wp->w_op.wrkBuff2 = NULL;
+        mt_zero_stats(&wp->w_op);
+        if ((ret = mt_worker_open(op, &wp->w_ids, op->idip)))
+            goto fini;
+        if ((ret = mt_worker_open(op, &wp->w_ods, op->odip)))
+            goto fini;
+        wp->w_op.wrkPos = wrk_buff_alloc(op, len, &wp->w_op.wrkBuff);
+        if (NULL == wp->w_op.wrkPos) {
+            ret = SG_LIB_CAT_OTHER;
+            goto fini;
+        }
+        if (FT_ALL_FF & op->idip->d_type)
+            memset(wp->w_op.wrkPos, 0xff, len);
+        if (op->oflagp->sparing) {
+            wp->w_op.wrkPos2 = wrk_buff_alloc(op, len, &wp->w_op.wrkBuff2);
+            if (NULL == wp->w_op.wrkPos2) {
+                ret = SG_LIB_CAT_OTHER;
+                goto fini;
+            }
+        }
+#ifdef DDPT_HAVE_URING
+        /* each worker has its own ring, fixed buffers and fixed files */
+        if (op->iflagp->uring || op->oflagp->uring)
+            uring_init(&wp->w_op, wp->w_op.wrkPos, wp->w_op.wrkPos2, len);
+#endif
+    }
+
+#if SA_NOCLDSTOP
+    /* only the main thread processes signals */
+    pthread_sigmask(SIG_BLOCK, &op->caught_signals, &orig_set);
+#endif
+    for (k = 0; k < op->num_threads; ++k) {
+        wp = warr + k;
+        res = pthread_create(&wp->tid, NULL, mt_worker_thread, wp);
+        if (res) {
+            pr2serr("%s: pthread_create: %s\n", __func__,
+                    safe_strerror(res));
+            pthread_mutex_lock(&mc.mtx);
+            mc.stop = true;
+            mc.ret = SG_LIB_CAT_OTHER;
+            pthread_mutex_unlock(&mc.mtx);
+            break;
+        }
+        pthread_mutex_lock(&mc.mtx);
+        ++mc.active;
+        pthread_mutex_unlock(&mc.mtx);
+        ++started;
+    }
+#if SA_NOCLDSTOP
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+#endif
+    if (op->verbose > 1)
+        pr2serr("%s: started %d worker threads\n", __func__, started);
+
+    pthread_mutex_lock(&mc.mtx);
+    while (mc.active > 0) {
+#ifdef HAVE_CLOCK_GETTIME
+        clock_gettime(CLOCK_REALTIME, &ts);
+#else
+        {
+            struct timeval tv;
+
+            gettimeofday(&tv, NULL);
+            ts.tv_sec = tv.tv_sec;
+            ts.tv_nsec = tv.tv_usec * 1000;
+        }
+#endif
+        ts.tv_nsec += MT_POLL_MS * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ++ts.tv_sec;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&mc.cv, &mc.mtx, &ts);
+        /* only this thread changes op, don't hold mtx for a report */
+        mt_fold_stats(op, &mc.pend);
+        op->dd_count -= mc.pend_blks;
+        mc.pend_blks = 0;
+        pthread_mutex_unlock(&mc.mtx);
+        signals_process_delay(op, DELAY_SIGNALS_ONLY);
+        pthread_mutex_lock(&mc.mtx);
+        if (op->jrnlp && jrnl_due(op)) {
+            /* don't hold up the workers while the outputs are flushed */
+            done = mt_jrnl_done(&mc, warr, op->num_threads);
+            pthread_mutex_unlock(&mc.mtx);
+            res = jrnl_checkpoint(op, done, false);
+            pthread_mutex_lock(&mc.mtx);
+            if (res && (0 == mc.ret)) {
+                mc.ret = res;
+                mc.stop = true;
+            }
+        }
+    }
+    pthread_mutex_unlock(&mc.mtx);
+    for (k = 0; k < started; ++k)
+        pthread_join(warr[k].tid, NULL);
+    mt_fold_stats(op, &mc.pend);
+    op->dd_count -= mc.pend_blks;
+    ret = mc.ret;
+    if (op->jrnlp) {
+        res = jrnl_checkpoint(op, mt_jrnl_done(&mc, warr, op->num_threads),
+                              (0 == ret) && (0 == op->dd_count));
+        if (0 == ret)
+            ret = res;
+    }
+    op->skip = mc.hi_skip;
+    op->seek = mc.hi_seek;
+    csp->partial_write_bytes = mc.part_wr_bytes;
+    csp->of_filepos = mc.hi_of_filepos;
+
+fini:
+    for (k = 0; k < op->num_threads; ++k) {
+        wp = warr + k;
+#ifdef DDPT_HAVE_URING
+        uring_fini(&wp->w_op);
+#endif
+        mt_worker_close(&wp->w_ids, op->idip);
+        mt_worker_close(&wp->w_ods, op->odip);
+        wrk_buff_free(op, wp->w_op.wrkBuff);
+        wrk_buff_free(op, wp->w_op.wrkBuff2);
+    }
+    free(warr);
+    pthread_cond_destroy(&mc.cv);
+    pthread_mutex_destroy(&mc.mtx);
+    return ret;
+}
+
+/* A ring of bufs=BUFS work buffers for a single threaded rw copy. A reader
+ * thread fills the next free buffer from IFILE while the main thread writes
+ * the oldest full buffer to OFILE, so reads can run up to BUFS-1 segments
+ * ahead of writes. Only the main thread touches the main opts_t; the reader
+ * uses a copy and passes its statistics over (in pend) under mtx.
+ * With tapebuf=SIZE the ring is SIZE bytes and has watermarks so a tape
+ * streams: writing to tape waits for hi_mark full slots (again after the
+ * ring runs dry), reading from tape, once the ring is full, waits until no
+ * more than lo_mark slots are full. The reader only lets itself be
+ * cancelled while in cp_read_segment(), so the main thread can stop a
+ * reader blocked reading a fifo without it holding mtx. */
+struct pl_slot_t {
+    int res;                    /* result of cp_read_segment() */
+    unsigned char * bp;         /* this slot's part of the work buffer */
+    struct cp_state_t cs;       /* reader's view of this segment */
+};
+
+struct pl_ctl_t {
+    bool stop;          /* main thread wants the reader to finish */
+    bool rd_done;       /* reader has finished, no more slots will fill */
+    bool continual_read;
+    bool filling;       /* OFILE tape: main waits for hi_mark (main only) */
+    bool draining;      /* IFILE tape: reader waits for lo_mark */
+    int n_full;         /* slots read but not yet written */
+    int head;           /* next slot the reader fills (reader only) */
+    int hi_mark;        /* tapebuf=: 0 when OFILE is not tape */
+    int lo_mark;        /* tapebuf=: -1 when IFILE is not tape */
+    int underruns;      /* OFILE tape: times the ring ran dry */
+    int stalls;         /* IFILE tape: times the ring filled up */
+    struct opts_t r_op;         /* reader's copy of main opts_t */
+    struct opts_t pend;         /* reader statistics not yet folded */
+    struct cp_state_t r_cs;
+    struct pl_slot_t * slots;   /* num_bufs of them */
+    pthread_t tid;
+    pthread_mutex_t mtx;
+    pthread_cond_t cv_free;     /* main has written a slot, or stop */
+    pthread_cond_t cv_full;     /* reader has filled a slot, or rd_done */
+};
+
+static void *
+pl_reader_thread(void * vp)
+{
+    bool last;
+    int res;
+    struct pl_ctl_t * pcp = (struct pl_ctl_t *)vp;
+    struct opts_t * rop = &pcp->r_op;
+    struct cp_state_t * csp = &pcp->r_cs;
+    struct pl_slot_t * sp;
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    while ((rop->dd_count > 0) || pcp->continual_read) {
+        pthread_mutex_lock(&pcp->mtx);
+        if ((pcp->n_full >= rop->num_bufs) && (pcp->lo_mark >= 0)) {
+            pcp->draining = true;
+            ++pcp->stalls;
+        }
+        while ((! pcp->stop) && ((pcp->n_full >= rop->num_bufs) ||
+                                 (pcp->draining &&
+                                  (pcp->n_full > pcp->lo_mark))))
+            pthread_cond_wait(&pcp->cv_free, &pcp->mtx);
+        pcp->draining = false;
+        last = pcp->stop;
+        pthread_mutex_unlock(&pcp->mtx);
+        if (last)
+            break;
+
+        sp = pcp->slots + pcp->head;
+        cp_segment_init(rop, csp, sp->bp, pcp->continual_read);
+        if (rop->ratep)
+            rate_limit(rop, (int64_t)csp->icbpt * rop->ibs);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        res = cp_read_segment(rop, csp, sp->bp);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        /* digests are taken here so they run beside the writes */
+        if ((0 == res) && rop->hashp && (csp->icbpt > 0))
+            res = cp_hash_segment(rop, csp, sp->bp);
+        sp->res = res;
+        sp->cs = *csp;
+        last = (res || (0 == csp->icbpt) ||
+                (csp->leave_after_write &&
+                 (REASON_TAPE_SHORT_READ != csp->leave_reason)));
+        if (rop->verbose > 3)
+            pr2serr("reader: slot=%d, skip=%" PRId64 ", icbpt=%d, "
+                    "res=%d\n", pcp->head, rop->skip, csp->icbpt, res);
+        pcp->head = (pcp->head + 1) % rop->num_bufs;
+
+        pthread_mutex_lock(&pcp->mtx);
+        mt_fold_stats(&pcp->pend, rop);
+        ++pcp->n_full;
+        pthread_cond_signal(&pcp->cv_full);
+        pthread_mutex_unlock(&pcp->mtx);
+        if (last)
+            break;
+
+        if (rop->dd_count > 0)
+            rop->dd_count -= csp->icbpt;
+        rop->skip += csp->icbpt;
+        /* tape short read: main thread handles the partial write */
+        csp->partial_write_bytes = 0;
+        csp->leave_after_write = false;
+    }
+    pthread_mutex_lock(&pcp->mtx);
+    pcp->rd_done = true;
+    pthread_cond_signal(&pcp->cv_full);
+    pthread_mutex_unlock(&pcp->mtx);
+    return NULL;
+}
+
+/* Version of the main copy loop used when bufs=BUFS is greater than 1 (and
+ * thr=THR is 1). The main thread writes segments in the order they were
+ * read, processing signals while it waits for the reader. Returns 0 if
+ * successful. */
+static int
+pl_rw_copy(struct opts_t * op, struct cp_state_t * csp, bool continual_read)
+{
+    bool first_time = true;
+    int k, res;
+    int tail = 0;
+    int ret = 0;
+    int len = op->ibs_pi * op->bpt_i;
+    struct pl_ctl_t * pcp;
+    struct pl_slot_t * sp;
+    struct timespec ts;
+    sigset_t orig_set;
+
+    pcp = (struct pl_ctl_t *)calloc(1, sizeof(struct pl_ctl_t));
+    if (NULL == pcp) {
+        pr2serr("%s: calloc failed\n", __func__);
+        return SG_LIB_CAT_OTHER;
+    }
+    pcp->slots = (struct pl_slot_t *)calloc(op->num_bufs,
+                                            sizeof(struct pl_slot_t));
+    if (NULL == pcp->slots) {
+        pr2serr("%s: calloc of %d slots failed\n", __func__, op->num_bufs);
+        free(pcp);
+        return SG_LIB_CAT_OTHER;
+    }
+    pcp->continual_read = continual_read;
+    pcp->lo_mark = -1;
+    if (op->tape_buf > 0) {
+        if (FT_TAPE & op->odip->d_type) {
+            pcp->hi_mark = (op->num_bufs * op->tape_buf_pct) / 100;
+            if (pcp->hi_mark < 1)
+                pcp->hi_mark = 1;
+            pcp->filling = true;
+        }
+        if (FT_TAPE & op->idip->d_type)
+            pcp->lo_mark = (op->num_bufs * (100 - op->tape_buf_pct)) / 100;
+    }
+    for (k = 0; k < op->num_bufs; ++k)
+        pcp->slots[k].bp = op->wrkPos + (k * len);
+    if (FT_ALL_FF & op->idip->d_type)
+        memset(op->wrkPos, 0xff, op->num_bufs * len);
+    pcp->r_op = *op;
+    pcp->r_op.mt_worker = true;
+    pcp->r_op.urp = NULL;
+    mt_zero_stats(&pcp->r_op);
+    pcp->pend = pcp->r_op;
+    pcp->r_cs = *csp;
+    pthread_mutex_init(&pcp->mtx, NULL);
+    pthread_cond_init(&pcp->cv_free, NULL);
+    pthread_cond_init(&pcp->cv_full, NULL);
+#ifdef DDPT_HAVE_URING
+    /* separate rings since the reader and the main thread submit at the
+     * same time; both register the whole ring of work buffers */
+    if (op->iflagp->uring || op->oflagp->uring) {
+        uring_init(&pcp->r_op, op->wrkPos, NULL, op->num_bufs * len);
+        uring_init(op, op->wrkPos, op->wrkPos2, op->num_bufs * len);
+    }
+#endif
+
+#if SA_NOCLDSTOP
+    /* only the main thread processes signals */
+    pthread_sigmask(SIG_BLOCK, &op->caught_signals, &orig_set);
+#endif
+    res = pthread_create(&pcp->tid, NULL, pl_reader_thread, pcp);
+#if SA_NOCLDSTOP
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+#endif
+    if (res) {
+        pr2serr("%s: pthread_create: %s\n", __func__, safe_strerror(res));
+        ret = SG_LIB_CAT_OTHER;
+        goto fini;
+    }
+    if (op->verbose > 1)
+        pr2serr("%s: reader thread started, %d buffers\n", __func__,
+                op->num_bufs);
+
+    while (true) {
+        pthread_mutex_lock(&pcp->mtx);
+        if ((pcp->hi_mark > 0) && (0 == pcp->n_full) && (! pcp->rd_done) &&
+            (! pcp->filling)) {
+            pcp->filling = true;        /* tape will stop, refill first */
+            ++pcp->underruns;
+        }
+        while (((0 == pcp->n_full) ||
+                (pcp->filling && (pcp->n_full < pcp->hi_mark))) &&
+               (! pcp->rd_done)) {
+#ifdef HAVE_CLOCK_GETTIME
+            clock_gettime(CLOCK_REALTIME, &ts);
+#else
+            {
+                struct timeval tv;
+
+                gettimeofday(&tv, NULL);
+                ts.tv_sec = tv.tv_sec;
+                ts.tv_nsec = tv.tv_usec * 1000;
+            }
+#endif
+            ts.tv_nsec += MT_POLL_MS * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ++ts.tv_sec;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&pcp->cv_full, &pcp->mtx, &ts);
+            mt_fold_stats(op, &pcp->pend);
+            signals_process_delay(op, DELAY_SIGNALS_ONLY);
+        }
+        mt_fold_stats(op, &pcp->pend);
+        pcp->filling = false;
+        k = pcp->n_full;
+        pthread_mutex_unlock(&pcp->mtx);
+        if (0 == k)
+            break;      /* reader finished and all slots written */
+
+        sp = pcp->slots + tail;
+        if (sp->res) {
+            ret = sp->res;
+            break;
+        }
+        /* take the reader's view of this segment, csp keeps the rest */
+        csp->leave_after_write = sp->cs.leave_after_write;
+        csp->in_hole = sp->cs.in_hole;
+        csp->icbpt = sp->cs.icbpt;
+        csp->ocbpt = sp->cs.ocbpt;
+        csp->bytes_read = sp->cs.bytes_read;
+        csp->bytes_of = 0;
+        csp->bytes_of2 = 0;
+        csp->leave_reason = sp->cs.leave_reason;
+        csp->partial_write_bytes = sp->cs.partial_write_bytes;
+        csp->if_filepos = sp->cs.if_filepos;
+        if (0 == csp->icbpt)
+            break;      /* nothing read so leave loop */
+        if (first_time)
+            first_time = false;
+        else
+            signals_process_delay(op, DELAY_COPY_SEGMENT);
+        ret = cp_write_outputs(op, csp, sp->bp, op->wrkPos2, continual_read);
+        tail = (tail + 1) % op->num_bufs;
+        pthread_mutex_lock(&pcp->mtx);
+        --pcp->n_full;
+        pthread_cond_signal(&pcp->cv_free);
+        pthread_mutex_unlock(&pcp->mtx);
+        if (ret)
+            break;
+
+#ifdef HAVE_POSIX_FADVISE
+        do_fadvise(op, csp->bytes_read, csp->bytes_of, csp->bytes_of2);
+#endif
+        if (op->dd_count > 0)
+            op->dd_count -= csp->icbpt;
+        op->skip += csp->icbpt;
+        op->seek += csp->ocbpt;
+        if ((ret = cp_jrnl_check(op, csp)))
+            break;
+        if (csp->leave_after_write) {
+            if (REASON_TAPE_SHORT_READ == csp->leave_reason) {
+                /* allow multiple partial writes for tape */
+                csp->partial_write_bytes = 0;
+                csp->leave_after_write = false;
+            } else {
+                /* other cases: stop copy after partial write */
+                ret = csp->leave_reason;
+                break;
+            }
+        }
+    }
+    pthread_mutex_lock(&pcp->mtx);
+    pcp->stop = true;
+    pthread_cond_signal(&pcp->cv_free);
+    /* after an error the reader may be blocked in read() (e.g. on a fifo
+     * whose writer has gone quiet); its segment would not be written */
+    if (! pcp->rd_done)
+        pthread_cancel(pcp->tid);
+    pthread_mutex_unlock(&pcp->mtx);
+    pthread_join(pcp->tid, NULL);
+    mt_fold_stats(op, &pcp->pend);
+    /* for the tape read summary in the final report */
+    op->read_tape_numbytes = pcp->r_op.read_tape_numbytes;
+    op->last_tape_read_len = pcp->r_op.last_tape_read_len;
+    op->consec_same_len_reads = pcp->r_op.consec_same_len_reads;
+    if (op->verbose && (op->tape_buf > 0)) {
+        if (pcp->hi_mark > 0)
+            pr2serr("tapebuf: buffer ran dry %d time%s while writing "
+                    "tape\n", pcp->underruns,
+                    (1 == pcp->underruns) ? "" : "s");
+        if (pcp->lo_mark >= 0)
+            pr2serr("tapebuf: buffer filled %d time%s while reading "
+                    "tape\n", pcp->stalls, (1 == pcp->stalls) ? "" : "s");
+    }
+
+fini:
+#ifdef DDPT_HAVE_URING
+    uring_fini(&pcp->r_op);
+#endif
+    pthread_cond_destroy(&pcp->cv_full);
+    pthread_cond_destroy(&pcp->cv_free);
+    pthread_mutex_destroy(&pcp->mtx);
+    free(pcp->slots);
+    free(pcp);
+    return ret;
+}
+
+#endif  /* HAVE_LIBPTHREAD */
+
+/* This is the main copy loop (unless an offloaded copy is requested).
+ * Attempts to copy 'dd_count' blocks (size given by bs or ibs) in chunks
+ * of op->bpt_i blocks. Returns 0 if successful.  */
+static int
+do_rw_copy(struct opts_t * op)
+{
+    bool continual_read;
+    bool first_time = true;
+    int ret = 0;
+    int od_type = op->odip->d_type;
+    struct cp_state_t * csp;
+    unsigned char * wPos = op->wrkPos;
+    struct cp_state_t cp_st;
+
+    continual_read = (op->reading_fifo && (op->dd_count < 0));
+    if (op->verbose > 3) {
+        if (continual_read)
+            pr2serr("do_rw_copy: reading fifo continually\n");
+        else
+            pr2serr("do_rw_copy: dd_count=%" PRId64 "\n", op->dd_count);
+    }
+    if ((op->dd_count <= 0) && (! op->reading_fifo))
+        return 0;
+    csp = &cp_st;
+    memset(csp, 0, sizeof(struct cp_state_t));
+    if ((ret = cp_construct_pt_zero_buff(op)))
+        goto copy_end;
+    if (op->fop && (ret = fo_begin(op)))
+        goto copy_end;
+    /* Both csp->if_filepos and csp->of_filepos are 0 */
+    if (FT_ALL_FF & op->idip->d_type)
+        memset(wPos, 0xff, op->ibs * op->bpt_i);
+
+#ifdef HAVE_LIBPTHREAD
+    if (op->num_threads > 1) {
+        ret = mt_rw_copy(op, csp);
+        goto finish;
+    } else if (op->num_bufs > 1) {
+        ret = pl_rw_copy(op, csp, continual_read);
+        goto finish;
+    }
+#endif
+#ifdef DDPT_HAVE_URING
+    if (op->iflagp->uring || op->oflagp->uring)
+        uring_init(op, op->wrkPos, op->wrkPos2, op->ibs_pi * op->bpt_i);
+#endif
+#ifdef SG_LIB_LINUX
+    if (op->iflagp->mmap || op->oflagp->mmap)
+        mm_begin(op);
+#endif
+
+    /* <<< main loop that does the copy >>> */
+    while ((op->dd_count > 0) || continual_read) {
+        if (first_time)
+            first_time = false;
+        else
+            signals_process_delay(op, DELAY_COPY_SEGMENT);
+        cp_segment_init(op, csp, wPos, continual_read);
+        if (op->ratep)
+            rate_limit(op, (int64_t)csp->icbpt * op->ibs);
+        if ((ret = cp_rw_segment(op, csp, wPos, op->wrkPos2,
+                                 continual_read)))
+            break;
+        if (0 == csp->icbpt)
+            break;      /* nothing read so leave loop */
+        if (op->hashp &&
+            (ret = cp_hash_segment(op, csp, csp->mm_bp ? csp->mm_bp : wPos)))
+            break;
+
+#ifdef HAVE_POSIX_FADVISE
+        do_fadvise(op, csp->bytes_read, csp->bytes_of, csp->bytes_of2);
+#endif
+        if (op->dd_count > 0)
+            op->dd_count -= csp->icbpt;
+        op->skip += csp->icbpt;
+        op->seek += csp->ocbpt;
+        if ((ret = cp_jrnl_check(op, csp)))
+            break;
+        if (csp->leave_after_write) {
+            if (REASON_TAPE_SHORT_READ == csp->leave_reason) {
+                /* allow multiple partial writes for tape */
+                csp->partial_write_bytes = 0;
+                csp->leave_after_write = false;
+            } else {
+                /* other cases: stop copy after partial write */
+                ret = csp->leave_reason;
+                break;
+            }
+        }
+    } /* end of main loop that does the copy ... */
+#ifdef SG_LIB_LINUX
+    {
+        int res = mm_end(op);
+
+        if (res && (0 == ret))
+            ret = res;
+    }
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+finish:
+#endif
+    /* queued trims go out before the length clean up and any sync */
+    if ((csp->trim_blks > 0) || (csp->trim_qn > 0))
+        cp_trim_flush(op, csp);
+    /* sparse: clean up ofile length when last block(s) were not written */
+    if ((FT_REG & od_type) && (! op->oflagp->nowrite) &&
+        op->oflagp->sparse)
+        cp_sparse_cleanup(op, csp);
+
+#ifdef HAVE_FDATASYNC
+    else if (op->oflagp->fdatasync) {
+        if (fdatasync(op->odip->fd) < 0)
+            perror("fdatasync() error");
+        if (op->verbose)
+            pr2serr("Called fdatasync() on %s successfully\n", op->odip->fn);
+    }
+#endif
+#ifdef HAVE_FSYNC
+    else if (op->oflagp->fsync) {
+        if (fsync(op->odip->fd) < 0)
+            perror("fsync() error");
+        if (op->verbose)
+            pr2serr("Called fsync() on %s successfully\n", op->odip->fn);
+    }
+#endif
+
+copy_end:
+    if (op->fop)
+        fo_end(op);
+    if (op->jrnlp && (op->num_threads < 2)) {
+        int res = jrnl_checkpoint(op, op->skip - op->jrnl_skip0,
+                                  (0 == ret) && (0 == op->dd_count));
+
+        if (0 == ret)
+            ret = res;
+    }
+    if (csp->ext_map)
+        free(csp->ext_map);
+#ifdef DDPT_HAVE_URING
+    uring_fini(op);
+#endif
+    if (op->idip->ptvp) {
+        pt_destruct_obj(op->idip->ptvp);
+        op->idip->ptvp = NULL;
+    }
+    if (op->odip->ptvp) {
+        pt_destruct_obj(op->odip->ptvp);
+        op->odip->ptvp = NULL;
+    }
+    return ret;
+}
+
+static int
+prepare_pi(struct opts_t * op)
+{
+#define PI_WORK 1       /* Protection Information */
+#ifdef PI_WORK
+    int res;
+
+    op->ibs_pi = op->ibs;
+    op->obs_pi = op->obs;
+    if (op->rdprotect) {
+        if ((0 == op->idip->prot_type) || (! (FT_PT & op->idip->d_type))) {
+            pr2serr("IFILE is not a pt device or doesn't have "
+                    "protection information\n");
+            return SG_LIB_CAT_OTHER;
+        }
+        if (op->ibs != op->obs) {
+            pr2serr("protect: don't support IFILE and OFILE "
+                    "with different block sizes\n");
+            return SG_LIB_CAT_OTHER;
+        }
+        if (op->wrprotect) {
+            if (op->idip->p_i_exp != op->odip->p_i_exp) {
+                pr2serr("Don't support IFILE and OFILE with "
+                        "different P_I_EXP fields\n");
+                return SG_LIB_CAT_OTHER;
+            }
+        }
+        res = (op->idip->p_i_exp ? (1 << op->idip->p_i_exp) : 1) * 8;
+        op->ibs_pi += res;
+        op->obs_pi += res;
+    }
+    if (op->wrprotect) {
+        if ((0 == op->odip->prot_type) || (! (FT_PT & op->odip->d_type))) {
+            pr2serr("OFILE is not a pt device or doesn't have "
+                    "protection information\n");
+            return SG_LIB_CAT_OTHER;
+        }
+        if (op->ibs != op->obs) {
+            pr2serr("protect: don't support IFILE and OFILE "
+                    "with different block sizes\n");
+            return SG_LIB_CAT_OTHER;
+        }
+        res = (op->odip->p_i_exp ? (1 << op->odip->p_i_exp) : 1) * 8;
+        op->ibs_pi += res;
+        op->obs_pi += res;
+    }
+#else
+    if (op) { ; }       /* suppress warning */
+#endif  /* PI_WORK */
+    return 0;
+}
+
+static int
+open_files_devices(struct opts_t * op)
+{
+    int fd, ret;
+    struct dev_info_t * idip = op->idip;
+    struct dev_info_t * odip = op->odip;
+    struct dev_info_t * o2dip = op->o2dip;
+
+#ifdef SG_LIB_WIN32
+    win32_adjust_fns_pt(op);
+#endif
+    if (idip->fn[0]) {
+        if (('-' == idip->fn[0]) && ('\0' == idip->fn[1])) {
+            fd = STDIN_FILENO;
+            idip->d_type = FT_FIFO;
+            op->reading_fifo = true;
+            if (op->verbose)
+                pr2serr(" >> Input file type: fifo [stdin, stdout, named "
+                        "pipe]\n");
+        } else {
+            fd = open_if(op);
+            if (fd < 0)
+                return -fd;
+        }
+        idip->fd = fd;
+    } else if (op->iflagp->ff) {
+        idip->d_type = FT_ALL_FF;
+        idip->fd = 9999;        /* unlikely file descriptor */
+    } else {
+        pr2serr("'if=IFILE' option must be given. For stdin as input use "
+                "'if=-'\n");
+        pr2serr("For more information use '--help'\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+
+    if ('\0' == odip->fn[0])
+        strcpy(odip->fn, "."); /* treat no 'of=OFILE' option as /dev/null */
+    if (('-' == odip->fn[0]) && ('\0' == odip->fn[1])) {
+        fd = STDOUT_FILENO;
+        odip->d_type = FT_FIFO;
+        odip->d_type_hold = odip->d_type;
+        if (op->verbose)
+            pr2serr(" >> Output file type: fifo [stdin, stdout, named "
+                    "pipe]\n");
+    } else {
+        fd = open_of(op);
+        if (fd < -1)
+            return -fd;
+    }
+    odip->fd = fd;
+    if ((op->num_xof > 0) && (ret = fo_open(op)))
+        return ret;
+
+    if (o2dip->fn[0]) {
+        if (('-' == o2dip->fn[0]) && ('\0' == o2dip->fn[1])) {
+            fd = STDOUT_FILENO;
+            o2dip->d_type = FT_FIFO;
+            if (op->verbose)
+                pr2serr(" >> Output 2 file type: fifo  [stdin, stdout, "
+                        "named pipe]\n");
+        } else {
+            o2dip->d_type = dd_filetype(o2dip->fn, op->verbose);
+            if (FT_DEV_NULL & o2dip->d_type)
+                fd = -1;
+            else if (! ((FT_REG | FT_FIFO) & o2dip->d_type)) {
+                pr2serr("Error: output 2 file type must be regular "
+                        "file or fifo\n");
+                return SG_LIB_FILE_ERROR;
+            } else {
+                if ((fd = open(o2dip->fn, O_WRONLY | O_CREAT, 0666)) < 0) {
+                    ret = errno;
+                    pr2serr("could not open %s for writing: %s\n", o2dip->fn,
+                            safe_strerror(errno));
+                    return ret;
+                }
+                if (sg_set_binary_mode(fd) < 0)
+                    perror("sg_set_binary_mode");
+                if (op->verbose)
+                    pr2serr(" >> Output 2 file type: regular\n");
+            }
+        }
+    } else
+        fd = -1;
+    o2dip->fd = fd;
+    return 0;
+}
+
+#ifdef SG_LIB_LINUX
+
+/* Reads an unsigned number from the sysfs queue directory of the block
+ * device open on fd (or of the whole disk when fd is a partition). Returns
+ * -1 if not found. */
+static int64_t
+blk_queue_attr(int fd, const char * attr)
+{
+    int64_t val = -1;
+    struct stat a_st;
+    FILE * fp;
+    char b[128];
+
+    if ((fstat(fd, &a_st) < 0) || (! S_ISBLK(a_st.st_mode)))
+        return -1;
+    snprintf(b, sizeof(b), "/sys/dev/block/%u:%u/queue/%s",
+             major(a_st.st_rdev), minor(a_st.st_rdev), attr);
+    if (NULL == (fp = fopen(b, "r"))) {
+        snprintf(b, sizeof(b), "/sys/dev/block/%u:%u/../queue/%s",
+                 major(a_st.st_rdev), minor(a_st.st_rdev), attr);
+        if (NULL == (fp = fopen(b, "r")))
+            return -1;
+    }
+    if (1 != fscanf(fp, "%" SCNd64, &val))
+        val = -1;
+    fclose(fp);
+    return val;
+}
+
+#endif  /* SG_LIB_LINUX */
+
+/* Fills dip->max_xfer_bytes and dip->opt_xfer_bytes from the Block Limits
+ * VPD page (pt) or the block layer's queue limits (Linux block device). */
+static void
+xfer_limits_of(struct opts_t * op, struct dev_info_t * dip)
+{
+    if (FT_PT & dip->d_type)
+        pt_block_limits_of(op, dip);
+#ifdef SG_LIB_LINUX
+    else if (FT_BLOCK & dip->d_type) {
+        int64_t n = blk_queue_attr(dip->fd, "max_sectors_kb");
+
+        if (n > 0)
+            dip->max_xfer_bytes = n * 1024;
+        n = blk_queue_attr(dip->fd, "optimal_io_size");
+        if (n > 0)
+            dip->opt_xfer_bytes = n;
+        if (op->verbose > 1)
+            pr2serr("%s: queue limits: maximum transfer %" PRId64 " bytes, "
+                    "optimal %" PRId64 "\n", dip->fn, dip->max_xfer_bytes,
+                    dip->opt_xfer_bytes);
+    }
+#endif
+}
+
+/* Smallest BPT step that keeps (IBS * BPT) a multiple of OBS */
+static int
+bpt_step(const struct opts_t * op)
+{
+    int a = op->ibs;
+    int b = op->obs;
+    int t;
+
+    while (b) {         /* gcd(ibs, obs) */
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return op->obs / a;
+}
+
+/* bpt=auto and bpt=cal: picks BPT from the maximum and optimal transfer
+ * lengths of IFILE and OFILE. The largest optimal length is used if any is
+ * reported, else the smallest maximum, capped at DDPT_AUTO_BPT_MAX_BYTES;
+ * with neither the default BPT is kept. */
+static void
+bpt_auto_set(struct opts_t * op)
+{
+    int step = bpt_step(op);
+    int64_t max_b = 0;
+    int64_t opt_b = 0;
+    int64_t target;
+    struct dev_info_t * dips[2];
+    struct dev_info_t * dip;
+    int k, n;
+
+    dips[0] = op->idip;
+    dips[1] = op->odip;
+    for (k = 0; k < 2; ++k) {
+        dip = dips[k];
+        xfer_limits_of(op, dip);
+        if ((dip->max_xfer_bytes > 0) &&
+            ((0 == max_b) || (dip->max_xfer_bytes < max_b)))
+            max_b = dip->max_xfer_bytes;
+        if (dip->opt_xfer_bytes > opt_b)
+            opt_b = dip->opt_xfer_bytes;
+    }
+    if (opt_b > 0)
+        target = opt_b;
+    else if (max_b > 0)
+        target = max_b;
+    else {
+        if (op->verbose)
+            pr2serr("bpt=auto: no transfer limits found, keep bpt=%d\n",
+                    op->bpt_i);
+        return;
+    }
+    if (target > DDPT_AUTO_BPT_MAX_BYTES)
+        target = DDPT_AUTO_BPT_MAX_BYTES;
+    if ((max_b > 0) && (target > max_b))
+        target = max_b;
+    n = (int)(target / op->ibs);
+    n = (n / step) * step;
+    if (n < step)
+        n = step;
+    op->bpt_i = n;
+    if (op->verbose)
+        pr2serr("bpt=auto: maximum transfer %" PRId64 " bytes, optimal %"
+                PRId64 " bytes, so bpt=%d\n", max_b, opt_b, op->bpt_i);
+}
+
+static void
+block_size_bpt_check(struct opts_t * op)
+{
+    if (0 == op->bpt_given) {
+/* If reading from or writing to tape, use default bpt 1 if user did not
+ * specify. Avoids inadvertent/accidental use of wrong tape block size. */
+        if ((FT_TAPE & op->idip->d_type) || (FT_TAPE & op->odip->d_type)) {
+            op->bpt_i = 1;
+            if (op->bpt_auto) {
+                pr2serr("bpt=auto ignored with tape, bpt=1\n");
+                op->bpt_auto = 0;
+            }
+        } else if (op->bpt_auto)
+            bpt_auto_set(op);
+#ifdef SG_LIB_FREEBSD
+        if (! ((FT_TAPE & op->idip->d_type) || (FT_TAPE & op->odip->d_type))) {
+     /* FreeBSD (7+8 [DFLTPHYS]) doesn't like buffers larger than 64 KB being
+     * sent to its pt interface (CAM), so take that into account when choosing
+     * the default bpt value. There is overhead in the pt interface so reduce
+     * default bpt value so bpt*ibs <= 32 KB .*/
+        if (((FT_PT & op->idip->d_type) || (FT_PT & op->odip->d_type)) &&
+            ((op->ibs <= 32768) && (op->bpt_i * op->ibs) > 32768))
+            op->bpt_i = 32768 / op->ibs;
+        }
+#endif
+    }
+}
+
+#ifndef SG_LIB_WIN32
+
+/* Reads blks blocks of IFILE starting blk_off blocks past skip into bp.
+ * Returns 0 on success. */
+static int
+bpt_cal_read(struct opts_t * op, unsigned char * bp, int64_t blk_off,
+             int blks)
+{
+    int res, blks_read;
+    int64_t hold_skip;
+    ssize_t n;
+
+    if (FT_PT & op->idip->d_type) {
+        hold_skip = op->skip;
+        op->skip += blk_off;
+        res = pt_read(op, false, bp, blks, &blks_read);
+        op->skip = hold_skip;
+        return (res || (blks_read < blks)) ? -1 : 0;
+    }
+    n = pread(op->idip->fd, bp, (size_t)blks * op->ibs,
+              (op->skip + blk_off) * op->ibs);
+    return (n == ((ssize_t)blks * op->ibs)) ? 0 : -1;
+}
+
+/* bpt=cal: after bpt_auto_set() has picked a starting BPT, times reads of
+ * DDPT_CAL_BYTES from IFILE with BPT/4, BPT/2, BPT and 2*BPT blocks per
+ * read, each on its own region of the blocks to be copied so earlier reads
+ * don't warm the cache for later ones, and keeps the fastest. Only IFILE is
+ * read so nothing is changed by calibration. */
+static void
+bpt_calibrate_check(struct opts_t * op)
+{
+    bool cdb10_in, cdb10_out;
+    int k, j, nc, cal_blks, best, step;
+    int cands[4];
+    int64_t t0, t1, blk_off, max_b;
+    double rate;
+    double best_rate = 0.0;
+    unsigned char * bp;
+    unsigned char * free_bp;
+
+    if (2 != op->bpt_auto)
+        return;
+    if (op->reading_fifo ||
+        (! ((FT_PT | FT_BLOCK | FT_REG) & op->idip->d_type)) ||
+        (0 == mono_time_us())) {
+        pr2serr("bpt=cal: cannot calibrate with this IFILE, bpt=%d\n",
+                op->bpt_i);
+        return;
+    }
+    step = bpt_step(op);
+    max_b = op->idip->max_xfer_bytes;
+    if ((op->odip->max_xfer_bytes > 0) &&
+        ((0 == max_b) || (op->odip->max_xfer_bytes < max_b)))
+        max_b = op->odip->max_xfer_bytes;
+    cdb10_in = (FT_PT & op->idip->d_type) && (op->iflagp->cdbsz < 16);
+    cdb10_out = (FT_PT & op->odip->d_type) && (op->oflagp->cdbsz < 16);
+    for (k = 0, nc = 0; k < 4; ++k) {
+        j = (k < 3) ? (op->bpt_i >> (2 - k)) : (op->bpt_i * 2);
+        j = (j / step) * step;
+        if ((j < step) || ((nc > 0) && (j == cands[nc - 1])))
+            continue;
+        if ((max_b > 0) && (((int64_t)j * op->ibs) > max_b))
+            continue;
+        if ((cdb10_in && (j > USHRT_MAX)) ||
+            (cdb10_out && (((op->ibs * j) / op->obs) > USHRT_MAX)))
+            continue;
+        cands[nc++] = j;
+    }
+    cal_blks = DDPT_CAL_BYTES / op->ibs;
+    if ((nc < 2) || (op->dd_count < ((int64_t)nc * cal_blks))) {
+        if (op->verbose)
+            pr2serr("bpt=cal: count too small to calibrate, bpt=%d\n",
+                    op->bpt_i);
+        return;
+    }
+    bp = wrk_buff_alloc(op, cands[nc - 1] * op->ibs_pi, &free_bp);
+    if (NULL == bp)
+        return;
+    best = op->bpt_i;
+    for (k = 0; k < nc; ++k) {
+        blk_off = (int64_t)k * cal_blks;
+        t0 = mono_time_us();
+        for (j = 0; (j + cands[k]) <= cal_blks; j += cands[k]) {
+            if (bpt_cal_read(op, bp, blk_off + j, cands[k]))
+                break;
+        }
+        t1 = mono_time_us();
+        if ((j + cands[k]) <= cal_blks) {
+            pr2serr("bpt=cal: read failed, keep bpt=%d\n", op->bpt_i);
+            best = op->bpt_i;
+            break;
+        }
+        rate = (double)j * op->ibs / ((t1 > t0) ? (t1 - t0) : 1);
+        if (op->verbose)
+            pr2serr("bpt=cal: bpt=%d: %.2f MB/sec\n", cands[k], rate);
+        if (rate > best_rate) {
+            best_rate = rate;
+            best = cands[k];
+        }
+    }
+    wrk_buff_free(op, free_bp);
+    op->bpt_i = best;
+    if (op->verbose)
+        pr2serr("bpt=cal: using bpt=%d\n", op->bpt_i);
+}
+
+#else
+
+static void
+bpt_calibrate_check(struct opts_t * op)
+{
+    if (2 == op->bpt_auto)
+        pr2serr("bpt=cal: not supported on this platform, bpt=%d\n",
+                op->bpt_i);
+}
+
+#endif
+
+static void
+sparse_sparing_check(struct opts_t * op)
+{
+    if (op->iflagp->sparse && (! op->oflagp->sparse)) {
+        if (FT_DEV_NULL & op->odip->d_type) {
+            pr2serr("sparse flag usually ignored on input; set it "
+                    "on output in this case\n");
+            ++op->oflagp->sparse;
+        } else
+            pr2serr("sparse flag ignored on input\n");
+    }
+    if (op->oflagp->sparse) {
+        if ((FT_FIFO | FT_TAPE) & op->odip->d_type) {
+            pr2serr("oflag=sparse needs seekable output file, ignore\n");
+            op->oflagp->sparse = 0;
+        } else {
+            op->out_sparse_active = true;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+            /* holes in a regular IFILE need not be read */
+            if ((FT_REG == op->idip->d_type) && (! op->reading_fifo))
+                op->in_sparse_active = true;
+#endif
+            if (cp_trim_capable(op)) {
+                op->out_trim_active = true;
+                /* so trims can be merged up to the device's limit */
+                if (FT_PT & op->odip->d_type)
+                    pt_block_limits_of(op, op->odip);
+            } else if (op->oflagp->wsame16 && op->verbose)
+                pr2serr("trim flag: cannot trim this OFILE, zero segments "
+                        "are skipped\n");
+        }
+    }
+    if (op->oflagp->sparing) {
+        if ((FT_DEV_NULL | FT_FIFO | FT_TAPE) & op->odip->d_type) {
+            pr2serr("oflag=sparing needs a readable and seekable "
+                    "output file, ignore\n");
+            op->oflagp->sparing = false;
+        } else
+            op->out_sparing_active = true;
+    }
+}
+
+static void
+cdb_size_prealloc(struct opts_t * op)
+{
+    if (op->oflagp->prealloc) {
+        if ((FT_DEV_NULL | FT_FIFO | FT_TAPE | FT_PT) & op->odip->d_type) {
+            pr2serr("oflag=prealloc needs a normal output file, ignore\n");
+            op->oflagp->prealloc = false;
+        }
+    }
+    if (! op->cdbsz_given) {
+        if ((FT_PT & op->idip->d_type) && (op->iflagp->cdbsz < 16) &&
+            (((op->dd_count + op->skip) > UINT_MAX) ||
+             (op->bpt_i > USHRT_MAX))) {
+            if (op->verbose > 0)
+                pr2serr("SCSI command size increased from 10 to 16 "
+                        "bytes on %s\n", op->idip->fn);
+            op->iflagp->cdbsz = 16;
+        }
+        if ((FT_PT & op->odip->d_type) && (op->oflagp->cdbsz < 16) &&
+            (((op->dd_count + op->seek) > UINT_MAX) ||
+             (((op->ibs * op->bpt_i) / op->obs) > USHRT_MAX))) {
+            if (op->verbose)
+                pr2serr("SCSI command size increased from 10 to 16 "
+                        "bytes on %s\n", op->odip->fn);
+            op->oflagp->cdbsz = 16;
+        }
+    }
+}
+
+/* The multi-threaded copy (thr=THR) needs seekable input and output with
+ * a known count, so fall back to a single thread when that is not so. */
+static void
+thread_count_check(struct opts_t * op)
+{
+    int id_type = op->idip->d_type;
+    int od_type = op->odip->d_type;
+    const char * cp = NULL;
+
+    if (op->num_threads < 2)
+        return;
+#ifdef SG_LIB_WIN32
+    cp = "not supported on Windows";
+#endif
+    if (cp)
+        ;
+    else if (op->reading_fifo ||
+             (! ((FT_PT | FT_REG | FT_BLOCK | FT_ALL_FF) & id_type)))
+        cp = "IFILE must be pt, block device or regular file";
+    else if (! ((FT_PT | FT_REG | FT_BLOCK | FT_DEV_NULL) & od_type))
+        cp = "OFILE must be pt, block device or regular file";
+    else if (op->o2dip->fd >= 0)
+        cp = "incompatible with of2=";
+    else if (op->fop)
+        cp = "incompatible with several of=";
+    else if (op->hashp)
+        cp = "incompatible with hash=, the digest needs the input in order";
+    else if (op->oflagp->append)
+        cp = "incompatible with oflag=append";
+    else if (op->dd_count <= op->bpt_i)
+        cp = "copy is a single segment";
+    if (cp) {
+        if (op->verbose || (op->dd_count > op->bpt_i))
+            pr2serr("thr=%d ignored: %s\n", op->num_threads, cp);
+        op->num_threads = 1;
+    } else if (op->verbose)
+        pr2serr("rw copy using %d worker threads%s\n", op->num_threads,
+                (op->thr_shard ? ", each with its own shard" : ""));
+}
+
+/* The cfr flag copies each segment within the kernel, so both files must
+ * be regular and nothing may need to look at (or change) the data. */
+static void
+cfr_check(struct opts_t * op)
+{
+    const char * cp = NULL;
+#ifdef HAVE_COPY_FILE_RANGE
+    struct stat a_st;
+#endif
+
+    if (! (op->iflagp->cfr || op->oflagp->cfr))
+        return;
+#ifdef HAVE_COPY_FILE_RANGE
+    if (op->reading_fifo || (FT_REG != op->idip->d_type))
+        cp = "IFILE must be a regular file";
+    else if (FT_REG != op->odip->d_type)
+        cp = "OFILE must be a regular file";
+    else if ((op->o2dip->fd >= 0) || op->hashp || op->mfp || op->fop)
+        cp = "incompatible with of2=, hash=, manifest= and several of=";
+    else if (op->oflagp->sparse || op->oflagp->sparing)
+        cp = "incompatible with sparse and sparing";
+    else if (op->oflagp->append || op->oflagp->nowrite)
+        cp = "incompatible with append and nowrite";
+    else if (op->iflagp->coe)
+        cp = "incompatible with coe";
+    else if (fstat(op->idip->fd, &a_st) < 0)
+        cp = "fstat on IFILE failed";
+#else
+    cp = "copy_file_range() not available in this build";
+#endif
+    if (cp) {
+        pr2serr("cfr flag ignored: %s\n", cp);
+        return;
+    }
+#ifdef HAVE_COPY_FILE_RANGE
+    op->cfr_active = true;
+    op->reflink_active = true;
+    op->cfr_in_size = a_st.st_size;
+    /* nothing for io_uring to do */
+    op->iflagp->uring = false;
+    op->oflagp->uring = false;
+    if (op->verbose)
+        pr2serr("rw copy using copy_file_range()\n");
+#endif
+}
+
+/* The splice flag moves segments with splice() when IFILE or OFILE is a
+ * pipe (fifo or stdin/stdout) and the other side is a regular file, block
+ * device or pipe. The data is never seen in user space so options that
+ * need to see it can't be given as well. Returns 0 if the copy may go
+ * ahead, else SG_LIB_SYNTAX_ERROR. */
+static int
+splice_check(struct opts_t * op)
+{
+    int i_type = op->idip->d_type;
+    int o_type = op->odip->d_type;
+    const char * cp = NULL;
+
+    if (! (op->iflagp->splice || op->oflagp->splice))
+        return 0;
+#ifdef HAVE_SPLICE
+    if ((FT_PT & (i_type | o_type)) ||
+        (! (((FT_FIFO & i_type) &&
+             ((FT_REG | FT_BLOCK | FT_FIFO) & o_type)) ||
+            (((FT_REG | FT_BLOCK) & i_type) && (FT_FIFO & o_type)))))
+        cp = "needs a fifo and a regular file, block device or fifo";
+    else if ((op->o2dip->fd >= 0) || op->hashp || op->mfp || op->fop)
+        cp = "incompatible with of2=, hash=, manifest= and several of=";
+    else if (op->oflagp->sparse || op->oflagp->sparing)
+        cp = "incompatible with sparse and sparing";
+    else if (op->oflagp->append || op->oflagp->nowrite || op->oflagp->pad)
+        cp = "incompatible with append, nowrite and pad";
+    else if (op->iflagp->direct || op->oflagp->direct)
+        cp = "incompatible with direct";
+    else if (op->iflagp->coe || op->cfr_active)
+        cp = "incompatible with coe and cfr";
+    else if ((op->num_threads > 1) || (op->num_bufs > 1))
+        cp = "incompatible with thr= and bufs=";
+    else if (op->iflagp->uring || op->oflagp->uring)
+        cp = "incompatible with uring";
+    if (cp) {
+        pr2serr("splice flag %s\n", cp);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    op->splice_active = true;
+    if (op->verbose)
+        pr2serr("rw copy using splice()\n");
+#else
+    cp = "splice() not available in this build";
+    pr2serr("splice flag ignored: %s\n", cp);
+    if (i_type || o_type) { ; }     /* suppress warning */
+#endif
+    return 0;
+}
+
+/* tapebuf=SIZE[,PCT] sizes the bufs=BUFS ring to SIZE bytes when IFILE or
+ * OFILE is a tape; bufs_check() below then applies. */
+static void
+tapebuf_check(struct opts_t * op)
+{
+    const char * cp = NULL;
+    int64_t n;
+    int len = op->ibs_pi * op->bpt_i;
+
+    if (op->tape_buf <= 0)
+        return;
+#ifdef SG_LIB_WIN32
+    cp = "not supported on Windows";
+#endif
+    if (cp)
+        ;
+    else if (! ((FT_TAPE & op->idip->d_type) ||
+                (FT_TAPE & op->odip->d_type)))
+        cp = "neither IFILE nor OFILE is a tape";
+    else if (op->num_threads > 1)
+        cp = "incompatible with thr=";
+    if (cp) {
+        pr2serr("tapebuf= ignored: %s\n", cp);
+        op->tape_buf = 0;
+        return;
+    }
+    n = op->tape_buf / len;
+    if (n < 2)
+        n = 2;
+    else if (n > DDPT_TAPE_MAX_BUFS) {
+        if (op->verbose)
+            pr2serr("tapebuf: limited to %d segments of %d bytes, use a "
+                    "larger bs=\n", DDPT_TAPE_MAX_BUFS, len);
+        n = DDPT_TAPE_MAX_BUFS;
+    }
+    op->num_bufs = (int)n;
+    if (op->verbose)
+        pr2serr("tapebuf: %d segments of %d bytes, stream at %d%%\n",
+                op->num_bufs, len, op->tape_buf_pct);
+}
+
+/* With bufs=BUFS a reader thread runs ahead of the main thread, so this
+ * needs thread support and is pointless for a single segment copy. */
+static void
+bufs_check(struct opts_t * op)
+{
+    const char * cp = NULL;
+
+    if (op->num_bufs < 2)
+        return;
+#ifdef SG_LIB_WIN32
+    cp = "not supported on Windows";
+#endif
+    if (cp)
+        ;
+    else if (op->num_threads > 1)
+        cp = "incompatible with thr=";
+    else if (op->cfr_active || op->splice_active)
+        cp = "nothing to overlap when copying in kernel";
+    else if ((op->dd_count <= op->bpt_i) && (! op->reading_fifo))
+        cp = "copy is a single segment";
+    if (cp) {
+        if (op->verbose || (op->num_threads > 1) ||
+            (op->dd_count > op->bpt_i))
+            pr2serr("bufs=%d ignored: %s\n", op->num_bufs, cp);
+        op->num_bufs = 1;
+    } else if (op->verbose)
+        pr2serr("rw copy using %d work buffers with read-ahead\n",
+                op->num_bufs);
+}
+
+/* iflag=uring and oflag=uring only apply to block devices and regular
+ * files in a rw copy; quietly ignore them elsewhere (e.g. of=/dev/null) */
+static void
+uring_flags_check(struct opts_t * op)
+{
+    if (op->iflagp->uring &&
+        (op->reading_fifo || (! ((FT_REG | FT_BLOCK) & op->idip->d_type)))) {
+        if (op->verbose)
+            pr2serr("iflag=uring ignored: IFILE not block device or "
+                    "regular file\n");
+        op->iflagp->uring = false;
+        op->iflagp->sqpoll = false;
+    }
+    if (op->oflagp->uring && (! ((FT_REG | FT_BLOCK) & op->odip->d_type))) {
+        if (op->verbose)
+            pr2serr("oflag=uring ignored: OFILE not block device or "
+                    "regular file\n");
+        op->oflagp->uring = false;
+        op->oflagp->sqpoll = false;
+    }
+#ifndef DDPT_HAVE_URING
+    op->iflagp->uring = false;
+    op->oflagp->uring = false;
+#endif
+}
+
+/* iflag=mmap and oflag=mmap only apply to regular files in a single
+ * threaded rw copy with one work buffer; ignore them elsewhere. A read
+ * error on a mapping arrives as SIGBUS so iflag=coe can't be honoured. */
+static void
+mmap_flags_check(struct opts_t * op)
+{
+    int k;
+    struct flags_t * fp;
+#ifdef SG_LIB_LINUX
+    struct dev_info_t * dip;
+#endif
+    const char * cp;
+
+    for (k = 0; k < 2; ++k) {
+        fp = k ? op->oflagp : op->iflagp;
+        if (! fp->mmap)
+            continue;
+        cp = NULL;
+#ifdef SG_LIB_LINUX
+        dip = k ? op->odip : op->idip;
+        if ((! (FT_REG & dip->d_type)) || ((0 == k) && op->reading_fifo))
+            cp = "not a regular file";
+        else if (op->has_xcopy || op->rsp || op->in_sgl || op->out_sgl)
+            cp = "incompatible with --xcopy, rescue= and scatter gather "
+                 "lists";
+        else if ((op->num_threads > 1) || (op->num_bufs > 1) ||
+                 (op->num_xof > 0))
+            cp = "incompatible with thr=, bufs= and several of=";
+        else if (op->cfr_active || op->splice_active)
+            cp = "segments copied in the kernel";
+        else if (fp->uring)
+            cp = "incompatible with uring flag";
+#ifndef HAVE_FALLOCATE
+        else if (k)
+            cp = "needs fallocate() to reserve space in OFILE";
+#endif
+        else if (k ? fp->append : fp->coe)
+            cp = k ? "incompatible with oflag=append" :
+                     "incompatible with iflag=coe";
+#else
+        cp = "only supported on Linux";
+#endif
+        if (cp) {
+            pr2serr("%s=mmap ignored: %s\n", (k ? "oflag" : "iflag"), cp);
+            fp->mmap = false;
+        }
+    }
+}
+
+/* iflag=async and oflag=async need a sg device, since commands are queued
+ * with write() and reaped with read() on its file descriptor. Responses
+ * can't be shared between worker threads so thr=THR must be 1. */
+static void
+pt_async_check(struct opts_t * op)
+{
+    int k;
+    struct flags_t * fp;
+#ifdef SG_LIB_LINUX
+    struct dev_info_t * dip;
+#endif
+    const char * cp;
+
+    for (k = 0; k < 2; ++k) {
+        fp = k ? op->oflagp : op->iflagp;
+        if (! fp->async)
+            continue;
+        cp = NULL;
+#ifdef SG_LIB_LINUX
+        dip = k ? op->odip : op->idip;
+        if (! (FT_PT & dip->d_type))
+            cp = "not a pt device";
+        else if (! pt_async_capable(dip->fd))
+            cp = "needs a sg device (e.g. /dev/sg1)";
+        else if (op->num_threads > 1)
+            cp = "incompatible with thr=";
+#else
+        cp = "only supported on Linux";
+#endif
+        if (cp) {
+            pr2serr("%s=async ignored: %s\n", (k ? "oflag" : "iflag"), cp);
+            fp->async = false;
+        }
+    }
+}
+
+#ifdef SG_LIB_LINUX
+
+static void
+tape_cleanup_of(struct opts_t * op)
+{
+    /* Before closing OFILE, if writing to tape handle suppressing the
+     * writing of a filemark and/or flushing the drive buffer which the
+     * Linux st driver normally does when tape file is closed after writing.
+     * Possibilities depend on oflag arguments:
+     * nofm:         MTWEOFI 0 if possible (kernel 2.6.37+), else MTBSR 0
+     * nofm & fsync: MTWEOF 0
+     * fsync:        Do nothing; st writes filemark & flushes buffer on close.
+     * neither:      MTWEOFI 1 if possible (2.6.37+), else nothing (drive
+     *               buffer will be flushed if MTWEOFI not possible). */
+    struct mtop mt_cmd;
+    int res;
+
+    if (op->oflagp->nofm || (! op->oflagp->fsync)) {
+        mt_cmd.mt_op = op->oflagp->fsync ? MTWEOF : MTWEOFI;
+        mt_cmd.mt_count = (op->oflagp->nofm) ? 0 : 1;
+        res = ioctl(op->odip->fd, MTIOCTOP, &mt_cmd);
+        if (res != 0) {
+            if (op->verbose > 0)
+                pr2serr("MTWEOF%s %d failed: %s\n",
+                        op->oflagp->fsync ? "" : "I", mt_cmd.mt_count,
+                        safe_strerror(errno));
+            if (op->oflagp->nofm && (! op->oflagp->fsync)) {
+                if (op->verbose > 0)
+                    pr2serr("Trying MTBSR 0 instead\n");
+                mt_cmd.mt_op = MTBSR; /* mt_cmd.mt_count = 0 from above */
+                res = ioctl(op->odip->fd, MTIOCTOP, &mt_cmd);
+                if (res != 0)
+                    pr2serr("MTBSR 0 failed: %s\n(Filemark will be written "
+                            "when tape file is closed)\n",
+                            safe_strerror(errno));
+            }
+        }
+    }
+}
+
+#endif  /* SG_LIB_LINUX */
+
+static int
+do_falloc(struct opts_t * op)
+{
+#ifdef SG_LIB_LINUX
+#ifdef HAVE_FALLOCATE
+    /* Try to pre-allocate space in the output file.
+     *
+     * If fallocate() does not succeed, exit with an error message. The user
+     * can then either free up some disk space or invoke ddpt without
+     * oflag=prealloc (at the risk of running out of disk space).
+     *
+     * TODO/DISCUSSION: Some filesystems (e.g. FAT32) don't support
+     * fallocate(). In that case we should probably have a way to continue if
+     * fallocate() fails, rather than exiting; useful for use in scripts
+     * where the user would like to pre-allocate space when possible.
+     *
+     * On Linux, try fallocate() with the FALLOC_FL_KEEP_SIZE flag, which
+     * allocates space but doesn't change the apparent file size (useful
+     * since oflag=resume can be used).
+     *
+     * If fallocate() with FALLOC_FL_KEEP_SIZE returns ENOTTY, EINVAL or
+     * EOPNOTSUPP, retry without that flag (since the flag is only supported
+     * in recent Linux kernels). */
+    int res;
+
+#ifdef PREALLOC_DEBUG
+    pr2serr("About to call fallocate() with FALLOC_FL_KEEP_SIZE\n");
+#endif
+    res = fallocate(op->odip->fd, FALLOC_FL_KEEP_SIZE, op->obs*op->seek,
+                    op->obs*op->dd_count);
+#ifdef PREALLOC_DEBUG
+    pr2serr("fallocate() returned %d\n", res);
+#endif
+    /* fallocate() fails if the kernel does not support
+     * FALLOC_FL_KEEP_SIZE, so retry without that flag. */
+    if (-1 == res) {
+        if ((ENOTTY == errno) || (EINVAL == errno)
+             || (EOPNOTSUPP == errno)) {
             if (op->verbose)
-                pr2serr(" >> Input file type: fifo [stdin, stdout, named "
-                        "pipe]\n");
-        } else {
-            fd = open_if(op);
-            if (fd < 0)
-                return -fd;
+                pr2serr("Could not pre-allocate with "
+                        "FALLOC_FL_KEEP_SIZE (%s), retrying without "
+                        "...\n", safe_strerror(errno));
+            res = fallocate(op->odip->fd, 0 /* no flags */,
+                            op->obs * op->seek, op->obs * op->dd_count);
+#ifdef PREALLOC_DEBUG
+            pr2serr("fallocate() without FALLOC_FL_KEEP_SIZE "
+                    " returned %d\n", res);
+#endif
         }
-        idip->fd = fd;
-    } else if (op->iflagp->ff) {
-        idip->d_type = FT_ALL_FF;
-        idip->fd = 9999;        /* unlikely file descriptor */
     } else {
-        pr2serr("'if=IFILE' option must be given. For stdin as input use "
-                "'if=-'\n");
-        pr2serr("For more information use '--help'\n");
+        /* fallocate() with FALLOC_FL_KEEP_SIZE succeeded. Set
+         * op->oflagp->prealloc to 0 so the possible message about using
+         * oflag=resume is not suppressed later. */
+        op->oflagp->prealloc = false;
+    }
+    if (-1 == res) {
+            pr2serr("Unable to pre-allocate space: %s\n",
+                    safe_strerror(errno));
+            return SG_LIB_CAT_OTHER;
+    }
+    if (op->verbose > 1)
+        pr2serr("Pre-allocated %" PRId64 " bytes at offset %"
+                PRId64 "\n", op->obs*op->dd_count, op->obs*op->seek);
+
+#endif  /* HAVE_FALLOCATE */
+#else   /* other than SG_LIB_LINUX */
+#ifdef HAVE_POSIX_FALLOCATE
+    int res;
+
+    /* If not on Linux, use posix_fallocate(). (That sets the file size to its
+     * full length, so re-invoking ddpt with oflag=resume will do nothing.) */
+    res = posix_fallocate(op->odip->fd, op->obs * op->seek,
+                          op->obs * op->dd_count);
+    if (-1 == res) {
+            pr2serr("Unable to pre-allocate space: %s\n",
+                    safe_strerror(errno));
+            return SG_LIB_CAT_OTHER;
+    }
+    if (op->verbose > 1)
+        pr2serr("Pre-allocated %" PRId64 " bytes at offset %" PRId64 "\n",
+                op->obs*op->dd_count, op->obs*op->seek);
+#else   /* do not HAVE_POSIX_FALLOCATE */
+    if (op) { ; }
+#endif  /* HAVE_POSIX_FALLOCATE else */
+#endif  /* SG_LIB_LINUX else */
+    return 0;
+}
+
+static void
+details_pre_copy_print(struct opts_t * op)
+{
+    pr2serr("skip=%" PRId64 " (blocks on input), seek=%" PRId64
+            " (blocks on output)\n", op->skip, op->seek);
+    if (op->verbose > 1) {
+        pr2serr("  ibs=%d bytes, obs=%d bytes, OBPC=%d\n",
+                op->ibs, op->obs, op->obpch);
+        if (op->ibs != op->ibs_pi)
+            pr2serr("  due to protect ibs_pi=%d bytes, "
+                    "obs_pi=%d bytes\n", op->ibs_pi, op->obs_pi);
+    }
+    if (op->reading_fifo && (op->dd_count < 0))
+        pr2serr("  reading fifo, blocks_per_transfer=%d\n", op->bpt_i);
+    else
+        pr2serr("  initial count=%" PRId64 " (blocks of input), "
+                "blocks_per_transfer=%d\n", op->dd_count, op->bpt_i);
+    if ((op->delay > 0) || (op->wdelay > 0))
+        pr2serr("  delay=%d ms, wdelay=%d ms\n", op->delay, op->wdelay);
+}
+
+static int
+wrk_buffers_init(struct opts_t * op)
+{
+    int len = op->ibs_pi * op->bpt_i;
+
+    if (op->has_xcopy)
+        return 0;
+    /* with bufs=BUFS the ring of segment buffers is one allocation */
+    op->wrkPos = wrk_buff_alloc(op, len * op->num_bufs, &op->wrkBuff);
+    if (NULL == op->wrkPos)
+        return SG_LIB_CAT_OTHER;
+    if (op->oflagp->sparing) {
+        op->wrkPos2 = wrk_buff_alloc(op, len, &op->wrkBuff2);
+        if (NULL == op->wrkPos2)
+            return SG_LIB_CAT_OTHER;
+    }
+    return 0;
+}
+
+static void
+cleanup_resources(struct opts_t * op)
+{
+#ifdef SG_LIB_LINUX
+    if ((FT_TAPE & op->idip->d_type) || (FT_TAPE & op->odip->d_type)) {
+        /* For writing, the st driver writes a filemark on closing the file
+         * (unless user specified oflag=nofm), so make clear that the
+         * position shown is prior to closing. */
+        print_tape_pos("Final ", " (before closing file)", op);
+        if ((FT_TAPE & op->odip->d_type) && (op->verbose > 1) &&
+            op->oflagp->nofm)
+            pr2serr("(suppressing writing of filemark on close)\n");
+    }
+#endif
+
+    /* before OFILE is closed as MF is only written once OFILE is synced */
+    if (op->mfp && mf_finish(op) && (0 == op->err_to_report))
+        op->err_to_report = SG_LIB_FILE_ERROR;
+    if (op->iflagp->errblk)
+        errblk_close(op);
+
+#ifdef HAVE_POSIX_FADVISE
+    if (op->cw_win > 0)
+        cache_window_end(op);
+#endif
+    wrk_buff_free(op, op->wrkBuff);
+    wrk_buff_free(op, op->wrkBuff2);
+    if (op->zeros_buff)
+        free(op->zeros_buff);
+    if (FT_PT & op->idip->d_type)
+        pt_close(op->idip->fd);
+    else if ((op->idip->fd >= 0) && (STDIN_FILENO != op->idip->fd))
+        close(op->idip->fd);
+    if (FT_PT & op->odip->d_type)
+        pt_close(op->odip->fd);
+    if ((op->odip->fd >= 0) && (STDOUT_FILENO != op->odip->fd) &&
+        !(FT_DEV_NULL & op->odip->d_type)) {
+#ifdef SG_LIB_LINUX
+        if (FT_TAPE & op->odip->d_type)
+            tape_cleanup_of(op);
+#endif
+        close(op->odip->fd);
+    }
+    if ((op->o2dip->fd >= 0) && (STDOUT_FILENO != op->o2dip->fd))
+        close(op->o2dip->fd);
+    rate_free(op);
+    jrnl_free(op);
+    hash_free(op);
+    mf_free(op);
+    fo_free(op);
+    rs_free(op);
+    bt_free(op);
+    if (op->in_sgl) {
+        free(op->in_sgl);
+        op->in_sgl = NULL;
+    }
+    if (op->out_sgl) {
+        free(op->out_sgl);
+        op->out_sgl = NULL;
+    }
+}
+
+#ifdef HAVE_LIBPTHREAD
+
+#define BENCH_READ 0
+#define BENCH_WRITE 1
+#define BENCH_COPY 2
+
+static const char * bench_mode_s[] = {"read", "write", "copy"};
+
+/* One point of a --bench sweep: QD worker threads, each with one command
+ * outstanding, claim BPT block chunks of the region under mtx until the
+ * region is done or the time is up. */
+struct bench_ctl_t {
+    bool stop;          /* error, short transfer or time is up */
+    int ret;            /* first error from a worker */
+    int active;         /* number of workers still running */
+    int mode;           /* BENCH_READ, BENCH_WRITE or BENCH_COPY */
+    int bpt;            /* input blocks per command */
+    int64_t next;       /* next unclaimed chunk, input blocks past skip */
+    int64_t end;        /* input blocks in region */
+    int64_t deadline;   /* mono_time_us() at which workers stop */
+    struct opts_t * op;
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+};
+
+struct bench_worker_t {
+    pthread_t tid;
+    struct bench_ctl_t * bcp;
+    struct opts_t w_op;
+    struct flags_t w_ifl;       /* own copies so direct can be toggled */
+    struct flags_t w_ofl;
+    struct dev_info_t w_ids;
+    struct dev_info_t w_ods;
+    unsigned char * bp;
+    unsigned char * free_bp;
+    int64_t bytes;              /* bytes read (or written if write mode) */
+    int64_t cmds;
+    int n_lat;                  /* latencies saved (up to DDPT_BENCH_LATS) */
+    uint32_t * lat;             /* per command latencies in microseconds */
+};
+
+/* Reads blks blocks from IFILE starting at from_block. Returns 0 on
+ * success, -1 on a short read, else an error. */
+static int
+bench_read(struct opts_t * wop, unsigned char * bp, int64_t from_block,
+           int blks)
+{
+    int res, blks_read;
+    ssize_t n;
+
+    if (FT_PT & wop->idip->d_type) {
+        wop->skip = from_block;
+        res = pt_read(wop, false, bp, blks, &blks_read);
+        if (res)
+            return res;
+        return (blks_read < blks) ? -1 : 0;
+    }
+    n = pread(wop->idip->fd, bp, (size_t)blks * wop->ibs,
+              from_block * wop->ibs);
+    if (n < 0) {
+        pr2serr("bench: reading %s: %s\n", wop->idip->fn,
+                safe_strerror(errno));
+        return SG_LIB_CAT_OTHER;
+    }
+    return (n < ((ssize_t)blks * wop->ibs)) ? -1 : 0;
+}
+
+/* Writes the bytes of blks input blocks to OFILE starting at to_block.
+ * Returns 0 on success. */
+static int
+bench_write(struct opts_t * wop, const unsigned char * bp, int64_t to_block,
+            int blks)
+{
+    int oblks = (blks * wop->ibs) / wop->obs;
+    ssize_t n;
+
+    if (FT_PT & wop->odip->d_type)
+        return pt_write(wop, bp, oblks, to_block);
+    n = pwrite(wop->odip->fd, bp, (size_t)oblks * wop->obs,
+               to_block * wop->obs);
+    if (n < ((ssize_t)oblks * wop->obs)) {
+        pr2serr("bench: writing %s: %s\n", wop->odip->fn,
+                (n < 0) ? safe_strerror(errno) : "short write");
+        return SG_LIB_CAT_OTHER;
+    }
+    return 0;
+}
+
+static void *
+bench_worker_thread(void * vp)
+{
+    int res, blks;
+    int64_t off, t0, t1;
+    struct bench_worker_t * bwp = (struct bench_worker_t *)vp;
+    struct bench_ctl_t * bcp = bwp->bcp;
+    struct opts_t * op = bcp->op;
+    struct opts_t * wop = &bwp->w_op;
+
+    while (true) {
+        pthread_mutex_lock(&bcp->mtx);
+        if (bcp->stop || (bcp->next >= bcp->end) ||
+            (mono_time_us() >= bcp->deadline)) {
+            pthread_mutex_unlock(&bcp->mtx);
+            break;
+        }
+        off = bcp->next;
+        blks = ((bcp->end - off) < bcp->bpt) ? (int)(bcp->end - off) :
+                                                bcp->bpt;
+        bcp->next += blks;
+        pthread_mutex_unlock(&bcp->mtx);
+
+        t0 = mono_time_us();
+        res = 0;
+        if (BENCH_WRITE != bcp->mode)
+            res = bench_read(wop, bwp->bp, op->skip + off, blks);
+        if ((0 == res) && (BENCH_READ != bcp->mode))
+            res = bench_write(wop, bwp->bp,
+                              op->seek + ((off * op->ibs) / op->obs), blks);
+        t1 = mono_time_us();
+        if (res) {
+            pthread_mutex_lock(&bcp->mtx);
+            if ((res > 0) && (0 == bcp->ret))
+                bcp->ret = res;
+            bcp->stop = true;   /* -1: short read, assume end of IFILE */
+            pthread_mutex_unlock(&bcp->mtx);
+            break;
+        }
+        ++bwp->cmds;
+        bwp->bytes += (int64_t)blks * wop->ibs;
+        if (bwp->n_lat < DDPT_BENCH_LATS)
+            bwp->lat[bwp->n_lat++] = (uint32_t)(t1 - t0);
+    }
+    pthread_mutex_lock(&bcp->mtx);
+    --bcp->active;
+    pthread_cond_signal(&bcp->cv);
+    pthread_mutex_unlock(&bcp->mtx);
+    return NULL;
+}
+
+static int
+bench_u32_cmp(const void * a, const void * b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+/* Returns the latency (in microseconds) at the permille point of the n
+ * sorted latencies in lat. */
+static uint32_t
+bench_pctl(const uint32_t * lat, int n, int permille)
+{
+    int64_t k;
+
+    if (n < 1)
+        return 0;
+    k = (((int64_t)n * permille) + 999) / 1000;
+    return lat[(k > 0) ? (k - 1) : 0];
+}
+
+/* Sets or clears O_DIRECT on a regular file or block device. Returns 0 on
+ * success (or when dip is neither). */
+static int
+bench_direct_set(struct dev_info_t * dip, bool direct)
+{
+#ifdef O_DIRECT
+    int flags;
+
+    if (! ((FT_REG | FT_BLOCK) & dip->d_type))
+        return 0;
+    flags = fcntl(dip->fd, F_GETFL);
+    if (flags >= 0) {
+        flags = direct ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+        if (fcntl(dip->fd, F_SETFL, flags) >= 0)
+            return 0;
+    }
+    pr2serr("bench: unable to %s O_DIRECT on %s: %s\n", direct ? "set" :
+            "clear", dip->fn, safe_strerror(errno));
+    return SG_LIB_FILE_ERROR;
+#else
+    if (direct) {
+        pr2serr("bench: no O_DIRECT for %s\n", dip->fn);
+        return SG_LIB_FILE_ERROR;
+    }
+    return 0;
+#endif
+}
+
+/* Runs a single point of the sweep and prints its line to stdout. Returns
+ * 0 if successful. */
+static int
+bench_point(struct opts_t * op, int mode, const char * path, int bpt,
+            int qd, int direct)
+{
+    bool dio = (direct > 0);
+    int k, res, n_lat;
+    int ret = 0;
+    int started = 0;
+    int len = op->ibs_pi * bpt;
+    int64_t t0, t1, bytes, cmds;
+    double usecs;
+    struct bench_worker_t * bwp;
+    struct bench_worker_t * warr;
+    uint32_t * lat = NULL;
+    struct bench_ctl_t bc;
+    struct timespec ts;
+    sigset_t orig_set;
+
+    warr = (struct bench_worker_t *)calloc(qd,
+                                           sizeof(struct bench_worker_t));
+    if (NULL == warr) {
+        pr2serr("%s: calloc for %d threads failed\n", __func__, qd);
+        return SG_LIB_CAT_OTHER;
+    }
+    memset(&bc, 0, sizeof(bc));
+    bc.op = op;
+    bc.mode = mode;
+    bc.bpt = bpt;
+    bc.end = op->dd_count;
+    pthread_mutex_init(&bc.mtx, NULL);
+    pthread_cond_init(&bc.cv, NULL);
+
+    for (k = 0; k < qd; ++k) {
+        warr[k].w_ids.fd = -1;
+        warr[k].w_ods.fd = -1;
+    }
+    for (k = 0; k < qd; ++k) {
+        bwp = warr + k;
+        bwp->bcp = &bc;
+        bwp->w_op = *op;
+        bwp->w_op.mt_worker = true;
+        bwp->w_ifl = *op->iflagp;
+        bwp->w_ofl = *op->oflagp;
+        bwp->w_ifl.direct = dio;
+        bwp->w_ofl.direct = dio;
+        bwp->w_op.iflagp = &bwp->w_ifl;
+        bwp->w_op.oflagp = &bwp->w_ofl;
+        bwp->w_op.idip = &bwp->w_ids;
+        bwp->w_op.odip = &bwp->w_ods;
+        if ((ret = mt_worker_open(op, &bwp->w_ids, op->idip)))
+            goto fini;
+        if ((ret = mt_worker_open(op, &bwp->w_ods, op->odip)))
+            goto fini;
+        if ((BENCH_WRITE != mode) &&
+            (ret = bench_direct_set(&bwp->w_ids, dio)))
+            goto fini;
+        if ((BENCH_READ != mode) &&
+            (ret = bench_direct_set(&bwp->w_ods, dio)))
+            goto fini;
+        bwp->bp = wrk_buff_alloc(&bwp->w_op, len, &bwp->free_bp);
+        bwp->lat = (uint32_t *)malloc(DDPT_BENCH_LATS * sizeof(uint32_t));
+        if ((NULL == bwp->bp) || (NULL == bwp->lat)) {
+            pr2serr("%s: out of memory\n", __func__);
+            ret = SG_LIB_CAT_OTHER;
+            goto fini;
+        }
+        if (FT_ALL_FF & op->idip->d_type)
+            memset(bwp->bp, 0xff, len);
+    }
+
+#if SA_NOCLDSTOP
+    /* only the main thread processes signals */
+    pthread_sigmask(SIG_BLOCK, &op->caught_signals, &orig_set);
+#endif
+    t0 = mono_time_us();
+    bc.deadline = t0 + ((int64_t)op->bench_secs * 1000000);
+    for (k = 0; k < qd; ++k) {
+        bwp = warr + k;
+        res = pthread_create(&bwp->tid, NULL, bench_worker_thread, bwp);
+        if (res) {
+            pr2serr("%s: pthread_create: %s\n", __func__,
+                    safe_strerror(res));
+            pthread_mutex_lock(&bc.mtx);
+            bc.stop = true;
+            bc.ret = SG_LIB_CAT_OTHER;
+            pthread_mutex_unlock(&bc.mtx);
+            break;
+        }
+        pthread_mutex_lock(&bc.mtx);
+        ++bc.active;
+        pthread_mutex_unlock(&bc.mtx);
+        ++started;
+    }
+#if SA_NOCLDSTOP
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
+#endif
+    pthread_mutex_lock(&bc.mtx);
+    while (bc.active > 0) {
+#ifdef HAVE_CLOCK_GETTIME
+        clock_gettime(CLOCK_REALTIME, &ts);
+#else
+        {
+            struct timeval tv;
+
+            gettimeofday(&tv, NULL);
+            ts.tv_sec = tv.tv_sec;
+            ts.tv_nsec = tv.tv_usec * 1000;
+        }
+#endif
+        ts.tv_nsec += MT_POLL_MS * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ++ts.tv_sec;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&bc.cv, &bc.mtx, &ts);
+        signals_process_delay(op, DELAY_SIGNALS_ONLY);
+    }
+    pthread_mutex_unlock(&bc.mtx);
+    for (k = 0; k < started; ++k)
+        pthread_join(warr[k].tid, NULL);
+    t1 = mono_time_us();
+    if ((ret = bc.ret))
+        goto fini;
+
+    for (k = 0, bytes = 0, cmds = 0, n_lat = 0; k < qd; ++k) {
+        bytes += warr[k].bytes;
+        cmds += warr[k].cmds;
+        n_lat += warr[k].n_lat;
+    }
+    if (n_lat > 0) {
+        lat = (uint32_t *)malloc(n_lat * sizeof(uint32_t));
+        if (NULL == lat) {
+            ret = SG_LIB_CAT_OTHER;
+            goto fini;
+        }
+        for (k = 0, n_lat = 0; k < qd; ++k) {
+            memcpy(lat + n_lat, warr[k].lat,
+                   warr[k].n_lat * sizeof(uint32_t));
+            n_lat += warr[k].n_lat;
+        }
+        qsort(lat, n_lat, sizeof(uint32_t), bench_u32_cmp);
+    }
+    usecs = (double)((t1 > t0) ? (t1 - t0) : 1);
+    printf("%s,%s,%d,%d,%d,%d,%s,%.3f,%" PRId64 ",%" PRId64 ",%.2f,%.1f,"
+           "%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n", bench_mode_s[mode], path,
+           op->ibs, bpt, bpt * op->ibs, qd,
+           (direct < 0) ? "-" : (direct ? "direct" : "buffered"),
+           usecs / 1000000.0, bytes, cmds, bytes / usecs,
+           cmds * 1000000.0 / usecs, bench_pctl(lat, n_lat, 500),
+           bench_pctl(lat, n_lat, 990), bench_pctl(lat, n_lat, 999));
+    fflush(stdout);
+
+fini:
+    for (k = 0; k < qd; ++k) {
+        bwp = warr + k;
+        mt_worker_close(&bwp->w_ids, op->idip);
+        mt_worker_close(&bwp->w_ods, op->odip);
+        wrk_buff_free(op, bwp->free_bp);
+        if (bwp->lat)
+            free(bwp->lat);
+    }
+    if (lat)
+        free(lat);
+    free(warr);
+    pthread_cond_destroy(&bc.cv);
+    pthread_mutex_destroy(&bc.mtx);
+    return ret;
+}
+
+static const char *
+bench_path_s(int d_type)
+{
+    if (FT_PT & d_type)
+        return "pt";
+    else if (FT_BLOCK & d_type)
+        return "blk";
+    else if (FT_REG & d_type)
+        return "reg";
+    return "-";
+}
+
+/* --bench[=SECS]: instead of copying, sweeps BPT (or just bpt=BPT), queue
+ * depth (or just qd=QD) and, for block devices and regular files, buffered
+ * and direct IO (or just direct when iflag=direct or oflag=direct is
+ * given). Reads IFILE when OFILE is /dev/null, writes OFILE when IFILE is
+ * /dev/zero (or iflag=ff) and otherwise reads IFILE and writes what was
+ * read to OFILE. Each point runs for SECS seconds or until the COUNT
+ * blocks starting at SKIP have been read (or written), whichever comes
+ * first. One comma separated line per point is sent to stdout. */
+static int
+do_bench(struct opts_t * op)
+{
+    static const int bench_bytes[] = {4096, 16384, 65536, 262144, 1048576};
+    static const int bench_qds[] = {1, 4, 16};
+    bool dir_only;
+    int k, j, d, mode, step, res, nb, nqd, d_lo, d_hi;
+    int bpts[sizeof(bench_bytes) / sizeof(bench_bytes[0])];
+    int qds[sizeof(bench_qds) / sizeof(bench_qds[0])];
+    int id_type = op->idip->d_type;
+    int od_type = op->odip->d_type;
+    int kinds = FT_PT | FT_BLOCK | FT_REG;
+    int dio_types = 0;
+    char path[16];
+
+    if (FT_DEV_NULL & od_type) {
+        mode = BENCH_READ;
+        dio_types = id_type;
+        snprintf(path, sizeof(path), "%s", bench_path_s(id_type));
+    } else if (! (kinds & od_type)) {
+        pr2serr("--bench: OFILE must be /dev/null, pt, block device or "
+                "regular file\n");
+        return SG_LIB_SYNTAX_ERROR;
+    } else if (kinds & id_type) {
+        mode = BENCH_COPY;
+        dio_types = id_type | od_type;
+        snprintf(path, sizeof(path), "%s:%s", bench_path_s(id_type),
+                 bench_path_s(od_type));
+    } else {
+        mode = BENCH_WRITE;
+        dio_types = od_type;
+        snprintf(path, sizeof(path), "%s", bench_path_s(od_type));
+    }
+    if ((BENCH_WRITE != mode) &&
+        (op->reading_fifo || (! (kinds & id_type)))) {
+        pr2serr("--bench: IFILE must be pt, block device or regular file\n");
         return SG_LIB_SYNTAX_ERROR;
     }
-
-    if ('\0' == odip->fn[0])
-        strcpy(odip->fn, "."); /* treat no 'of=OFILE' option as /dev/null */
-    if (('-' == odip->fn[0]) && ('\0' == odip->fn[1])) {
-        fd = STDOUT_FILENO;
-        odip->d_type = FT_FIFO;
-        odip->d_type_hold = odip->d_type;
-        if (op->verbose)
-            pr2serr(" >> Output file type: fifo [stdin, stdout, named "
-                    "pipe]\n");
+    if (op->dd_count <= 0) {
+        pr2serr("--bench: nothing to do, give count=COUNT\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (0 == mono_time_us()) {
+        pr2serr("--bench: no clock on this platform\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    step = bpt_step(op);
+    if (op->bpt_given || op->bpt_auto) {
+        bpts[0] = op->bpt_i;
+        nb = 1;
     } else {
-        fd = open_of(op);
-        if (fd < -1)
-            return -fd;
+        for (k = 0, nb = 0; k < (int)(sizeof(bench_bytes) /
+                                     sizeof(bench_bytes[0])); ++k) {
+            j = ((bench_bytes[k] / op->ibs) / step) * step;
+            if ((j >= step) && ((0 == nb) || (j > bpts[nb - 1])))
+                bpts[nb++] = j;
+        }
+        if (0 == nb)
+            bpts[nb++] = step;
     }
-    odip->fd = fd;
-
-    if (o2dip->fn[0]) {
-        if (('-' == o2dip->fn[0]) && ('\0' == o2dip->fn[1])) {
-            fd = STDOUT_FILENO;
-            o2dip->d_type = FT_FIFO;
-            if (op->verbose)
-                pr2serr(" >> Output 2 file type: fifo  [stdin, stdout, "
-                        "named pipe]\n");
-        } else {
-            o2dip->d_type = dd_filetype(o2dip->fn, op->verbose);
-            if (FT_DEV_NULL & o2dip->d_type)
-                fd = -1;
-            else if (! ((FT_REG | FT_FIFO) & o2dip->d_type)) {
-                pr2serr("Error: output 2 file type must be regular "
-                        "file or fifo\n");
-                return SG_LIB_FILE_ERROR;
-            } else {
-                if ((fd = open(o2dip->fn, O_WRONLY | O_CREAT, 0666)) < 0) {
-                    ret = errno;
-                    pr2serr("could not open %s for writing: %s\n", o2dip->fn,
-                            safe_strerror(errno));
-                    return ret;
+    if (op->qd_given) {
+        qds[0] = op->queue_depth;
+        nqd = 1;
+    } else {
+        nqd = sizeof(bench_qds) / sizeof(bench_qds[0]);
+        for (k = 0; k < nqd; ++k)
+            qds[k] = bench_qds[k];
+    }
+    dir_only = op->iflagp->direct || op->oflagp->direct;
+    if (! ((FT_BLOCK | FT_REG) & dio_types)) {
+        d_lo = -1;       /* pt: not applicable */
+        d_hi = -1;
+    } else {
+        d_lo = dir_only ? 1 : 0;
+        d_hi = 1;
+    }
+    if (op->verbose)
+        pr2serr("--bench: %s %s, %" PRId64 " blocks from %s, %d seconds "
+                "per point\n", bench_mode_s[mode], path, op->dd_count,
+                (BENCH_WRITE == mode) ? "seek" : "skip", op->bench_secs);
+
+    printf("mode,path,bs,bpt,bytes_per_cmd,qd,io,secs,bytes,cmds,"
+           "mb_per_sec,iops,lat_p50_us,lat_p99_us,lat_p999_us\n");
+    for (d = d_lo; d <= d_hi; ++d) {
+        for (k = 0; k < nb; ++k) {
+            for (j = 0; j < nqd; ++j) {
+                res = bench_point(op, mode, path, bpts[k], qds[j], d);
+                if (res) {
+                    pr2serr("--bench: %s, bpt=%d, qd=%d failed\n",
+                            (d < 0) ? "-" : (d ? "direct" : "buffered"),
+                            bpts[k], qds[j]);
+                    return res;
                 }
-                if (sg_set_binary_mode(fd) < 0)
-                    perror("sg_set_binary_mode");
-                if (op->verbose)
-                    pr2serr(" >> Output 2 file type: regular\n");
             }
         }
-    } else
-        fd = -1;
-    o2dip->fd = fd;
+    }
     return 0;
 }
 
-static void
-block_size_bpt_check(struct opts_t * op)
+#else
+
+static int
+do_bench(struct opts_t * op)
 {
-    if (0 == op->bpt_given) {
-/* If reading from or writing to tape, use default bpt 1 if user did not
- * specify. Avoids inadvertent/accidental use of wrong tape block size. */
-        if ((FT_TAPE & op->idip->d_type) || (FT_TAPE & op->odip->d_type)) {
-            op->bpt_i = 1;
-        }
-#ifdef SG_LIB_FREEBSD
-        else {
-     /* FreeBSD (7+8 [DFLTPHYS]) doesn't like buffers larger than 64 KB being
-     * sent to its pt interface (CAM), so take that into account when choosing
-     * the default bpt value. There is overhead in the pt interface so reduce
-     * default bpt value so bpt*ibs <= 32 KB .*/
-        if (((FT_PT & op->idip->d_type) || (FT_PT & op->odip->d_type)) &&
-            ((op->ibs <= 32768) && (op->bpt_i * op->ibs) > 32768))
-            op->bpt_i = 32768 / op->ibs;
-        }
-#endif
-    }
+    if (op->bench_secs > 0)
+        pr2serr("--bench: needs pthreads, not supported in this build\n");
+    return SG_LIB_CAT_OTHER;
 }
 
-static void
-sparse_sparing_check(struct opts_t * op)
+#endif  /* HAVE_LIBPTHREAD */
+
+#ifdef HAVE_LIBPTHREAD
+
+/* --compare: one reader thread per file fills its own ring of buffers, the
+ * IFILE reader with cp_read_segment() so coe, errblk and holes work as in
+ * a copy, the OFILE reader with plain reads or pt READs. The main thread
+ * compares each pair of buffers as soon as both are full while the readers
+ * go on to later segments, so both files are read at once. */
+struct cmp_side_t {
+    bool done;          /* reader has finished, no more buffers will fill */
+    int ret;            /* reader's error, 0 if none */
+    int64_t n_full;     /* segments read so far */
+    int len[DDPT_MAX_BUFS];     /* bytes read into each buffer */
+    unsigned char * bp[DDPT_MAX_BUFS];
+    unsigned char * free_bp;
+    struct opts_t r_op;         /* reader's copy of main opts_t */
+    struct cmp_ctl_t * ccp;
+    pthread_t tid;
+};
+
+struct cmp_ctl_t {
+    bool stop;          /* main thread wants the readers to finish */
+    int nb;             /* buffers in each ring */
+    int64_t n_done;     /* segments compared, their buffers are free */
+    int64_t diff_blks;  /* blocks that differ ... */
+    int64_t n_ranges;   /* ... in this many ranges */
+    int64_t r_lba;      /* pending range of differing IFILE blocks */
+    int64_t r_num;
+    FILE * fp;          /* CMPF, ranges listed like iflag=errblk */
+    struct cmp_side_t side[2];  /* [0]: IFILE, [1]: OFILE */
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+};
+
+/* Reads blks blocks of OFILE starting at rop->seek into bp and places the
+ * number of bytes read in *lenp. Returns 0 on success (a short read at
+ * the end of OFILE included). */
+static int
+cmp_read_of(struct opts_t * rop, unsigned char * bp, int blks, int * lenp)
 {
-    if (op->iflagp->sparse && (! op->oflagp->sparse)) {
-        if (FT_DEV_NULL & op->odip->d_type) {
-            pr2serr("sparse flag usually ignored on input; set it "
-                    "on output in this case\n");
-            ++op->oflagp->sparse;
-        } else
-            pr2serr("sparse flag ignored on input\n");
-    }
-    if (op->oflagp->sparse) {
-        if ((FT_FIFO | FT_TAPE) & op->odip->d_type) {
-            pr2serr("oflag=sparse needs seekable output file, ignore\n");
-            op->oflagp->sparse = 0;
-        } else {
-            op->out_sparse_active = true;
-            if (op->oflagp->wsame16)
-                op->out_trim_active = true;
+    int res, blks_read;
+    int want = blks * rop->obs;
+    int got;
+    int64_t t0;
+    ssize_t n;
+
+    if (FT_PT & rop->odip->d_type) {
+        blks_read = 0;
+        res = pt_read(rop, true, bp, blks, &blks_read);
+        if (res && (0 == blks_read)) {
+            pr2serr("pt_read(compare) failed, at or after lba=%" PRId64
+                    " [0x%" PRIx64 "]\n", rop->seek, rop->seek);
+            return res;
         }
+        *lenp = blks_read * rop->obs_pi;
+        return 0;
     }
-    if (op->oflagp->sparing) {
-        if ((FT_DEV_NULL | FT_FIFO | FT_TAPE) & op->odip->d_type) {
-            pr2serr("oflag=sparing needs a readable and seekable "
-                    "output file, ignore\n");
-            op->oflagp->sparing = false;
-        } else
-            op->out_sparing_active = true;
+    for (got = 0; got < want; got += n) {
+        t0 = lat_start(rop);
+        n = pread(rop->odip->fd, bp + got, want - got,
+                  (rop->seek * rop->obs) + got);
+        lat_end(rop, DDPT_PH_READ, t0);
+        if (n < 0) {
+            if (EINTR == errno) {
+                ++rop->interrupted_retries;
+                n = 0;
+                continue;
+            }
+            pr2serr("read(compare), seek=%" PRId64 " : %s\n", rop->seek,
+                    safe_strerror(errno));
+            return ((EIO == errno) || (EREMOTEIO == errno)) ?
+                   SG_LIB_CAT_MEDIUM_HARD : SG_LIB_CAT_OTHER;
+        } else if (0 == n)
+            break;      /* end of OFILE */
     }
+    *lenp = got;
+    return 0;
 }
 
-static void
-cdb_size_prealloc(struct opts_t * op)
+static void *
+cmp_reader_thread(void * vp)
 {
-    if (op->oflagp->prealloc) {
-        if ((FT_DEV_NULL | FT_FIFO | FT_TAPE | FT_PT) & op->odip->d_type) {
-            pr2serr("oflag=prealloc needs a normal output file, ignore\n");
-            op->oflagp->prealloc = false;
-        }
-    }
-    if (! op->cdbsz_given) {
-        if ((FT_PT & op->idip->d_type) && (op->iflagp->cdbsz < 16) &&
-            (((op->dd_count + op->skip) > UINT_MAX) ||
-             (op->bpt_i > USHRT_MAX))) {
-            if (op->verbose > 0)
-                pr2serr("SCSI command size increased from 10 to 16 "
-                        "bytes on %s\n", op->idip->fn);
-            op->iflagp->cdbsz = 16;
-        }
-        if ((FT_PT & op->odip->d_type) && (op->oflagp->cdbsz < 16) &&
-            (((op->dd_count + op->seek) > UINT_MAX) ||
-             (((op->ibs * op->bpt_i) / op->obs) > USHRT_MAX))) {
-            if (op->verbose)
-                pr2serr("SCSI command size increased from 10 to 16 "
-                        "bytes on %s\n", op->odip->fn);
-            op->oflagp->cdbsz = 16;
+    bool out, last;
+    int k, res, len, blks;
+    int64_t seg;
+    struct cmp_side_t * sp = (struct cmp_side_t *)vp;
+    struct cmp_ctl_t * ccp = sp->ccp;
+    struct opts_t * rop = &sp->r_op;
+    struct cp_state_t cs;
+
+    out = (sp != ccp->side);
+    memset(&cs, 0, sizeof(cs));
+    for (seg = 0; rop->dd_count > 0; ++seg) {
+        pthread_mutex_lock(&ccp->mtx);
+        while ((! ccp->stop) && ((seg - ccp->n_done) >= ccp->nb))
+            pthread_cond_wait(&ccp->cv, &ccp->mtx);
+        last = ccp->stop;
+        pthread_mutex_unlock(&ccp->mtx);
+        if (last)
+            break;
+
+        k = seg % ccp->nb;
+        blks = (rop->dd_count < rop->bpt_i) ? (int)rop->dd_count :
+                                              rop->bpt_i;
+        len = 0;
+        if (out)
+            res = cmp_read_of(rop, sp->bp[k], blks, &len);
+        else {
+            cp_segment_init(rop, &cs, sp->bp[k], false);
+            res = cp_read_segment(rop, &cs, sp->bp[k]);
+            if (0 == res) {
+                len = cp_bytes_in(rop, &cs);
+                if (rop->hashp && (cs.icbpt > 0))
+                    res = cp_hash_segment(rop, &cs, sp->bp[k]);
+            }
         }
+        last = (res || (len < (blks * rop->ibs_pi)));
+
+        pthread_mutex_lock(&ccp->mtx);
+        sp->len[k] = len;
+        sp->ret = res;
+        ++sp->n_full;
+        pthread_cond_broadcast(&ccp->cv);
+        pthread_mutex_unlock(&ccp->mtx);
+        if (last)
+            break;
+        rop->dd_count -= blks;
+        if (out)
+            rop->seek += blks;
+        else
+            rop->skip += blks;
     }
+    pthread_mutex_lock(&ccp->mtx);
+    sp->done = true;
+    pthread_cond_broadcast(&ccp->cv);
+    pthread_mutex_unlock(&ccp->mtx);
+    return NULL;
 }
 
-#ifdef SG_LIB_LINUX
+static void
+cmp_range_flush(struct opts_t * op, struct cmp_ctl_t * ccp)
+{
+    if (0 == ccp->r_num)
+        return;
+    ++ccp->n_ranges;
+    lba_list_put_range(ccp->fp, ccp->r_lba, ccp->r_num);
+    if (op->verbose)
+        pr2serr("--compare: %" PRId64 " blocks differ from IFILE lba=%"
+                PRId64 " [0x%" PRIx64 "]\n", ccp->r_num, ccp->r_lba,
+                ccp->r_lba);
+    ccp->r_num = 0;
+}
 
+/* Adds num differing blocks of IFILE starting at lba, merging them with
+ * the pending range when contiguous (also across segments). */
 static void
-tape_cleanup_of(struct opts_t * op)
+cmp_range_add(struct opts_t * op, struct cmp_ctl_t * ccp, int64_t lba,
+              int64_t num)
 {
-    /* Before closing OFILE, if writing to tape handle suppressing the
-     * writing of a filemark and/or flushing the drive buffer which the
-     * Linux st driver normally does when tape file is closed after writing.
-     * Possibilities depend on oflag arguments:
-     * nofm:         MTWEOFI 0 if possible (kernel 2.6.37+), else MTBSR 0
-     * nofm & fsync: MTWEOF 0
-     * fsync:        Do nothing; st writes filemark & flushes buffer on close.
-     * neither:      MTWEOFI 1 if possible (2.6.37+), else nothing (drive
-     *               buffer will be flushed if MTWEOFI not possible). */
-    struct mtop mt_cmd;
-    int res;
+    if ((ccp->r_num > 0) && ((ccp->r_lba + ccp->r_num) != lba))
+        cmp_range_flush(op, ccp);
+    if (0 == ccp->r_num)
+        ccp->r_lba = lba;
+    ccp->r_num += num;
+    ccp->diff_blks += num;
+}
 
-    if (op->oflagp->nofm || (! op->oflagp->fsync)) {
-        mt_cmd.mt_op = op->oflagp->fsync ? MTWEOF : MTWEOFI;
-        mt_cmd.mt_count = (op->oflagp->nofm) ? 0 : 1;
-        res = ioctl(op->odip->fd, MTIOCTOP, &mt_cmd);
-        if (res != 0) {
-            if (op->verbose > 0)
-                pr2serr("MTWEOF%s %d failed: %s\n",
-                        op->oflagp->fsync ? "" : "I", mt_cmd.mt_count,
-                        safe_strerror(errno));
-            if (op->oflagp->nofm && (! op->oflagp->fsync)) {
-                if (op->verbose > 0)
-                    pr2serr("Trying MTBSR 0 instead\n");
-                mt_cmd.mt_op = MTBSR; /* mt_cmd.mt_count = 0 from above */
-                res = ioctl(op->odip->fd, MTIOCTOP, &mt_cmd);
-                if (res != 0)
-                    pr2serr("MTBSR 0 failed: %s\n(Filemark will be written "
-                            "when tape file is closed)\n",
-                            safe_strerror(errno));
-            }
+/* Compares len bytes of a segment starting at IFILE block op->skip. The
+ * whole segment is scanned at once, only blocks after a difference are
+ * compared one at a time to find where the differing run ends. A partial
+ * block at the end counts as a block. */
+static void
+cmp_segment(struct opts_t * op, struct cmp_ctl_t * ccp,
+            const unsigned char * ap, const unsigned char * bp, int len)
+{
+    int k, b, e, n;
+    int bs = op->ibs_pi;
+    int64_t t0 = lat_start(op);
+
+    for (k = 0; k < len; k = e * bs) {
+        k += first_mismatch(ap + k, bp + k, len - k);
+        if (k >= len)
+            break;
+        b = k / bs;
+        for (e = b + 1; (e * bs) < len; ++e) {
+            n = ((len - (e * bs)) < bs) ? (len - (e * bs)) : bs;
+            if (first_mismatch(ap + (e * bs), bp + (e * bs), n) >= n)
+                break;
         }
+        cmp_range_add(op, ccp, op->skip + b, e - b);
     }
+    lat_end(op, DDPT_PH_COMP, t0);
 }
 
-#endif  /* SG_LIB_LINUX */
-
+/* --compare[=CMPF]: instead of copying, reads COUNT blocks from IFILE
+ * (from SKIP) and OFILE (from SEEK) concurrently and compares them. IFILE
+ * block addresses of differing runs are appended to CMPF in the iflag=errblk
+ * format. If one file ends before the other the rest of COUNT counts as
+ * differing. Returns SG_LIB_CAT_MISCOMPARE if any block differs, else 0 or
+ * an error. */
 static int
-do_falloc(struct opts_t * op)
+do_compare(struct opts_t * op)
 {
-#ifdef SG_LIB_LINUX
-#ifdef HAVE_FALLOCATE
-    /* Try to pre-allocate space in the output file.
-     *
-     * If fallocate() does not succeed, exit with an error message. The user
-     * can then either free up some disk space or invoke ddpt without
-     * oflag=prealloc (at the risk of running out of disk space).
-     *
-     * TODO/DISCUSSION: Some filesystems (e.g. FAT32) don't support
-     * fallocate(). In that case we should probably have a way to continue if
-     * fallocate() fails, rather than exiting; useful for use in scripts
-     * where the user would like to pre-allocate space when possible.
-     *
-     * On Linux, try fallocate() with the FALLOC_FL_KEEP_SIZE flag, which
-     * allocates space but doesn't change the apparent file size (useful
-     * since oflag=resume can be used).
-     *
-     * If fallocate() with FALLOC_FL_KEEP_SIZE returns ENOTTY, EINVAL or
-     * EOPNOTSUPP, retry without that flag (since the flag is only supported
-     * in recent Linux kernels). */
-    int res;
+    bool more;
+    int k, j, n, res, len0, len1;
+    int ret = 0;
+    int started = 0;
+    int kinds = FT_PT | FT_BLOCK | FT_REG;
+    int blen = op->ibs_pi * op->bpt_i;
+    int64_t seg, skip_end;
+    struct cmp_ctl_t * ccp;
+    struct cmp_side_t * sp;
+    struct timespec ts;
+    sigset_t orig_set;
+
+    if ((! (FT_ALL_FF & op->idip->d_type)) &&
+        (op->reading_fifo || (! (kinds & op->idip->d_type)))) {
+        pr2serr("--compare: IFILE must be pt, block device or regular "
+                "file\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (! (kinds & op->odip->d_type)) {
+        pr2serr("--compare: OFILE must be pt, block device or regular "
+                "file\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((op->ibs != op->obs) || (op->ibs_pi != op->obs_pi)) {
+        pr2serr("--compare: needs the same block size (and protection "
+                "information) for\nIFILE and OFILE\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (op->dd_count <= 0) {
+        pr2serr("--compare: nothing to do, give count=COUNT\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (op->jrnlp || op->ratep || (op->o2dip->fd >= 0))
+        pr2serr("--compare: journal=, rate= and of2= are ignored\n");
+    if ((ret = cp_construct_pt_zero_buff(op)))
+        return ret;
 
-#ifdef PREALLOC_DEBUG
-    pr2serr("About to call fallocate() with FALLOC_FL_KEEP_SIZE\n");
+    ccp = (struct cmp_ctl_t *)calloc(1, sizeof(struct cmp_ctl_t));
+    if (NULL == ccp) {
+        pr2serr("%s: calloc failed\n", __func__);
+        return SG_LIB_CAT_OTHER;
+    }
+    ccp->nb = (op->num_bufs > 1) ? op->num_bufs : 2;
+    for (k = 0; k < 2; ++k) {
+        sp = ccp->side + k;
+        sp->ccp = ccp;
+        sp->r_op = *op;
+        sp->r_op.mt_worker = true;
+        sp->r_op.urp = NULL;
+        mt_zero_stats(&sp->r_op);
+        sp->bp[0] = wrk_buff_alloc(op, ccp->nb * blen, &sp->free_bp);
+        if (NULL == sp->bp[0]) {
+            pr2serr("%s: out of memory\n", __func__);
+            ret = SG_LIB_CAT_OTHER;
+            goto fini;
+        }
+        for (j = 1; j < ccp->nb; ++j)
+            sp->bp[j] = sp->bp[0] + (j * blen);
+    }
+    if (FT_ALL_FF & op->idip->d_type)
+        memset(ccp->side[0].bp[0], 0xff, ccp->nb * blen);
+    if (NULL == (ccp->fp = lba_list_open(op->cmp_fn))) {
+        ret = SG_LIB_FILE_ERROR;
+        goto fini;
+    }
+    fprintf(ccp->fp, "# compare IFILE %s from skip=%" PRId64 " with OFILE "
+            "%s from seek=%" PRId64 "\n", op->idip->fn, op->skip,
+            op->odip->fn, op->seek);
+    pthread_mutex_init(&ccp->mtx, NULL);
+    pthread_cond_init(&ccp->cv, NULL);
+    skip_end = op->skip + op->dd_count;
+    op->dd_count_start = op->dd_count;
+    if (op->do_time)
+        calc_duration_init(op);
+
+#if SA_NOCLDSTOP
+    /* only the main thread processes signals */
+    pthread_sigmask(SIG_BLOCK, &op->caught_signals, &orig_set);
 #endif
-    res = fallocate(op->odip->fd, FALLOC_FL_KEEP_SIZE, op->obs*op->seek,
-                    op->obs*op->dd_count);
-#ifdef PREALLOC_DEBUG
-    pr2serr("fallocate() returned %d\n", res);
+    for (k = 0; k < 2; ++k, ++started) {
+        res = pthread_create(&ccp->side[k].tid, NULL, cmp_reader_thread,
+                             ccp->side + k);
+        if (res) {
+            pr2serr("%s: pthread_create: %s\n", __func__,
+                    safe_strerror(res));
+            ret = SG_LIB_CAT_OTHER;
+            break;
+        }
+    }
+#if SA_NOCLDSTOP
+    pthread_sigmask(SIG_SETMASK, &orig_set, NULL);
 #endif
-    /* fallocate() fails if the kernel does not support
-     * FALLOC_FL_KEEP_SIZE, so retry without that flag. */
-    if (-1 == res) {
-        if ((ENOTTY == errno) || (EINVAL == errno)
-             || (EOPNOTSUPP == errno)) {
-            if (op->verbose)
-                pr2serr("Could not pre-allocate with "
-                        "FALLOC_FL_KEEP_SIZE (%s), retrying without "
-                        "...\n", safe_strerror(errno));
-            res = fallocate(op->odip->fd, 0 /* no flags */,
-                            op->obs * op->seek, op->obs * op->dd_count);
-#ifdef PREALLOC_DEBUG
-            pr2serr("fallocate() without FALLOC_FL_KEEP_SIZE "
-                    " returned %d\n", res);
+    for (seg = 0; 0 == ret; ++seg) {
+        k = seg % ccp->nb;
+        pthread_mutex_lock(&ccp->mtx);
+        while (((ccp->side[0].n_full <= seg) && (! ccp->side[0].done)) ||
+               ((ccp->side[1].n_full <= seg) && (! ccp->side[1].done))) {
+#ifdef HAVE_CLOCK_GETTIME
+            clock_gettime(CLOCK_REALTIME, &ts);
+#else
+            {
+                struct timeval tv;
+
+                gettimeofday(&tv, NULL);
+                ts.tv_sec = tv.tv_sec;
+                ts.tv_nsec = tv.tv_usec * 1000;
+            }
 #endif
+            ts.tv_nsec += MT_POLL_MS * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ++ts.tv_sec;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&ccp->cv, &ccp->mtx, &ts);
+            signals_process_delay(op, DELAY_SIGNALS_ONLY);
+        }
+        /* the readers write ret and n_full under mtx, take them here */
+        for (j = 0; j < 2; ++j) {
+            sp = ccp->side + j;
+            if ((sp->n_full > seg) && sp->ret && (0 == ret))
+                ret = sp->ret;
+        }
+        more = ((ccp->side[0].n_full > seg) && (ccp->side[1].n_full > seg));
+        pthread_mutex_unlock(&ccp->mtx);
+        if (ret || (! more))
+            break;      /* error or nothing more to compare */
+
+        len0 = ccp->side[0].len[k];
+        len1 = ccp->side[1].len[k];
+        cmp_segment(op, ccp, ccp->side[0].bp[k], ccp->side[1].bp[k],
+                    (len0 < len1) ? len0 : len1);
+        n = (((len0 < len1) ? len0 : len1) + op->ibs_pi - 1) / op->ibs_pi;
+        op->dd_count -= n;
+        op->skip += n;
+        op->seek += n;
+        pthread_mutex_lock(&ccp->mtx);
+        ++ccp->n_done;
+        pthread_cond_broadcast(&ccp->cv);
+        pthread_mutex_unlock(&ccp->mtx);
+        if (len0 != len1) {
+            pr2serr("--compare: %s ends at block %" PRId64 ", before the "
+                    "other file\n", (len0 < len1) ? op->idip->fn :
+                    op->odip->fn, (len0 < len1) ? op->skip : op->seek);
+            if (op->skip < skip_end)
+                cmp_range_add(op, ccp, op->skip, skip_end - op->skip);
+            break;
         }
-    } else {
-        /* fallocate() with FALLOC_FL_KEEP_SIZE succeeded. Set
-         * op->oflagp->prealloc to 0 so the possible message about using
-         * oflag=resume is not suppressed later. */
-        op->oflagp->prealloc = false;
     }
-    if (-1 == res) {
-            pr2serr("Unable to pre-allocate space: %s\n",
-                    safe_strerror(errno));
-            return SG_LIB_CAT_OTHER;
+    pthread_mutex_lock(&ccp->mtx);
+    ccp->stop = true;
+    pthread_cond_broadcast(&ccp->cv);
+    pthread_mutex_unlock(&ccp->mtx);
+    for (k = 0; k < started; ++k)
+        pthread_join(ccp->side[k].tid, NULL);
+    cmp_range_flush(op, ccp);
+    for (k = 0; k < 2; ++k)
+        mt_fold_stats(op, &ccp->side[k].r_op);
+
+    if (! op->status_none) {
+        print_stats("", op, 1 /* in only */);
+        pr2serr("%" PRId64 " blocks compared, ", op->dd_count_start -
+                op->dd_count);
+        if (ccp->diff_blks > 0)
+            pr2serr("%" PRId64 " differ in %" PRId64 " range%s, listed in "
+                    "%s\n", ccp->diff_blks, ccp->n_ranges,
+                    (1 == ccp->n_ranges) ? "" : "s", op->cmp_fn);
+        else
+            pr2serr("no differences\n");
     }
-    if (op->verbose > 1)
-        pr2serr("Pre-allocated %" PRId64 " bytes at offset %"
-                PRId64 "\n", op->obs*op->dd_count, op->obs*op->seek);
-
-#endif  /* HAVE_FALLOCATE */
-#else   /* other than SG_LIB_LINUX */
-#ifdef HAVE_POSIX_FALLOCATE
-    int res;
-
-    /* If not on Linux, use posix_fallocate(). (That sets the file size to its
-     * full length, so re-invoking ddpt with oflag=resume will do nothing.) */
-    res = posix_fallocate(op->odip->fd, op->obs * op->seek,
-                          op->obs * op->dd_count);
-    if (-1 == res) {
-            pr2serr("Unable to pre-allocate space: %s\n",
-                    safe_strerror(errno));
-            return SG_LIB_CAT_OTHER;
+    if (op->do_time)
+        calc_duration_throughput("", false /* contin */, op);
+    print_lat_stats("", op);
+    if (op->hashp)
+        hash_report(op);
+    if ((0 == ret) && (ccp->diff_blks > 0))
+        ret = SG_LIB_CAT_MISCOMPARE;
+    pthread_cond_destroy(&ccp->cv);
+    pthread_mutex_destroy(&ccp->mtx);
+
+fini:
+    if (ccp->fp)
+        lba_list_close(ccp->fp);
+    for (k = 0; k < 2; ++k) {
+        sp = ccp->side + k;
+        wrk_buff_free(op, sp->free_bp);
     }
-    if (op->verbose > 1)
-        pr2serr("Pre-allocated %" PRId64 " bytes at offset %" PRId64 "\n",
-                op->obs*op->dd_count, op->obs*op->seek);
-#else   /* do not HAVE_POSIX_FALLOCATE */
-    if (op) { ; }
-#endif  /* HAVE_POSIX_FALLOCATE else */
-#endif  /* SG_LIB_LINUX else */
-    return 0;
+    free(ccp);
+    return ret;
 }
 
-static void
-details_pre_copy_print(struct opts_t * op)
+#else
+
+static int
+do_compare(struct opts_t * op)
 {
-    pr2serr("skip=%" PRId64 " (blocks on input), seek=%" PRId64
-            " (blocks on output)\n", op->skip, op->seek);
-    if (op->verbose > 1) {
-        pr2serr("  ibs=%d bytes, obs=%d bytes, OBPC=%d\n",
-                op->ibs, op->obs, op->obpch);
-        if (op->ibs != op->ibs_pi)
-            pr2serr("  due to protect ibs_pi=%d bytes, "
-                    "obs_pi=%d bytes\n", op->ibs_pi, op->obs_pi);
-    }
-    if (op->reading_fifo && (op->dd_count < 0))
-        pr2serr("  reading fifo, blocks_per_transfer=%d\n", op->bpt_i);
-    else
-        pr2serr("  initial count=%" PRId64 " (blocks of input), "
-                "blocks_per_transfer=%d\n", op->dd_count, op->bpt_i);
-    if ((op->delay > 0) || (op->wdelay > 0))
-        pr2serr("  delay=%d ms, wdelay=%d ms\n", op->delay, op->wdelay);
+    if (op->do_compare)
+        pr2serr("--compare: needs pthreads, not supported in this build\n");
+    return SG_LIB_CAT_OTHER;
 }
 
+#endif  /* HAVE_LIBPTHREAD */
+
+/* One run of a copy with skip= and seek= lists: num blocks from in_lba
+ * of IFILE to out_lba of OFILE. ord is the run's place in the lists. */
+struct sgl_run_t {
+    uint64_t in_lba;
+    uint64_t out_lba;
+    uint32_t num;
+    int ord;
+};
+
 static int
-wrk_buffers_init(struct opts_t * op)
+sgl_run_cmp_in(const void * a, const void * b)
 {
-    int len = op->ibs_pi * op->bpt_i;
+    const struct sgl_run_t * rap = (const struct sgl_run_t *)a;
+    const struct sgl_run_t * rbp = (const struct sgl_run_t *)b;
 
-    if (op->has_xcopy)
-        return 0;
-    if (op->iflagp->direct || op->oflagp->direct) {
-        size_t psz;
+    if (rap->in_lba != rbp->in_lba)
+        return (rap->in_lba < rbp->in_lba) ? -1 : 1;
+    return rap->ord - rbp->ord;
+}
 
-#if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
-        psz = sysconf(_SC_PAGESIZE); /* POSIX.1 (was getpagesize()) */
-#elif defined(SG_LIB_WIN32)
-        psz = win32_pagesize();
-#else
-        psz = 4096;     /* give up, pick likely figure */
-#endif
+static int
+sgl_run_cmp_out(const void * a, const void * b)
+{
+    const struct sgl_run_t * rap = (const struct sgl_run_t *)a;
+    const struct sgl_run_t * rbp = (const struct sgl_run_t *)b;
 
-#ifdef HAVE_POSIX_MEMALIGN
-        {
-            int err;
-            void * wp;
+    if (rap->out_lba != rbp->out_lba)
+        return (rap->out_lba < rbp->out_lba) ? -1 : 1;
+    return rap->ord - rbp->ord;
+}
 
-            wp = op->wrkBuff;
-            err = posix_memalign(&wp, psz, len);
-            if (err) {
-                pr2serr("posix_memalign: error [%d] out of memory?\n", err);
-                return SG_LIB_CAT_OTHER;
-            }
-            op->wrkBuff = (unsigned char *)wp;
-            memset(op->wrkBuff, 0, len);
-            op->wrkPos = op->wrkBuff;
-            if (op->oflagp->sparing) {
-                wp = op->wrkBuff2;
-                err = posix_memalign(&wp, psz, len);
-                if (err) {
-                    pr2serr("posix_memalign(2): error [%d] out of memory?\n",
-                             err);
-                    return SG_LIB_CAT_OTHER;
-                }
-                op->wrkBuff2 = (unsigned char *)wp;
-                memset(op->wrkBuff2, 0, len);
-                op->wrkPos2 = op->wrkBuff2;
-            }
-        }
-#else   /* do not HAVE_POSIX_MEMALIGN */
-        op->wrkBuff = (unsigned char*)calloc(len + psz, 1);
-        if (0 == op->wrkBuff) {
-            pr2serr("Not enough user memory for aligned usage\n");
-            return SG_LIB_CAT_OTHER;
+static int
+sgl_run_cmp_ord(const void * a, const void * b)
+{
+    return ((const struct sgl_run_t *)a)->ord -
+           ((const struct sgl_run_t *)b)->ord;
+}
+
+/* Takes multiple element skip= (gather) and/or seek= (scatter) lists for a
+ * copy without odx. The lists are split at each other's element boundaries
+ * into runs, a missing list being contiguous from SKIP or SEEK. When both
+ * lists are given and no two runs write the same OFILE block, the runs are
+ * sorted by IFILE address. Runs adjacent in both IFILE and OFILE are then
+ * merged. in_sgl and out_sgl are replaced by the runs (element k of each
+ * making run k) for sgl_rw_copy(). Returns 0 if ok. */
+static int
+sgl_rw_prepare(struct opts_t * op)
+{
+    bool sorted = false;
+    int k, nr, ki, ko;
+    uint32_t i_off, o_off;
+    uint64_t in_tot, out_tot, tot, done, i_lba, o_lba, num;
+    struct scat_gath_elem * isgl = op->in_sgl;
+    struct scat_gath_elem * osgl = op->out_sgl;
+    struct sgl_run_t * runs;
+    struct sgl_run_t * rp;
+
+    if (op->ibs != op->obs) {
+        pr2serr("a skip= or seek= list without odx needs IBS and OBS to "
+                "be equal\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (op->jrnlp || op->mfp || (op->num_xof > 0) || op->oflagp->resume ||
+        op->oflagp->append || op->oflagp->trunc || op->do_compare ||
+        (op->bench_secs > 0)) {
+        pr2serr("a skip= or seek= list without odx can't be used with "
+                "journal=, manifest=,\nseveral of=, oflag=append, "
+                "oflag=resume, oflag=trunc, --compare or --bench\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    in_tot = isgl ? count_sgl_blocks(isgl, op->in_sgl_elems) : 0;
+    out_tot = osgl ? count_sgl_blocks(osgl, op->out_sgl_elems) : 0;
+    if (isgl && osgl && (in_tot != out_tot)) {
+        pr2serr("skip= list has %" PRIu64 " blocks but seek= list has %"
+                PRIu64 "\n", in_tot, out_tot);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    tot = isgl ? in_tot : out_tot;
+    if (0 == tot) {
+        pr2serr("skip= and seek= lists have no blocks to copy\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((op->dd_count >= 0) && ((uint64_t)op->dd_count != tot)) {
+        pr2serr("count=%" PRId64 " and the %" PRIu64 " blocks in the skip= "
+                "or seek= list\ncontradict\n", op->dd_count, tot);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    nr = (isgl ? op->in_sgl_elems : 0) + (osgl ? op->out_sgl_elems : 0);
+    runs = (struct sgl_run_t *)calloc(nr, sizeof(struct sgl_run_t));
+    if (NULL == runs) {
+        pr2serr("%s: out of memory\n", __func__);
+        return SG_LIB_CAT_OTHER;
+    }
+    ki = 0;
+    ko = 0;
+    i_off = 0;
+    o_off = 0;
+    i_lba = op->skip;
+    o_lba = op->seek;
+    for (nr = 0, done = 0; done < tot; ++nr, done += num) {
+        while (isgl && (0 == isgl[ki].num))
+            ++ki;
+        while (osgl && (0 == osgl[ko].num))
+            ++ko;
+        if (isgl) {
+            i_lba = isgl[ki].lba + i_off;
+            num = isgl[ki].num - i_off;
+        } else
+            num = tot - done;
+        if (osgl) {
+            o_lba = osgl[ko].lba + o_off;
+            if ((uint64_t)(osgl[ko].num - o_off) < num)
+                num = osgl[ko].num - o_off;
         }
-        op->wrkPos = (unsigned char *)(((uintptr_t)op->wrkBuff + psz - 1) &
-                                       (~((uintptr_t)psz - 1)));
-        if (op->oflagp->sparing) {
-            op->wrkBuff2 = (unsigned char*)calloc(len + psz, 1);
-            if (0 == op->wrkBuff2) {
-                pr2serr("Not enough user memory for aligned usage(2)\n");
-                return SG_LIB_CAT_OTHER;
-            }
-            op->wrkPos2 = (unsigned char *)
-                           (((uintptr_t)op->wrkBuff2 + psz - 1) &
-                            (~((uintptr_t)psz - 1)));
+        rp = runs + nr;
+        rp->in_lba = i_lba;
+        rp->out_lba = o_lba;
+        rp->num = (uint32_t)num;
+        rp->ord = nr;
+        i_lba += num;
+        o_lba += num;
+        if (isgl && ((i_off += num) == isgl[ki].num)) {
+            ++ki;
+            i_off = 0;
         }
-#endif  /* HAVE_POSIX_MEMALIGN */
-    } else {
-        op->wrkBuff = (unsigned char*)calloc(op->ibs_pi * op->bpt_i, 1);
-        if (0 == op->wrkBuff) {
-            pr2serr("Not enough user memory\n");
-            return SG_LIB_CAT_OTHER;
+        if (osgl && ((o_off += num) == osgl[ko].num)) {
+            ++ko;
+            o_off = 0;
         }
-        op->wrkPos = op->wrkBuff;
-        if (op->oflagp->sparing) {
-            op->wrkBuff2 = (unsigned char*)calloc(op->ibs_pi * op->bpt_i, 1);
-            if (0 == op->wrkBuff2) {
-                pr2serr("Not enough user memory(2)\n");
-                return SG_LIB_CAT_OTHER;
-            }
-            op->wrkPos2 = op->wrkBuff2;
+    }
+    if (isgl && osgl && (nr > 1)) {
+        qsort(runs, nr, sizeof(struct sgl_run_t), sgl_run_cmp_out);
+        for (k = 1; k < nr; ++k) {
+            if ((runs[k - 1].out_lba + runs[k - 1].num) > runs[k].out_lba)
+                break;
         }
+        sorted = (k == nr);
+        qsort(runs, nr, sizeof(struct sgl_run_t),
+              sorted ? sgl_run_cmp_in : sgl_run_cmp_ord);
+    }
+    for (k = 1, rp = runs; k < nr; ++k) {
+        if (((rp->in_lba + rp->num) == runs[k].in_lba) &&
+            ((rp->out_lba + rp->num) == runs[k].out_lba) &&
+            (((uint64_t)rp->num + runs[k].num) <= UINT32_MAX))
+            rp->num += runs[k].num;
+        else
+            *++rp = runs[k];
+    }
+    nr = (int)(rp - runs) + 1;
+
+    isgl = (struct scat_gath_elem *)calloc(nr, sizeof(*isgl));
+    osgl = (struct scat_gath_elem *)calloc(nr, sizeof(*osgl));
+    if ((NULL == isgl) || (NULL == osgl)) {
+        pr2serr("%s: out of memory\n", __func__);
+        free(runs);
+        if (isgl)
+            free(isgl);
+        return SG_LIB_CAT_OTHER;
     }
+    for (k = 0, rp = runs; k < nr; ++k, ++rp) {
+        isgl[k].lba = rp->in_lba;
+        isgl[k].num = rp->num;
+        osgl[k].lba = rp->out_lba;
+        osgl[k].num = rp->num;
+    }
+    free(runs);
+    if (op->in_sgl)
+        free(op->in_sgl);
+    if (op->out_sgl)
+        free(op->out_sgl);
+    op->in_sgl = isgl;
+    op->in_sgl_elems = nr;
+    op->out_sgl = osgl;
+    op->out_sgl_elems = nr;
+    op->skip = isgl[0].lba;
+    op->seek = osgl[0].lba;
+    op->dd_count = (int64_t)tot;
+    if (op->verbose)
+        pr2serr("skip= and seek= lists: %d run%s, %" PRIu64 " blocks in "
+                "all%s\n", nr, ((1 == nr) ? "" : "s"), tot,
+                (sorted ? ", sorted by IFILE address" : ""));
     return 0;
 }
 
-static void
-cleanup_resources(struct opts_t * op)
+/* A copy with several runs from sgl_rw_prepare() can't use a fifo or tape
+ * as IFILE or OFILE since each run starts with a seek. */
+static int
+sgl_rw_type_check(const struct opts_t * op)
 {
-#ifdef SG_LIB_LINUX
-    if ((FT_TAPE & op->idip->d_type) || (FT_TAPE & op->odip->d_type)) {
-        /* For writing, the st driver writes a filemark on closing the file
-         * (unless user specified oflag=nofm), so make clear that the
-         * position shown is prior to closing. */
-        print_tape_pos("Final ", " (before closing file)", op);
-        if ((FT_TAPE & op->odip->d_type) && (op->verbose > 1) &&
-            op->oflagp->nofm)
-            pr2serr("(suppressing writing of filemark on close)\n");
+    if (op->reading_fifo ||
+        (! ((FT_PT | FT_BLOCK | FT_REG) & op->idip->d_type)) ||
+        (! ((FT_PT | FT_BLOCK | FT_REG | FT_DEV_NULL) & op->odip->d_type))) {
+        pr2serr("skip= and seek= lists need IFILE and OFILE to be a pt, "
+                "block device or\nregular file\n");
+        return SG_LIB_SYNTAX_ERROR;
     }
-#endif
-
-    if (op->iflagp->errblk)
-        errblk_close(op);
+    return 0;
+}
 
-    if (op->wrkBuff)
-        free(op->wrkBuff);
-    if (op->wrkBuff2)
-        free(op->wrkBuff2);
-    if (op->zeros_buff)
-        free(op->zeros_buff);
-    if (FT_PT & op->idip->d_type)
-        pt_close(op->idip->fd);
-    else if ((op->idip->fd >= 0) && (STDIN_FILENO != op->idip->fd))
-        close(op->idip->fd);
-    if (FT_PT & op->odip->d_type)
-        pt_close(op->odip->fd);
-    if ((op->odip->fd >= 0) && (STDOUT_FILENO != op->odip->fd) &&
-        !(FT_DEV_NULL & op->odip->d_type)) {
-#ifdef SG_LIB_LINUX
-        if (FT_TAPE & op->odip->d_type)
-            tape_cleanup_of(op);
-#endif
-        close(op->odip->fd);
+/* Copies the runs that sgl_rw_prepare() left in in_sgl and out_sgl, each
+ * with do_rw_copy() so that thr=, bufs=, qd= and the other copy options
+ * apply within each run. do_rw_copy() starts assuming both file positions
+ * are 0 so they are put back there between runs. Stops at the first error
+ * or short run. On return dd_count holds the number of blocks not copied. */
+static int
+sgl_rw_copy(struct opts_t * op)
+{
+    int k;
+    int ret = 0;
+    int64_t left = op->dd_count;
+
+    for (k = 0; k < op->in_sgl_elems; ++k) {
+        if ((k > 0) &&
+            (((! (FT_PT & op->idip->d_type)) &&
+              (lseek(op->idip->fd, 0, SEEK_SET) < 0)) ||
+             ((! (FT_PT & op->odip->d_type)) &&
+              (lseek(op->odip->fd, 0, SEEK_SET) < 0)))) {
+            pr2serr("%s: lseek: %s\n", __func__, safe_strerror(errno));
+            ret = SG_LIB_FILE_ERROR;
+            break;
+        }
+        op->skip = op->in_sgl[k].lba;
+        op->seek = op->out_sgl[k].lba;
+        op->dd_count = op->in_sgl[k].num;
+        left -= op->dd_count;
+        if (op->verbose > 1)
+            pr2serr("run %d: skip=%" PRId64 " seek=%" PRId64 " count=%"
+                    PRId64 "\n", k + 1, op->skip, op->seek, op->dd_count);
+        ret = do_rw_copy(op);
+        if (ret || (op->dd_count > 0))
+            break;
     }
-    if ((op->o2dip->fd >= 0) && (STDOUT_FILENO != op->o2dip->fd))
-        close(op->o2dip->fd);
+    op->dd_count += left;
+    return ret;
 }
 
 static int
 chk_sgl_for_non_offload(struct opts_t * op)
 {
+    if ((! op->has_xcopy) &&
+        ((op->in_sgl && (op->in_sgl_elems > 1)) ||
+         (op->out_sgl && (op->out_sgl_elems > 1))))
+        return sgl_rw_prepare(op);
     if (op->in_sgl) {
         if (op->in_sgl_elems > 1) {
             pr2serr("Only accept a multiple element skip= (gather) list for "
@@ -2512,40 +6825,54 @@ chk_sgl_for_non_offload(struct opts_t * op)
 }
 
 
-/* The main() function: much of the its complex logic is spawned off to
- * helper functions shown directly above. */
-int
-main(int argc, char * argv[])
+/* One copy (or odx, xcopy, compare or bench) once the command line has
+ * been processed. Called from main() and, for each line of BFILE, from the
+ * child processes of batch=BFILE. Returns the exit status. */
+static int
+main_copy(struct opts_t * op)
 {
     int ret = 0;
     int started_copy = 0;
-    int jf_depth = 0;
-    struct opts_t ops;
-    struct flags_t iflag, oflag;
-    struct dev_info_t ids, ods, o2ds;
-    struct opts_t * op;
 
-    op = &ops;
-    state_init(op, &iflag, &oflag, &ids, &ods, &o2ds);
-    ret = cl_process(op, argc, argv, ddpt_version_str, jf_depth);
-    if (op->do_help > 0) {
-        ddpt_usage(op->do_help);
-        return 0;
-    } else if (ret)
-        return (ret < 0) ? 0 : ret;
+    install_signal_handlers(op);
+    if ((ret = progress_open(op)))
+        return ret;
+    if (op->hashp && (op->has_odx || op->has_xcopy)) {
+        pr2serr("hash= ignored, data of an offloaded copy doesn't pass "
+                "through ddpt\n");
+        hash_free(op);
+    }
+    if (op->mfp && (op->has_odx || op->has_xcopy || op->do_compare ||
+                    (op->bench_secs > 0))) {
+        pr2serr("manifest= ignored with --odx, --xcopy, --compare and "
+                "--bench\n");
+        mf_free(op);
+    }
 
-    if (op->quiet) {
-        if (NULL == freopen("/dev/null", "w", stderr))
-            pr2serr("freopen: failed to redirect stderr to /dev/null : %s\n",
-                    safe_strerror(errno));
+    if ((op->num_xof > 0) && (op->has_odx || op->has_xcopy ||
+                              op->do_compare || (op->bench_secs > 0) ||
+                              op->jrnlp || op->mfp || op->oflagp->resume)) {
+        pr2serr("several of= can't be used with --odx, --xcopy, --compare, "
+                "--bench,\n"
+                "journal=, manifest= or oflag=resume\n");
+        return SG_LIB_SYNTAX_ERROR;
     }
 
-#ifdef SG_LIB_WIN32
-    if (op->wscan)
-        return sg_do_wscan('\0', op->wscan, op->verbose);
-#endif
+    if (op->rsp && (op->has_odx || op->has_xcopy || op->do_compare ||
+                    (op->bench_secs > 0) || op->jrnlp || op->mfp ||
+                    (op->num_xof > 0) || op->oflagp->resume)) {
+        pr2serr("rescue= can't be used with --odx, --xcopy, --compare, "
+                "--bench, journal=,\nmanifest=, several of= or "
+                "oflag=resume\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
 
-    install_signal_handlers(op);
+    if (op->do_compare && (op->has_odx || op->has_xcopy ||
+                           (op->bench_secs > 0))) {
+        pr2serr("--compare can't be used with --odx, --xcopy or "
+                "--bench\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
 
     if (op->has_odx) {
         started_copy = 1;
@@ -2553,13 +6880,18 @@ main(int argc, char * argv[])
         goto cleanup;
     }
 
-    /* may allow scatter gather lists for non-odx copies in future */
+    /* multiple element lists become runs for sgl_rw_copy() */
     ret = chk_sgl_for_non_offload(op);
     if (ret)
         return ret;
 
     if ((ret = open_files_devices(op)))
         return ret;
+    if ((op->in_sgl_elems > 1) && (ret = sgl_rw_type_check(op)))
+        goto cleanup;
+#ifdef SG_LIB_LINUX
+    mem_node_check(op);
+#endif
 
     block_size_bpt_check(op);
     sparse_sparing_check(op);
@@ -2580,6 +6912,33 @@ main(int argc, char * argv[])
     }
 
     cdb_size_prealloc(op);
+    bpt_calibrate_check(op);
+    if (op->bench_secs > 0) {
+        ret = do_bench(op);
+        goto cleanup;
+    }
+    if (op->do_compare) {
+        ret = do_compare(op);
+        goto cleanup;
+    }
+    if (op->mfp && (ret = mf_start(op)))
+        goto cleanup;
+    if (op->rsp && (ret = rs_start(op)))
+        goto cleanup;
+    if (op->jrnlp && (ret = jrnl_resume_rw(op))) {
+        if (ret < 0)
+            ret = 0;    /* copy already complete */
+        goto cleanup;
+    }
+    thread_count_check(op);
+    cfr_check(op);
+    if ((ret = splice_check(op)))
+        goto cleanup;
+    tapebuf_check(op);
+    bufs_check(op);
+    uring_flags_check(op);
+    mmap_flags_check(op);
+    pt_async_check(op);
 
     if ((ret = wrk_buffers_init(op)))
         goto cleanup;
@@ -2612,11 +6971,18 @@ main(int argc, char * argv[])
     ++started_copy;
     if (op->has_xcopy)
         ret = do_xcopy_lid1(op);
+    else if (op->rsp)
+        ret = do_rescue(op);
+    else if (op->in_sgl_elems > 1)
+        ret = sgl_rw_copy(op);
     else
         ret = do_rw_copy(op);
 
-    if (! op->status_none)
+    if (! op->status_none) {
         print_stats("", op, 0 /* both in and out */);
+        if (op->fop)
+            fo_report(op);
+    }
 
     if (op->oflagp->ssync && (FT_PT & op->odip->d_type)) {
         if (! op->status_none)
@@ -2625,6 +6991,9 @@ main(int argc, char * argv[])
     }
     if (op->do_time)
         calc_duration_throughput("", false /* contin */, op);
+    print_lat_stats("", op);
+    if (op->hashp)
+        hash_report(op);
 
     if (op->sum_of_resids)
         pr2serr(">> Non-zero sum of residual counts=%d\n", op->sum_of_resids);
@@ -2647,5 +7016,43 @@ cleanup:
                 pr2serr("Early termination: some error occurred\n");
         }
     }
+    progress_final(op, (ret >= 0) ? ret : SG_LIB_CAT_OTHER);
     return (ret >= 0) ? ret : SG_LIB_CAT_OTHER;
 }
+
+/* The main() function: much of the its complex logic is spawned off to
+ * helper functions shown directly above. */
+int
+main(int argc, char * argv[])
+{
+    int ret = 0;
+    int jf_depth = 0;
+    struct opts_t ops;
+    struct flags_t iflag, oflag;
+    struct dev_info_t ids, ods, o2ds;
+    struct opts_t * op;
+
+    op = &ops;
+    state_init(op, &iflag, &oflag, &ids, &ods, &o2ds);
+    ret = cl_process(op, argc, argv, ddpt_version_str, jf_depth);
+    if (op->do_help > 0) {
+        ddpt_usage(op->do_help);
+        return 0;
+    } else if (ret)
+        return (ret < 0) ? 0 : ret;
+
+    if (op->quiet) {
+        if (NULL == freopen("/dev/null", "w", stderr))
+            pr2serr("freopen: failed to redirect stderr to /dev/null : %s\n",
+                    safe_strerror(errno));
+    }
+
+#ifdef SG_LIB_WIN32
+    if (op->wscan)
+        return sg_do_wscan('\0', op->wscan, op->verbose);
+#endif
+
+    if (op->btp)
+        return do_batch(op, argc, argv, ddpt_version_str, main_copy);
+    return main_copy(op);
+}
@@ -62,6 +62,10 @@ extern "C" {
 #include <windows.h>
 #endif
 
+#if defined(SG_LIB_LINUX) && defined(HAVE_LINUX_IO_URING_H)
+#define DDPT_HAVE_URING 1       /* iflag=uring and oflag=uring available */
+#endif
+
 #ifdef SG_LIB_FREEBSD
 #ifndef SIGINFO
 /* hack to undo hiding by _XOPEN_SOURCE and _GNU_SOURCE */
@@ -119,9 +123,47 @@ extern "C" {
 #define DDPT_MAX_JF_LINES 1000
 #define DDPT_MAX_JF_ARGS_PER_LINE 16
 #define DDPT_COUNT_INDEFINITE (-1)
+#define DDPT_MAX_THREADS 64     /* upper limit for thr=THR */
+#define DDPT_MAX_BUFS 16        /* upper limit for bufs=BUFS */
+#define DDPT_TAPE_MAX_BUFS 4096         /* tapebuf=SIZE: most segments */
+#define DDPT_TAPE_BUF_PCT 75    /* tapebuf=,PCT: default watermark */
+#define DDPT_MM_WIN_BYTES (256 * 1024 * 1024)  /* mmap flag: window size */
+#define DDPT_MAX_OUTS 8         /* upper limit for of=OFILE given again */
+#define DDPT_TRIM_MAX_DESCS 128 /* ranges batched into one UNMAP command */
+#define DDPT_TRIM_MAX_BYTES (1024 * 1024 * 1024)  /* blk, reg: per trim */
+#define DDPT_MEM_HEAP 0         /* mem=MEM: work buffers from the heap */
+#define DDPT_MEM_PAGE 1         /*   mapped anonymous pages */
+#define DDPT_MEM_THP 2          /*   madvise()d for transparent hugepages */
+#define DDPT_MEM_HUGE 3         /*   2 MB hugetlb pages else THP */
+#define DDPT_MEM_HUGE1G 4       /*   1 GB hugetlb pages else THP */
+#define DDPT_MEM_NO_NODE (-1)   /* mem=MEM,NODE: no NUMA binding */
+#define DDPT_MEM_AUTO_NODE (-2) /*   node of the IFILE (or OFILE) device */
+#define DDPT_AUTO_BPT_MAX_BYTES (4 * 1024 * 1024) /* bpt=auto upper limit */
+#define DDPT_CAL_BYTES (8 * 1024 * 1024)  /* bpt=cal: read per trial size */
+#define DDPT_BENCH_SECS 5       /* --bench: default seconds per point */
+#define DDPT_BENCH_LATS (256 * 1024)  /* --bench: latencies kept per thread */
+#define DDPT_CMP_FILE "cmpblk.txt"    /* --compare: default CMPF */
+#define DDPT_LAT_BUCKETS 32     /* status=lat: log2(microsecond) buckets */
+#define DDPT_JRNL_SECS 10       /* journal=: default checkpoint interval */
+#define DDPT_MF_CHUNK_BYTES 65536   /* manifest=: default OBPC * OBS */
+#define DDPT_RS_SECS 30         /* rescue=: default map save interval */
+#define DDPT_RS_MAX_SKIP_BYTES (1024 * 1024 * 1024) /* rescue=: skip cap */
+#define DDPT_BT_JOBS 4          /* batch=: default copies running at once */
+#define DDPT_BT_MAX_JOBS 256
+#define DDPT_BT_DEVQ 1          /* batch=: default running per device */
+
+#define DDPT_HASH_NONE 0        /* hash=ALG digests, see ddpt_hash.c */
+#define DDPT_HASH_CRC32C 1
+#define DDPT_HASH_XXH64 2
+#define DDPT_HASH_SHA256 3
+#define DDPT_HASH_MAX_LEN 32    /* bytes in the longest digest */
+#define DDPT_DEF_QUEUE_DEPTH 32 /* default for qd=QD */
+#define DDPT_MAX_QUEUE_DEPTH 1024 /* upper limit for qd=QD */
 
 #define VPD_DEVICE_ID 0x83
 #define VPD_3PARTY_COPY 0x8f
+#define VPD_BLOCK_LIMITS 0xb0
+#define VPD_BLOCK_LIMITS_LEN 0x40
 
 #define SENSE_BUFF_LEN 32       /* Arbitrary, could be larger */
 #define READ_CAP_REPLY_LEN 8
@@ -193,9 +235,15 @@ extern "C" {
 
 #define DELAY_COPY_SEGMENT 0
 #define DELAY_WRITE 1
+#define DELAY_SIGNALS_ONLY 2    /* process pending signals, no delay */
 
 #define REASON_TAPE_SHORT_READ 1024     /* leave_reason indication */
 
+/* kinds of runs in the cp_finer_comp_wr() extent map */
+#define CP_EXT_WRITE 0  /* differs, write to OFILE */
+#define CP_EXT_SAME 1   /* same as OFILE (sparing) or zeros (sparse) */
+#define CP_EXT_TRIM 2   /* zeros, also trimmed (oflag=sparse,trim) */
+
 /* Following used for sense_key=aborted_command, asc=0x10, ascq=* which
  * contains errors associated with protection fields */
 #ifndef SG_LIB_CAT_PROTECTION
@@ -223,7 +271,8 @@ extern "C" {
 /* ODX: length field inside ROD Token constant, implies 512 byte ROD Token */
 #define ODX_ROD_TOK_LEN_FLD 504       /* 0x1f8 */
 
-#define DEF_ODX_POLL_DELAY_MS 500
+#define DEF_ODX_POLL_DELAY_MS 500     /* upper limit of poll backoff */
+#define ODX_POLL_MIN_MS 10      /* first backoff poll delay */
 
 /* In SPC-4 the cdb opcodes have more generic names */
 #define THIRD_PARTY_COPY_OUT_CMD 0x83
@@ -246,7 +295,7 @@ extern "C" {
 #define SA_ROD_TOK_INFO         0x7     /* IN, retrieve [RRTI] */
 #define SA_ALL_ROD_TOKS         0x8     /* IN, retrieve */
 
-#define MAX_FIXED_SGL_ELEMS 128         /* same for gl and sl; MS max is 64 */
+#define DEF_SGL_ELEMS 32  /* initial size of gl and sl, grown as needed */
 
 
 struct scat_gath_elem {
@@ -260,6 +309,7 @@ struct block_rodtok_vpd {
     uint32_t def_inactivity_to;
     uint32_t max_tok_xfer_size;
     uint32_t optimal_xfer_count;
+    uint32_t max_conc_copies;   /* from General Copy Operations desc */
 };
 
 /* One instance for arguments to iflag= , another instance for oflag=
@@ -267,9 +317,14 @@ struct block_rodtok_vpd {
  * flags for classic dd on disks or files unless otherwise noted. */
 struct flags_t {
     bool append;        /* open non-pt OF with O_APPEND flag */
+    bool async;         /* linux, pt: queue up to QD READs or WRITEs per
+                         * segment via the sg driver's async interface */
     bool atomic;        /* for pt OF use WRITE ATOMIC instead of WRITE */
     bool block;         /* only for pt, non blocking open is default */
     bool cat;           /* xcopy(lid1) tape: strategy for inexact fit */
+    bool cfr;           /* regular files: copy_file_range() or reflink */
+    bool coalesce;      /* sparse + OBPC: write short zero runs between
+                         * writes rather than leave tiny holes */
     bool coe;           /* continue on (read) error, supply zeros */
     bool dc;            /* xcopy(lid1): destination count */
     bool del_tkn;       /* xcopy(odx): delete token after operation */
@@ -286,6 +341,7 @@ struct flags_t {
     bool ignoreew;      /* tape: ignore early warning */
     bool immed;         /* xcopy(odx): returns immediately from POPULATE
                          * TOKEN and WRITE USING TOKEN then poll */
+    bool mmap;          /* linux: reg file read or written through mmap() */
     bool no_del_tkn;    /* xcopy(odx): don't delete token after xfer */
     bool nofm;          /* tape: no filemark on close */
     bool nopad;         /* tape: no pad on partial writes */
@@ -307,6 +363,10 @@ struct flags_t {
     bool sparing;       /* saves on writes by reading OF (and/or OF2) and if
                          * same as segment read from IF, move on (i.e. don't
                          * overwrite OF (and/or OF2) with same data */
+    bool splice;        /* fifo: move data with splice(), not read() and
+                         * write() */
+    bool sqpoll;        /* io_uring: kernel thread polls submissions,
+                         * implies uring */
     bool ssync;         /* for pt OF (or OF2) do a SCSI SYNCHRONIZE CACHE
                          * at end of transfer before close */
     bool strunc;        /* perform sparse copy on non-pt OF using the
@@ -314,6 +374,8 @@ struct flags_t {
     bool sync;          /* open non-pt file with O_SYNC flag */
     bool trunc;         /* truncate non-pt OF to SEEK (typically 0 length)
                          * before start of copy */
+    bool uring;         /* linux: use io_uring on block device or regular
+                         * file (see qd=QD) */
     bool verify;        /* oflag with pt, turns WRITE into WRITE AND VERIFY */
     bool wsame16;       /* given trim or unmap then wsame16 is set. Trim/unmap
                          * done on pt using SCSI WRITE SAME(16) command */
@@ -346,36 +408,94 @@ struct dev_info_t {
     int p_i_exp;        /* protection intervals exponent */
     uint32_t xc_min_bytes;
     uint32_t xc_max_bytes;
+    uint32_t max_ws_blks;       /* from Block Limits VPD page, 0: unknown */
+    uint32_t max_unmap_blks;    /* from Block Limits VPD page, 0: no UNMAP */
+    uint32_t max_unmap_descs;   /*   or UNMAP rejected */
+    int ws_ndob;        /* WRITE SAME NDOB bit: 0 untried, 1 ok, -1 not */
+    int64_t max_xfer_bytes;     /* pt: Block Limits VPD, blk: sysfs queue */
+    int64_t opt_xfer_bytes;     /*   limits; 0 if unknown */
     char fn[INOUTF_SZ];
     struct block_rodtok_vpd * odxp;
     struct sg_pt_base * ptvp;
 };
 
+/* Phases timed by status=lat; reads and writes also get a histogram */
+#define DDPT_PH_READ 0          /* pt_low_read() and read() of IFILE */
+#define DDPT_PH_WRITE 1         /* pt_low_write() and write() of OFILE */
+#define DDPT_PH_COMP 2          /* sparse zero scans, sparing compares */
+#define DDPT_PH_DELAY 3         /* delay=MS[,W_MS] sleeps */
+#define DDPT_PH_NUM 4
+
+/* status=lat: bkt[0] counts commands taking under 1 microsecond and
+ * bkt[k] (k > 0) those taking from 2**(k-1) up to 2**k microseconds, the
+ * last bucket taking anything longer. */
+struct lat_hist_t {
+    int64_t count;
+    int64_t max_us;
+    int64_t bkt[DDPT_LAT_BUCKETS];
+};
+
+struct lat_stats_t {
+    int64_t phase_us[DDPT_PH_NUM];      /* time spent in each phase */
+    struct lat_hist_t hist[2];          /* DDPT_PH_READ and DDPT_PH_WRITE */
+};
+
+struct rate_ctl_t;      /* rate=: token buckets, see ddpt_com.c */
+struct jrnl_t;          /* journal=: checkpoint state, see ddpt_com.c */
+struct mf_ctl_t;        /* manifest=: chunk digests, see ddpt_hash.c */
+struct fo_ctl_t;        /* several of=: the other outputs, see ddpt.c */
+struct mm_ctl_t;        /* iflag=mmap, oflag=mmap: mappings, see ddpt.c */
+struct rs_ctl_t;        /* rescue=: map of IFILE, see ddpt_rescue.c */
+struct bt_ctl_t;        /* batch=: copies to run, see ddpt_batch.c */
+struct hash_ctl_t;      /* hash=: digests of IFILE, see ddpt_hash.c */
+
+/* A running crc32c, xxh64 or sha256 digest */
+struct ddpt_hash_t {
+    int alg;            /* DDPT_HASH_* */
+    int blen;           /* bytes held in buf */
+    uint64_t len;       /* bytes hashed so far */
+    union {
+        uint32_t crc;
+        uint64_t xxh[4];
+        uint32_t sha[8];
+    } s;
+    unsigned char buf[64];      /* partial block (xxh64, sha256) */
+};
+
 /* command line options plus most other state variables */
 /* The _given fields indicate whether option was given or is a default */
 struct opts_t {
     bool bpt_given;     /* true implies bpt= option given on command line */
     bool bs_given;
     bool cdbsz_given;
+    bool cfr_active;    /* segments copied in kernel (cfr flag) */
     bool count_given;
+    bool do_compare;    /* --compare[=CMPF]: compare IFILE with OFILE */
     bool do_time;       /* default true, set false by --status=none */
     bool has_odx;       /* --odx: equivalent to iflag=odx or oflag=odx */
     bool has_xcopy;     /* --xcopy (LID1): iflag=xcopy or oflag=xcopy */
     bool ibs_given;
+    bool in_sparse_active;      /* oflag=sparse: don't read IFILE holes */
     bool interrupt_io;  /* [intio=0|1] if false, mask SIGINFO++ during IO */
     bool list_id_given;
+    bool mt_worker;     /* this is a worker thread's copy (thr= > 1) */
     bool obs_given;
     bool o_readonly;
     bool out_sparing_active;
     bool out_sparse_active;
     bool out_trim_active;
     bool outf_given;
+    bool qd_given;
     bool quiet;         /* set true when verbose=-1 (or any negative int) */
     bool reading_fifo;
     bool read1_or_transfer;     /* true when of=/dev/null or similar */
+    bool reflink_active;        /* cfr: try FICLONERANGE first */
+    bool splice_active;         /* fifo segments moved with splice() */
     bool rod_type_given;
     bool rtf_append;            /* if rtf is regular file: open(O_APPEND) */
     bool rtf_len_add;           /* append 64 bit ROD byte size to token */
+    bool prog_sock;             /* progress= DEST is a socket */
+    bool status_lat;            /* status=lat given */
     bool status_none;           /* status=none given */
     bool subsequent_wdelay;     /* so no delay before first write */
     bool xc_cat;
@@ -396,12 +516,30 @@ struct opts_t {
     int wrprotect;
     int coe_limit;
     int coe_count;
+    int num_threads;    /* thr=THR, worker threads in rw copy (def: 1) */
+    bool thr_shard;     /* thr=THR,shard: a contiguous range per worker */
+    int num_bufs;       /* bufs=BUFS, ring of work buffers (def: 1) */
+    int tape_buf_pct;   /* tapebuf=,PCT: ring full enough to stream */
+    int64_t tape_buf;   /* tapebuf=SIZE: bytes of ring, 0: not given */
+    int mem_type;       /* mem=MEM, DDPT_MEM_* (def: DDPT_MEM_HEAP) */
+    int mem_node;       /* mem=,NODE: numa node for work buffers (def: -1) */
+    int bpt_auto;       /* bpt=auto (1) from device limits, bpt=cal (2) */
+                        /* then time reads at a few sizes */
+    int64_t cfr_in_size;        /* cfr: IFILE size in bytes */
+    int queue_depth;    /* qd=QD, for io_uring and pt async (def: 32) */
+    int bench_secs;     /* --bench[=SECS], seconds per point, 0: no bench */
+    int prog_secs;      /* progress=SECS, 0: no time interval */
+    int prog_fd;        /* JSON progress records sent here (init: -1) */
+    int64_t prog_bytes;         /* progress=,BYTES, 0: no byte interval */
+    int64_t prog_start_us;      /* mono_time_us() when stream opened */
+    int64_t prog_last_us;       /* ... when previous record sent */
+    int64_t prog_last_bytes;    /* bytes read when previous record sent */
     int verbose;
     int do_help;
     int odx_request;    /* ODX_REQ_NONE==0 for no ODX */
     int timeout_xcopy;          /* xcopy(LID1) and ODX */
-    int in_sgl_elems;           /* xcopy, odx */
-    int out_sgl_elems;          /* xcopy, odx */
+    int in_sgl_elems;           /* xcopy, odx, rw with several runs */
+    int out_sgl_elems;          /* xcopy, odx, rw with several runs */
     int rtf_fd;                 /* ODX: rtf's file descriptor (init: -1) */
     uint32_t inactivity_to;     /* ODX: timeout in seconds */
     uint32_t list_id;           /* xcopy(LID1) and odx related */
@@ -413,12 +551,17 @@ struct opts_t {
     int64_t dd_count;   /* -1 for not specified, 0 for no blocks to copy */
                         /* after copy/read starts, decrements to 0 */
     int64_t dd_count_start;     /* dd_count prior to start of copy/read */
+    int64_t jrnl_skip0; /* journal=: skip of the copy as first started */
     int64_t in_full;    /* full blocks read from IFILE so far */
     int64_t out_full;   /* full blocks written to OFILE so far */
     int64_t out_sparse; /* used for sparse, sparing + trim */
     int64_t lowest_unrecovered;         /* on reads */
     int64_t highest_unrecovered;        /* on reads */
     int64_t num_xcopy;                  /* xcopy(LID1) */
+    int64_t odx_polls;                  /* odx: RRTI or RCS while busy */
+    int64_t odx_poll_wait_ms;           /* odx: time slept between polls */
+    int64_t odx_poll_idle_ms;           /* odx: est. of that after done */
+    struct lat_stats_t lat;             /* status=lat */
     int in_partial;
     int max_aborted;
     int max_uas;
@@ -439,10 +582,10 @@ struct opts_t {
     int err_to_report;
     int ibs_hold;
     FILE * errblk_fp;
-    struct scat_gath_elem * in_sgl;     /* xcopy, odx: alternative to skip=
-                                         * and count= */
-    struct scat_gath_elem * out_sgl;    /* xcopy, odx: alternative to seek=
-                                         * and count= */
+    struct scat_gath_elem * in_sgl;     /* alternative to skip= and count=,
+                                         * from malloc() */
+    struct scat_gath_elem * out_sgl;    /* alternative to seek= and count=,
+                                         * from malloc() */
     struct flags_t * iflagp;
     struct dev_info_t * idip;
     struct flags_t * oflagp;
@@ -453,13 +596,33 @@ struct opts_t {
     unsigned char * wrkBuff2;
     unsigned char * wrkPos2;
     unsigned char * zeros_buff;
+    struct ddpt_uring_t * urp;  /* io_uring state, NULL if not in use */
+    struct rate_ctl_t * ratep;  /* rate=, shared by worker threads */
+    struct jrnl_t * jrnlp;      /* journal=JRN, NULL if not given */
+    struct mf_ctl_t * mfp;      /* manifest=MF, NULL if not given */
+    struct fo_ctl_t * fop;      /* outputs after the first of=OFILE */
+    struct mm_ctl_t * mmp;      /* mmap flag windows, NULL when not used */
+    struct rs_ctl_t * rsp;      /* rescue=MAP[,SECS], NULL if not given */
+    struct bt_ctl_t * btp;      /* batch=BFILE, NULL if not given */
+    struct hash_ctl_t * hashp;  /* hash=ALG[,FILE], NULL if not given */
     char rtf[INOUTF_SZ];        /* ODX: ROD token filename */
+    char prog_dest[INOUTF_SZ];  /* progress=,,DEST ("" for stderr) */
+    char cmp_fn[INOUTF_SZ];     /* --compare=CMPF, differing LBAs go here */
+    int num_xof;                /* of= given (num_xof + 1) times */
+    char xof_fn[DDPT_MAX_OUTS - 1][INOUTF_SZ];  /* of= after the first */
 #ifdef SG_LIB_WIN32
     int wscan;          /* only used on Windows, for scanning devices */
 #endif
 #ifdef HAVE_POSIX_FADVISE
     off_t lowest_skip;
     off_t lowest_seek;
+    int64_t cw_win;     /* cache=WIN: IFILE readahead window bytes, 0: off */
+    int64_t cw_dirty;   /* cache=,DIRTY: most OFILE bytes left dirty */
+    int64_t cw_in_lo;   /* IFILE bytes before this dropped, -1: not begun */
+    int64_t cw_in_ra;   /* IFILE WILLNEED given up to this byte */
+    int64_t cw_out_lo;  /* OFILE bytes before this written back, dropped */
+    int64_t cw_out_wb;  /* OFILE writeback started up to this byte */
+    int64_t cw_out_hi;  /* OFILE written up to this byte, -1: not begun */
 #endif
 #if SA_NOCLDSTOP
     sigset_t caught_signals;
@@ -476,8 +639,22 @@ struct opts_t {
 
 /* state of working variables within do_copy() */
 /* permits do_copy() to be broken up into lots of helpers */
+/* A run of OBPC sized chunks that cp_finer_comp_wr() treats alike */
+struct cp_extent_t {
+    int kind;           /* CP_EXT_WRITE, CP_EXT_SAME or CP_EXT_TRIM */
+    int off;            /* byte offset within the segment */
+    int len;            /* byte length of run */
+};
+
+/* A range of OFILE blocks to be trimmed, as in an UNMAP block descriptor */
+struct trim_rng_t {
+    int64_t lba;
+    uint32_t num;
+};
+
 struct cp_state_t {
     bool leave_after_write;
+    bool in_hole;       /* segment is a hole in IFILE so wasn't read */
     int icbpt;
     int ocbpt;
     int bytes_read;
@@ -485,8 +662,20 @@ struct cp_state_t {
     int bytes_of2;
     int leave_reason;   /* ==0 for no error (e.g. EOF) */
     int partial_write_bytes;
+    int ext_max;        /* number of elements in ext_map */
     int64_t if_filepos;
     int64_t of_filepos;
+    int64_t trim_lba;   /* start of pending trim (WRITE SAME(16), UNMAP) */
+    int64_t trim_blks;  /* number of blocks in pending trim, 0 for none */
+    int trim_qn;        /* ranges queued in trim_q to be sent */
+    int64_t trim_q_blks;        /* blocks in those ranges */
+    struct trim_rng_t trim_q[DDPT_TRIM_MAX_DESCS];
+    int64_t in_data_lo; /* byte range of IFILE known to hold data */
+    int64_t in_data_hi;
+    int64_t in_hole_lo; /* byte range of IFILE known to be a hole */
+    int64_t in_hole_hi;
+    struct cp_extent_t * ext_map;       /* used by cp_finer_comp_wr() */
+    unsigned char * mm_bp;      /* iflag=mmap: segment in mapped IFILE */
 };
 
 struct val_str_t {
@@ -508,7 +697,17 @@ struct rrti_resp_t {
     unsigned char rod_tok[512]; /* (perhaps truncate to) ODX ROD Token */
 };
 
+/* Adaptive poller for a command sent with the IMMED bit (odx) */
+struct odx_poll_t {
+    uint32_t backoff;   /* next delay (ms) when nothing better is known */
+    uint32_t waited;    /* ms slept since the previous poll */
+    uint64_t want;      /* transfer count expected, 0 if not known */
+    uint64_t last_tc;   /* transfer count at previous poll */
+    double ms_per_blk;  /* from transfer count advance, 0 if not known */
+};
+
 struct sg_simple_inquiry_resp;
+struct ddpt_uring_t;
 
 
 /* Functions declared below are shared by different compilation units */
@@ -518,10 +717,27 @@ struct sg_simple_inquiry_resp;
 
 /* defined in ddpt_com.c */
 void sleep_ms(int millisecs);
+int64_t mono_time_us(void);
 void state_init(struct opts_t * op, struct flags_t * ifp,
                 struct flags_t * ofp, struct dev_info_t * idip,
                 struct dev_info_t * odip, struct dev_info_t * o2dip);
 void print_stats(const char * str, struct opts_t * op, int who);
+int64_t lat_start(const struct opts_t * op);
+void lat_end(struct opts_t * op, int phase, int64_t start);
+void lat_stats_fold(struct lat_stats_t * to, const struct lat_stats_t * from);
+void print_lat_stats(const char * str, const struct opts_t * op);
+int rate_parse(struct opts_t * op, const char * arg);
+void rate_limit(struct opts_t * op, int64_t bytes);
+void rate_free(struct opts_t * op);
+int jrnl_parse(struct opts_t * op, const char * arg);
+int jrnl_start(struct opts_t * op, int64_t * donep);
+bool jrnl_due(const struct opts_t * op);
+int jrnl_checkpoint(struct opts_t * op, int64_t done, bool complete);
+void jrnl_free(struct opts_t * op);
+int sync_outputs(struct opts_t * op, const char * who);
+int progress_open(struct opts_t * op);
+void progress_check(struct opts_t * op);
+void progress_final(struct opts_t * op, int ret);
 int dd_filetype(const char * filename, int verbose);
 char * dd_filetype_str(int ft, char * buff, int max_bufflen,
                        const char * fname);
@@ -531,8 +747,14 @@ void calc_duration_throughput(const char * leadin, bool contin,
 void print_blk_sizes(const char * fname, const char * access_typ,
                      int64_t num_blks, int blk_sz, bool to_stderr);
 void zero_coe_limit_count(struct opts_t * op);
+int first_nonzero(const unsigned char * bp, int len);
+int first_mismatch(const unsigned char * ap, const unsigned char * bp,
+                   int len);
 int get_blkdev_capacity(struct opts_t * op, int which_arg,
                         int64_t * num_blks, int * blk_sz);
+FILE * lba_list_open(const char * fn);
+void lba_list_put_range(FILE * fp, uint64_t lba, int64_t num);
+void lba_list_close(FILE * fp);
 void errblk_open(struct opts_t * op);
 void errblk_put(uint64_t lba, struct opts_t * op);
 void errblk_put_range(uint64_t lba, int num, struct opts_t * op);
@@ -552,10 +774,10 @@ char * rt_cm_id_str(const unsigned char * rtp, int rt_len, char * b,
                     int b_mlen);
 void print_exit_status_msg(const char * prefix, int exit_stat,
                            bool to_stderr);
-int cl_to_sgl(const char * inp, struct scat_gath_elem * sgl_arr,
-              int * arr_len, int max_arr_len);
-int file_to_sgl(const char * file_name, struct scat_gath_elem * sgl_arr,
-                int * arr_len, int max_arr_len);
+int cl_to_sgl(const char * inp, struct scat_gath_elem ** sgl_pp,
+              int * arr_len);
+int file_to_sgl(const char * file_name, struct scat_gath_elem ** sgl_pp,
+                int * arr_len);
 
 /* defined in ddpt_pt.c */
 void * pt_construct_obj(void);
@@ -571,7 +793,16 @@ int pt_write(struct opts_t * op, const unsigned char * buff, int blocks,
              int64_t to_block);
 int pt_write_same16(struct opts_t * op, const unsigned char * buff, int bs,
                     int blocks, int64_t start_block);
+int pt_unmap(struct opts_t * op, const struct trim_rng_t * rp, int num);
 void pt_sync_cache(int fd);
+int pt_block_limits_of(struct opts_t * op, struct dev_info_t * dip);
+#ifdef SG_LIB_LINUX
+bool pt_async_capable(int fd);
+int pt_read_async(struct opts_t * op, bool in0_out1, unsigned char * buff,
+                  int blocks, int * blks_readp);
+int pt_write_async(struct opts_t * op, const unsigned char * buff,
+                   int blocks, int64_t to_block);
+#endif
 int pt_3party_copy_out(int sg_fd, int sa, uint32_t list_id, int group_num,
                        int timeout_secs, void * paramp, int param_len,
                        bool noisy, int verbose, int err_vb);
@@ -592,13 +823,65 @@ int do_rrti(struct opts_t * op, bool in0_out1, struct rrti_resp_t * rrp,
 int do_rcs(struct opts_t * op, bool in0_out1, struct rrti_resp_t * rrp,
            int verb);
 void get_local_rod_tok(unsigned char * tokp, int max_tok_len);
-int process_after_poptok(struct opts_t * op, uint64_t * tcp, int vb_a);
+void odx_poll_init(struct odx_poll_t * pp, uint64_t want);
+uint32_t odx_poll_next(struct opts_t * op, struct odx_poll_t * pp,
+                       const struct rrti_resp_t * rrp);
+void odx_poll_sleep(struct opts_t * op, struct odx_poll_t * pp,
+                    uint32_t delay);
+void odx_poll_done(struct opts_t * op, struct odx_poll_t * pp,
+                   const struct rrti_resp_t * rrp);
+int process_after_poptok(struct opts_t * op, uint64_t * tcp,
+                         uint64_t want_blks, int vb_a);
 int do_wut(struct opts_t * op, unsigned char * tokp, uint64_t blk_off,
            uint32_t num_blks, uint64_t oir, bool more_left, bool walk_list_id,
            int vb_a);
-int process_after_wut(struct opts_t * op, uint64_t * tcp, int vb_a);
+int process_after_wut(struct opts_t * op, uint64_t * tcp,
+                      uint64_t want_blks, int vb_a);
 int do_odx(struct opts_t * op);
 
+#ifdef DDPT_HAVE_URING
+/* defined in ddpt_uring.c */
+int uring_init(struct opts_t * op, unsigned char * bp, unsigned char * bp2,
+               int blen);
+void uring_fini(struct opts_t * op);
+int uring_rw(struct opts_t * op, int which_arg, bool wr, unsigned char * bp,
+             int numbytes, int64_t offset, int blk_sz);
+#endif
+
+/* defined in ddpt_hash.c */
+int hash_alg_from_name(const char * name);
+const char * hash_alg_name(int alg);
+void hash_init(struct ddpt_hash_t * hp, int alg);
+void hash_update(struct ddpt_hash_t * hp, const unsigned char * bp,
+                 size_t len);
+int hash_final(struct ddpt_hash_t * hp, unsigned char * out);
+void hash_hex(const unsigned char * dp, int len, char * b);
+int hash_parse(struct opts_t * op, const char * arg);
+int hash_segment(struct opts_t * op, const unsigned char * bp, int len,
+                 int64_t skip, int blks);
+void hash_report(struct opts_t * op);
+void hash_free(struct opts_t * op);
+int mf_parse(struct opts_t * op, const char * arg);
+int mf_start(struct opts_t * op);
+bool mf_chunk_same(struct opts_t * op, int64_t lba, const unsigned char * bp,
+                   int len);
+void mf_invalidate(struct opts_t * op, int64_t lba, int64_t blks);
+int mf_finish(struct opts_t * op);
+void mf_free(struct opts_t * op);
+
+/* defined in ddpt_rescue.c */
+int rs_parse(struct opts_t * op, const char * arg);
+int rs_start(struct opts_t * op);
+int do_rescue(struct opts_t * op);
+void rs_free(struct opts_t * op);
+
+/* defined in ddpt_batch.c */
+typedef int (*bt_copy_fn)(struct opts_t * op);  /* one copy, as main() */
+int bt_parse(struct opts_t * op, const char * arg);
+int do_batch(struct opts_t * op, int argc, char * argv[],
+             const char * version_str, bt_copy_fn copy_fn);
+void bt_free(struct opts_t * op);
+
 /* defined in ddpt_cl.c */
 int cl_process(struct opts_t * op, int argc, char * argv[],
                const char * version_str, int jf_depth);
@@ -0,0 +1,687 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * This file contains batch=BFILE[,JOBS[,DEVQ]]: running the copies listed
+ * in BFILE, one per line, with up to JOBS of them at once. Each copy is a
+ * child process that parses the rest of the command line and then its own
+ * line, just as if ddpt had been invoked with both. No more than DEVQ
+ * running copies may use the same device (or the same queue=NAME) at once.
+ * At the end the counts from all copies are summed into one report.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* N.B. config.h must precede anything that depends on HAVE_*  */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifndef SG_LIB_WIN32
+#include <sys/wait.h>
+#endif
+
+#include "ddpt.h"       /* includes <signal.h> */
+
+#include "sg_lib.h"
+#include "sg_pr2serr.h"
+
+#define BT_MAX_KEYS 8           /* devices and queue= names on one line */
+#define BT_LINE_SZ 8192         /* longest line, after '\' continuations */
+
+#define BT_WAITING 0
+#define BT_RUNNING 1
+#define BT_DONE 2
+
+/* Counts that a finished copy passes back to the parent for the summary */
+struct bt_stats_t {
+    int64_t in_full;
+    int64_t out_full;
+    int64_t out_sparse;
+    int in_partial;
+    int out_partial;
+    int out_sparse_partial;
+    int recovered_errs;
+    int unrecovered_errs;
+    int wr_recovered_errs;
+    int wr_unrecovered_errs;
+    int trim_errs;
+    int num_retries;
+    int sum_of_resids;
+    int interrupted_retries;
+    int io_eagains;
+    bool out_sparse_active;
+    bool out_sparing_active;
+    bool out_trim_active;
+};
+
+/* One line of BFILE */
+struct bt_job_t {
+    int state;          /* BT_WAITING, BT_RUNNING or BT_DONE */
+    int line;           /* in BFILE, of the first part of the line */
+    int argc;           /* argv[0] names the line for messages */
+    int nkeys;
+    int keys[BT_MAX_KEYS];      /* indexes into bt_ctl_t::key */
+    int fd;             /* read end of the pipe from the child */
+    int ret;            /* exit status of the copy */
+    pid_t pid;
+    bool got_stats;
+    char * text;        /* copy of the line, argv[1..] point into it */
+    char ** argv;
+    struct bt_stats_t st;
+};
+
+/* A device, or a queue=NAME, and the number of running copies using it */
+struct bt_key_t {
+    int running;
+    char name[INOUTF_SZ];
+};
+
+struct bt_ctl_t {
+    int jobs;           /* JOBS: most copies running at once */
+    int devq;           /* DEVQ: most running per device, 0: no limit */
+    int njob;
+    int nkey;
+    struct bt_job_t * job;
+    struct bt_key_t * key;
+    char fn[INOUTF_SZ];         /* BFILE */
+};
+
+#ifndef SG_LIB_WIN32
+static volatile sig_atomic_t bt_stop_sig;
+#endif
+
+
+/* Parses the argument of batch=BFILE[,JOBS[,DEVQ]]. Returns 0 on success */
+int
+bt_parse(struct opts_t * op, const char * arg)
+{
+    int n;
+    const char * cp;
+    struct bt_ctl_t * btp;
+
+    cp = strchr(arg, ',');
+    n = cp ? (int)(cp - arg) : (int)strlen(arg);
+    if ((0 == n) || (n >= INOUTF_SZ)) {
+        pr2serr("bad argument to 'batch=', expect BFILE[,JOBS[,DEVQ]]\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (NULL == op->btp) {
+        op->btp = (struct bt_ctl_t *)calloc(1, sizeof(struct bt_ctl_t));
+        if (NULL == op->btp) {
+            pr2serr("batch=: out of memory\n");
+            return SG_LIB_CAT_OTHER;
+        }
+    }
+    btp = op->btp;
+    memcpy(btp->fn, arg, n);
+    btp->fn[n] = '\0';
+    btp->jobs = DDPT_BT_JOBS;
+    btp->devq = DDPT_BT_DEVQ;
+    if (NULL == cp)
+        return 0;
+    if (',' != cp[1]) {
+        btp->jobs = sg_get_num(cp + 1);
+        if ((btp->jobs < 1) || (btp->jobs > DDPT_BT_MAX_JOBS)) {
+            pr2serr("bad JOBS argument to 'batch=', expect 1 to %d\n",
+                    DDPT_BT_MAX_JOBS);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    if ((cp = strchr(cp + 1, ','))) {
+        if ((btp->devq = sg_get_num(cp + 1)) < 0) {
+            pr2serr("bad DEVQ argument to 'batch=', expect 0 (no limit) "
+                    "or more\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    return 0;
+}
+
+void
+bt_free(struct opts_t * op)
+{
+    int k;
+    struct bt_ctl_t * btp = op->btp;
+
+    if (NULL == btp)
+        return;
+    for (k = 0; k < btp->njob; ++k) {
+        free(btp->job[k].text);
+        if (btp->job[k].argv) {
+            free(btp->job[k].argv[0]);
+            free(btp->job[k].argv);
+        }
+    }
+    free(btp->job);
+    free(btp->key);
+    free(btp);
+    op->btp = NULL;
+}
+
+#ifndef SG_LIB_WIN32
+
+/* Adds key name (a device or queue) to jp unless it is already there.
+ * Returns 0 on success. */
+static int
+bt_key_add(struct bt_ctl_t * btp, struct bt_job_t * jp, const char * name)
+{
+    int k, j;
+    struct bt_key_t * kp;
+
+    for (k = 0; k < btp->nkey; ++k) {
+        if (0 == strcmp(name, btp->key[k].name))
+            break;
+    }
+    if (k == btp->nkey) {
+        kp = (struct bt_key_t *)realloc(btp->key,
+                                        (k + 1) * sizeof(struct bt_key_t));
+        if (NULL == kp)
+            return SG_LIB_CAT_OTHER;
+        btp->key = kp;
+        kp += k;
+        kp->running = 0;
+        snprintf(kp->name, sizeof(kp->name), "%s", name);
+        ++btp->nkey;
+    }
+    for (j = 0; j < jp->nkeys; ++j) {
+        if (k == jp->keys[j])
+            return 0;
+    }
+    if (jp->nkeys < BT_MAX_KEYS)
+        jp->keys[jp->nkeys++] = k;
+    return 0;
+}
+
+/* Finds the device that IFILE or OFILE fn is (block and char devices) or
+ * is on (others, including an OFILE yet to be created) and adds it to jp.
+ * Standard input and output and /dev/null aren't limited. */
+static int
+bt_dev_key(struct bt_ctl_t * btp, struct bt_job_t * jp, const char * fn)
+{
+    struct stat a_st;
+    char * cp;
+    char b[INOUTF_SZ + 8];
+
+    if (('\0' == fn[0]) || (0 == strcmp(fn, "-")) ||
+        (0 == strcmp(fn, ".")) || (0 == strcmp(fn, "/dev/null")))
+        return 0;
+    snprintf(b, sizeof(b), "%s", fn);
+    if (stat(b, &a_st) < 0) {
+        if ((cp = strrchr(b, '/')))
+            cp[(cp == b) ? 1 : 0] = '\0';
+        else
+            snprintf(b, sizeof(b), ".");
+        if (stat(b, &a_st) < 0)
+            return bt_key_add(btp, jp, fn);
+    } else if (S_ISBLK(a_st.st_mode) || S_ISCHR(a_st.st_mode)) {
+        snprintf(b, sizeof(b), "dev %" PRIu64, (uint64_t)a_st.st_rdev);
+        return bt_key_add(btp, jp, b);
+    }
+    snprintf(b, sizeof(b), "on dev %" PRIu64, (uint64_t)a_st.st_dev);
+    return bt_key_add(btp, jp, b);
+}
+
+/* Splits line (found at line number lnum of BFILE) into the next job.
+ * queue=NAME operands are taken out and become its keys; without them the
+ * devices of if=, of= and of2= are its keys. Returns 0 on success. */
+static int
+bt_job_add(struct bt_ctl_t * btp, const char * line, int lnum)
+{
+    int k, ntok;
+    int ndev = 0;
+    char * cp;
+    char * dev[3];
+    struct bt_job_t * jp;
+    char b[INOUTF_SZ + 32];
+
+    jp = (struct bt_job_t *)realloc(btp->job, (btp->njob + 1) *
+                                    sizeof(struct bt_job_t));
+    if (NULL == jp)
+        return SG_LIB_CAT_OTHER;
+    btp->job = jp;
+    jp += btp->njob;
+    memset(jp, 0, sizeof(*jp));
+    jp->fd = -1;
+    jp->line = lnum;
+    ++btp->njob;
+    if (NULL == (jp->text = strdup(line)))
+        return SG_LIB_CAT_OTHER;
+    for (ntok = 0, cp = jp->text; *cp; ++ntok) {
+        cp += strspn(cp, " \t");
+        if ('\0' == *cp)
+            break;
+        cp += strcspn(cp, " \t");
+    }
+    jp->argv = (char **)calloc(ntok + 2, sizeof(char *));
+    if (NULL == jp->argv)
+        return SG_LIB_CAT_OTHER;
+    snprintf(b, sizeof(b), "%s line %d", btp->fn, lnum);
+    if (NULL == (jp->argv[0] = strdup(b)))
+        return SG_LIB_CAT_OTHER;
+    jp->argc = 1;
+    for (cp = strtok(jp->text, " \t"); cp; cp = strtok(NULL, " \t")) {
+        k = 0;
+        if (0 == strncmp(cp, "queue=", 6)) {
+            snprintf(b, sizeof(b), "queue %s", cp + 6);
+            if (bt_key_add(btp, jp, b))
+                return SG_LIB_CAT_OTHER;
+            continue;
+        } else if (0 == strncmp(cp, "if=", 3))
+            k = 3;
+        else if (0 == strncmp(cp, "of=", 3))
+            k = 3;
+        else if (0 == strncmp(cp, "of2=", 4))
+            k = 4;
+        if (k && (ndev < 3))
+            dev[ndev++] = cp + k;
+        jp->argv[jp->argc++] = cp;
+    }
+    if (jp->nkeys > 0)
+        return 0;
+    for (k = 0; k < ndev; ++k) {
+        if (bt_dev_key(btp, jp, dev[k]))
+            return SG_LIB_CAT_OTHER;
+    }
+    return 0;
+}
+
+/* Reads BFILE: one copy per line, a '\' at the end of a line continues it
+ * on the next, '#' starts a comment. Returns 0 on success. */
+static int
+bt_read(struct opts_t * op)
+{
+    int len, lnum, first;
+    int ret = 0;
+    struct bt_ctl_t * btp = op->btp;
+    FILE * fp;
+    char * cp;
+    char b[BT_LINE_SZ];
+
+    if (NULL == (fp = fopen(btp->fn, "r"))) {
+        pr2serr("batch=: open of %s failed: %s\n", btp->fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    for (len = 0, lnum = 0, first = 1;
+         fgets(b + len, sizeof(b) - len, fp); ) {
+        ++lnum;
+        if (0 == len)
+            first = lnum;
+        cp = b + len;
+        len += strlen(cp);
+        if ((len > 0) && ('\n' != b[len - 1]) && (! feof(fp))) {
+            pr2serr("batch=: %s line %d too long\n", btp->fn, lnum);
+            ret = SG_LIB_FILE_ERROR;
+            break;
+        }
+        if ((cp = strchr(cp, '#'))) {
+            *cp = '\0';
+            len = cp - b;
+        }
+        while ((len > 0) && strchr(" \t\r\n", b[len - 1]))
+            b[--len] = '\0';
+        if ((len > 0) && ('\\' == b[len - 1])) {
+            b[len - 1] = ' ';
+            continue;
+        }
+        if ((len > 0) && (len != (int)strspn(b, " \t"))) {
+            if ((ret = bt_job_add(btp, b, first))) {
+                pr2serr("batch=: out of memory\n");
+                break;
+            }
+        }
+        len = 0;
+    }
+    if ((0 == ret) && ferror(fp)) {
+        pr2serr("batch=: read error on %s\n", btp->fn);
+        ret = SG_LIB_FILE_ERROR;
+    }
+    fclose(fp);
+    if ((0 == ret) && (0 == btp->njob)) {
+        pr2serr("batch=: no copies in %s\n", btp->fn);
+        ret = SG_LIB_FILE_ERROR;
+    }
+    return ret;
+}
+
+static void
+bt_stats_get(struct bt_stats_t * sp, const struct opts_t * op)
+{
+    memset(sp, 0, sizeof(*sp));
+    sp->in_full = op->in_full;
+    sp->out_full = op->out_full;
+    sp->out_sparse = op->out_sparse;
+    sp->in_partial = op->in_partial;
+    sp->out_partial = op->out_partial;
+    sp->out_sparse_partial = op->out_sparse_partial;
+    sp->recovered_errs = op->recovered_errs;
+    sp->unrecovered_errs = op->unrecovered_errs;
+    sp->wr_recovered_errs = op->wr_recovered_errs;
+    sp->wr_unrecovered_errs = op->wr_unrecovered_errs;
+    sp->trim_errs = op->trim_errs;
+    sp->num_retries = op->num_retries;
+    sp->sum_of_resids = op->sum_of_resids;
+    sp->interrupted_retries = op->interrupted_retries;
+    sp->io_eagains = op->io_eagains;
+    sp->out_sparse_active = op->out_sparse_active;
+    sp->out_sparing_active = op->out_sparing_active;
+    sp->out_trim_active = op->out_trim_active;
+}
+
+static void
+bt_stats_fold(struct opts_t * op, const struct bt_stats_t * sp)
+{
+    op->in_full += sp->in_full;
+    op->out_full += sp->out_full;
+    op->out_sparse += sp->out_sparse;
+    op->in_partial += sp->in_partial;
+    op->out_partial += sp->out_partial;
+    op->out_sparse_partial += sp->out_sparse_partial;
+    op->recovered_errs += sp->recovered_errs;
+    op->unrecovered_errs += sp->unrecovered_errs;
+    op->wr_recovered_errs += sp->wr_recovered_errs;
+    op->wr_unrecovered_errs += sp->wr_unrecovered_errs;
+    op->trim_errs += sp->trim_errs;
+    op->num_retries += sp->num_retries;
+    op->sum_of_resids += sp->sum_of_resids;
+    op->interrupted_retries += sp->interrupted_retries;
+    op->io_eagains += sp->io_eagains;
+    op->out_sparse_active = op->out_sparse_active || sp->out_sparse_active;
+    op->out_sparing_active = op->out_sparing_active ||
+                             sp->out_sparing_active;
+    op->out_trim_active = op->out_trim_active || sp->out_trim_active;
+}
+
+/* Runs in the child: the rest of the command line (argc, argv) is parsed
+ * as usual, followed by the line of BFILE, then the copy is done. Its
+ * counts go back up the pipe fd. Does not return. */
+static void
+bt_child(const struct bt_job_t * jp, int fd, int argc, char * argv[],
+         const char * version_str, bt_copy_fn copy_fn)
+{
+    int ret;
+    struct opts_t ops;
+    struct flags_t iflag, oflag;
+    struct dev_info_t ids, ods, o2ds;
+    struct opts_t * op = &ops;
+    struct bt_stats_t st;
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGHUP, SIG_DFL);
+    state_init(op, &iflag, &oflag, &ids, &ods, &o2ds);
+    ret = cl_process(op, argc, argv, version_str, 0);
+    bt_free(op);        /* this process does just the one copy */
+    if (0 == ret)
+        ret = cl_process(op, jp->argc, jp->argv, version_str, 0);
+    if ((0 == ret) && (op->btp || op->do_help)) {
+        pr2serr("%s: batch= and --help not allowed in BFILE\n",
+                jp->argv[0]);
+        ret = SG_LIB_SYNTAX_ERROR;
+    }
+    if (0 == ret)
+        ret = copy_fn(op);
+    else if (ret < 0)
+        ret = 0;
+    bt_stats_get(&st, op);
+    if (write(fd, &st, sizeof(st)) < 0) {
+        ;       /* parent reports the copy without its counts */
+    }
+    close(fd);
+    exit(ret);
+}
+
+static int
+bt_start(struct opts_t * op, struct bt_job_t * jp, int argc, char * argv[],
+         const char * version_str, bt_copy_fn copy_fn)
+{
+    int k;
+    int pfd[2];
+    pid_t pid;
+
+    if (pipe(pfd) < 0) {
+        pr2serr("batch=: pipe: %s\n", safe_strerror(errno));
+        return SG_LIB_CAT_OTHER;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid < 0) {
+        pr2serr("batch=: fork: %s\n", safe_strerror(errno));
+        close(pfd[0]);
+        close(pfd[1]);
+        return SG_LIB_CAT_OTHER;
+    }
+    if (0 == pid) {
+        close(pfd[0]);
+        bt_child(jp, pfd[1], argc, argv, version_str, copy_fn);
+    }
+    close(pfd[1]);
+    jp->pid = pid;
+    jp->fd = pfd[0];
+    jp->state = BT_RUNNING;
+    for (k = 0; k < jp->nkeys; ++k)
+        ++op->btp->key[jp->keys[k]].running;
+    if (op->verbose)
+        pr2serr("batch: started %s, pid=%d\n", jp->argv[0], (int)pid);
+    return 0;
+}
+
+/* Collects the child of jp that has exited with status. */
+static void
+bt_finish(struct opts_t * op, struct bt_job_t * jp, int status)
+{
+    int k;
+    ssize_t n;
+
+    n = read(jp->fd, &jp->st, sizeof(jp->st));
+    jp->got_stats = (n == (ssize_t)sizeof(jp->st));
+    close(jp->fd);
+    jp->fd = -1;
+    jp->state = BT_DONE;
+    for (k = 0; k < jp->nkeys; ++k)
+        --op->btp->key[jp->keys[k]].running;
+    if (WIFEXITED(status))
+        jp->ret = WEXITSTATUS(status);
+    else {
+        jp->ret = SG_LIB_CAT_OTHER;
+        if (WIFSIGNALED(status))
+            pr2serr("batch: %s killed by signal %d\n", jp->argv[0],
+                    WTERMSIG(status));
+    }
+    if (jp->ret)
+        pr2serr("batch: %s failed, exit status %d\n", jp->argv[0],
+                jp->ret);
+    else if (op->verbose)
+        pr2serr("batch: %s done\n", jp->argv[0]);
+}
+
+/* True if jp can start without a device or queue going over DEVQ */
+static bool
+bt_can_start(const struct bt_ctl_t * btp, const struct bt_job_t * jp)
+{
+    int k;
+
+    if (btp->devq > 0) {
+        for (k = 0; k < jp->nkeys; ++k) {
+            if (btp->key[jp->keys[k]].running >= btp->devq)
+                return false;
+        }
+    }
+    return true;
+}
+
+static void
+bt_stop_handler(int sig)
+{
+    bt_stop_sig = sig;
+}
+
+/* Runs the copies in BFILE, in order of their lines but passing over those
+ * waiting for a device or queue. After a signal (SIGINT, SIGTERM or SIGHUP)
+ * no more copies are started, the signal is passed on to the running ones
+ * and once they have finished the summary is printed. Returns 0 if all
+ * copies succeeded, else the exit status of the first to fail. */
+int
+do_batch(struct opts_t * op, int argc, char * argv[],
+         const char * version_str, bt_copy_fn copy_fn)
+{
+    bool passed_on = false;
+    bool start_err = false;
+    int k, res, status;
+    int running = 0;
+    int next = 0;
+    int ret = 0;
+    int num_ok = 0;
+    int num_bad = 0;
+    int64_t t0;
+    pid_t pid;
+    struct bt_ctl_t * btp = op->btp;
+    struct bt_job_t * jp;
+    struct sigaction act;
+    struct opts_t sum;
+    struct flags_t iflag, oflag;
+    struct dev_info_t ids, ods, o2ds;
+
+    if (op->idip->fn[0] || op->odip->fn[0] || op->o2dip->fn[0]) {
+        pr2serr("batch=: give if=, of= and of2= on the lines of BFILE\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if ((res = bt_read(op)))
+        return res;
+    if (op->verbose)
+        pr2serr("batch: %d copies in %s, up to %d at once, %d per device "
+                "or queue (0: no limit)\n", btp->njob, btp->fn, btp->jobs,
+                btp->devq);
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = bt_stop_handler;
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = 0;   /* no SA_RESTART so waitpid() returns EINTR */
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    sigaction(SIGHUP, &act, NULL);
+    t0 = mono_time_us();
+
+    while (true) {
+        for (k = next; (k < btp->njob) && (running < btp->jobs) &&
+                       (! bt_stop_sig) && (! start_err); ++k) {
+            jp = btp->job + k;
+            if ((BT_WAITING != jp->state) || (! bt_can_start(btp, jp)))
+                continue;
+            if ((res = bt_start(op, jp, argc, argv, version_str,
+                                copy_fn))) {
+                start_err = true;   /* no more, wait for those running */
+                if (0 == ret)
+                    ret = res;
+            } else
+                ++running;
+        }
+        while ((next < btp->njob) && (BT_WAITING != btp->job[next].state))
+            ++next;
+        if (0 == running)
+            break;
+        pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (EINTR != errno) {
+                pr2serr("batch: waitpid: %s\n", safe_strerror(errno));
+                ret = SG_LIB_CAT_OTHER;
+                break;
+            }
+            if (bt_stop_sig && (! passed_on)) {
+                passed_on = true;
+                pr2serr("batch: signal %d, waiting for %d running "
+                        "cop%s\n", (int)bt_stop_sig, running,
+                        (1 == running) ? "y" : "ies");
+                for (k = 0; k < btp->njob; ++k) {
+                    if (BT_RUNNING == btp->job[k].state)
+                        kill(btp->job[k].pid, bt_stop_sig);
+                }
+            }
+            continue;
+        }
+        for (k = 0, jp = btp->job; k < btp->njob; ++k, ++jp) {
+            if ((BT_RUNNING == jp->state) && (pid == jp->pid))
+                break;
+        }
+        if (k == btp->njob)
+            continue;
+        bt_finish(op, jp, status);
+        --running;
+        if (jp->ret) {
+            ++num_bad;
+            if (0 == ret)
+                ret = jp->ret;
+        } else
+            ++num_ok;
+    }
+
+    state_init(&sum, &iflag, &oflag, &ids, &ods, &o2ds);
+    sum.dd_count = 0;
+    for (k = 0; k < btp->njob; ++k) {
+        if (btp->job[k].got_stats)
+            bt_stats_fold(&sum, &btp->job[k].st);
+    }
+    if (! op->status_none)
+        print_stats("batch: ", &sum, 0);
+    pr2serr("batch: %d cop%s succeeded, %d failed, %d not started, took "
+            "%.1f secs\n", num_ok, (1 == num_ok) ? "y" : "ies", num_bad,
+            btp->njob - num_ok - num_bad,
+            (double)(mono_time_us() - t0) / 1000000.0);
+    bt_free(op);
+    if (bt_stop_sig) {
+        signal(bt_stop_sig, SIG_DFL);
+        raise(bt_stop_sig);
+    }
+    return ret;
+}
+
+#else   /* SG_LIB_WIN32 */
+
+int
+do_batch(struct opts_t * op, int argc, char * argv[],
+         const char * version_str, bt_copy_fn copy_fn)
+{
+    if (argc && argv && version_str && copy_fn)
+        ;       /* suppress unused warnings */
+    pr2serr("batch= not supported on Windows\n");
+    bt_free(op);
+    return SG_LIB_SYNTAX_ERROR;
+}
+
+#endif  /* SG_LIB_WIN32 */
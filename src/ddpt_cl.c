@@ -68,11 +68,6 @@
 #include "sg_pt.h"
 #include "sg_pr2serr.h"
 
-
-static struct scat_gath_elem in_fixed_sgl[MAX_FIXED_SGL_ELEMS];
-static struct scat_gath_elem out_fixed_sgl[MAX_FIXED_SGL_ELEMS];
-
-
 void
 ddpt_usage(int help)
 {
@@ -85,29 +80,45 @@ ddpt_usage(int help)
 
 primary_help:
     pr2serr("Usage: "
-           "ddpt  [bpt=BPT[,OBPC]] [bs=BS] [cdbsz=6|10|12|16|32] [coe=0|1]\n"
-           "             [coe_limit=CL] [conv=CONVS] [count=COUNT] "
-           "[delay=MS[,W_MS]]\n"
+           "ddpt  [batch=BFILE[,JOBS[,DEVQ]]] [bpt=BPT[,OBPC]] [bs=BS] "
+           "[bufs=BUFS]\n"
+           "             [cache=WIN[,DIRTY]] [cdbsz=6|10|12|16|32] [coe=0|1] "
+           "[coe_limit=CL]\n"
+           "             [conv=CONVS] [count=COUNT] [delay=MS[,W_MS]] "
+           "[hash=ALG[,FILE]]\n"
            "             [ibs=IBS] [id_usage=LIU] if=IFILE [iflag=FLAGS] "
            "[intio=0|1]\n"
-           "             [iseek=SKIP] [ito=ITO] [list_id=LID] [obs=OBS] "
+           "             [iseek=SKIP] [ito=ITO] [journal=JRN[,SECS]] "
+           "[list_id=LID]\n"
+           "             [manifest=MF] [mem=MEM[,NODE]] [obs=OBS] "
            "[of=OFILE]\n"
            "             [of2=OFILE2] [oflag=FLAGS] [oseek=SEEK] "
            "[prio=PRIO]\n"
-           "             [protect=RDP[,WRP]] [retries=RETR] [rtf=RTF] "
-           "[rtype=RTYPE]\n"
-           "             [seek=SEEK] [skip=SKIP] [status=STAT] [to=TO] "
+           "             [progress=SECS[,BYTES[,DEST]]] [protect=RDP[,WRP]] "
+           "[qd=QD]\n"
+           "             [rate=BPS[,IOPS[,BURST]]] [rescue=MAP[,SECS]] "
+           "[retries=RETR]\n"
+           "             [rtf=RTF] [rtype=RTYPE] [seek=SEEK] [skip=SKIP] "
+           "[status=STAT]\n"
+           "             [tapebuf=SIZE[,PCT]] [thr=THR[,shard]] [to=TO] "
            "[verbose=VERB]\n"
+           "             [--bench[=SECS]] [--compare[=CMPF]] [--help] "
+           "[--odx] [--verbose]\n"
 #ifdef SG_LIB_WIN32
-           "             [--help] [--odx] [--verbose] [--version] [--wscan] "
-           "[--xcopy]\n"
+           "             [--version] [--wscan] [--xcopy]\n"
 #else
-           "             [--help] [--odx] [--verbose] [--version] [--xcopy]\n"
+           "             [--version] [--xcopy]\n"
 #endif
            "             [JF]\n"
            "  where the main options are:\n"
+           "    batch       run the copies on the lines of BFILE, up to JOBS "
+           "(def: 4)\n"
+           "                at once and DEVQ (def: 1) per device or "
+           "queue=NAME\n"
            "    bpt         input Blocks Per Transfer (BPT) (def: 128 when "
            "IBS is 512)\n"
+           "                'auto' from device limits, 'cal' also times "
+           "reads\n"
            "                Output Blocks Per Check (OBPC) (def: 0 implies "
            "BPT*IBS/OBS)\n"
            "    bs          block size for input and output (overrides "
@@ -126,19 +137,34 @@ primary_help:
            "    obs         output block size (def: 512). When IBS is "
            "not equal to OBS\n"
            "                then (((IBS * BPT) %% OBS) == 0) is required\n"
-           "    of          file or device to write to (def: /dev/null)\n");
+           "    of          file or device to write to (def: /dev/null); "
+           "give up to 8\n"
+           "                times to write each segment read to all of "
+           "them at once\n");
     pr2serr(
            "    oflag       output flags, comma separated list from FLAGS "
            "(see below)\n"
-           "    seek        block position to start writing in OFILE\n"
-           "    skip        block position to start reading from IFILE\n"
+           "    seek        block position to start writing in OFILE (or "
+           "scatter list)\n"
+           "    skip        block position to start reading from IFILE (or "
+           "gather list)\n"
            "    status      'noxfer' suppresses throughput calculation; "
            "'none'\n"
            "                suppresses all trailing reports (apart from "
-           "errors)\n"
+           "errors);\n"
+           "                'lat' adds read/write latency histograms and "
+           "phase times\n"
            "    verbose     0->normal(def), 1->some noise, 2->more noise, "
            "etc\n"
            "                -1->quiet (stderr->/dev/null)\n"
+           "    --bench[=SECS]    sweep BPT, QD and buffered/direct IO for "
+           "SECS\n"
+           "                (def: 5) seconds each, print CSV to stdout; "
+           "no copy\n"
+           "    --compare[=CMPF]  read IFILE and OFILE at once and compare "
+           "them,\n"
+           "                differing LBAs appended to CMPF (def: "
+           "cmpblk.txt); no copy\n"
            "    --help      print out this usage message then exit\n"
            "    --job=JF    JF is job file containing options\n"
            "    --odx       do ODX copy rather than normal rw copy\n"
@@ -161,6 +187,14 @@ primary_help:
 
 secondary_help:
     pr2serr("  where the lesser used command line options are:\n"
+           "    bufs        number of work buffers in rw copy; when > 1 "
+           "reads run\n"
+           "                ahead of writes by up to BUFS-1 segments "
+           "(def: 1)\n"
+           "    cache       buffered copy: read ahead WIN bytes, drop what "
+           "has been\n"
+           "                copied, at most DIRTY (def: WIN) output bytes "
+           "dirty\n"
            "    cdbsz       size of SCSI READ or WRITE cdb (default is "
            "10)\n"
            "    coe_limit   limit consecutive 'bad' blocks on reads to CL "
@@ -172,6 +206,9 @@ secondary_help:
            "(def: 0)\n"
            "                wait W_MS milliseconds prior to each write "
            "(def: 0)\n"
+           "    hash        digest IFILE data with ALG (crc32c, xxh64 or "
+           "sha256);\n"
+           "                also per segment digests to FILE\n"
            "    id_usage    xcopy: set list_id_usage to hold (0), discard "
            "(2),\n"
            "                disable (3), or the given number (def: 0 or "
@@ -183,15 +220,46 @@ secondary_help:
            "(same as skip)\n"
            "    ito         inactivity timeout (def: 0 (from 3PC VPD); "
            "units: seconds)\n"
+           "    journal     checkpoint progress to file JRN every SECS "
+           "seconds (def:\n"
+           "                10); if JRN exists resume the same copy "
+           "from it\n"
            "    list_id     xcopy: list_id (def: 1 or 0) [1 byte]\n"
            "                odx: list_id (def: 257 or 258) [4 bytes]\n"
+           "    manifest    write only OBPC chunks whose xxh64 digest "
+           "differs from file\n"
+           "                MF, kept from the previous copy to the same "
+           "OFILE\n"
+           "    mem         work buffers from heap (def), page, thp, huge "
+           "(2 MB) or\n"
+           "                huge1g (1 GB) pages, on NUMA node NODE or the "
+           "device's (auto)\n"
            "    of2         additional output file (def: /dev/null), "
            "OFILE2 should be\n"
            "                regular file or pipe\n"
            "    oseek       block position to start writing in OFILE\n"
            "    prio        xcopy: set priority field to PRIO (def: 1)\n"
+           "    progress    send JSON progress records every SECS seconds "
+           "and/or\n"
+           "                BYTES bytes to DEST: fd number, 'unix:PATH' "
+           "or file\n"
+           "                (def: stderr)\n"
            "    protect     set rdprotect and/or wrprotect fields on "
            "pt commands\n"
+           "    qd          queue depth for uring and async flags: "
+           "commands per\n"
+           "                segment in flight (def: 32); odx: segments "
+           "in flight\n"
+           "    rate        rw copy: limit to BPS bytes and IOPS "
+           "segments per second\n"
+           "                (0: no limit), BURST bytes ahead; rate=@FILE "
+           "reads them\n"
+           "                from FILE and again when it changes\n"
+           "    rescue      copy what can be read first, skipping bad "
+           "areas, then\n"
+           "                trim and scrape them; progress kept in map "
+           "file MAP\n"
+           "                (saved every SECS seconds, def: 30)\n"
            "    retries     retry pass-through errors RETR times "
            "(def: 0)\n"
            "    rtf         ROD Token filename (odx)\n"
@@ -199,14 +267,30 @@ secondary_help:
            "pit-pers,\n"
            "                pit-vuln, zero or number (def: 0 -> cm "
            "decides)\n"
+           "    tapebuf     tape: SIZE bytes of buffering between tape and "
+           "the other\n"
+           "                side; stream once PCT (def: 75) percent full "
+           "or free\n"
+           "    thr         number of worker threads in rw copy, each "
+           "with a segment\n"
+           "                in flight (def: 1); with 'shard' each copies "
+           "its own\n"
+           "                contiguous part of the copy\n"
            "    to          xcopy, odx: timeout in seconds (def: 600 "
            "(10 mins))\n\n");
     pr2serr("FLAGS: (arguments to oflag= and oflag=; may be comma "
             "separated)\n"
             "  append (o)     append (part of) IFILE to end of OFILE\n"
+            "  async (pt)     queue up to QD commands per segment (sg "
+            "devices)\n"
             "  atomic (o,pt)  use WRITE ATOMIC(16) on OFILE\n"
             "  block (pt)     pt opens are non blocking by default\n"
             "  cat (xcopy)    set CAT bit in segment descriptor header\n"
+            "  cfr (reg)      copy in kernel with copy_file_range or a "
+            "reflink\n"
+            "  coalesce (o)   with sparse and OBPC, write zero runs under "
+            "32 KiB\n"
+            "                 between writes\n"
             "  coe            continue on (read) error\n"
             "  dc (xcopy)     set DC bit in segment descriptor header\n"
             "  direct         set O_DIRECT flag in open() of IFILE and/or "
@@ -229,6 +313,8 @@ secondary_help:
             "  ignoreew (o)   ignore early warning (end of tape)\n"
             "  immed (odx)    commands poll until complete, report "
             "progress\n"
+            "  mmap           linux: read or write a regular file through "
+            "mmap()\n"
             "... continued on next page (use '-hhh')\n");
     return;
 tertiary_help:
@@ -264,17 +350,23 @@ tertiary_help:
             "pointer\n"
             "                 or if OFILE is pt assume it contains zeroes "
             "already\n"
+            "  splice (fifo)  splice() rather than read() and write()\n"
+            "  sqpoll         io_uring with kernel submission polling "
+            "thread\n"
             "  ssync (o,pt)   at end of copy do SCSI SYNCHRONIZE CACHE\n"
             "  strunc (o)     sparse copy using ftruncate to extend OFILE "
             "as needed\n"
             "  sync           set O_SYNC flag in open() of IFILE and/or "
             "OFILE\n"
-            "  trim (pt)      use SCSI UNMAP (trim) on zero segments "
+            "  trim (o)       use SCSI UNMAP (trim) on zero segments "
             "instead of\n"
-            "                 writing them to OFILE\n"
+            "                 writing them to OFILE (blk: BLKZEROOUT, "
+            "reg: punch hole)\n"
             "  trunc (o)      truncate a regular OFILE prior to copy (def: "
             "overwrite)\n"
-            "  unmap (pt)     same as trim flag\n"
+            "  unmap (o)      same as trim flag\n"
+            "  uring          linux: use io_uring on block device or "
+            "regular file\n"
             "  xcopy (pt)     invoke SCSI XCOPY; send to IFILE or OFILE.\n\n"
             "CONVS:\n"
             "  fdatasync      same as oflag=fdatasync\n"
@@ -343,21 +435,18 @@ do_skip(struct opts_t * op, const char * key, const char * buf)
 
     len = (int)strlen(buf);
     if ((('-' == buf[0]) && (1 == len)) || ((len > 1) && ('@' == buf[0]))) {
-        res = file_to_sgl(((len > 1) ? (buf + 1) : buf), in_fixed_sgl, &got,
-                          MAX_FIXED_SGL_ELEMS);
+        res = file_to_sgl(((len > 1) ? (buf + 1) : buf), &op->in_sgl, &got);
         if (res) {
             pr2serr("bad argument to '%s='\n", key);
             return SG_LIB_SYNTAX_ERROR;
         }
-        op->in_sgl = in_fixed_sgl;
         op->in_sgl_elems = got;
     } else if (num_chs_in_str(buf, len, ',') > 0) {
-        res = cl_to_sgl(buf, in_fixed_sgl, &got, MAX_FIXED_SGL_ELEMS);
+        res = cl_to_sgl(buf, &op->in_sgl, &got);
         if (res) {
             pr2serr("bad argument to '%s='\n", key);
             return SG_LIB_SYNTAX_ERROR;
         }
-        op->in_sgl = in_fixed_sgl;
         op->in_sgl_elems = got;
     } else {
         op->skip = sg_get_llnum(buf);
@@ -377,21 +466,18 @@ do_seek(struct opts_t * op, const char * key, const char * buf)
 
     len = (int)strlen(buf);
     if ((('-' == buf[0]) && (1 == len)) || ((len > 1) && ('@' == buf[0]))) {
-        res = file_to_sgl(((len > 1) ? (buf + 1) : buf), out_fixed_sgl, &got,
-                          MAX_FIXED_SGL_ELEMS);
+        res = file_to_sgl(((len > 1) ? (buf + 1) : buf), &op->out_sgl, &got);
         if (res) {
             pr2serr("bad argument to '%s='\n", key);
             return SG_LIB_SYNTAX_ERROR;
         }
-        op->out_sgl = out_fixed_sgl;
         op->out_sgl_elems = got;
     } else if (num_chs_in_str(buf, len, ',') > 0) {
-        res = cl_to_sgl(buf, out_fixed_sgl, &got, MAX_FIXED_SGL_ELEMS);
+        res = cl_to_sgl(buf, &op->out_sgl, &got);
         if (res) {
             pr2serr("bad argument to '%s='\n", key);
             return SG_LIB_SYNTAX_ERROR;
         }
-        op->out_sgl = out_fixed_sgl;
         op->out_sgl_elems = got;
     } else {
         op->seek = sg_get_llnum(buf);
@@ -403,6 +489,49 @@ do_seek(struct opts_t * op, const char * key, const char * buf)
     return 0;
 }
 
+/* Process mem=MEM[,NODE] where MEM is one of heap, page, thp, huge or
+ * huge1g and NODE is a NUMA node number or 'auto'. */
+static int
+mem_process(struct opts_t * op, const char * buf)
+{
+    int n;
+    const char * cp = strchr(buf, ',');
+    int len = cp ? (int)(cp - buf) : (int)strlen(buf);
+
+    if ((4 == len) && (0 == strncmp(buf, "heap", len)))
+        op->mem_type = DDPT_MEM_HEAP;
+    else if ((4 == len) && (0 == strncmp(buf, "page", len)))
+        op->mem_type = DDPT_MEM_PAGE;
+    else if ((3 == len) && (0 == strncmp(buf, "thp", len)))
+        op->mem_type = DDPT_MEM_THP;
+    else if ((4 == len) && (0 == strncmp(buf, "huge", len)))
+        op->mem_type = DDPT_MEM_HUGE;
+    else if ((6 == len) && (0 == strncmp(buf, "huge1g", len)))
+        op->mem_type = DDPT_MEM_HUGE1G;
+    else {
+        pr2serr("bad MEM in mem=MEM[,NODE], expect heap, page, thp, huge "
+                "or huge1g\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (NULL == cp)
+        return 0;
+    ++cp;
+    if (0 == strcmp(cp, "auto"))
+        op->mem_node = DDPT_MEM_AUTO_NODE;
+    else {
+        n = sg_get_num(cp);
+        if ((n < 0) || (n > 1023)) {
+            pr2serr("bad NODE in mem=MEM[,NODE], expect 0 to 1023 or "
+                    "auto\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        op->mem_node = n;
+    }
+    if (DDPT_MEM_HEAP == op->mem_type)
+        op->mem_type = DDPT_MEM_PAGE;   /* binding needs a mapping */
+    return 0;
+}
+
 /* Process arguments given to 'conv=" option. Returns 0 on success,
  * 1 on error. */
 static int
@@ -483,6 +612,8 @@ flags_process(const char * arg, struct flags_t * fp)
             *np++ = '\0';
         if (0 == strcmp(cp, "append"))
             fp->append = true;
+        else if (0 == strcmp(cp, "async"))
+            fp->async = true;
         else if (0 == strcmp(cp, "atomic"))
             fp->atomic = true;
         else if (0 == strcmp(cp, "block"))
@@ -491,6 +622,10 @@ flags_process(const char * arg, struct flags_t * fp)
             ++fp->bytchk;
         else if (0 == strcmp(cp, "cat"))
             fp->cat = true;
+        else if (0 == strcmp(cp, "cfr"))
+            fp->cfr = true;
+        else if (0 == strcmp(cp, "coalesce"))
+            fp->coalesce = true;
         else if (0 == strcmp(cp, "coe"))
             fp->coe = true;
         else if (0 == strcmp(cp, "dc"))
@@ -522,6 +657,8 @@ flags_process(const char * arg, struct flags_t * fp)
             fp->ignoreew = true;
         else if (0 == strcmp(cp, "immed"))
             fp->immed = true;
+        else if (0 == strcmp(cp, "mmap"))
+            fp->mmap = true;
         else if (0 == strcmp(cp, "nocache"))    /* can be (0), 1, 2, or 3 */
             ++fp->nocache;
         else if ((0 == strcmp(cp, "no_del_tkn")) ||
@@ -562,7 +699,12 @@ flags_process(const char * arg, struct flags_t * fp)
             fp->sparing = true;
         else if (0 == strcmp(cp, "sparse"))
             ++fp->sparse;
-        else if (0 == strcmp(cp, "ssync"))
+        else if (0 == strcmp(cp, "splice"))
+            fp->splice = true;
+        else if (0 == strcmp(cp, "sqpoll")) {
+            fp->sqpoll = true;
+            fp->uring = true;
+        } else if (0 == strcmp(cp, "ssync"))
             fp->ssync = true;
         else if (0 == strcmp(cp, "strunc"))
             fp->strunc = true;
@@ -573,6 +715,8 @@ flags_process(const char * arg, struct flags_t * fp)
             fp->wsame16 = true;
         } else if (0 == strcmp(cp, "trunc"))
             fp->trunc = true;
+        else if (0 == strcmp(cp, "uring"))
+            fp->uring = true;
         else if (0 == strcmp(cp, "verify"))
             fp->verify = true;
         else if (0 == strcmp(cp, "xcopy"))
@@ -868,7 +1012,48 @@ cl_sanity_defaults(struct opts_t * op)
             pr2serr("warning: 'direct' flag (O_DIRECT) not supported "
                     "on this platform\n");
 #endif
+#ifndef DDPT_HAVE_URING
+        if (ifp->uring || ofp->uring)
+            pr2serr("warning: 'uring' flag (io_uring) not supported "
+                    "on this platform\n");
+#endif
+#ifndef SG_LIB_LINUX
+        if (ifp->mmap || ofp->mmap)
+            pr2serr("warning: 'mmap' flag not supported on this "
+                    "platform\n");
+#endif
+    }
+#ifndef SG_LIB_LINUX
+    if (DDPT_MEM_HEAP != op->mem_type) {
+        pr2serr("warning: mem= ignored, not supported on this platform\n");
+        op->mem_type = DDPT_MEM_HEAP;
+        op->mem_node = DDPT_MEM_NO_NODE;
     }
+#endif
+#ifdef HAVE_POSIX_FADVISE
+    if ((op->cw_win > 0) && (op->num_threads > 1)) {
+        pr2serr("warning: cache=WIN ignored with thr=%d, each worker "
+                "copies other segments\n", op->num_threads);
+        op->cw_win = 0;
+    }
+#endif
+#ifndef HAVE_LIBPTHREAD
+    if (op->num_threads > 1) {
+        pr2serr("warning: thr=%d ignored, no thread support in this "
+                "build\n", op->num_threads);
+        op->num_threads = 1;
+    }
+    if (op->num_bufs > 1) {
+        pr2serr("warning: bufs=%d ignored, no thread support in this "
+                "build\n", op->num_bufs);
+        op->num_bufs = 1;
+    }
+    if (op->tape_buf > 0) {
+        pr2serr("warning: tapebuf= ignored, no thread support in this "
+                "build\n");
+        op->tape_buf = 0;
+    }
+#endif
     if (ofp->atomic)
         ofp->cdbsz = 16;        /* only WRITE ATOMIC(16) supported for now */
     if (ofp->ff) {
@@ -998,17 +1183,27 @@ cl_process(struct opts_t * op, int argc, char * argv[],
         //   or '=' is the trailing character.
         keylen = (int)strlen(key);
         // check for option names, in alphabetical order
-        if (0 == strcmp(key, "bpt")) {
+        if (0 == strcmp(key, "batch")) {
+            res = bt_parse(op, buf);
+            if (res)
+                return res;
+        } else if (0 == strcmp(key, "bpt")) {
             cp = strchr(buf, ',');
             if (cp)
                 *cp = '\0';
-            if ((n = sg_get_num(buf)) < 0) {
-                pr2serr("bad BPT argument to 'bpt='\n");
-                return SG_LIB_SYNTAX_ERROR;
-            }
-            if (n > 0) {
-                op->bpt_i = n;
-                op->bpt_given = true;
+            if (0 == strcmp(buf, "auto"))
+                op->bpt_auto = 1;
+            else if (0 == strcmp(buf, "cal"))
+                op->bpt_auto = 2;
+            else {
+                if ((n = sg_get_num(buf)) < 0) {
+                    pr2serr("bad BPT argument to 'bpt='\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                if (n > 0) {
+                    op->bpt_i = n;
+                    op->bpt_given = true;
+                }
             }
             if (cp) {
                 n = sg_get_num(cp + 1);
@@ -1036,6 +1231,41 @@ cl_process(struct opts_t * op, int argc, char * argv[],
             }
             op->ibs = n;
             op->obs = n;
+        } else if (0 == strcmp(key, "bufs")) {
+            n = sg_get_num(buf);
+            if ((n < 1) || (n > DDPT_MAX_BUFS)) {
+                pr2serr("bad argument to 'bufs=', expect 1 to %d\n",
+                        DDPT_MAX_BUFS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->num_bufs = n;
+        } else if (0 == strcmp(key, "cache")) {
+#ifdef HAVE_POSIX_FADVISE
+            int64_t ll;
+
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp = '\0';
+            ll = sg_get_llnum(buf);
+            if (ll <= 0) {
+                pr2serr("bad WIN in cache=WIN[,DIRTY], expect bytes > 0\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->cw_win = ll;
+            op->cw_dirty = ll;
+            if (cp) {
+                ll = sg_get_llnum(cp + 1);
+                if (ll <= 0) {
+                    pr2serr("bad DIRTY in cache=WIN[,DIRTY], expect bytes "
+                            "> 0\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                op->cw_dirty = ll;
+            }
+#else
+            pr2serr("warning: cache= ignored, posix_fadvise() not "
+                    "supported on this platform\n");
+#endif
         } else if (0 == strcmp(key, "cbs"))
             pr2serr("the cbs= option is ignored\n");
         else if (0 == strcmp(key, "cdbsz")) {
@@ -1084,6 +1314,10 @@ cl_process(struct opts_t * op, int argc, char * argv[],
                 }
                 op->wdelay = n;
             }
+        } else if (0 == strcmp(key, "hash")) {
+            res = hash_parse(op, buf);
+            if (res)
+                return res;
         } else if (0 == strcmp(key, "ibs")) {
             n = sg_get_num(buf);
             if (n < 0) {
@@ -1143,6 +1377,10 @@ cl_process(struct opts_t * op, int argc, char * argv[],
                 return SG_LIB_SYNTAX_ERROR;
             }
             op->inactivity_to = n;
+        } else if (0 == strcmp(key, "journal")) {
+            res = jrnl_parse(op, buf);
+            if (res)
+                return res;
         } else if ((0 == strcmp(key, "list_id")) ||
                    (0 == strcmp(key, "list-id"))) {
             i64 = sg_get_llnum(buf);
@@ -1156,6 +1394,10 @@ cl_process(struct opts_t * op, int argc, char * argv[],
             }
             op->list_id = (uint32_t)i64;
             op->list_id_given = true;
+        } else if (0 == strcmp(key, "manifest")) {
+            res = mf_parse(op, buf);
+            if (res)
+                return res;
         } else if (0 == strcmp(key, "obs")) {
             n = sg_get_num(buf);
             if (n < 0) {
@@ -1169,15 +1411,26 @@ cl_process(struct opts_t * op, int argc, char * argv[],
             }
             op->obs_given = true;
             op->obs = n;
+        } else if (0 == strcmp(key, "mem")) {
+            if ((res = mem_process(op, buf)))
+                return res;
         } else if (strcmp(key, "of") == 0) {
-            if ('\0' != op->odip->fn[0]) {
-                pr2serr("Second OFILE argument??\n");
-                return SG_LIB_SYNTAX_ERROR;
-            } else if (0 == strlen(buf)) {
+            if (0 == strlen(buf)) {
                 pr2serr("expected of=OFILE but no OFILE argument\n");
                 return SG_LIB_SYNTAX_ERROR;
+            } else if ('\0' == op->odip->fn[0])
+                strncpy(op->odip->fn, buf, INOUTF_SZ - 1);
+            else if (strlen(buf) >= INOUTF_SZ) {
+                pr2serr("of=OFILE name too long, at most %d bytes\n",
+                        INOUTF_SZ - 1);
+                return SG_LIB_SYNTAX_ERROR;
+            } else if (op->num_xof < (DDPT_MAX_OUTS - 1))
+                strcpy(op->xof_fn[op->num_xof++], buf);
+            else {
+                pr2serr("of=OFILE may be given at most %d times\n",
+                        DDPT_MAX_OUTS);
+                return SG_LIB_SYNTAX_ERROR;
             }
-            strncpy(op->odip->fn, buf, INOUTF_SZ - 1);
             op->outf_given = true;
         } else if (strcmp(key, "of2") == 0) {
             if ('\0' != op->o2dip->fn[0]) {
@@ -1201,6 +1454,37 @@ cl_process(struct opts_t * op, int argc, char * argv[],
                 return SG_LIB_SYNTAX_ERROR;
             }
             op->prio = n;
+        } else if (0 == strcmp(key, "progress")) {
+            /* progress=SECS[,BYTES[,DEST]] */
+            cp = strchr(buf, ',');
+            if (cp)
+                *cp++ = '\0';
+            n = sg_get_num(buf);
+            if (n < 0) {
+                pr2serr("bad SECS argument to 'progress='\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->prog_secs = n;
+            if (cp) {
+                char * dp = strchr(cp, ',');
+
+                if (dp)
+                    *dp++ = '\0';
+                if ('\0' == *cp)
+                    op->prog_bytes = 0;
+                else if ((op->prog_bytes = sg_get_llnum(cp)) < 0) {
+                    pr2serr("bad BYTES argument to 'progress='\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                if (dp) {
+                    strncpy(op->prog_dest, dp, INOUTF_SZ - 1);
+                    op->prog_dest[INOUTF_SZ - 1] = '\0';
+                }
+            }
+            if ((0 == op->prog_secs) && (0 == op->prog_bytes)) {
+                pr2serr("'progress=' needs SECS or BYTES greater than 0\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
         } else if (0 == strcmp(key, "protect")) {
             cp = strchr(buf, ',');
             if (cp)
@@ -1219,6 +1503,23 @@ cl_process(struct opts_t * op, int argc, char * argv[],
                 }
                 op->wrprotect = n;
             }
+        } else if (0 == strcmp(key, "qd")) {
+            n = sg_get_num(buf);
+            if ((n < 1) || (n > DDPT_MAX_QUEUE_DEPTH)) {
+                pr2serr("bad argument to 'qd=', expect 1 to %d\n",
+                        DDPT_MAX_QUEUE_DEPTH);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->queue_depth = n;
+            op->qd_given = true;
+        } else if (0 == strcmp(key, "rate")) {
+            res = rate_parse(op, buf);
+            if (res)
+                return res;
+        } else if (0 == strcmp(key, "rescue")) {
+            res = rs_parse(op, buf);
+            if (res)
+                return res;
         } else if (0 == strcmp(key, "retries")) {
             ifp->retries = sg_get_num(buf);
             ofp->retries = ifp->retries;
@@ -1277,15 +1578,56 @@ cl_process(struct opts_t * op, int argc, char * argv[],
         } else if (0 == strcmp(key, "status")) {
             if (0 == strncmp(buf, "null", 4))
                 ;
+            else if (0 == strncmp(buf, "lat", 3))
+                op->status_lat = true;
             else if (0 == strncmp(buf, "noxfer", 6))
                 op->do_time = false;
             else if (0 == strncmp(buf, "none", 4)) {
                 op->status_none = true;
                 op->do_time = false;
             } else {
-                pr2serr("'status=' expects 'none', 'noxfer' or 'null'\n");
+                pr2serr("'status=' expects 'lat', 'none', 'noxfer' or "
+                        "'null'\n");
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        } else if (0 == strcmp(key, "tapebuf")) {
+            int64_t ll;
+
+            cp = strchr(buf, ',');
+            if (cp) {
+                *cp = '\0';
+                n = sg_get_num(cp + 1);
+                if ((n < 1) || (n > 100)) {
+                    pr2serr("bad PCT in tapebuf=SIZE[,PCT], expect 1 to "
+                            "100\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                op->tape_buf_pct = n;
+            }
+            ll = sg_get_llnum(buf);
+            if (ll <= 0) {
+                pr2serr("bad SIZE in tapebuf=SIZE[,PCT], expect bytes > "
+                        "0\n");
                 return SG_LIB_SYNTAX_ERROR;
             }
+            op->tape_buf = ll;
+        } else if (0 == strcmp(key, "thr")) {
+            cp = strchr(buf, ',');
+            if (cp) {
+                if (0 != strcmp(cp + 1, "shard")) {
+                    pr2serr("bad argument to 'thr=', expect THR[,shard]\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                *cp = '\0';
+                op->thr_shard = true;
+            }
+            n = sg_get_num(buf);
+            if ((n < 1) || (n > DDPT_MAX_THREADS)) {
+                pr2serr("bad argument to 'thr=', expect 1 to %d\n",
+                        DDPT_MAX_THREADS);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->num_threads = n;
         } else if (0 == strcmp(key, "to")) {
             op->timeout_xcopy = sg_get_num(buf);
             if (-1 == op->timeout_xcopy) {
@@ -1304,7 +1646,25 @@ cl_process(struct opts_t * op, int argc, char * argv[],
             }
         }
         /* look for long options that start with '--' */
-        else if (0 == strncmp(key, "--help", 6))
+        else if (0 == strncmp(key, "--bench", 7)) {
+            if (strlen(buf) > 0) {
+                n = sg_get_num(buf);
+                if (n < 1) {
+                    pr2serr("bad argument to '--bench='\n");
+                    return SG_LIB_SYNTAX_ERROR;
+                }
+                op->bench_secs = n;
+            } else
+                op->bench_secs = DDPT_BENCH_SECS;
+        } else if (0 == strncmp(key, "--compare", 9)) {
+            if (strlen(buf) >= INOUTF_SZ) {
+                pr2serr("--compare=CMPF name too long, at most %d bytes\n",
+                        INOUTF_SZ - 1);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+            op->do_compare = true;
+            strcpy(op->cmp_fn, (strlen(buf) > 0) ? buf : DDPT_CMP_FILE);
+        } else if (0 == strncmp(key, "--help", 6))
             ++op->do_help;
         else if (0 == strncmp(key, "--job", 5)) {
             if (strlen(buf) > 0) {
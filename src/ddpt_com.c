@@ -73,8 +73,24 @@
 #include <sys/time.h>
 #endif
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#define DDPT_ZERO_SSE2 1
+#include <emmintrin.h>
+#if defined(__x86_64__) && ((__GNUC__ > 4) || defined(__clang__))
+#define DDPT_ZERO_AVX2 1
+#include <immintrin.h>
+#endif
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#define DDPT_ZERO_NEON 1
+#include <arm_neon.h>
+#endif
+
 #include "ddpt.h"       /* includes <signal.h> */
 
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>    /* rate= buckets are shared by worker threads */
+#endif
+
 #ifdef SG_LIB_LINUX
 #include <sys/ioctl.h>
 #include <sys/file.h>
@@ -118,6 +134,11 @@
 
 #endif  /* end SG_LIB_WIN32 */
 
+#ifndef SG_LIB_WIN32
+#include <sys/socket.h>         /* for progress=,,unix:PATH */
+#include <sys/un.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_pr2serr.h"
 
@@ -163,6 +184,29 @@ sleep_ms(int millisecs)
 #endif
 }
 
+/* Returns a monotonic clock in microseconds (or wall clock time if that
+ * is all there is), 0 if neither is available. Only differences between
+ * two calls are meaningful. */
+int64_t
+mono_time_us(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (0 == clock_gettime(CLOCK_MONOTONIC, &ts))
+        return ((int64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+    return 0;
+#elif defined(HAVE_GETTIMEOFDAY)
+    struct timeval tv;
+
+    if (0 == gettimeofday(&tv, NULL))
+        return ((int64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+    return 0;
+#else
+    return 0;
+#endif
+}
+
 void
 state_init(struct opts_t * op, struct flags_t * ifp, struct flags_t * ofp,
            struct dev_info_t * idip, struct dev_info_t * odip,
@@ -177,6 +221,11 @@ state_init(struct opts_t * op, struct flags_t * ifp, struct flags_t * ofp,
     op->prio = 1;
     op->max_uas = MAX_UNIT_ATTENTIONS;
     op->max_aborted = MAX_ABORTED_CMDS;
+    op->num_threads = 1;
+    op->num_bufs = 1;
+    op->tape_buf_pct = DDPT_TAPE_BUF_PCT;
+    op->mem_node = DDPT_MEM_NO_NODE;
+    op->queue_depth = DDPT_DEF_QUEUE_DEPTH;
     memset(ifp, 0, sizeof(struct flags_t));
     memset(ofp, 0, sizeof(struct flags_t));
     op->iflagp = ifp;
@@ -198,10 +247,13 @@ state_init(struct opts_t * op, struct flags_t * ifp, struct flags_t * ofp,
 #ifdef HAVE_POSIX_FADVISE
     op->lowest_skip = -1;
     op->lowest_seek = -1;
+    op->cw_in_lo = -1;
+    op->cw_out_hi = -1;
 #endif
     op->idip->pdt = -1;
     op->odip->pdt = -1;
     op->rtf_fd = -1;
+    op->prog_fd = -1;
 }
 
 /* When who<=0 print both in+out, when who==1 print in, else print out */
@@ -285,6 +337,771 @@ print_stats(const char * str, struct opts_t * op, int who)
                 ((1 == op->num_xcopy) ? "" : "s"));
 }
 
+/* status=lat: returns the start time of something to be timed, else 0 */
+int64_t
+lat_start(const struct opts_t * op)
+{
+    return op->status_lat ? mono_time_us() : 0;
+}
+
+/* status=lat: adds the time since start (from lat_start()) to phase and,
+ * for reads and writes, to its histogram. */
+void
+lat_end(struct opts_t * op, int phase, int64_t start)
+{
+    int k;
+    int64_t us;
+    struct lat_hist_t * hp;
+
+    if (0 == start)
+        return;
+    us = mono_time_us() - start;
+    if (us < 0)
+        us = 0;
+    op->lat.phase_us[phase] += us;
+    if (phase > DDPT_PH_WRITE)
+        return;
+    hp = &op->lat.hist[phase];
+    ++hp->count;
+    if (us > hp->max_us)
+        hp->max_us = us;
+    for (k = 0; (us > 0) && (k < (DDPT_LAT_BUCKETS - 1)); ++k)
+        us >>= 1;
+    ++hp->bkt[k];
+}
+
+void
+lat_stats_fold(struct lat_stats_t * to, const struct lat_stats_t * from)
+{
+    int k, j;
+
+    for (k = 0; k < DDPT_PH_NUM; ++k)
+        to->phase_us[k] += from->phase_us[k];
+    for (k = 0; k < 2; ++k) {
+        to->hist[k].count += from->hist[k].count;
+        if (from->hist[k].max_us > to->hist[k].max_us)
+            to->hist[k].max_us = from->hist[k].max_us;
+        for (j = 0; j < DDPT_LAT_BUCKETS; ++j)
+            to->hist[k].bkt[j] += from->hist[k].bkt[j];
+    }
+}
+
+/* status=lat: prints the time spent in each phase then a histogram of
+ * read and of write latencies (empty buckets are not shown). */
+void
+print_lat_stats(const char * str, const struct opts_t * op)
+{
+    int k, j;
+    const struct lat_stats_t * lp = &op->lat;
+    const struct lat_hist_t * hp;
+    static const char * rw_s[2] = {"read", "write"};
+
+    if (! op->status_lat)
+        return;
+    pr2serr("%stime in reads: %.3f, writes: %.3f, compares: %.3f, delays: "
+            "%.3f secs\n", str, lp->phase_us[DDPT_PH_READ] / 1000000.0,
+            lp->phase_us[DDPT_PH_WRITE] / 1000000.0,
+            lp->phase_us[DDPT_PH_COMP] / 1000000.0,
+            lp->phase_us[DDPT_PH_DELAY] / 1000000.0);
+    for (k = 0; k < 2; ++k) {
+        hp = &lp->hist[k];
+        if (0 == hp->count)
+            continue;
+        pr2serr("%s%s latency: %" PRId64 " commands, average %" PRId64
+                " us, max %" PRId64 " us\n", str, rw_s[k], hp->count,
+                lp->phase_us[k] / hp->count, hp->max_us);
+        for (j = 0; j < DDPT_LAT_BUCKETS; ++j) {
+            if (0 == hp->bkt[j])
+                continue;
+            if (0 == j)
+                pr2serr("%s  %10s < 1 us: %" PRId64 "\n", str, "",
+                        hp->bkt[j]);
+            else if (j < (DDPT_LAT_BUCKETS - 1))
+                pr2serr("%s  %10" PRId64 " - %" PRId64 " us: %" PRId64 "\n",
+                        str, (int64_t)1 << (j - 1), (int64_t)1 << j,
+                        hp->bkt[j]);
+            else
+                pr2serr("%s  %10" PRId64 " us and more: %" PRId64 "\n", str,
+                        (int64_t)1 << (j - 1), hp->bkt[j]);
+        }
+    }
+}
+
+#ifndef SG_LIB_WIN32
+
+/* Connects a stream socket to the AF_UNIX socket at path. Returns the file
+ * descriptor or -1. */
+static int
+progress_unix_connect(const char * path)
+{
+    int fd;
+    struct sockaddr_un sa;
+
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    strcpy(sa.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        int err = errno;
+
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+#endif
+
+/* progress=SECS[,BYTES[,DEST]]: opens DEST for the JSON progress stream.
+ * DEST is a number taken as an open file descriptor, "unix:PATH" for a
+ * stream socket, else a file name; stderr when DEST is not given.
+ * Returns 0 on success. */
+int
+progress_open(struct opts_t * op)
+{
+    const char * dp = op->prog_dest;
+    int fd;
+
+    if ((0 == op->prog_secs) && (0 == op->prog_bytes))
+        return 0;
+    if (0 == mono_time_us()) {
+        pr2serr("progress=: no clock on this platform\n");
+        return SG_LIB_CAT_OTHER;
+    }
+    if ('\0' == dp[0])
+        fd = STDERR_FILENO;
+    else if (isdigit((unsigned char)dp[0]) &&
+             (strspn(dp, "0123456789") == strlen(dp))) {
+        fd = atoi(dp);
+        if (fcntl(fd, F_GETFL) < 0) {
+            pr2serr("progress=: file descriptor %d: %s\n", fd,
+                    safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+#ifndef SG_LIB_WIN32
+    } else if (0 == strncmp(dp, "unix:", 5)) {
+        fd = progress_unix_connect(dp + 5);
+        if (fd < 0) {
+            pr2serr("progress=: connect to %s: %s\n", dp + 5,
+                    safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+        op->prog_sock = true;
+#endif
+    } else {
+        fd = open(dp, O_WRONLY | O_CREAT | O_APPEND, 0666);
+        if (fd < 0) {
+            pr2serr("progress=: could not open %s: %s\n", dp,
+                    safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+    }
+    op->prog_fd = fd;
+    op->prog_start_us = mono_time_us();
+    op->prog_last_us = op->prog_start_us;
+    op->prog_last_bytes = 0;
+    return 0;
+}
+
+/* Sends one JSON record (a single line) to the progress stream. If that
+ * fails the stream is closed, the copy carries on. */
+static void
+progress_emit(struct opts_t * op, const char * type, int64_t now,
+              const int * retp)
+{
+    int n, k, len;
+    int64_t bytes = op->in_full * op->ibs;
+    int64_t us = now - op->prog_start_us;
+    int64_t d_us = now - op->prog_last_us;
+    double avg, inst;
+    char b[1024];
+
+    avg = (us > 0) ? ((double)bytes / us) : 0.0;       /* MB/sec */
+    inst = (d_us > 0) ? ((double)(bytes - op->prog_last_bytes) / d_us) :
+                        avg;
+    n = snprintf(b, sizeof(b), "{\"type\":\"%s\",\"elapsed\":%.3f,"
+                 "\"in_full\":%" PRId64 ",\"in_partial\":%d,\"out_full\":%"
+                 PRId64 ",\"out_partial\":%d,\"out_sparse\":%" PRId64 ","
+                 "\"bytes\":%" PRId64 ",", type, us / 1000000.0,
+                 op->in_full, op->in_partial, op->out_full, op->out_partial,
+                 op->out_sparse, bytes);
+    n += snprintf(b + n, sizeof(b) - n, "\"recovered_errs\":%d,"
+                  "\"unrecovered_errs\":%d,\"wr_recovered_errs\":%d,"
+                  "\"wr_unrecovered_errs\":%d,\"trim_errs\":%d,"
+                  "\"retries\":%d,", op->recovered_errs,
+                  op->unrecovered_errs, op->wr_recovered_errs,
+                  op->wr_unrecovered_errs, op->trim_errs, op->num_retries);
+    if ((op->dd_count >= 0) && (! op->reading_fifo)) {
+        n += snprintf(b + n, sizeof(b) - n, "\"remaining\":%" PRId64 ",",
+                      op->dd_count);
+        if (avg > 0.0)
+            n += snprintf(b + n, sizeof(b) - n, "\"eta\":%.1f,",
+                          (op->dd_count * op->ibs) / avg / 1000000.0);
+    }
+    n += snprintf(b + n, sizeof(b) - n, "\"rate\":%.2f,\"avg_rate\":%.2f",
+                  inst, avg);
+    if (retp)
+        n += snprintf(b + n, sizeof(b) - n, ",\"exit_status\":%d", *retp);
+    n += snprintf(b + n, sizeof(b) - n, "}\n");
+    op->prog_last_us = now;
+    op->prog_last_bytes = bytes;
+
+    for (len = 0; len < n; len += k) {
+#if ! defined(SG_LIB_WIN32) && defined(MSG_NOSIGNAL)
+        if (op->prog_sock)
+            k = send(op->prog_fd, b + len, n - len, MSG_NOSIGNAL);
+        else
+#endif
+            k = write(op->prog_fd, b + len, n - len);
+        if ((k < 0) && (EINTR == errno)) {
+            k = 0;
+            continue;
+        }
+        if (k <= 0) {
+            pr2serr("progress=: write failed, %s; stop sending records\n",
+                    (k < 0) ? safe_strerror(errno) : "no progress");
+            if (op->prog_fd > STDERR_FILENO)
+                close(op->prog_fd);
+            op->prog_fd = -1;
+            return;
+        }
+    }
+}
+
+/* Called from signals_process_delay(), so between segments, when the
+ * progress stream is open. Sends a record if the time or byte interval
+ * since the last one has elapsed. */
+void
+progress_check(struct opts_t * op)
+{
+    int64_t now = mono_time_us();
+
+    if (((op->prog_secs > 0) &&
+         ((now - op->prog_last_us) >= (int64_t)op->prog_secs * 1000000)) ||
+        ((op->prog_bytes > 0) &&
+         (((op->in_full * op->ibs) - op->prog_last_bytes) >=
+          op->prog_bytes)))
+        progress_emit(op, "progress", now, NULL);
+}
+
+/* Sends the last record (type "end", with the exit status) then closes
+ * the progress stream. */
+void
+progress_final(struct opts_t * op, int ret)
+{
+    if (op->prog_fd < 0)
+        return;
+    progress_emit(op, "end", mono_time_us(), &ret);
+    if (op->prog_fd > STDERR_FILENO)
+        close(op->prog_fd);
+    op->prog_fd = -1;
+}
+
+/* rate=BPS[,IOPS[,BURST]] or rate=@FILE: a token bucket for bytes and
+ * another for segments (commands) per second. Tokens may go negative:
+ * the caller then sleeps until the debt would be paid off, so several
+ * threads sharing the buckets each wait their turn. */
+struct rate_ctl_t {
+    int64_t bps;        /* bytes per second, 0: no limit */
+    int64_t iops;       /* segments per second, 0: no limit */
+    int64_t burst;      /* byte bucket size, 0: a tenth of a second's worth */
+    double b_tok;       /* byte tokens */
+    double c_tok;       /* segment tokens */
+    int64_t last_us;    /* when tokens were last added, 0: not yet */
+    int64_t chk_us;     /* when fn was last looked at */
+    time_t mtime;       /* of fn when it was last read */
+    char fn[INOUTF_SZ]; /* rate=@FILE, re-read when changed */
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_t mtx;
+#endif
+};
+
+/* Parses "BPS[,IOPS[,BURST]]" into rp. Returns 0 on success. */
+static int
+rate_parse_str(struct rate_ctl_t * rp, const char * arg)
+{
+    int64_t v[3] = {0, 0, 0};
+    int k;
+    const char * cp = arg;
+
+    for (k = 0; k < 3; ++k) {
+        while (isspace((unsigned char)*cp))
+            ++cp;
+        if (('\0' == *cp) || (',' == *cp))
+            v[k] = 0;
+        else if ((v[k] = sg_get_llnum(cp)) < 0)
+            return SG_LIB_SYNTAX_ERROR;
+        cp = strchr(cp, ',');
+        if (NULL == cp)
+            break;
+        ++cp;
+    }
+    if (cp && (k >= 3))
+        return SG_LIB_SYNTAX_ERROR;     /* too many fields */
+    rp->bps = v[0];
+    rp->iops = v[1];
+    rp->burst = v[2];
+    return 0;
+}
+
+/* Reads rp->fn when it is new or its modification time has changed.
+ * Returns 0 if the rates are unchanged or were read, else an error. */
+static int
+rate_file_read(struct opts_t * op, struct rate_ctl_t * rp)
+{
+    int res = 0;
+    FILE * fp;
+    char * cp;
+    struct stat a_st;
+    char b[256];
+
+    if (stat(rp->fn, &a_st) < 0) {
+        pr2serr("rate=@%s: %s\n", rp->fn, safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    if ((rp->mtime > 0) && (a_st.st_mtime == rp->mtime))
+        return 0;
+    rp->mtime = a_st.st_mtime;
+    if (NULL == (fp = fopen(rp->fn, "r"))) {
+        pr2serr("rate=@%s: %s\n", rp->fn, safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    if (NULL == fgets(b, sizeof(b), fp))
+        b[0] = '\0';
+    fclose(fp);
+    if ((cp = strpbrk(b, "#\r\n")))
+        *cp = '\0';
+    if ((res = rate_parse_str(rp, b)))
+        pr2serr("rate=@%s: expected BPS[,IOPS[,BURST]], not: %s\n",
+                rp->fn, b);
+    else {
+        rp->b_tok = 0.0;
+        rp->c_tok = 0.0;
+        if (op->verbose)
+            pr2serr("rate: %" PRId64 " bytes/sec, %" PRId64 " segments/sec"
+                    ", burst %" PRId64 " bytes (0: no limit)\n", rp->bps,
+                    rp->iops, rp->burst);
+    }
+    return res;
+}
+
+/* rate=BPS[,IOPS[,BURST]] or rate=@FILE. Returns 0 on success. */
+int
+rate_parse(struct opts_t * op, const char * arg)
+{
+    int res;
+    struct rate_ctl_t * rp = op->ratep;
+
+    if (NULL == rp) {
+        rp = (struct rate_ctl_t *)calloc(1, sizeof(*rp));
+        if (NULL == rp) {
+            pr2serr("rate=: out of memory\n");
+            return SG_LIB_CAT_OTHER;
+        }
+#ifdef HAVE_LIBPTHREAD
+        pthread_mutex_init(&rp->mtx, NULL);
+#endif
+        op->ratep = rp;
+    }
+    if ('@' == arg[0]) {
+        strncpy(rp->fn, arg + 1, INOUTF_SZ - 1);
+        rp->fn[INOUTF_SZ - 1] = '\0';
+        rp->mtime = 0;
+        return rate_file_read(op, rp);
+    }
+    rp->fn[0] = '\0';
+    if ((res = rate_parse_str(rp, arg)))
+        pr2serr("bad argument to 'rate=', expect BPS[,IOPS[,BURST]] or "
+                "@FILE\n");
+    return res;
+}
+
+void
+rate_free(struct opts_t * op)
+{
+    if (op->ratep) {
+#ifdef HAVE_LIBPTHREAD
+        pthread_mutex_destroy(&op->ratep->mtx);
+#endif
+        free(op->ratep);
+        op->ratep = NULL;
+    }
+}
+
+/* Called before each segment of bytes is read (rate= given). Takes bytes
+ * and one segment from the buckets, then sleeps for as long as that puts
+ * either bucket in debt. A rate=@FILE is looked at once a second at most.
+ * The main thread processes signals while it sleeps. */
+void
+rate_limit(struct opts_t * op, int64_t bytes)
+{
+    bool first;
+    int64_t now, elapsed, t0;
+    int64_t wait_us = 0;
+    double cap, w;
+    struct rate_ctl_t * rp = op->ratep;
+
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&rp->mtx);
+#endif
+    now = mono_time_us();
+    if (rp->fn[0] && ((now - rp->chk_us) >= 1000000)) {
+        rp->chk_us = now;
+        rate_file_read(op, rp);
+    }
+    first = (0 == rp->last_us);     /* buckets start full */
+    elapsed = first ? 0 : (now - rp->last_us);
+    rp->last_us = now;
+    if (rp->bps > 0) {
+        cap = rp->burst ? (double)rp->burst : (rp->bps / 10.0);
+        if (cap < bytes)
+            cap = bytes;
+        rp->b_tok += first ? cap : ((rp->bps * (double)elapsed) / 1000000.0);
+        if (rp->b_tok > cap)
+            rp->b_tok = cap;
+        rp->b_tok -= bytes;
+        if (rp->b_tok < 0.0)
+            wait_us = (int64_t)((-rp->b_tok * 1000000.0) / rp->bps);
+    }
+    if (rp->iops > 0) {
+        cap = (rp->iops < 10) ? 1.0 : (rp->iops / 10.0);
+        rp->c_tok += first ? cap :
+                               ((rp->iops * (double)elapsed) / 1000000.0);
+        if (rp->c_tok > cap)
+            rp->c_tok = cap;
+        rp->c_tok -= 1.0;
+        if (rp->c_tok < 0.0) {
+            w = (-rp->c_tok * 1000000.0) / rp->iops;
+            if ((int64_t)w > wait_us)
+                wait_us = (int64_t)w;
+        }
+    }
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&rp->mtx);
+#endif
+    if (wait_us < 1000)
+        return;         /* owed time is carried by the tokens */
+    if (op->verbose > 3)
+        pr2serr("rate: wait %" PRId64 " microseconds\n", wait_us);
+    t0 = lat_start(op);
+    while (wait_us >= 1000) {
+        int ms = (wait_us > 100000) ? 100 : (int)(wait_us / 1000);
+
+        sleep_ms(ms);
+        wait_us -= ms * 1000;
+        if (! op->mt_worker)
+            signals_process_delay(op, DELAY_SIGNALS_ONLY);
+    }
+    lat_end(op, DDPT_PH_DELAY, t0);
+}
+
+/* journal=JFILE[,SECS]: a small text file holding the identity of the copy
+ * and how many input blocks, counted from the start of the copy as first
+ * invoked, are known to be on OFILE (and OFILE2). Blocks skipped by the
+ * sparse and sparing flags count as done, as do blocks taken from a gather
+ * list (odx) so resuming in that list works too. The file is replaced
+ * (written to JFILE.tmp, fsync-ed then renamed) only after the outputs have
+ * been flushed so it never claims more than is on the media. */
+struct jrnl_t {
+    bool complete;      /* an earlier run finished this copy */
+    int secs;           /* checkpoint interval, 0: after every segment */
+    int64_t skip0;      /* skip, seek and count of the copy as first */
+    int64_t seek0;      /*   started; these must match on resume */
+    int64_t count0;
+    int64_t done;       /* input blocks known to be copied */
+    int64_t last_us;    /* mono_time_us() of last checkpoint */
+    char fn[INOUTF_SZ];
+};
+
+/* journal=JFILE[,SECS]. Returns 0 on success. */
+int
+jrnl_parse(struct opts_t * op, const char * arg)
+{
+    int n;
+    const char * cp;
+    struct jrnl_t * jp;
+
+    cp = strchr(arg, ',');
+    n = cp ? (int)(cp - arg) : (int)strlen(arg);
+    if ((0 == n) || (n >= INOUTF_SZ)) {
+        pr2serr("bad argument to 'journal=', expect JFILE[,SECS]\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (NULL == op->jrnlp) {
+        op->jrnlp = (struct jrnl_t *)calloc(1, sizeof(struct jrnl_t));
+        if (NULL == op->jrnlp) {
+            pr2serr("journal=: out of memory\n");
+            return SG_LIB_CAT_OTHER;
+        }
+    }
+    jp = op->jrnlp;
+    memcpy(jp->fn, arg, n);
+    jp->fn[n] = '\0';
+    jp->secs = DDPT_JRNL_SECS;
+    if (cp) {
+        if ((jp->secs = sg_get_num(cp + 1)) < 0) {
+            pr2serr("bad SECS argument to 'journal='\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    return 0;
+}
+
+void
+jrnl_free(struct opts_t * op)
+{
+    if (op->jrnlp) {
+        free(op->jrnlp);
+        op->jrnlp = NULL;
+    }
+}
+
+/* Flushes OFILE and OFILE2 to their media, before journal= or manifest=
+ * (named by who) record that data as written. Returns 0 on success. */
+int
+sync_outputs(struct opts_t * op, const char * who)
+{
+    int k, res;
+    struct dev_info_t * dips[2];
+    struct dev_info_t * dip;
+
+    dips[0] = op->odip;
+    dips[1] = op->o2dip;
+    for (k = 0; k < 2; ++k) {
+        dip = dips[k];
+        if ((NULL == dip) || (dip->fd < 0) || op->oflagp->nowrite)
+            continue;
+        if (FT_PT & dip->d_type) {
+            pt_sync_cache(dip->fd);
+            continue;
+        }
+        if (! ((FT_REG | FT_BLOCK) & dip->d_type))
+            continue;
+        res = 0;
+#ifdef HAVE_FDATASYNC
+        res = fdatasync(dip->fd);
+#elif defined(HAVE_FSYNC)
+        res = fsync(dip->fd);
+#endif
+        if (res < 0) {
+            pr2serr("%s: flushing %s: %s\n", who, dip->fn,
+                    safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+    }
+    return 0;
+}
+
+/* Writes the journal to JFILE.tmp, flushes that, then renames it over
+ * JFILE. Returns 0 on success. */
+static int
+jrnl_write(struct opts_t * op, const struct jrnl_t * jp)
+{
+    int fd, n;
+    bool ok;
+    char b[4 * INOUTF_SZ + 256];
+    char tmp_fn[INOUTF_SZ + 8];
+
+    n = snprintf(b, sizeof(b), "ddpt-journal 1\nif=%s\nof=%s\nof2=%s\n"
+                 "ibs=%d\nobs=%d\nskip=%" PRId64 "\nseek=%" PRId64 "\n"
+                 "count=%" PRId64 "\ndone=%" PRId64 "\nstate=%s\n",
+                 op->idip->fn, op->odip->fn, op->o2dip ? op->o2dip->fn : "",
+                 op->ibs, op->obs, jp->skip0, jp->seek0, jp->count0,
+                 jp->done, (jp->complete ? "complete" : "copying"));
+    snprintf(tmp_fn, sizeof(tmp_fn), "%s.tmp", jp->fn);
+    fd = open(tmp_fn, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        pr2serr("journal: could not open %s: %s\n", tmp_fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    ok = (write(fd, b, n) == n);
+#ifdef HAVE_FSYNC
+    if (ok)
+        ok = (fsync(fd) >= 0);
+#endif
+    if (close(fd) < 0)
+        ok = false;
+    if (ok)
+        ok = (rename(tmp_fn, jp->fn) >= 0);
+    if (! ok) {
+        pr2serr("journal: could not write %s: %s\n", jp->fn,
+                safe_strerror(errno));
+        unlink(tmp_fn);
+        return SG_LIB_FILE_ERROR;
+    }
+    return 0;
+}
+
+/* Reads JFILE if it exists, placing its 'done' value in jp. Returns 0 if
+ * it was read (or did not exist) and describes this copy, else an error. */
+static int
+jrnl_read(struct opts_t * op, struct jrnl_t * jp)
+{
+    bool match = true;
+    int lines = 0;
+    int64_t v;
+    FILE * fp;
+    char * cp;
+    const char * s;
+    char b[INOUTF_SZ + 32];
+
+    if (NULL == (fp = fopen(jp->fn, "r"))) {
+        if (ENOENT == errno)
+            return 0;
+        pr2serr("journal: could not open %s: %s\n", jp->fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    if ((NULL == fgets(b, sizeof(b), fp)) ||
+        strncmp(b, "ddpt-journal 1\n", sizeof(b))) {
+        fclose(fp);
+        pr2serr("journal: %s is not a ddpt journal\n", jp->fn);
+        return SG_LIB_FILE_ERROR;
+    }
+    while (match && fgets(b, sizeof(b), fp)) {
+        if ((cp = strchr(b, '\n')))
+            *cp = '\0';
+        if (NULL == (cp = strchr(b, '=')))
+            continue;
+        *cp++ = '\0';
+        ++lines;
+        v = (isdigit((unsigned char)*cp)) ? sg_get_llnum(cp) : -1;
+        if (0 == strcmp(b, "if"))
+            match = (0 == strcmp(cp, op->idip->fn));
+        else if (0 == strcmp(b, "of"))
+            match = (0 == strcmp(cp, op->odip->fn));
+        else if (0 == strcmp(b, "of2")) {
+            s = op->o2dip ? op->o2dip->fn : "";
+            match = (0 == strcmp(cp, s));
+        } else if (0 == strcmp(b, "ibs"))
+            match = (v == op->ibs);
+        else if (0 == strcmp(b, "obs"))
+            match = (v == op->obs);
+        else if (0 == strcmp(b, "skip"))
+            match = (v == jp->skip0);
+        else if (0 == strcmp(b, "seek"))
+            match = (v == jp->seek0);
+        else if (0 == strcmp(b, "count"))
+            match = (v == jp->count0);
+        else if (0 == strcmp(b, "done"))
+            jp->done = v;
+        else if (0 == strcmp(b, "state"))
+            jp->complete = (0 == strcmp(cp, "complete"));
+        else
+            --lines;
+    }
+    fclose(fp);
+    if (! match) {
+        pr2serr("journal: %s is for another copy (%s= differs), remove it "
+                "to start\nagain\n", jp->fn, b);
+        return SG_LIB_FILE_ERROR;
+    }
+    if ((lines < 10) || (jp->done < 0) || (jp->done > jp->count0)) {
+        pr2serr("journal: %s is damaged, remove it to start again\n",
+                jp->fn);
+        return SG_LIB_FILE_ERROR;
+    }
+    if (jp->complete)
+        jp->done = jp->count0;
+    return 0;
+}
+
+/* Called once skip, seek and count are known and before anything is
+ * copied. Checks the copy can be journalled, then reads JFILE. Places the
+ * number of input blocks already copied (by earlier runs) in *donep,
+ * otherwise 0. Returns 0 on success. */
+int
+jrnl_start(struct opts_t * op, int64_t * donep)
+{
+    int res;
+    const char * cp = NULL;
+    struct jrnl_t * jp = op->jrnlp;
+
+    *donep = 0;
+    if (op->reading_fifo || (op->dd_count <= 0))
+        cp = "needs a known count";
+    else if (! ((FT_PT | FT_REG | FT_BLOCK | FT_ALL_FF | FT_DEV_NULL) &
+                op->idip->d_type))
+        cp = "IFILE must be pt, block device or regular file";
+    else if (! ((FT_PT | FT_REG | FT_BLOCK | FT_DEV_NULL) &
+                op->odip->d_type))
+        cp = "OFILE must be pt, block device or regular file";
+    else if (op->o2dip && (op->o2dip->fd >= 0) &&
+             (! (FT_REG & op->o2dip->d_type)))
+        cp = "OFILE2 must be a regular file";
+    else if (op->oflagp->append || op->oflagp->resume ||
+             op->oflagp->trunc)
+        cp = "incompatible with oflag=append, resume and trunc";
+    if (cp) {
+        pr2serr("journal=%s: %s\n", jp->fn, cp);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    jp->skip0 = op->skip;
+    jp->seek0 = op->seek;
+    jp->count0 = op->dd_count;
+    jp->done = 0;
+    jp->complete = false;
+    op->jrnl_skip0 = op->skip;
+    if ((res = jrnl_read(op, jp)))
+        return res;
+    jp->last_us = mono_time_us();
+    if (jp->done > 0) {
+        pr2serr("journal %s: %" PRId64 " of %" PRId64 " blocks already "
+                "copied\n", jp->fn, jp->done, jp->count0);
+        *donep = jp->done;
+        return 0;
+    }
+    if (op->verbose)
+        pr2serr("journal %s: starting copy of %" PRId64 " blocks, "
+                "checkpoint every %d seconds\n", jp->fn, jp->count0,
+                jp->secs);
+    return jrnl_write(op, jp);
+}
+
+/* True when the checkpoint interval has passed. */
+bool
+jrnl_due(const struct opts_t * op)
+{
+    const struct jrnl_t * jp = op->jrnlp;
+
+    return (mono_time_us() - jp->last_us) >= ((int64_t)jp->secs * 1000000);
+}
+
+/* Records that done input blocks (from the start of the copy as first
+ * started) are copied, or all of them when complete is true. Nothing
+ * past done may still be needed to produce those blocks on OFILE: the
+ * caller flushes any pending trim first. Returns 0 on success. */
+int
+jrnl_checkpoint(struct opts_t * op, int64_t done, bool complete)
+{
+    int res;
+    struct jrnl_t * jp = op->jrnlp;
+
+    if (jp->complete)
+        return 0;
+    jp->last_us = mono_time_us();
+    if (complete)
+        done = jp->count0;
+    if ((done < jp->done) || ((done == jp->done) && (! complete)))
+        return 0;
+    if ((res = sync_outputs(op, "journal")))
+        return res;
+    jp->done = done;
+    jp->complete = complete;
+    if (op->verbose > 1)
+        pr2serr("journal %s: checkpoint, done=%" PRId64 "%s\n", jp->fn,
+                done, (complete ? ", copy complete" : ""));
+    return jrnl_write(op, jp);
+}
+
 /* Attempt to categorize the file type from the given filename.
  * Separate version for Windows and Unix. Windows version does some
  * file name processing. */
@@ -593,6 +1410,217 @@ zero_coe_limit_count(struct opts_t * op)
         op->coe_count = 0;
 }
 
+/* Zero detection for oflag=sparse. Scans a segment once, stopping at the
+ * first non-zero byte, rather than memcmp()-ing it against a same sized
+ * buffer of zeros. SSE2 and NEON are baseline on x86_64 and aarch64 so
+ * are used directly; AVX2 is chosen at run time when the CPU has it. */
+static int
+first_nonzero_tail(const unsigned char * bp, int len, int k)
+{
+    uint64_t w[4];
+
+    for ( ; (k + (int)sizeof(w)) <= len; k += sizeof(w)) {
+        memcpy(w, bp + k, sizeof(w));
+        if (w[0] | w[1] | w[2] | w[3])
+            break;
+    }
+    for ( ; k < len; ++k) {
+        if (bp[k])
+            return k;
+    }
+    return len;
+}
+
+#ifdef DDPT_ZERO_AVX2
+__attribute__((target("avx2")))
+static int
+first_nonzero_avx2(const unsigned char * bp, int len)
+{
+    int k;
+    __m256i v;
+
+    for (k = 0; (k + 128) <= len; k += 128) {
+        v = _mm256_or_si256(
+                _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(bp + k)),
+                        _mm256_loadu_si256((const __m256i *)(bp + k + 32))),
+                _mm256_or_si256(
+                        _mm256_loadu_si256((const __m256i *)(bp + k + 64)),
+                        _mm256_loadu_si256((const __m256i *)(bp + k + 96))));
+        if (! _mm256_testz_si256(v, v))
+            break;
+    }
+    return first_nonzero_tail(bp, len, k);
+}
+#endif
+
+#ifdef DDPT_ZERO_SSE2
+static int
+first_nonzero_sse2(const unsigned char * bp, int len)
+{
+    int k;
+    __m128i v;
+    const __m128i z = _mm_setzero_si128();
+
+    for (k = 0; (k + 64) <= len; k += 64) {
+        v = _mm_or_si128(
+                _mm_or_si128(_mm_loadu_si128((const __m128i *)(bp + k)),
+                             _mm_loadu_si128((const __m128i *)(bp + k + 16))),
+                _mm_or_si128(_mm_loadu_si128((const __m128i *)(bp + k + 32)),
+                             _mm_loadu_si128((const __m128i *)(bp + k + 48))));
+        if (0xffff != _mm_movemask_epi8(_mm_cmpeq_epi8(v, z)))
+            break;
+    }
+    return first_nonzero_tail(bp, len, k);
+}
+#endif
+
+#ifdef DDPT_ZERO_NEON
+static int
+first_nonzero_neon(const unsigned char * bp, int len)
+{
+    int k;
+    uint8x16_t v;
+
+    for (k = 0; (k + 64) <= len; k += 64) {
+        v = vorrq_u8(vorrq_u8(vld1q_u8(bp + k), vld1q_u8(bp + k + 16)),
+                     vorrq_u8(vld1q_u8(bp + k + 32), vld1q_u8(bp + k + 48)));
+        if (vmaxvq_u8(v))
+            break;
+    }
+    return first_nonzero_tail(bp, len, k);
+}
+#endif
+
+/* Returns the offset of the first non-zero byte in bp[0..len) or len if
+ * all those bytes are zero. */
+int
+first_nonzero(const unsigned char * bp, int len)
+{
+#ifdef DDPT_ZERO_AVX2
+    static int have_avx2 = -1;  /* -1: not checked yet */
+
+    if (have_avx2 < 0)
+        have_avx2 = !! __builtin_cpu_supports("avx2");
+    if (have_avx2)
+        return first_nonzero_avx2(bp, len);
+#endif
+#if defined(DDPT_ZERO_SSE2)
+    return first_nonzero_sse2(bp, len);
+#elif defined(DDPT_ZERO_NEON)
+    return first_nonzero_neon(bp, len);
+#else
+    return first_nonzero_tail(bp, len, 0);
+#endif
+}
+
+/* --compare: like the zero scan above but on the XOR of two buffers, so
+ * equal segments are passed over in one pass without memcmp()-ing each
+ * block. */
+static int
+first_mismatch_tail(const unsigned char * ap, const unsigned char * bp,
+                    int len, int k)
+{
+    uint64_t w[2], x[2];
+
+    for ( ; (k + (int)sizeof(w)) <= len; k += sizeof(w)) {
+        memcpy(w, ap + k, sizeof(w));
+        memcpy(x, bp + k, sizeof(x));
+        if ((w[0] ^ x[0]) | (w[1] ^ x[1]))
+            break;
+    }
+    for ( ; k < len; ++k) {
+        if (ap[k] != bp[k])
+            return k;
+    }
+    return len;
+}
+
+#ifdef DDPT_ZERO_AVX2
+__attribute__((target("avx2")))
+static int
+first_mismatch_avx2(const unsigned char * ap, const unsigned char * bp,
+                    int len)
+{
+    int k, j;
+    __m256i v;
+
+    for (k = 0; (k + 128) <= len; k += 128) {
+        v = _mm256_setzero_si256();
+        for (j = 0; j < 128; j += 32)
+            v = _mm256_or_si256(v, _mm256_xor_si256(
+                    _mm256_loadu_si256((const __m256i *)(ap + k + j)),
+                    _mm256_loadu_si256((const __m256i *)(bp + k + j))));
+        if (! _mm256_testz_si256(v, v))
+            break;
+    }
+    return first_mismatch_tail(ap, bp, len, k);
+}
+#endif
+
+#ifdef DDPT_ZERO_SSE2
+static int
+first_mismatch_sse2(const unsigned char * ap, const unsigned char * bp,
+                    int len)
+{
+    int k, j;
+    __m128i v;
+    const __m128i z = _mm_setzero_si128();
+
+    for (k = 0; (k + 64) <= len; k += 64) {
+        v = z;
+        for (j = 0; j < 64; j += 16)
+            v = _mm_or_si128(v, _mm_xor_si128(
+                    _mm_loadu_si128((const __m128i *)(ap + k + j)),
+                    _mm_loadu_si128((const __m128i *)(bp + k + j))));
+        if (0xffff != _mm_movemask_epi8(_mm_cmpeq_epi8(v, z)))
+            break;
+    }
+    return first_mismatch_tail(ap, bp, len, k);
+}
+#endif
+
+#ifdef DDPT_ZERO_NEON
+static int
+first_mismatch_neon(const unsigned char * ap, const unsigned char * bp,
+                    int len)
+{
+    int k, j;
+    uint8x16_t v;
+
+    for (k = 0; (k + 64) <= len; k += 64) {
+        v = vdupq_n_u8(0);
+        for (j = 0; j < 64; j += 16)
+            v = vorrq_u8(v, veorq_u8(vld1q_u8(ap + k + j),
+                                     vld1q_u8(bp + k + j)));
+        if (vmaxvq_u8(v))
+            break;
+    }
+    return first_mismatch_tail(ap, bp, len, k);
+}
+#endif
+
+/* Returns the offset of the first byte that differs between ap[0..len)
+ * and bp[0..len) or len if they are equal. */
+int
+first_mismatch(const unsigned char * ap, const unsigned char * bp, int len)
+{
+#ifdef DDPT_ZERO_AVX2
+    static int have_avx2 = -1;  /* -1: not checked yet */
+
+    if (have_avx2 < 0)
+        have_avx2 = !! __builtin_cpu_supports("avx2");
+    if (have_avx2)
+        return first_mismatch_avx2(ap, bp, len);
+#endif
+#if defined(DDPT_ZERO_SSE2)
+    return first_mismatch_sse2(ap, bp, len);
+#elif defined(DDPT_ZERO_NEON)
+    return first_mismatch_neon(ap, bp, len);
+#else
+    return first_mismatch_tail(ap, bp, len, 0);
+#endif
+}
+
 /* Print number of blocks, block size. If over 1 MB print size in MB
  * (10**6 bytes), GB (10**9 bytes) or TB (10**12 bytes) to stderr. */
 void
@@ -810,14 +1838,17 @@ calc_duration_throughput(const char * leadin, bool contin, struct opts_t * op)
 #endif
 }
 
-/* Create errblk file (see iflag=errblk) and if we have gettimeofday
- * puts are start timestampl on the first line. */
-void
-errblk_open(struct opts_t * op)
+/* Opens (appending to) or creates a file listing LB addresses, one
+ * address or range per line, and if we have gettimeofday puts a start
+ * timestamp on the first line. Used by iflag=errblk and --compare.
+ * Returns NULL if the file can't be opened. */
+FILE *
+lba_list_open(const char * fn)
 {
-    op->errblk_fp = fopen(errblk_file, "a");        /* append */
-    if (NULL == op->errblk_fp)
-        pr2serr("unable to open or create %s\n", errblk_file);
+    FILE * fp = fopen(fn, "a");        /* append */
+
+    if (NULL == fp)
+        pr2serr("unable to open or create %s\n", fn);
     else {
 #ifdef HAVE_GETTIMEOFDAY
         {
@@ -827,37 +1858,32 @@ errblk_open(struct opts_t * op)
             t = time(NULL);
             strftime(b, sizeof(b), "# start: %Y-%m-%d %H:%M:%S\n",
                      localtime(&t));
-            fputs(b, op->errblk_fp);
+            fputs(b, fp);
         }
 #else
-        fputs("# start\n", op->errblk_fp);
+        fputs("# start\n", fp);
 #endif
     }
+    return fp;
 }
 
-void    /* Global function, used by ddpt_pt.c */
-errblk_put(uint64_t lba, struct opts_t * op)
-{
-    if (op->errblk_fp)
-        fprintf(op->errblk_fp, "0x%" PRIx64 "\n", lba);
-}
-
-void    /* Global function, used by ddpt_pt.c */
-errblk_put_range(uint64_t lba, int num, struct opts_t * op)
+void
+lba_list_put_range(FILE * fp, uint64_t lba, int64_t num)
 {
-    if (op->errblk_fp) {
+    if (fp) {
         if (1 == num)
-            errblk_put(lba, op);
+            fprintf(fp, "0x%" PRIx64 "\n", lba);
         else if (num > 1)
-            fprintf(op->errblk_fp, "0x%" PRIx64 "-0x%" PRIx64 "\n", lba,
+            fprintf(fp, "0x%" PRIx64 "-0x%" PRIx64 "\n", lba,
                     lba + (num - 1));
     }
 }
 
+/* Puts a stop timestamp on the last line then closes fp. */
 void
-errblk_close(struct opts_t * op)
+lba_list_close(FILE * fp)
 {
-    if (op->errblk_fp) {
+    if (fp) {
 #ifdef HAVE_GETTIMEOFDAY
         {
             time_t t;
@@ -866,12 +1892,39 @@ errblk_close(struct opts_t * op)
             t = time(NULL);
             strftime(b, sizeof(b), "# stop: %Y-%m-%d %H:%M:%S\n",
                      localtime(&t));
-            fputs(b, op->errblk_fp);
+            fputs(b, fp);
         }
 #else
-        fputs("# stop\n", op->errblk_fp);
+        fputs("# stop\n", fp);
 #endif
-        fclose(op->errblk_fp);
+        fclose(fp);
+    }
+}
+
+/* Create errblk file (see iflag=errblk) */
+void
+errblk_open(struct opts_t * op)
+{
+    op->errblk_fp = lba_list_open(errblk_file);
+}
+
+void    /* Global function, used by ddpt_pt.c */
+errblk_put(uint64_t lba, struct opts_t * op)
+{
+    lba_list_put_range(op->errblk_fp, lba, 1);
+}
+
+void    /* Global function, used by ddpt_pt.c */
+errblk_put_range(uint64_t lba, int num, struct opts_t * op)
+{
+    lba_list_put_range(op->errblk_fp, lba, num);
+}
+
+void
+errblk_close(struct opts_t * op)
+{
+    if (op->errblk_fp) {
+        lba_list_close(op->errblk_fp);
         op->errblk_fp = NULL;
     }
 }
@@ -1136,10 +2189,31 @@ signals_process_delay(struct opts_t * op, int delay_type)
     bool got_something = false;
     char b[32];
     int delay = 0;
-
 #if SA_NOCLDSTOP
     bool found_pending = false;
+#endif
 
+    if (op->mt_worker) {
+        /* worker threads only delay, the main thread processes signals */
+        if ((op->delay > 0) && (DELAY_COPY_SEGMENT == delay_type))
+            delay = op->delay;
+        else if ((op->wdelay > 0) && (DELAY_WRITE == delay_type)) {
+            if (op->subsequent_wdelay)
+                delay = op->wdelay;
+            else
+                op->subsequent_wdelay = true;
+        }
+        if (delay) {
+            int64_t t0 = lat_start(op);
+
+            sleep_ms(delay);
+            lat_end(op, DDPT_PH_DELAY, t0);
+        }
+        return;
+    }
+    if (op->prog_fd >= 0)
+        progress_check(op);
+#if SA_NOCLDSTOP
     if ((0 == op->interrupt_io) &&
         (sigismember(&op->caught_signals, SIGINT) ||
          sigismember(&op->caught_signals, SIGPIPE) ||
@@ -1163,11 +2237,15 @@ signals_process_delay(struct opts_t * op, int delay_type)
                     op->subsequent_wdelay = true;
             }
             if (delay) {
+                int64_t t0;
+
                 sigprocmask(SIG_SETMASK, &op->orig_mask, NULL);
                 if (op->verbose > 3)
                     pr2serr("delay=%d milliseconds [%s]\n", delay,
                             ((DELAY_WRITE == delay_type) ? "write" : "copy"));
+                t0 = lat_start(op);
                 sleep_ms(delay);
+                lat_end(op, DDPT_PH_DELAY, t0);
                 sigprocmask(SIG_BLOCK, &op->caught_signals, NULL);
             }
             if (! (interrupt_signal || info_signals_pending))
@@ -1216,8 +2294,12 @@ signals_process_delay(struct opts_t * op, int delay_type)
                     pr2serr(">> User should check and perform by hand if "
                             "necessary\n");
                 }
-                pr2serr("To resume, invoke with same arguments plus "
-                        "oflag=resume\n");
+                if (op->rsp)
+                    pr2serr("To carry on, invoke again with the same "
+                            "rescue=MAP\n");
+                else
+                    pr2serr("To resume, invoke with same arguments plus "
+                            "oflag=resume\n");
             }
             // Could more cleanup or suggestions be made here?
         } else {
@@ -1225,6 +2307,7 @@ signals_process_delay(struct opts_t * op, int delay_type)
             print_stats("  ", op, 0);
             if (op->do_time)
                 calc_duration_throughput("  ", true /* contin */, op);
+            print_lat_stats("  ", op);
             pr2serr("  continuing ...\n");
         }
         if (interrupt) {
@@ -1251,8 +2334,12 @@ signals_process_delay(struct opts_t * op, int delay_type)
             else
                 op->subsequent_wdelay = true;
         }
-        if (delay)
-            sleep_ms(op->delay);
+        if (delay) {
+            int64_t t0 = lat_start(op);
+
+            sleep_ms(delay);
+            lat_end(op, DDPT_PH_DELAY, t0);
+        }
     }
 }
 
@@ -1516,21 +2603,45 @@ print_exit_status_msg(const char * prefix, int exit_stat, bool to_stderr)
     }
 }
 
+/* Makes room for element ind in the list at *sgl_pp which has space for
+ * *max_p elements, doubling the space as needed. Returns 0 if ok, or 1 if
+ * out of memory. */
+static int
+sgl_grow(struct scat_gath_elem ** sgl_pp, int * max_p, int ind)
+{
+    int n;
+    struct scat_gath_elem * sglp;
+
+    if (ind < *max_p)
+        return 0;
+    n = (*max_p > 0) ? (2 * *max_p) : DEF_SGL_ELEMS;
+    sglp = (struct scat_gath_elem *)realloc(*sgl_pp, n * sizeof(*sglp));
+    if (NULL == sglp) {
+        pr2serr("%s: out of memory at %d elements\n", __func__, ind);
+        return 1;
+    }
+    *sgl_pp = sglp;
+    *max_p = n;
+    return 0;
+}
+
 /* Read numbers (up to 64 bits in size) from command line (comma (or
  * (single) space) separated list). Assumed decimal unless prefixed
  * by '0x', '0X' or contains trailing 'h' or 'H' (which indicate hex).
- * Returns 0 if ok, or 1 if error. */
+ * The list at *sgl_pp (NULL or from malloc()) is grown as needed and
+ * should be freed by the caller. Returns 0 if ok, or 1 if error. */
 int
-cl_to_sgl(const char * inp, struct scat_gath_elem * sgl_arr, int * arr_len,
-          int max_arr_len)
+cl_to_sgl(const char * inp, struct scat_gath_elem ** sgl_pp, int * arr_len)
 {
     int in_len, k;
+    int max_arr_len = 0;
     int64_t ll;
     char * cp;
     char * c2p;
     const char * lcp;
+    struct scat_gath_elem * sgl_arr;
 
-    if ((NULL == inp) || (NULL == sgl_arr) ||
+    if ((NULL == inp) || (NULL == sgl_pp) ||
         (NULL == arr_len))
         return 1;
     lcp = inp;
@@ -1546,7 +2657,10 @@ cl_to_sgl(const char * inp, struct scat_gath_elem * sgl_arr, int * arr_len,
             pr2serr("%s: error at pos %d\n", __func__, k + 1);
             return 1;
         }
-        for (k = 0; k < max_arr_len; ++k) {
+        for (k = 0; ; ++k) {
+            if (sgl_grow(sgl_pp, &max_arr_len, k))
+                return 1;
+            sgl_arr = *sgl_pp;
             ll = sg_get_llnum(lcp);
             if (-1 != ll) {
                 sgl_arr[k].lba = (uint64_t)ll;
@@ -1590,10 +2704,6 @@ cl_to_sgl(const char * inp, struct scat_gath_elem * sgl_arr, int * arr_len,
             }
         }
         *arr_len = k + 1;
-        if (k == max_arr_len) {
-            pr2serr("%s: array length exceeded\n", __func__);
-            return 1;
-        }
     }
     return 0;
 }
@@ -1601,14 +2711,16 @@ cl_to_sgl(const char * inp, struct scat_gath_elem * sgl_arr, int * arr_len,
 /* Read numbers from filename (or stdin) line by line (comma (or
  * (single) space) separated list). Assumed decimal unless prefixed
  * by '0x', '0X' or contains trailing 'h' or 'H' (which indicate hex).
- * Returns 0 if ok, or 1 if error. */
+ * The list at *sgl_pp is grown as for cl_to_sgl(). Returns 0 if ok, or 1
+ * if error (including a list without any LBA,NUM pairs). */
 int
-file_to_sgl(const char * file_name, struct scat_gath_elem * sgl_arr,
-            int * arr_len, int max_arr_len)
+file_to_sgl(const char * file_name, struct scat_gath_elem ** sgl_pp,
+            int * arr_len)
 {
     bool have_stdin, bit0;
     int in_len, k, j, m, ind, res;
     int off = 0;
+    int max_arr_len = 0;
     int64_t ll;
     FILE * fp;
     char * lcp;
@@ -1626,7 +2738,7 @@ file_to_sgl(const char * file_name, struct scat_gath_elem * sgl_arr,
     }
 
     res = 1;
-    for (j = 0; j < 512; ++j) {
+    for (j = 0; ; ++j) {
         if (NULL == fgets(line, sizeof(line), fp))
             break;
         // could improve with carry_over logic if sizeof(line) too small
@@ -1663,10 +2775,8 @@ file_to_sgl(const char * file_name, struct scat_gath_elem * sgl_arr,
             if (-1 != ll) {
                 ind = ((off + k) >> 1);
                 bit0 = !! (0x1 & (off + k));
-                if (ind >= max_arr_len) {
-                    pr2serr("%s: array length exceeded\n", __func__);
+                if (sgl_grow(sgl_pp, &max_arr_len, ind))
                     goto the_end;
-                }
                 if (bit0) {
                     if (ll > UINT32_MAX) {
                         pr2serr("%s: number exceeds 32 bits in line %d, at "
@@ -1674,9 +2784,9 @@ file_to_sgl(const char * file_name, struct scat_gath_elem * sgl_arr,
                                 (int)(lcp - line + 1));
                         goto the_end;
                     }
-                    sgl_arr[ind].num = (uint32_t)ll;
+                    (*sgl_pp)[ind].num = (uint32_t)ll;
                 } else
-                    sgl_arr[ind].lba = (uint64_t)ll;
+                    (*sgl_pp)[ind].lba = (uint64_t)ll;
                 lcp = strpbrk(lcp, " ,\t#");
                 if ((NULL == lcp) || ('#' == *lcp))
                     break;
@@ -1700,6 +2810,11 @@ file_to_sgl(const char * file_name, struct scat_gath_elem * sgl_arr,
                 "%s\n", __func__, have_stdin ? "stdin" : file_name);
         goto the_end;
     }
+    if (0 == off) {
+        pr2serr("%s: no LBA,NUM pairs found in %s\n", __func__,
+                have_stdin ? "stdin" : file_name);
+        goto the_end;
+    }
     *arr_len = off >> 1;
     res = 0;
 
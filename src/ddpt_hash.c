@@ -0,0 +1,998 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * This file contains the digests that ddpt can compute over the data read
+ * from IFILE during a rw copy (see hash=ALG[,FILE]): crc32c, xxh64 and
+ * sha256. The crc32c and sha256 ones use the SSE4.2 CRC32 and the SHA
+ * extensions instructions when the x86 CPU has them (checked at run time)
+ * and the ARMv8 CRC32 instructions when built for them. It also holds
+ * the chunk digests of manifest=MF used to write only what changed since
+ * the previous copy.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+/* N.B. config.h must precede anything that depends on HAVE_*  */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ddpt.h"       /* includes <signal.h> */
+
+#include "sg_lib.h"
+#include "sg_unaligned.h"
+#include "sg_pr2serr.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && \
+    ((__GNUC__ > 4) || defined(__clang__))
+#define DDPT_HASH_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && \
+      defined(__ARM_FEATURE_CRC32)
+#define DDPT_HASH_ARM_CRC 1
+#include <arm_acle.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define DDPT_HASH_BIG_ENDIAN 1
+#endif
+
+/* hash=ALG[,FILE]: a digest of everything read from IFILE plus, when FILE
+ * is given, one line per copy segment holding its IFILE block address,
+ * number of blocks and digest. */
+struct hash_ctl_t {
+    bool started;       /* first segment seen */
+    int64_t start_skip; /* IFILE block of first byte hashed */
+    int64_t blks;       /* IFILE blocks hashed */
+    FILE * fp;          /* per segment digests, NULL if not wanted */
+    char fn[INOUTF_SZ];
+    struct ddpt_hash_t h;       /* of the whole input */
+};
+
+static const char * hash_names[] = {"none", "crc32c", "xxh64", "sha256"};
+
+
+/* crc32c (Castagnoli), reflected polynomial 0x82f63b78 */
+
+#ifndef DDPT_HASH_ARM_CRC
+static uint32_t crc32c_tab[8][256];
+static bool crc32c_tab_done;
+
+static void
+crc32c_tab_init(void)
+{
+    int k, j;
+    uint32_t c;
+
+    for (k = 0; k < 256; ++k) {
+        c = k;
+        for (j = 0; j < 8; ++j)
+            c = (c & 1) ? ((c >> 1) ^ 0x82f63b78) : (c >> 1);
+        crc32c_tab[0][k] = c;
+    }
+    for (k = 0; k < 256; ++k) {
+        c = crc32c_tab[0][k];
+        for (j = 1; j < 8; ++j) {
+            c = crc32c_tab[0][c & 0xff] ^ (c >> 8);
+            crc32c_tab[j][k] = c;
+        }
+    }
+    crc32c_tab_done = true;
+}
+
+/* slicing by 8 */
+static uint32_t
+crc32c_sw(uint32_t c, const unsigned char * bp, size_t len)
+{
+    uint32_t lo, hi;
+
+    for ( ; len && ((uintptr_t)bp & 7); --len)
+        c = crc32c_tab[0][(c ^ *bp++) & 0xff] ^ (c >> 8);
+    for ( ; len >= 8; len -= 8, bp += 8) {
+        lo = c ^ ((uint32_t)bp[0] | ((uint32_t)bp[1] << 8) |
+                  ((uint32_t)bp[2] << 16) | ((uint32_t)bp[3] << 24));
+        hi = (uint32_t)bp[4] | ((uint32_t)bp[5] << 8) |
+             ((uint32_t)bp[6] << 16) | ((uint32_t)bp[7] << 24);
+        c = crc32c_tab[7][lo & 0xff] ^ crc32c_tab[6][(lo >> 8) & 0xff] ^
+            crc32c_tab[5][(lo >> 16) & 0xff] ^ crc32c_tab[4][lo >> 24] ^
+            crc32c_tab[3][hi & 0xff] ^ crc32c_tab[2][(hi >> 8) & 0xff] ^
+            crc32c_tab[1][(hi >> 16) & 0xff] ^ crc32c_tab[0][hi >> 24];
+    }
+    for ( ; len; --len)
+        c = crc32c_tab[0][(c ^ *bp++) & 0xff] ^ (c >> 8);
+    return c;
+}
+#endif
+
+#ifdef DDPT_HASH_X86
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t c, const unsigned char * bp, size_t len)
+{
+    uint64_t c64;
+    uint64_t v;
+
+    for ( ; len && ((uintptr_t)bp & 7); --len)
+        c = _mm_crc32_u8(c, *bp++);
+    c64 = c;
+    for ( ; len >= 8; len -= 8, bp += 8) {
+        memcpy(&v, bp, 8);
+        c64 = _mm_crc32_u64(c64, v);
+    }
+    c = (uint32_t)c64;
+    for ( ; len; --len)
+        c = _mm_crc32_u8(c, *bp++);
+    return c;
+}
+#endif
+
+#ifdef DDPT_HASH_ARM_CRC
+static uint32_t
+crc32c_arm(uint32_t c, const unsigned char * bp, size_t len)
+{
+    uint64_t v;
+
+    for ( ; len && ((uintptr_t)bp & 7); --len)
+        c = __crc32cb(c, *bp++);
+    for ( ; len >= 8; len -= 8, bp += 8) {
+        memcpy(&v, bp, 8);
+        c = __crc32cd(c, v);
+    }
+    for ( ; len; --len)
+        c = __crc32cb(c, *bp++);
+    return c;
+}
+#endif
+
+static uint32_t
+crc32c_update(uint32_t c, const unsigned char * bp, size_t len)
+{
+#ifdef DDPT_HASH_X86
+    static int have_sse42 = -1;  /* -1: not checked yet */
+
+    if (have_sse42 < 0)
+        have_sse42 = !! __builtin_cpu_supports("sse4.2");
+    if (have_sse42)
+        return crc32c_sse42(c, bp, len);
+#endif
+#ifdef DDPT_HASH_ARM_CRC
+    return crc32c_arm(c, bp, len);
+#else
+    if (! crc32c_tab_done)
+        crc32c_tab_init();
+    return crc32c_sw(c, bp, len);
+#endif
+}
+
+
+/* xxh64 with a seed of 0 */
+
+#define XXH_P1 0x9e3779b185ebca87ULL
+#define XXH_P2 0xc2b2ae3d27d4eb4fULL
+#define XXH_P3 0x165667b19e3779f9ULL
+#define XXH_P4 0x85ebca77c2b2ae63ULL
+#define XXH_P5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t
+rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+le64_get(const unsigned char * bp)
+{
+    uint64_t v;
+
+    memcpy(&v, bp, 8);
+#ifdef DDPT_HASH_BIG_ENDIAN
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint64_t
+xxh64_round(uint64_t acc, uint64_t in)
+{
+    acc += in * XXH_P2;
+    return rotl64(acc, 31) * XXH_P1;
+}
+
+/* Consumes whole 32 byte stripes, returns bytes used */
+static size_t
+xxh64_stripes(uint64_t * v, const unsigned char * bp, size_t len)
+{
+    size_t k;
+
+    for (k = 0; (k + 32) <= len; k += 32) {
+        v[0] = xxh64_round(v[0], le64_get(bp + k));
+        v[1] = xxh64_round(v[1], le64_get(bp + k + 8));
+        v[2] = xxh64_round(v[2], le64_get(bp + k + 16));
+        v[3] = xxh64_round(v[3], le64_get(bp + k + 24));
+    }
+    return k;
+}
+
+static uint64_t
+xxh64_final(const struct ddpt_hash_t * hp)
+{
+    int k;
+    uint32_t u;
+    uint64_t h;
+    const uint64_t * v = hp->s.xxh;
+    const unsigned char * bp = hp->buf;
+
+    if (hp->len >= 32) {
+        h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) +
+            rotl64(v[3], 18);
+        for (k = 0; k < 4; ++k) {
+            h ^= xxh64_round(0, v[k]);
+            h = (h * XXH_P1) + XXH_P4;
+        }
+    } else
+        h = XXH_P5;
+    h += hp->len;
+    for (k = 0; (k + 8) <= hp->blen; k += 8) {
+        h ^= xxh64_round(0, le64_get(bp + k));
+        h = (rotl64(h, 27) * XXH_P1) + XXH_P4;
+    }
+    if ((k + 4) <= hp->blen) {
+        u = (uint32_t)bp[k] | ((uint32_t)bp[k + 1] << 8) |
+            ((uint32_t)bp[k + 2] << 16) | ((uint32_t)bp[k + 3] << 24);
+        h ^= u * XXH_P1;
+        h = (rotl64(h, 23) * XXH_P2) + XXH_P3;
+        k += 4;
+    }
+    for ( ; k < hp->blen; ++k) {
+        h ^= bp[k] * XXH_P5;
+        h = rotl64(h, 11) * XXH_P1;
+    }
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+/* sha256 (FIPS 180-4) */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint32_t sha256_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+    0x1f83d9ab, 0x5be0cd19};
+
+#define ROR32(x, r) (((x) >> (r)) | ((x) << (32 - (r))))
+
+static void
+sha256_blocks_sw(uint32_t * st, const unsigned char * bp, size_t nblk)
+{
+    int k;
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    uint32_t w[64];
+
+    for ( ; nblk > 0; --nblk, bp += 64) {
+        for (k = 0; k < 16; ++k)
+            w[k] = ((uint32_t)bp[4 * k] << 24) |
+                   ((uint32_t)bp[4 * k + 1] << 16) |
+                   ((uint32_t)bp[4 * k + 2] << 8) | bp[4 * k + 3];
+        for ( ; k < 64; ++k) {
+            t1 = ROR32(w[k - 2], 17) ^ ROR32(w[k - 2], 19) ^
+                 (w[k - 2] >> 10);
+            t2 = ROR32(w[k - 15], 7) ^ ROR32(w[k - 15], 18) ^
+                 (w[k - 15] >> 3);
+            w[k] = t1 + w[k - 7] + t2 + w[k - 16];
+        }
+        a = st[0];
+        b = st[1];
+        c = st[2];
+        d = st[3];
+        e = st[4];
+        f = st[5];
+        g = st[6];
+        h = st[7];
+        for (k = 0; k < 64; ++k) {
+            t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) +
+                 ((e & f) ^ (~e & g)) + sha256_k[k] + w[k];
+            t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) +
+                 ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        st[0] += a;
+        st[1] += b;
+        st[2] += c;
+        st[3] += d;
+        st[4] += e;
+        st[5] += f;
+        st[6] += g;
+        st[7] += h;
+    }
+}
+
+#ifdef DDPT_HASH_X86
+/* Four rounds per step with the SHA extensions; the state is kept as the
+ * ABEF and CDGH halves those instructions want. */
+__attribute__((target("sha,ssse3,sse4.1")))
+static void
+sha256_blocks_shani(uint32_t * st, const unsigned char * bp, size_t nblk)
+{
+    int k;
+    __m128i s0, s1, t, m, abef, cdgh;
+    __m128i w[4];
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL);
+
+    t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)st), 0xb1);
+    s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(st + 4)),
+                           0x1b);
+    s0 = _mm_alignr_epi8(t, s1, 8);             /* ABEF */
+    s1 = _mm_blend_epi16(s1, t, 0xf0);          /* CDGH */
+    for ( ; nblk > 0; --nblk, bp += 64) {
+        abef = s0;
+        cdgh = s1;
+        for (k = 0; k < 16; ++k) {
+            if (k < 4)
+                w[k] = _mm_shuffle_epi8(
+                        _mm_loadu_si128((const __m128i *)(bp + 16 * k)),
+                        bswap);
+            else
+                w[k & 3] = _mm_sha256msg2_epu32(
+                        _mm_add_epi32(_mm_sha256msg1_epu32(w[k & 3],
+                                                           w[(k + 1) & 3]),
+                                      _mm_alignr_epi8(w[(k + 3) & 3],
+                                                      w[(k + 2) & 3], 4)),
+                        w[(k + 3) & 3]);
+            m = _mm_add_epi32(w[k & 3], _mm_loadu_si128(
+                                (const __m128i *)(sha256_k + 4 * k)));
+            s1 = _mm_sha256rnds2_epu32(s1, s0, m);
+            s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(m, 0x0e));
+        }
+        s0 = _mm_add_epi32(s0, abef);
+        s1 = _mm_add_epi32(s1, cdgh);
+    }
+    t = _mm_shuffle_epi32(s0, 0x1b);            /* FEBA */
+    s1 = _mm_shuffle_epi32(s1, 0xb1);           /* DCHG */
+    _mm_storeu_si128((__m128i *)st, _mm_blend_epi16(t, s1, 0xf0));
+    _mm_storeu_si128((__m128i *)(st + 4), _mm_alignr_epi8(s1, t, 8));
+}
+
+static bool
+have_sha_ext(void)
+{
+    unsigned int a, b, c, d;
+
+    if (! __builtin_cpu_supports("sse4.1"))
+        return false;
+    if (! __get_cpuid_count(7, 0, &a, &b, &c, &d))
+        return false;
+    return !! (b & (1 << 29));          /* CPUID.(EAX=7,ECX=0):EBX.SHA */
+}
+#endif
+
+static void
+sha256_blocks(uint32_t * st, const unsigned char * bp, size_t nblk)
+{
+#ifdef DDPT_HASH_X86
+    static int have_sha = -1;   /* -1: not checked yet */
+
+    if (have_sha < 0)
+        have_sha = have_sha_ext();
+    if (have_sha) {
+        sha256_blocks_shani(st, bp, nblk);
+        return;
+    }
+#endif
+    sha256_blocks_sw(st, bp, nblk);
+}
+
+static void
+sha256_final(struct ddpt_hash_t * hp, unsigned char * out)
+{
+    int k;
+    uint64_t bits = hp->len * 8;
+
+    hp->buf[hp->blen++] = 0x80;
+    if (hp->blen > 56) {
+        memset(hp->buf + hp->blen, 0, 64 - hp->blen);
+        sha256_blocks(hp->s.sha, hp->buf, 1);
+        hp->blen = 0;
+    }
+    memset(hp->buf + hp->blen, 0, 56 - hp->blen);
+    for (k = 0; k < 8; ++k)
+        hp->buf[56 + k] = (unsigned char)(bits >> (56 - (8 * k)));
+    sha256_blocks(hp->s.sha, hp->buf, 1);
+    for (k = 0; k < 8; ++k)
+        sg_put_unaligned_be32(hp->s.sha[k], out + (4 * k));
+}
+
+
+/* common to all: ALG name to DDPT_HASH_* and back */
+
+int
+hash_alg_from_name(const char * name)
+{
+    int k;
+
+    for (k = DDPT_HASH_CRC32C; k <= DDPT_HASH_SHA256; ++k) {
+        if (0 == strcmp(name, hash_names[k]))
+            return k;
+    }
+    return -1;
+}
+
+const char *
+hash_alg_name(int alg)
+{
+    return ((alg > DDPT_HASH_NONE) && (alg <= DDPT_HASH_SHA256)) ?
+           hash_names[alg] : hash_names[DDPT_HASH_NONE];
+}
+
+void
+hash_init(struct ddpt_hash_t * hp, int alg)
+{
+    memset(hp, 0, sizeof(*hp));
+    hp->alg = alg;
+    switch (alg) {
+    case DDPT_HASH_CRC32C:
+        hp->s.crc = 0xffffffff;
+        break;
+    case DDPT_HASH_XXH64:
+        hp->s.xxh[0] = XXH_P1 + XXH_P2;
+        hp->s.xxh[1] = XXH_P2;
+        hp->s.xxh[2] = 0;
+        hp->s.xxh[3] = 0 - XXH_P1;
+        break;
+    case DDPT_HASH_SHA256:
+        memcpy(hp->s.sha, sha256_h0, sizeof(sha256_h0));
+        break;
+    default:
+        break;
+    }
+}
+
+void
+hash_update(struct ddpt_hash_t * hp, const unsigned char * bp, size_t len)
+{
+    int n;
+    int blk = (DDPT_HASH_SHA256 == hp->alg) ? 64 : 32;
+    size_t k;
+
+    if (DDPT_HASH_CRC32C == hp->alg) {
+        hp->s.crc = crc32c_update(hp->s.crc, bp, len);
+        hp->len += len;
+        return;
+    }
+    hp->len += len;
+    if (hp->blen > 0) {         /* top up the partial block first */
+        n = blk - hp->blen;
+        if ((size_t)n > len)
+            n = (int)len;
+        memcpy(hp->buf + hp->blen, bp, n);
+        hp->blen += n;
+        bp += n;
+        len -= n;
+        if (hp->blen < blk)
+            return;
+        if (DDPT_HASH_SHA256 == hp->alg)
+            sha256_blocks(hp->s.sha, hp->buf, 1);
+        else
+            xxh64_stripes(hp->s.xxh, hp->buf, 32);
+        hp->blen = 0;
+    }
+    if (DDPT_HASH_SHA256 == hp->alg) {
+        k = (len / 64) * 64;
+        if (k)
+            sha256_blocks(hp->s.sha, bp, len / 64);
+    } else
+        k = xxh64_stripes(hp->s.xxh, bp, len);
+    if (k < len) {
+        memcpy(hp->buf, bp + k, len - k);
+        hp->blen = (int)(len - k);
+    }
+}
+
+/* Places the digest (big endian, as usually printed) in out which should
+ * have room for DDPT_HASH_MAX_LEN bytes. Returns its length. hp is spent
+ * afterwards. */
+int
+hash_final(struct ddpt_hash_t * hp, unsigned char * out)
+{
+    switch (hp->alg) {
+    case DDPT_HASH_CRC32C:
+        sg_put_unaligned_be32(~hp->s.crc, out);
+        return 4;
+    case DDPT_HASH_XXH64:
+        sg_put_unaligned_be64(xxh64_final(hp), out);
+        return 8;
+    case DDPT_HASH_SHA256:
+        sha256_final(hp, out);
+        return 32;
+    default:
+        return 0;
+    }
+}
+
+/* Writes the digest in hex to b, which needs 2*DDPT_HASH_MAX_LEN+1 bytes. */
+void
+hash_hex(const unsigned char * dp, int len, char * b)
+{
+    int k;
+
+    for (k = 0; k < len; ++k)
+        sprintf(b + (2 * k), "%02x", dp[k]);
+    b[2 * len] = '\0';
+}
+
+
+/* hash=ALG[,FILE] option and its use in the rw copy */
+
+int
+hash_parse(struct opts_t * op, const char * arg)
+{
+    int alg, n;
+    const char * cp;
+    char b[16];
+    struct hash_ctl_t * hcp;
+
+    cp = strchr(arg, ',');
+    n = cp ? (int)(cp - arg) : (int)strlen(arg);
+    if (n >= (int)sizeof(b))
+        n = sizeof(b) - 1;
+    memcpy(b, arg, n);
+    b[n] = '\0';
+    if ((alg = hash_alg_from_name(b)) < 0) {
+        pr2serr("bad argument to 'hash=', expect crc32c, xxh64 or sha256 "
+                "then\noptionally ',FILE'\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (cp && (strlen(cp + 1) >= INOUTF_SZ)) {
+        pr2serr("hash=: FILE name too long\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (NULL == op->hashp) {
+        op->hashp = (struct hash_ctl_t *)calloc(1, sizeof(*op->hashp));
+        if (NULL == op->hashp) {
+            pr2serr("hash=: out of memory\n");
+            return SG_LIB_CAT_OTHER;
+        }
+    }
+    hcp = op->hashp;
+    hash_init(&hcp->h, alg);
+    strcpy(hcp->fn, cp ? (cp + 1) : "");
+#ifndef DDPT_HASH_ARM_CRC
+    if (DDPT_HASH_CRC32C == alg)
+        crc32c_tab_init();      /* before any other thread gets here */
+#endif
+    return 0;
+}
+
+/* Opens FILE, appending when a journal= copy is being resumed. */
+static int
+hash_file_open(struct opts_t * op, struct hash_ctl_t * hcp)
+{
+    bool resumed = op->jrnlp && (op->skip > op->jrnl_skip0);
+
+    hcp->fp = fopen(hcp->fn, (resumed ? "a" : "w"));
+    if (NULL == hcp->fp) {
+        pr2serr("hash=%s,%s: %s\n", hash_alg_name(hcp->h.alg), hcp->fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    if (! resumed)
+        fprintf(hcp->fp, "# ddpt hash=%s if=%s ibs=%d\n# skip blocks "
+                "digest\n", hash_alg_name(hcp->h.alg), op->idip->fn,
+                op->ibs);
+    return 0;
+}
+
+/* Called with each segment read from IFILE, in order: len bytes at bp
+ * which start at IFILE block skip and hold blks blocks. Returns 0 on
+ * success. */
+int
+hash_segment(struct opts_t * op, const unsigned char * bp, int len,
+             int64_t skip, int blks)
+{
+    int res, n;
+    struct hash_ctl_t * hcp = op->hashp;
+    struct ddpt_hash_t sh;
+    unsigned char d[DDPT_HASH_MAX_LEN];
+    char b[2 * DDPT_HASH_MAX_LEN + 1];
+
+    if (! hcp->started) {
+        hcp->started = true;
+        hcp->start_skip = skip;
+        if (hcp->fn[0] && (res = hash_file_open(op, hcp)))
+            return res;
+    }
+    hash_update(&hcp->h, bp, len);
+    hcp->blks += blks;
+    if (hcp->fp) {
+        hash_init(&sh, hcp->h.alg);
+        hash_update(&sh, bp, len);
+        n = hash_final(&sh, d);
+        hash_hex(d, n, b);
+        if (fprintf(hcp->fp, "%" PRId64 " %d %s\n", skip, blks, b) < 0) {
+            pr2serr("hash=: writing %s: %s\n", hcp->fn,
+                    safe_strerror(errno));
+            return SG_LIB_FILE_ERROR;
+        }
+    }
+    return 0;
+}
+
+/* Prints the digest of the input after the copy. */
+void
+hash_report(struct opts_t * op)
+{
+    int n;
+    struct hash_ctl_t * hcp = op->hashp;
+    unsigned char d[DDPT_HASH_MAX_LEN];
+    char b[2 * DDPT_HASH_MAX_LEN + 1];
+
+    n = hash_final(&hcp->h, d);
+    hash_hex(d, n, b);
+    pr2serr("%s: %s  (IFILE blocks %" PRId64 " to %" PRId64 ", %" PRIu64
+            " bytes)\n", hash_alg_name(hcp->h.alg), b, hcp->start_skip,
+            hcp->start_skip + hcp->blks - (hcp->blks ? 1 : 0), hcp->h.len);
+}
+
+void
+hash_free(struct opts_t * op)
+{
+    struct hash_ctl_t * hcp = op->hashp;
+
+    if (NULL == hcp)
+        return;
+    if (hcp->fp && (fclose(hcp->fp) < 0))
+        pr2serr("hash=: closing %s: %s\n", hcp->fn, safe_strerror(errno));
+    free(hcp);
+    op->hashp = NULL;
+}
+
+
+/* manifest=MF: delta copies. MF holds an xxh64 digest of each OBPC sized
+ * chunk of OFILE as ddpt last wrote it. A later copy of the same range
+ * hashes each chunk read from IFILE and only writes those whose digest
+ * differs, without reading OFILE. MF is a line of text describing the
+ * copy followed by the digests, 8 bytes each, big endian. */
+struct mf_ctl_t {
+    bool started;       /* mf_start() done so save MF at the end */
+    int chunk;          /* OFILE blocks per digest (OBPC) */
+    int64_t base;       /* OFILE block of the first chunk (SEEK) */
+    int64_t n;          /* chunks in d[] */
+    uint64_t * d;       /* digest of each chunk in OFILE, 0: unknown */
+    char fn[INOUTF_SZ];
+};
+
+#define MF_BATCH 512    /* digests read or written at a time */
+
+int
+mf_parse(struct opts_t * op, const char * arg)
+{
+    if ((0 == strlen(arg)) || (strlen(arg) >= INOUTF_SZ)) {
+        pr2serr("bad argument to 'manifest=', expect MF (a file name)\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (NULL == op->mfp) {
+        op->mfp = (struct mf_ctl_t *)calloc(1, sizeof(*op->mfp));
+        if (NULL == op->mfp) {
+            pr2serr("manifest=: out of memory\n");
+            return SG_LIB_CAT_OTHER;
+        }
+    }
+    strcpy(op->mfp->fn, arg);
+    return 0;
+}
+
+static int
+mf_gcd(int a, int b)
+{
+    int t;
+
+    while (b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Loads the digests in MF into mp->d[] when MF describes chunks of this
+ * OFILE, starting at the same block, of the same size. Anything else just
+ * means everything is written. Returns 0 unless MF can't be read. */
+static int
+mf_read(struct opts_t * op, struct mf_ctl_t * mp)
+{
+    int k, n, obs, chunk, off;
+    int64_t seek, cnt, j, need;
+    FILE * fp;
+    struct stat a_st;
+    unsigned char b[MF_BATCH * 8];
+    char line[INOUTF_SZ + 128];
+
+    if (NULL == (fp = fopen(mp->fn, "rb"))) {
+        if (ENOENT == errno) {
+            if (op->verbose)
+                pr2serr("manifest %s: not found, writing everything\n",
+                        mp->fn);
+            return 0;
+        }
+        pr2serr("manifest: could not open %s: %s\n", mp->fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    off = 0;
+    if ((NULL == fgets(line, sizeof(line), fp)) ||
+        (4 != sscanf(line, "ddpt-manifest 1 xxh64 obs=%d chunk=%d seek=%"
+                     SCNd64 " chunks=%" SCNd64 " of=%n", &obs, &chunk,
+                     &seek, &cnt, &off)) || (0 == off)) {
+        pr2serr("manifest %s: not a ddpt manifest, writing everything\n",
+                mp->fn);
+        goto fini;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    if (strcmp(line + off, op->odip->fn) || (obs != op->obs) ||
+        (chunk != mp->chunk) || (seek != mp->base) || (cnt < 0)) {
+        pr2serr("manifest %s: made for another OFILE, OBS, OBPC or SEEK, "
+                "writing everything\n", mp->fn);
+        goto fini;
+    }
+    if (cnt > mp->n)
+        cnt = mp->n;
+    /* a regular OFILE that has been truncated since (its last block may
+     * be partial) */
+    need = cnt * chunk * obs;
+    if (need > (op->dd_count * op->ibs))
+        need = op->dd_count * op->ibs;
+    if ((FT_REG & op->odip->d_type) && (0 == fstat(op->odip->fd, &a_st)) &&
+        (a_st.st_size <= ((mp->base * obs) + need - obs))) {
+        pr2serr("manifest %s: %s is shorter than when MF was written, "
+                "writing everything\n", mp->fn, op->odip->fn);
+        goto fini;
+    }
+    for (j = 0; j < cnt; j += n) {
+        n = ((cnt - j) < MF_BATCH) ? (int)(cnt - j) : MF_BATCH;
+        if (1 != fread(b, n * 8, 1, fp)) {
+            pr2serr("manifest %s: truncated, writing everything\n",
+                    mp->fn);
+            memset(mp->d, 0, mp->n * sizeof(uint64_t));
+            goto fini;
+        }
+        for (k = 0; k < n; ++k)
+            mp->d[j + k] = sg_get_unaligned_be64(b + (8 * k));
+    }
+    if (op->verbose)
+        pr2serr("manifest %s: %" PRId64 " digests of %d block chunks "
+                "loaded\n", mp->fn, cnt, chunk);
+fini:
+    fclose(fp);
+    return 0;
+}
+
+/* Called once the count and BPT are known, before a journal= copy is
+ * resumed. Picks OBPC when not given, loads MF then removes it: it is
+ * written again when ddpt finishes, so a copy killed part way doesn't
+ * leave digests of data that may not be on OFILE. Returns 0 on success,
+ * manifest= being dropped when it can't be used. */
+int
+mf_start(struct opts_t * op)
+{
+    int res, n;
+    int ocbpt = (op->ibs * op->bpt_i) / op->obs;
+    int64_t oblks;
+    struct mf_ctl_t * mp = op->mfp;
+    const char * cp = NULL;
+
+    if (! ((FT_PT | FT_BLOCK | FT_REG) & op->odip->d_type))
+        cp = "OFILE must be pt, block device or regular file";
+    else if (op->reading_fifo || (op->dd_count <= 0))
+        cp = "needs a known count";
+    else if (op->oflagp->nowrite)
+        cp = "nothing written with oflag=nowrite";
+    if (cp) {
+        pr2serr("manifest= ignored, %s\n", cp);
+        mf_free(op);
+        return 0;
+    }
+    if (op->oflagp->sparse || op->oflagp->sparing) {
+        pr2serr("manifest=: sparse and sparing flags ignored\n");
+        op->oflagp->sparse = 0;
+        op->oflagp->sparing = false;
+        op->out_sparse_active = false;
+        op->in_sparse_active = false;
+        op->out_trim_active = false;
+    }
+    if (0 == op->obpch) {
+        n = DDPT_MF_CHUNK_BYTES / op->obs;
+        op->obpch = mf_gcd(ocbpt, (n > 0) ? n : 1);
+    } else if (ocbpt % op->obpch) {
+        n = mf_gcd(ocbpt, op->obpch);
+        pr2serr("manifest=: OBPC must divide BPT*IBS/OBS, so OBPC=%d\n", n);
+        op->obpch = n;
+    }
+    mp->chunk = op->obpch;
+    mp->base = op->seek;
+    oblks = ((op->dd_count * op->ibs) + op->obs - 1) / op->obs;
+    mp->n = (oblks + mp->chunk - 1) / mp->chunk;
+    mp->d = (uint64_t *)calloc(mp->n, sizeof(uint64_t));
+    if (NULL == mp->d) {
+        pr2serr("manifest=: out of memory for %" PRId64 " digests\n",
+                mp->n);
+        return SG_LIB_CAT_OTHER;
+    }
+    if ((res = mf_read(op, mp)))
+        return res;
+    if ((unlink(mp->fn) < 0) && (ENOENT != errno)) {
+        pr2serr("manifest: could not remove %s: %s\n", mp->fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    mp->started = true;
+    op->out_sparing_active = true;      /* report unchanged as bypassed */
+    return 0;
+}
+
+/* len bytes at bp are to be written to OFILE starting at block lba, the
+ * start of a chunk. Records their digest and returns true if the chunk
+ * already holds them so need not be written. Worker threads (thr=THR) only
+ * touch the chunks of their own segments. */
+bool
+mf_chunk_same(struct opts_t * op, int64_t lba, const unsigned char * bp,
+              int len)
+{
+    int64_t off;
+    uint64_t v;
+    struct mf_ctl_t * mp = op->mfp;
+    struct ddpt_hash_t h;
+    unsigned char d[DDPT_HASH_MAX_LEN];
+    bool same;
+
+    off = lba - mp->base;
+    if ((off < 0) || (off % mp->chunk) || ((off / mp->chunk) >= mp->n))
+        return false;
+    hash_init(&h, DDPT_HASH_XXH64);
+    hash_update(&h, bp, len);
+    hash_final(&h, d);
+    v = sg_get_unaligned_be64(d);
+    same = (v && (v == mp->d[off / mp->chunk]));
+    mp->d[off / mp->chunk] = v;
+    return same;
+}
+
+/* Writes of blks blocks starting at OFILE block lba failed or were cut
+ * short, so forget the digests of the chunks in that range. */
+void
+mf_invalidate(struct opts_t * op, int64_t lba, int64_t blks)
+{
+    int64_t k, lo, hi;
+    struct mf_ctl_t * mp = op->mfp;
+
+    lo = (lba - mp->base) / mp->chunk;
+    hi = (lba + blks - mp->base + mp->chunk - 1) / mp->chunk;
+    for (k = (lo > 0) ? lo : 0; (k < hi) && (k < mp->n); ++k)
+        mp->d[k] = 0;
+}
+
+/* Flushes OFILE then writes MF (via MF.tmp and a rename). Returns 0 on
+ * success. */
+int
+mf_finish(struct opts_t * op)
+{
+    bool ok;
+    int k, n, res;
+    int64_t j;
+    FILE * fp;
+    struct mf_ctl_t * mp = op->mfp;
+    unsigned char b[MF_BATCH * 8];
+    char tmp_fn[INOUTF_SZ + 8];
+
+    if ((NULL == mp) || (! mp->started))
+        return 0;
+    mp->started = false;
+    if ((res = sync_outputs(op, "manifest")))
+        return res;
+    snprintf(tmp_fn, sizeof(tmp_fn), "%s.tmp", mp->fn);
+    if (NULL == (fp = fopen(tmp_fn, "wb"))) {
+        pr2serr("manifest: could not open %s: %s\n", tmp_fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    ok = (fprintf(fp, "ddpt-manifest 1 xxh64 obs=%d chunk=%d seek=%" PRId64
+                  " chunks=%" PRId64 " of=%s\n", op->obs, mp->chunk,
+                  mp->base, mp->n, op->odip->fn) > 0);
+    for (j = 0; ok && (j < mp->n); j += n) {
+        n = ((mp->n - j) < MF_BATCH) ? (int)(mp->n - j) : MF_BATCH;
+        for (k = 0; k < n; ++k)
+            sg_put_unaligned_be64(mp->d[j + k], b + (8 * k));
+        ok = (1 == fwrite(b, n * 8, 1, fp));
+    }
+    if (ok)
+        ok = (0 == fflush(fp));
+#ifdef HAVE_FSYNC
+    if (ok)
+        ok = (fsync(fileno(fp)) >= 0);
+#endif
+    if (fclose(fp) < 0)
+        ok = false;
+    if (ok)
+        ok = (rename(tmp_fn, mp->fn) >= 0);
+    if (! ok) {
+        pr2serr("manifest: could not write %s: %s\n", mp->fn,
+                safe_strerror(errno));
+        unlink(tmp_fn);
+        return SG_LIB_FILE_ERROR;
+    }
+    if (op->verbose)
+        pr2serr("manifest %s: %" PRId64 " digests written\n", mp->fn,
+                mp->n);
+    return 0;
+}
+
+void
+mf_free(struct opts_t * op)
+{
+    struct mf_ctl_t * mp = op->mfp;
+
+    if (NULL == mp)
+        return;
+    if (mp->d)
+        free(mp->d);
+    free(mp);
+    op->mfp = NULL;
+}
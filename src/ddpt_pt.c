@@ -61,6 +61,16 @@
 
 #include "ddpt.h"       /* includes <signal.h> */
 
+#ifdef SG_LIB_LINUX
+#include <poll.h>
+#include <sys/sysmacros.h>
+#ifndef major
+#include <sys/types.h>
+#endif
+#include <linux/major.h>
+#include <scsi/sg.h>
+#endif
+
 #include "sg_lib.h"
 #include "sg_cmds_basic.h"
 #include "sg_cmds_extra.h"
@@ -113,6 +123,8 @@
 
 #define DEF_PT_TIMEOUT 60       /* 60 seconds */
 
+#define PT_ASYNC_MIN_CHUNK (32 * 1024)  /* don't split segments finer */
+
 
 void *
 pt_construct_obj(void)
@@ -599,7 +611,7 @@ pt_read(struct opts_t * op, bool in0_out1, unsigned char * buff, int blocks,
     bool use_io_addr;
     int res, blks, xferred, pi_len, bs, retries_tmp;
     int ret = 0;
-    int64_t from_block;
+    int64_t from_block, t0;
     uint64_t io_addr;
     int64_t lba;
     struct flags_t * fp;
@@ -625,7 +637,9 @@ pt_read(struct opts_t * op, bool in0_out1, unsigned char * buff, int blocks,
         io_addr = 0;
         use_io_addr = false;
         may_coe = false;
+        t0 = lat_start(op);
         res = pt_low_read(op, in0_out1, bp, blks, lba, bs, &io_addr);
+        lat_end(op, DDPT_PH_READ, t0);
         switch (res) {
         case 0:         /* this is the fast path after good pt_low_read() */
             if (blks_readp)
@@ -732,7 +746,9 @@ pt_read(struct opts_t * op, bool in0_out1, unsigned char * buff, int blocks,
             if (op->verbose)
                 pr2serr("  partial re-read of %d blocks prior to medium "
                         "error\n", blks);
+            t0 = lat_start(op);
             res = pt_low_read(op, in0_out1, bp, blks, lba, bs, &io_addr);
+            lat_end(op, DDPT_PH_READ, t0);
             switch (res) {
             case 0:
                 break;
@@ -942,10 +958,13 @@ pt_write(struct opts_t * op, const unsigned char * buff, int blocks,
     int retries_tmp;
     int ret = 0;
     int bs = op->obs_pi;
+    int64_t t0;
 
     retries_tmp = op->oflagp->retries;
     while (1) {
+        t0 = lat_start(op);
         ret = pt_low_write(op, buff, blocks, to_block, bs);
+        lat_end(op, DDPT_PH_WRITE, t0);
         if (0 == ret)
             break;
         if ((SG_LIB_CAT_NOT_READY == ret) ||
@@ -982,48 +1001,363 @@ pt_write(struct opts_t * op, const unsigned char * buff, int blocks,
     return ret;
 }
 
-/* This function performs a "trim" on a pt device. In the SCSI command set
- * this is either done with the UNMAP command or WRITE SAME command. This
- * function uses WRITE SAME(16) with the unmap bit set. In Linux libata
- * translates this to the ATA DATA SET MANAGEMENT command with the trim
- * field set. Returns 0 on success. */
+#ifdef SG_LIB_LINUX
+
+/* One per command queued with the sg driver's asynchronous interface */
+struct pt_async_t {
+    bool done;          /* response has been read() */
+    int blks;
+    int64_t lba;
+    unsigned char * bp;
+    unsigned char cdb[MAX_SCSI_CDBSZ];
+    unsigned char sense_b[SENSE_BUFF_LEN];
+    struct sg_io_hdr io_hdr;
+};
+
+/* The asynchronous (queued) pt mode uses write() and read() on a sg
+ * device file descriptor. That would be harmful on anything else (e.g. a
+ * block device opened for SG_IO) so check before using it. */
+bool
+pt_async_capable(int fd)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) < 0)
+        return false;
+    return (S_ISCHR(st.st_mode) &&
+            (SCSI_GENERIC_MAJOR == major(st.st_rdev)));
+}
+
+/* After an error part way through pt_async_queue(), reaps the commands
+ * still in flight so their responses are not read by a later command.
+ * Responses not from arr are dropped. The sg driver only writes into arr
+ * (sense buffer) when a response is read, so arr can be freed either way.
+ * Returns 0 when all were reaped, else -1 (reported to stderr). */
+static int
+pt_async_drain(struct opts_t * op, const struct dev_info_t * dip,
+               struct pt_async_t * arr, int submitted, int completed)
+{
+    int res;
+    int fd = dip->fd;
+    struct pt_async_t * ap;
+    struct sg_io_hdr rhdr;
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (completed < submitted) {
+        memset(&rhdr, 0, sizeof(rhdr));
+        rhdr.interface_id = 'S';
+        rhdr.pack_id = -1;
+        res = read(fd, &rhdr, sizeof(struct sg_io_hdr));
+        if (res >= 0) {
+            ap = (struct pt_async_t *)rhdr.usr_ptr;
+            if ((ap >= arr) && (ap < (arr + submitted)) && (! ap->done)) {
+                ap->done = true;
+                ++completed;
+            }
+            continue;
+        }
+        if (EINTR == errno)
+            ++op->interrupted_retries;
+        else if (EAGAIN == errno) {
+            /* commands time out after DEF_RW_TIMEOUT, allow twice that */
+            res = poll(&pfd, 1, 2 * DEF_RW_TIMEOUT * 1000);
+            if ((res < 0) && (EINTR == errno))
+                continue;
+            if (res <= 0)
+                break;
+        } else
+            break;
+    }
+    if (completed == submitted)
+        return 0;
+    pr2serr("%s: %d commands still in flight on %s, their responses are "
+            "left\nto the sg driver\n", __func__, submitted - completed,
+            dip->fn);
+    return -1;
+}
+
+/* Splits 'blocks' starting at 'start_block' into up to op->queue_depth
+ * (qd=QD) commands, builds a READ or WRITE cdb for each with
+ * pt_build_scsi_cdb() then submits them all without waiting. Responses
+ * are reaped in whatever order they complete. The commands are placed in
+ * *app (caller frees) and their number in *np. Commands that could not be
+ * submitted are left with done false. Returns 0 on success, else
+ * SG_LIB_SYNTAX_ERROR, -2 (ENOMEM) or -1 . On -1 any commands in flight
+ * have been reaped if possible (see pt_async_drain()). */
+static int
+pt_async_queue(struct opts_t * op, bool in0_out1, bool write_true,
+               unsigned char * buff, int blocks, int64_t start_block,
+               int bs, struct pt_async_t ** app, int * np)
+{
+    bool q_full = false;
+    int k, n, res, min_blks, chunk, off, fd, flags;
+    int submitted, completed, protect, limit;
+    const struct dev_info_t * dip = (in0_out1 ? op->odip : op->idip);
+    const struct flags_t * fp = (in0_out1 ? op->oflagp : op->iflagp);
+    struct pt_async_t * ap;
+    struct pt_async_t * arr;
+    struct sg_io_hdr rhdr;
+    struct pollfd pfd;
+
+    fd = dip->fd;
+    protect = (write_true ? op->wrprotect :
+               (in0_out1 ? op->wrprotect : op->rdprotect));
+    min_blks = (PT_ASYNC_MIN_CHUNK + bs - 1) / bs;
+    n = blocks / min_blks;
+    if (n < 1)
+        n = 1;
+    else if (n > op->queue_depth)
+        n = op->queue_depth;
+    chunk = (blocks + n - 1) / n;
+    n = (blocks + chunk - 1) / chunk;
+    arr = (struct pt_async_t *)calloc(n, sizeof(struct pt_async_t));
+    if (NULL == arr) {
+        pr2serr("%s: calloc failed\n", __func__);
+        return -2;
+    }
+    *app = arr;
+    *np = n;
+    flags = 0;
+#ifdef SG_FLAG_Q_AT_TAIL
+    flags |= SG_FLAG_Q_AT_TAIL;
+#endif
+    for (k = 0, off = 0; k < n; ++k, off += chunk) {
+        ap = arr + k;
+        ap->lba = start_block + off;
+        ap->blks = ((blocks - off) < chunk) ? (blocks - off) : chunk;
+        ap->bp = buff + ((int64_t)off * bs);
+        if (pt_build_scsi_cdb(ap->cdb, fp->cdbsz, ap->blks, ap->lba,
+                              write_true, fp, protect)) {
+            pr2serr("bad %s cdb build, lba=%" PRId64 ", blocks=%d\n",
+                    (write_true ? "wr" : "rd"), ap->lba, ap->blks);
+            return SG_LIB_SYNTAX_ERROR;
+        }
+        ap->io_hdr.interface_id = 'S';
+        ap->io_hdr.dxfer_direction = write_true ? SG_DXFER_TO_DEV :
+                                                  SG_DXFER_FROM_DEV;
+        ap->io_hdr.cmd_len = fp->cdbsz;
+        ap->io_hdr.cmdp = ap->cdb;
+        ap->io_hdr.mx_sb_len = sizeof(ap->sense_b);
+        ap->io_hdr.sbp = ap->sense_b;
+        ap->io_hdr.dxfer_len = ap->blks * bs;
+        ap->io_hdr.dxferp = ap->bp;
+        ap->io_hdr.timeout = DEF_RW_TIMEOUT * 1000;     /* milliseconds */
+        ap->io_hdr.flags = flags;
+        ap->io_hdr.pack_id = k;
+        ap->io_hdr.usr_ptr = ap;
+    }
+    if (op->verbose > 2)
+        pr2serr("%s: %s %d blocks at lba=%" PRId64 " as %d queued "
+                "commands\n", __func__, (write_true ? "write" : "read"),
+                blocks, start_block, n);
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    limit = n;
+    for (submitted = 0, completed = 0;
+         (completed < submitted) || (submitted < limit); ) {
+        if ((submitted < limit) && (! q_full)) {
+            res = write(fd, &arr[submitted].io_hdr,
+                        sizeof(struct sg_io_hdr));
+            if (res >= 0) {
+                ++submitted;
+                continue;
+            }
+            if (EINTR == errno) {
+                ++op->interrupted_retries;
+                continue;
+            }
+            if ((EAGAIN == errno) || (EDOM == errno)) {
+                /* sg queue full, reap one then resubmit */
+                ++op->io_eagains;
+                if (completed == submitted)
+                    break;      /* nothing to wait for */
+                q_full = true;
+            } else {
+                if (op->verbose)
+                    pr2serr("%s: write(sg): %s, finish synchronously\n",
+                            __func__, safe_strerror(errno));
+                limit = submitted;
+                continue;
+            }
+        }
+        memset(&rhdr, 0, sizeof(rhdr));
+        rhdr.interface_id = 'S';
+        rhdr.pack_id = -1;      /* any completed command */
+        res = read(fd, &rhdr, sizeof(struct sg_io_hdr));
+        if (res < 0) {
+            if (EINTR == errno)
+                ++op->interrupted_retries;
+            else if (EAGAIN == errno) {         /* O_NONBLOCK open() */
+                if ((poll(&pfd, 1, -1) < 0) && (EINTR != errno)) {
+                    pr2serr("%s: poll: %s\n", __func__,
+                            safe_strerror(errno));
+                    goto drain;
+                }
+            } else {
+                pr2serr("%s: read(sg): %s\n", __func__,
+                        safe_strerror(errno));
+                goto drain;
+            }
+            continue;
+        }
+        ap = (struct pt_async_t *)rhdr.usr_ptr;
+        if ((ap < arr) || (ap >= (arr + submitted)) || ap->done) {
+            pr2serr("%s: unexpected response, pack_id=%d\n", __func__,
+                    rhdr.pack_id);
+            goto drain;
+        }
+        ap->io_hdr = rhdr;
+        ap->done = true;
+        ++completed;
+        q_full = false;
+    }
+    return 0;
+
+drain:
+    pt_async_drain(op, dip, arr, submitted, completed);
+    return -1;
+}
+
+/* Good when the command completed without any status, transport or
+ * driver problem and with no residual. Anything else is redone with
+ * pt_read() or pt_write() for the full sense data processing */
+static bool
+pt_async_good(const struct pt_async_t * ap)
+{
+    return (ap->done &&
+            (SG_INFO_OK == (ap->io_hdr.info & SG_INFO_OK_MASK)) &&
+            (0 == ap->io_hdr.resid));
+}
+
+/* Queued (asynchronous) version of pt_read(), used when iflag=async. The
+ * READ commands for a segment are all in flight together. Any that fail
+ * (e.g. medium error or unit attention) are redone in LBA order by
+ * pt_read() so retries, coe and sense processing are unchanged. Return
+ * values are the same as pt_read(). */
 int
-pt_write_same16(struct opts_t * op, const unsigned char * buff, int bs,
-                int blocks, int64_t start_block)
+pt_read_async(struct opts_t * op, bool in0_out1, unsigned char * buff,
+              int blocks, int * blks_readp)
+{
+    int k, res, blks, xferred;
+    int n = 0;
+    int ret = 0;
+    int64_t hold;
+    int64_t * posp = (in0_out1 ? &op->seek : &op->skip);
+    int bs = (in0_out1 ? op->obs_pi : op->ibs_pi);
+    struct pt_async_t * arr = NULL;
+    struct pt_async_t * ap;
+
+    ret = pt_async_queue(op, in0_out1, false, buff, blocks, *posp, bs, &arr,
+                         &n);
+    if (ret) {
+        if (arr)
+            free(arr);
+        return ret;
+    }
+    hold = *posp;
+    for (k = 0, xferred = 0; k < n; ++k) {
+        ap = arr + k;
+        if (pt_async_good(ap)) {
+            xferred += ap->blks;
+            continue;
+        }
+        if (op->verbose > 1)
+            pr2serr("%s: redo READ at lba=%" PRId64 " blocks=%d, "
+                    "status=0x%x host=0x%x driver=0x%x resid=%d\n",
+                    __func__, ap->lba, ap->blks, ap->io_hdr.status,
+                    ap->io_hdr.host_status, ap->io_hdr.driver_status,
+                    ap->io_hdr.resid);
+        blks = 0;
+        *posp = ap->lba;        /* pt_read() starts at skip (or seek) */
+        res = pt_read(op, in0_out1, ap->bp, ap->blks, &blks);
+        *posp = hold;
+        xferred += blks;
+        if (res || (blks < ap->blks)) {
+            ret = res;
+            break;
+        }
+    }
+    free(arr);
+    if ((0 == ret) && (0 == in0_out1))
+        zero_coe_limit_count(op);
+    if (blks_readp)
+        *blks_readp = xferred;
+    return ret;
+}
+
+/* Queued (asynchronous) version of pt_write(), used when oflag=async.
+ * WRITE commands that fail are redone, in LBA order, by pt_write(). Return
+ * values are the same as pt_write(). */
+int
+pt_write_async(struct opts_t * op, const unsigned char * buff, int blocks,
+               int64_t to_block)
+{
+    int k;
+    int n = 0;
+    int ret;
+    struct pt_async_t * arr = NULL;
+    struct pt_async_t * ap;
+
+    ret = pt_async_queue(op, true, true, (unsigned char *)buff, blocks,
+                         to_block, op->obs_pi, &arr, &n);
+    if (ret) {
+        if (arr)
+            free(arr);
+        return ret;
+    }
+    for (k = 0; k < n; ++k) {
+        ap = arr + k;
+        if (pt_async_good(ap))
+            continue;
+        if (op->verbose > 1)
+            pr2serr("%s: redo WRITE at lba=%" PRId64 " blocks=%d, "
+                    "status=0x%x host=0x%x driver=0x%x resid=%d\n",
+                    __func__, ap->lba, ap->blks, ap->io_hdr.status,
+                    ap->io_hdr.host_status, ap->io_hdr.driver_status,
+                    ap->io_hdr.resid);
+        if ((ret = pt_write(op, ap->bp, ap->blks, ap->lba)))
+            break;
+    }
+    free(arr);
+    return ret;
+}
+
+#endif  /* SG_LIB_LINUX */
+
+/* Sends a trim cdb (WRITE SAME(16) or UNMAP) to OFILE with dlen bytes of
+ * data-out at dop (none if dlen is 0). Returns 0 on success, -1 or a
+ * SG_LIB_CAT_* value otherwise. */
+static int
+pt_trim_cmd(struct opts_t * op, const unsigned char * cdbp, int cdb_len,
+            const unsigned char * dop, int dlen, const char * leadin,
+            bool noisy)
 {
     int k, ret, res, sense_cat, vt;
     int sg_fd = op->odip->fd;
-    uint32_t unum;
-    uint64_t llba;
     struct sg_pt_base * ptvp = op->odip->ptvp;
-    unsigned char wsCmdBlk[16];
     unsigned char sense_b[SENSE_BUFF_LEN];
 
-    memset(wsCmdBlk, 0, sizeof(wsCmdBlk));
-    wsCmdBlk[0] = 0x93;         /* WRITE SAME(16) opcode */
-    /* set UNMAP; clear wrprotect, anchor, pbdata, lbdata */
-    wsCmdBlk[1] = 0x8;
-    llba = start_block;
-    sg_put_unaligned_be64(llba, wsCmdBlk + 2);
-    unum = blocks;
-    sg_put_unaligned_be32(unum, wsCmdBlk + 10);
     if (op->verbose > 2) {
-        pr2serr("    WRITE SAME(16) cdb: ");
-        for (k = 0; k < (int)sizeof(wsCmdBlk); ++k)
-            pr2serr("%02x ", wsCmdBlk[k]);
+        pr2serr("    %s cdb: ", leadin);
+        for (k = 0; k < cdb_len; ++k)
+            pr2serr("%02x ", cdbp[k]);
         pr2serr("\n");
         if (op->verbose > 4)
-            pr2serr("    Data-out buffer length=%d\n", bs);
+            pr2serr("    Data-out buffer length=%d\n", dlen);
     }
 
     if (NULL == ptvp) {
-        pr2serr("pt_write_same16: ptvp NULL?\n");
+        pr2serr("%s: ptvp NULL?\n", __func__);
         return -1;
     }
     clear_scsi_pt_obj(ptvp);
-    set_scsi_pt_cdb(ptvp, wsCmdBlk, sizeof(wsCmdBlk));
+    set_scsi_pt_cdb(ptvp, cdbp, cdb_len);
     set_scsi_pt_sense(ptvp, sense_b, sizeof(sense_b));
-    set_scsi_pt_data_out(ptvp, buff, bs);
+    if (dlen > 0)
+        set_scsi_pt_data_out(ptvp, dop, dlen);
     vt = ((op->verbose > 1) ? (op->verbose - 1) : 0);
     while (((res = do_scsi_pt(ptvp, sg_fd, WRITE_SAME16_TIMEOUT, vt)) < 0) &&
            ((-EINTR == res) || (-EAGAIN == res))) {
@@ -1033,8 +1367,8 @@ pt_write_same16(struct opts_t * op, const unsigned char * buff, int bs,
         else
             ++op->io_eagains;
     }
-    ret = sg_cmds_process_resp(ptvp, "Write same(16)", res, 0, sense_b,
-                               true /*noisy */, vt, &sense_cat);
+    ret = sg_cmds_process_resp(ptvp, leadin, res, 0, sense_b, noisy, vt,
+                               &sense_cat);
     if (-1 == ret)
         ;
     else if (-2 == ret) {
@@ -1067,6 +1401,156 @@ pt_write_same16(struct opts_t * op, const unsigned char * buff, int bs,
     return ret;
 }
 
+/* This function performs a "trim" on a pt device. In the SCSI command set
+ * this is either done with the UNMAP command or WRITE SAME command. This
+ * function uses WRITE SAME(16) with the unmap bit set. In Linux libata
+ * translates this to the ATA DATA SET MANAGEMENT command with the TRIM
+ * field set. The NDOB (no data-out buffer) bit is tried first; a device
+ * rejecting it is sent the bs byte block at buff from then on. Returns 0
+ * on success. */
+int
+pt_write_same16(struct opts_t * op, const unsigned char * buff, int bs,
+                int blocks, int64_t start_block)
+{
+    int ret;
+    uint32_t unum;
+    uint64_t llba;
+    struct dev_info_t * dip = op->odip;
+    unsigned char wsCmdBlk[16];
+
+    memset(wsCmdBlk, 0, sizeof(wsCmdBlk));
+    wsCmdBlk[0] = 0x93;         /* WRITE SAME(16) opcode */
+    /* set UNMAP; clear wrprotect, anchor, pbdata, lbdata */
+    wsCmdBlk[1] = 0x8;
+    llba = start_block;
+    sg_put_unaligned_be64(llba, wsCmdBlk + 2);
+    unum = blocks;
+    sg_put_unaligned_be32(unum, wsCmdBlk + 10);
+    if (dip->ws_ndob >= 0) {
+        wsCmdBlk[1] |= 0x1;     /* NDOB */
+        ret = pt_trim_cmd(op, wsCmdBlk, sizeof(wsCmdBlk), NULL, 0,
+                          "Write same(16)", (dip->ws_ndob > 0));
+        if ((dip->ws_ndob > 0) || (SG_LIB_CAT_ILLEGAL_REQ != ret)) {
+            if (0 == ret)
+                dip->ws_ndob = 1;
+            return ret;
+        }
+        if (op->verbose)
+            pr2serr("%s: WRITE SAME(16) NDOB bit rejected, send a "
+                    "data-out block\n", dip->fn);
+        dip->ws_ndob = -1;
+        wsCmdBlk[1] &= ~0x1;
+    }
+    return pt_trim_cmd(op, wsCmdBlk, sizeof(wsCmdBlk), buff, bs,
+                       "Write same(16)", true);
+}
+
+/* Trims the num ranges at rp with one UNMAP command; the caller keeps them
+ * within dip->max_unmap_descs and dip->max_unmap_blks. A device rejecting
+ * UNMAP has max_unmap_descs set to 0 so WRITE SAME(16) is used from then
+ * on. Returns 0 on success, SG_LIB_CAT_ILLEGAL_REQ or SG_LIB_CAT_INVALID_OP
+ * if UNMAP is not supported, else another error. */
+int
+pt_unmap(struct opts_t * op, const struct trim_rng_t * rp, int num)
+{
+    int k, ret;
+    int plen = 8 + (num * 16);
+    struct dev_info_t * dip = op->odip;
+    unsigned char * pl;
+    unsigned char uCmdBlk[10];
+
+    pl = (unsigned char *)calloc(plen, 1);
+    if (NULL == pl) {
+        pr2serr("%s: out of memory\n", __func__);
+        return -1;
+    }
+    sg_put_unaligned_be16(plen - 2, pl + 0);
+    sg_put_unaligned_be16(plen - 8, pl + 2);
+    for (k = 0; k < num; ++k, ++rp) {
+        sg_put_unaligned_be64((uint64_t)rp->lba, pl + 8 + (k * 16));
+        sg_put_unaligned_be32(rp->num, pl + 16 + (k * 16));
+    }
+    memset(uCmdBlk, 0, sizeof(uCmdBlk));
+    uCmdBlk[0] = 0x42;          /* UNMAP opcode */
+    sg_put_unaligned_be16(plen, uCmdBlk + 7);
+    ret = pt_trim_cmd(op, uCmdBlk, sizeof(uCmdBlk), pl, plen, "Unmap",
+                      (op->verbose > 0));
+    free(pl);
+    if ((SG_LIB_CAT_ILLEGAL_REQ == ret) || (SG_LIB_CAT_INVALID_OP == ret)) {
+        if (op->verbose)
+            pr2serr("%s: UNMAP rejected, use WRITE SAME(16)\n", dip->fn);
+        dip->max_unmap_descs = 0;
+    }
+    return ret;
+}
+
+/* Fetches the Block Limits VPD page of dip (IFILE or OFILE). Places its
+ * MAXIMUM WRITE SAME LENGTH in dip->max_ws_blks; 0 (no limit reported) is
+ * kept so trims are then sent one segment (IBS * BPT) at a time. The
+ * MAXIMUM UNMAP LBA COUNT and BLOCK DESCRIPTOR COUNT fields go to
+ * dip->max_unmap_blks and dip->max_unmap_descs, both 0 when UNMAP isn't
+ * supported or when READ CAPACITY(16) doesn't report LBPRZ (unmapped
+ * blocks then needn't read back as zeros, so WRITE SAME(16) is used). The
+ * MAXIMUM and OPTIMAL TRANSFER LENGTH fields go to dip->max_xfer_bytes and
+ * dip->opt_xfer_bytes (0 when not reported). On failure the fields are
+ * left at 0 (unknown). Returns 0 on success. */
+int
+pt_block_limits_of(struct opts_t * op, struct dev_info_t * dip)
+{
+    int res, resid, verb, len;
+    int bs = (dip == op->idip) ? op->ibs : op->obs;
+    uint64_t ull;
+    unsigned char rcBuff[VPD_BLOCK_LIMITS_LEN];
+    unsigned char rc16Buff[RCAP16_REPLY_LEN];
+
+    verb = (op->verbose ? op->verbose - 1: 0);
+    memset(rcBuff, 0, sizeof(rcBuff));
+    res = sg_ll_inquiry_v2(dip->fd, true, VPD_BLOCK_LIMITS, rcBuff,
+                           sizeof(rcBuff), 0, &resid, false, verb);
+    if (res) {
+        if (op->verbose)
+            pr2serr("Block Limits VPD page not available [%s], res=%d\n",
+                    dip->fn, res);
+        return res;
+    }
+    len = sg_get_unaligned_be16(rcBuff + 2) + 4;
+    if ((rcBuff[1] != VPD_BLOCK_LIMITS) || (len < VPD_BLOCK_LIMITS_LEN) ||
+        ((int)sizeof(rcBuff) - resid < VPD_BLOCK_LIMITS_LEN)) {
+        if (op->verbose)
+            pr2serr("Block Limits VPD page too short [%s]\n", dip->fn);
+        return SG_LIB_CAT_MALFORMED;
+    }
+    ull = sg_get_unaligned_be64(rcBuff + 36);
+    if (ull > UINT32_MAX)
+        ull = UINT32_MAX;
+    dip->max_ws_blks = (uint32_t)ull;
+    dip->max_unmap_blks = sg_get_unaligned_be32(rcBuff + 20);
+    dip->max_unmap_descs = sg_get_unaligned_be32(rcBuff + 24);
+    if (0 == dip->max_unmap_blks)
+        dip->max_unmap_descs = 0;
+    if (dip->max_unmap_descs > 0) {
+        memset(rc16Buff, 0, sizeof(rc16Buff));
+        if (sg_ll_readcap_16(dip->fd, false, 0, rc16Buff, sizeof(rc16Buff),
+                             true, verb) || (! (0x40 & rc16Buff[14]))) {
+            if (op->verbose > 1)
+                pr2serr("%s: LBPRZ not set, trim with WRITE SAME(16) "
+                        "rather than UNMAP\n", dip->fn);
+            dip->max_unmap_descs = 0;
+        }
+    }
+    dip->max_xfer_bytes = (int64_t)sg_get_unaligned_be32(rcBuff + 8) * bs;
+    dip->opt_xfer_bytes = (int64_t)sg_get_unaligned_be32(rcBuff + 12) * bs;
+    if (op->verbose > 1)
+        pr2serr("%s: maximum write same length: %u blocks, maximum and "
+                "optimal\n  transfer lengths: %" PRId64 " and %" PRId64
+                " bytes\n", dip->fn, dip->max_ws_blks, dip->max_xfer_bytes,
+                dip->opt_xfer_bytes);
+    if (op->verbose > 1)
+        pr2serr("  maximum unmap LBA count: %u, block descriptor count: "
+                "%u\n", dip->max_unmap_blks, dip->max_unmap_descs);
+    return 0;
+}
+
 void
 pt_sync_cache(int fd)
 {
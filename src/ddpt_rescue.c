@@ -0,0 +1,748 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * This file contains rescue=MAP[,SECS]: copying from a failing IFILE so
+ * that what can be read comes off at full speed first. Areas that give
+ * read errors are skipped, with a growing step, and only come back to in
+ * later passes that trim the edges of each bad area and then scrape what
+ * is left one block at a time. Progress is kept in the text map file MAP
+ * so an interrupted rescue carries on where it stopped.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+/* N.B. config.h must precede anything that depends on HAVE_*  */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ddpt.h"       /* includes <signal.h> */
+
+#include "sg_lib.h"
+#include "sg_pr2serr.h"
+
+/* Status of each extent of IFILE in the map, as letters like ddrescue's */
+#define RS_UNTRIED '?'          /* not read yet */
+#define RS_UNTRIMMED '*'        /* in a BPT sized read that failed */
+#define RS_UNSCRAPED '/'        /* between the bad edges of a trimmed area */
+#define RS_BAD '-'              /* single block read failed */
+#define RS_DONE '+'             /* read and written to OFILE */
+
+#define RS_PASS_COPY 0
+#define RS_PASS_RETRY 1
+#define RS_PASS_TRIM 2
+#define RS_PASS_SCRAPE 3
+
+static const char * rs_pass_s[] = {"copy", "retry", "trim", "scrape"};
+
+struct rs_ext_t {
+    int64_t lba;        /* first IFILE block */
+    int64_t num;
+    char st;            /* one of the RS_* letters */
+};
+
+/* rescue=MAP[,SECS]: ext[] is sorted by lba and covers the blocks from
+ * skip0 to end with no gaps; neighbours never share a status. */
+struct rs_ctl_t {
+    int secs;           /* map save interval */
+    int n;              /* extents in ext[] */
+    int max;            /* room in ext[] */
+    int64_t skip0;      /* IFILE and OFILE blocks of the first extent */
+    int64_t seek0;
+    int64_t end;        /* IFILE block after the last extent */
+    int64_t last_us;    /* mono_time_us() of last save */
+    int64_t good;       /* blocks copied by this invocation */
+    int64_t bad;        /* blocks found bad by this invocation */
+    struct rs_ext_t * ext;
+    char fn[INOUTF_SZ];
+};
+
+/* rescue=MAP[,SECS]. Returns 0 on success. */
+int
+rs_parse(struct opts_t * op, const char * arg)
+{
+    int n;
+    const char * cp;
+    struct rs_ctl_t * rsp;
+
+    cp = strchr(arg, ',');
+    n = cp ? (int)(cp - arg) : (int)strlen(arg);
+    if ((0 == n) || (n >= INOUTF_SZ)) {
+        pr2serr("bad argument to 'rescue=', expect MAP[,SECS]\n");
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (NULL == op->rsp) {
+        op->rsp = (struct rs_ctl_t *)calloc(1, sizeof(struct rs_ctl_t));
+        if (NULL == op->rsp) {
+            pr2serr("rescue=: out of memory\n");
+            return SG_LIB_CAT_OTHER;
+        }
+    }
+    rsp = op->rsp;
+    memcpy(rsp->fn, arg, n);
+    rsp->fn[n] = '\0';
+    rsp->secs = DDPT_RS_SECS;
+    if (cp) {
+        if ((rsp->secs = sg_get_num(cp + 1)) < 0) {
+            pr2serr("bad SECS argument to 'rescue='\n");
+            return SG_LIB_SYNTAX_ERROR;
+        }
+    }
+    return 0;
+}
+
+void
+rs_free(struct opts_t * op)
+{
+    struct rs_ctl_t * rsp = op->rsp;
+
+    if (NULL == rsp)
+        return;
+    if (rsp->ext)
+        free(rsp->ext);
+    free(rsp);
+    op->rsp = NULL;
+}
+
+/* Appends an extent, merging it into the last one when they have the same
+ * status. Returns 0 if ok, else out of memory. */
+static int
+rs_append(struct rs_ctl_t * rsp, int64_t lba, int64_t num, char st)
+{
+    struct rs_ext_t * ep;
+
+    if ((rsp->n > 0) && (st == rsp->ext[rsp->n - 1].st)) {
+        rsp->ext[rsp->n - 1].num += num;
+        return 0;
+    }
+    if (rsp->n >= rsp->max) {
+        int m = rsp->max ? (2 * rsp->max) : 64;
+
+        ep = (struct rs_ext_t *)realloc(rsp->ext, m * sizeof(*ep));
+        if (NULL == ep) {
+            pr2serr("rescue: out of memory for %d extents\n", m);
+            return SG_LIB_CAT_OTHER;
+        }
+        rsp->ext = ep;
+        rsp->max = m;
+    }
+    ep = rsp->ext + rsp->n++;
+    ep->lba = lba;
+    ep->num = num;
+    ep->st = st;
+    return 0;
+}
+
+/* Index of the extent holding IFILE block lba (skip0 <= lba < end) */
+static int
+rs_find(const struct rs_ctl_t * rsp, int64_t lba)
+{
+    int lo = 0;
+    int hi = rsp->n - 1;
+    int mid;
+
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (rsp->ext[mid].lba <= lba)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+/* Gives num blocks from lba, all within a single extent, status st. That
+ * extent is split and the pieces merged with their neighbours as needed.
+ * Returns 0 if ok, else out of memory. */
+static int
+rs_mark(struct rs_ctl_t * rsp, int64_t lba, int64_t num, char st)
+{
+    int k, j, add;
+    struct rs_ext_t e;
+    struct rs_ext_t * ep;
+
+    k = rs_find(rsp, lba);
+    e = rsp->ext[k];
+    if ((num <= 0) || (e.st == st))
+        return 0;
+    add = (lba > e.lba) + ((lba + num) < (e.lba + e.num));
+    if ((rsp->n + add) > rsp->max) {
+        int m = 2 * (rsp->max + add);
+
+        ep = (struct rs_ext_t *)realloc(rsp->ext, m * sizeof(*ep));
+        if (NULL == ep) {
+            pr2serr("rescue: out of memory for %d extents\n", m);
+            return SG_LIB_CAT_OTHER;
+        }
+        rsp->ext = ep;
+        rsp->max = m;
+    }
+    ep = rsp->ext;
+    memmove(ep + k + 1 + add, ep + k + 1,
+            (rsp->n - k - 1) * sizeof(*ep));
+    rsp->n += add;
+    j = k;
+    if (lba > e.lba) {
+        ep[j].lba = e.lba;
+        ep[j].num = lba - e.lba;
+        ep[j++].st = e.st;
+    }
+    ep[j].lba = lba;
+    ep[j].num = num;
+    ep[j].st = st;
+    if ((lba + num) < (e.lba + e.num)) {
+        ep[j + 1].lba = lba + num;
+        ep[j + 1].num = e.lba + e.num - (lba + num);
+        ep[j + 1].st = e.st;
+    }
+    /* merge the new extent with the one after it, then before it */
+    if ((j + 1 < rsp->n) && (ep[j + 1].st == st)) {
+        ep[j].num += ep[j + 1].num;
+        memmove(ep + j + 1, ep + j + 2, (rsp->n - j - 2) * sizeof(*ep));
+        --rsp->n;
+    }
+    if ((j > 0) && (ep[j - 1].st == st)) {
+        ep[j - 1].num += ep[j].num;
+        memmove(ep + j, ep + j + 1, (rsp->n - j - 1) * sizeof(*ep));
+        --rsp->n;
+    }
+    return 0;
+}
+
+/* Writes the map to MAP.tmp, flushes that, then renames it over MAP. The
+ * outputs are flushed first so MAP never claims more than is on OFILE.
+ * Returns 0 on success. */
+static int
+rs_write(struct opts_t * op, struct rs_ctl_t * rsp)
+{
+    bool ok;
+    int k, res;
+    FILE * fp;
+    char tmp_fn[INOUTF_SZ + 8];
+
+    if ((res = sync_outputs(op, "rescue")))
+        return res;
+    snprintf(tmp_fn, sizeof(tmp_fn), "%s.tmp", rsp->fn);
+    if (NULL == (fp = fopen(tmp_fn, "w"))) {
+        pr2serr("rescue: could not open %s: %s\n", tmp_fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    ok = (fprintf(fp, "ddpt-rescue 1\nif=%s\nof=%s\nibs=%d\nskip=%" PRId64
+                  "\nseek=%" PRId64 "\ncount=%" PRId64 "\n# IFILE block, "
+                  "number of blocks, status (%c%c%c%c%c)\n", op->idip->fn,
+                  op->odip->fn, op->ibs, rsp->skip0, rsp->seek0,
+                  rsp->end - rsp->skip0, RS_UNTRIED, RS_UNTRIMMED,
+                  RS_UNSCRAPED, RS_BAD, RS_DONE) > 0);
+    for (k = 0; ok && (k < rsp->n); ++k)
+        ok = (fprintf(fp, "%" PRId64 " %" PRId64 " %c\n", rsp->ext[k].lba,
+                      rsp->ext[k].num, rsp->ext[k].st) > 0);
+    if (ok)
+        ok = (0 == fflush(fp));
+#ifdef HAVE_FSYNC
+    if (ok)
+        ok = (fsync(fileno(fp)) >= 0);
+#endif
+    if (fclose(fp) < 0)
+        ok = false;
+    if (ok)
+        ok = (rename(tmp_fn, rsp->fn) >= 0);
+    if (! ok) {
+        pr2serr("rescue: could not write %s: %s\n", rsp->fn,
+                safe_strerror(errno));
+        unlink(tmp_fn);
+        return SG_LIB_FILE_ERROR;
+    }
+    rsp->last_us = mono_time_us();
+    return 0;
+}
+
+/* Saves the map if SECS have passed since it was last saved */
+static int
+rs_checkpoint(struct opts_t * op, struct rs_ctl_t * rsp)
+{
+    if ((mono_time_us() - rsp->last_us) < ((int64_t)rsp->secs * 1000000))
+        return 0;
+    return rs_write(op, rsp);
+}
+
+/* Loads MAP if it exists. Returns 0 if it was loaded (or did not exist)
+ * and describes this copy, else an error. */
+static int
+rs_read(struct opts_t * op, struct rs_ctl_t * rsp)
+{
+    bool match = true;
+    int res = 0;
+    int64_t v, lba, num;
+    int64_t next = rsp->skip0;
+    FILE * fp;
+    char * cp;
+    char st;
+    char b[INOUTF_SZ + 32];
+
+    if (NULL == (fp = fopen(rsp->fn, "r"))) {
+        if (ENOENT == errno)
+            return rs_append(rsp, rsp->skip0, rsp->end - rsp->skip0,
+                             RS_UNTRIED);
+        pr2serr("rescue: could not open %s: %s\n", rsp->fn,
+                safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    if ((NULL == fgets(b, sizeof(b), fp)) ||
+        strncmp(b, "ddpt-rescue 1\n", sizeof(b))) {
+        fclose(fp);
+        pr2serr("rescue: %s is not a ddpt rescue map\n", rsp->fn);
+        return SG_LIB_FILE_ERROR;
+    }
+    while (fgets(b, sizeof(b), fp)) {
+        if ((cp = strchr(b, '\n')))
+            *cp = '\0';
+        if ('#' == b[0])
+            continue;
+        if (isdigit((unsigned char)b[0])) {
+            if ((3 != sscanf(b, "%" SCNd64 " %" SCNd64 " %c", &lba, &num,
+                             &st)) || (lba != next) || (num <= 0) ||
+                (! strchr("?*/-+", st)) || ((lba + num) > rsp->end)) {
+                pr2serr("rescue: %s: bad extent line: %s\n", rsp->fn, b);
+                res = SG_LIB_FILE_ERROR;
+                break;
+            }
+            if ((res = rs_append(rsp, lba, num, st)))
+                break;
+            next = lba + num;
+            continue;
+        }
+        if (NULL == (cp = strchr(b, '=')))
+            continue;
+        *cp++ = '\0';
+        v = (isdigit((unsigned char)*cp)) ? sg_get_llnum(cp) : -1;
+        if (0 == strcmp(b, "if"))
+            match = (0 == strcmp(cp, op->idip->fn));
+        else if (0 == strcmp(b, "of"))
+            match = (0 == strcmp(cp, op->odip->fn));
+        else if (0 == strcmp(b, "ibs"))
+            match = (v == op->ibs);
+        else if (0 == strcmp(b, "skip"))
+            match = (v == rsp->skip0);
+        else if (0 == strcmp(b, "seek"))
+            match = (v == rsp->seek0);
+        else if (0 == strcmp(b, "count"))
+            match = (v == (rsp->end - rsp->skip0));
+        if (! match)
+            break;
+    }
+    fclose(fp);
+    if (! match) {
+        pr2serr("rescue: %s is for another copy (%s= differs), remove it "
+                "to start\nagain\n", rsp->fn, b);
+        return SG_LIB_FILE_ERROR;
+    }
+    if ((0 == res) && (next != rsp->end)) {
+        pr2serr("rescue: %s: extents end at %" PRId64 ", expected %" PRId64
+                "\n", rsp->fn, next, rsp->end);
+        res = SG_LIB_FILE_ERROR;
+    }
+    return res;
+}
+
+/* Reads num blocks from IFILE block lba into bp. Places the number of
+ * good blocks read before any error in *goodp. If IFILE (not pt) ends part
+ * way into the block after those, the bytes of that partial block are put
+ * in *partp and reading stops there. Returns 0 if all were read and 1 if a
+ * read error (worth trying again later) stopped it, else an error (greater
+ * than 1) that ends the rescue. */
+static int
+rs_read_blks(struct opts_t * op, int64_t lba, int num, unsigned char * bp,
+             int * goodp, int * partp)
+{
+    int res, got;
+    int64_t hold_skip, t0;
+    ssize_t n;
+
+    *goodp = 0;
+    *partp = 0;
+    if (FT_PT & op->idip->d_type) {
+        got = 0;
+        hold_skip = op->skip;
+        op->skip = lba;
+        res = pt_read(op, false, bp, num, &got);
+        op->skip = hold_skip;
+        if ((got > 0) && (got <= num))
+            *goodp = got;
+        switch (res) {
+        case 0:
+            return (got < num) ? 1 : 0;
+        case -2:
+        case -1:
+        case SG_LIB_SYNTAX_ERROR:
+            return SG_LIB_CAT_OTHER;
+        case SG_LIB_CAT_NOT_READY:
+            return res;
+        default:
+            return 1;
+        }
+    }
+    t0 = lat_start(op);
+    while (((n = pread(op->idip->fd, bp, (size_t)num * op->ibs,
+                       lba * op->ibs)) < 0) && (EINTR == errno))
+        ++op->interrupted_retries;
+    lat_end(op, DDPT_PH_READ, t0);
+    if (n < 0) {
+        if ((EIO == errno) || (EREMOTEIO == errno))
+            return 1;
+        pr2serr("rescue: reading %s at block %" PRId64 ": %s\n",
+                op->idip->fn, lba, safe_strerror(errno));
+        return SG_LIB_FILE_ERROR;
+    }
+    *goodp = (int)(n / op->ibs);
+    if (n % op->ibs) {          /* short read at end of IFILE */
+        *partp = (int)(n % op->ibs);
+        return ((*goodp + 1) < num) ? 1 : 0;
+    }
+    return (*goodp < num) ? 1 : 0;
+}
+
+/* Writes num blocks read from IFILE block lba, followed by part bytes of
+ * a partial last block, to where they go in OFILE. A pt OFILE only takes
+ * the partial block padded with zeros when oflag=pad is given. Returns 0 on
+ * success. */
+static int
+rs_write_blks(struct opts_t * op, struct rs_ctl_t * rsp, int64_t lba,
+              int num, int part, unsigned char * bp)
+{
+    int res;
+    int64_t to = rsp->seek0 + (lba - rsp->skip0);
+    int64_t t0;
+    ssize_t n;
+    size_t len = ((size_t)num * op->obs) + part;
+    size_t off;
+
+    if (op->oflagp->nowrite || (FT_DEV_NULL & op->odip->d_type))
+        n = 0;
+    else if (FT_PT & op->odip->d_type) {
+        if (part > 0) {
+            if (op->oflagp->pad) {
+                memset(bp + len, 0, op->obs - part);
+                ++num;
+            } else
+                pr2serr(">>> ignore partial write of %d bytes to pt "
+                        "device\n", part);
+            part = 0;
+        }
+        if ((num > 0) && (res = pt_write(op, bp, num, to))) {
+            pr2serr("rescue: writing %s at block %" PRId64 " failed\n",
+                    op->odip->fn, to);
+            return res;
+        }
+    } else {
+        t0 = lat_start(op);
+        for (off = 0; off < len; off += n) {
+            n = pwrite(op->odip->fd, bp + off, len - off,
+                       (to * op->obs) + off);
+            if ((n < 0) && (EINTR == errno)) {
+                ++op->interrupted_retries;
+                n = 0;
+            } else if (n <= 0) {
+                pr2serr("rescue: writing %s at block %" PRId64 ": %s\n",
+                        op->odip->fn, to,
+                        (n < 0) ? safe_strerror(errno) : "short write");
+                lat_end(op, DDPT_PH_WRITE, t0);
+                return ((n < 0) && (ENOSPC != errno)) ?
+                       SG_LIB_CAT_MEDIUM_HARD : SG_LIB_FILE_ERROR;
+            }
+        }
+        lat_end(op, DDPT_PH_WRITE, t0);
+    }
+    op->out_full += num;
+    if (part > 0)
+        ++op->out_partial;
+    return 0;
+}
+
+/* Reads num blocks at lba and writes the good ones, marking them done in
+ * the map and the rest (if there was a read error) with status bad_st.
+ * Returns 0 if all were copied, 1 after a read error, else an error. */
+static int
+rs_copy_blks(struct opts_t * op, struct rs_ctl_t * rsp, int64_t lba,
+             int num, char bad_st)
+{
+    int res, res2, good, part;
+    unsigned char * bp = op->wrkPos;
+
+    signals_process_delay(op, DELAY_COPY_SEGMENT);
+    if (op->ratep)
+        rate_limit(op, (int64_t)num * op->ibs);
+    res = rs_read_blks(op, lba, num, bp, &good, &part);
+    if (res > 1)
+        return res;
+    if ((good > 0) || (part > 0)) {
+        if ((res2 = rs_write_blks(op, rsp, lba, good, part, bp)))
+            return res2;
+        op->in_full += good;
+        if (part > 0) {
+            ++op->in_partial;
+            ++good;             /* partial last block is done too */
+        }
+        if ((res2 = rs_mark(rsp, lba, good, RS_DONE)))
+            return res2;
+        rsp->good += good;
+    }
+    if (res) {
+        if ((res2 = rs_mark(rsp, lba + good, num - good, bad_st)))
+            return res2;
+        if (RS_BAD == bad_st) {
+            rsp->bad += num - good;
+            op->unrecovered_errs += num - good;
+            if ((op->highest_unrecovered < 0) ||
+                ((lba + good) < op->lowest_unrecovered))
+                op->lowest_unrecovered = lba + good;
+            if ((lba + num - 1) > op->highest_unrecovered)
+                op->highest_unrecovered = lba + num - 1;
+        }
+        if (op->verbose)
+            pr2serr("rescue: read error in %d blocks at %" PRId64 "\n",
+                    num - good, lba + good);
+    }
+    if ((res2 = rs_checkpoint(op, rsp)))
+        return res2;
+    return res;
+}
+
+/* Copy and retry passes: reads the untried extents BPT blocks at a time.
+ * In the copy pass a read error makes the next step blocks be skipped
+ * (left untried), step starting at BPT and doubling with each error in a
+ * row up to DDPT_RS_MAX_SKIP_BYTES, so the readable data comes first. */
+static int
+rs_pass_copy(struct opts_t * op, struct rs_ctl_t * rsp, bool skipping)
+{
+    int k, num, res;
+    int64_t pos, e_end, step, max_step;
+
+    step = op->bpt_i;
+    max_step = DDPT_RS_MAX_SKIP_BYTES / op->ibs;
+    if (max_step < step)
+        max_step = step;
+    for (pos = rsp->skip0; pos < rsp->end; ) {
+        k = rs_find(rsp, pos);
+        e_end = rsp->ext[k].lba + rsp->ext[k].num;
+        if (RS_UNTRIED != rsp->ext[k].st) {
+            pos = e_end;
+            continue;
+        }
+        num = ((e_end - pos) < op->bpt_i) ? (int)(e_end - pos) : op->bpt_i;
+        res = rs_copy_blks(op, rsp, pos, num, RS_UNTRIMMED);
+        if (res > 1)
+            return res;
+        pos += num;
+        if (0 == res)
+            step = op->bpt_i;
+        else if (skipping) {
+            if (op->verbose > 1)
+                pr2serr("rescue: skip %" PRId64 " blocks\n", step);
+            pos += step;
+            step = ((2 * step) < max_step) ? (2 * step) : max_step;
+        }
+    }
+    return 0;
+}
+
+/* Trim pass: reads single blocks forward from the start of each untrimmed
+ * extent and backward from its end, each way until one fails. The bad
+ * block found each way is marked as such and what lies between is left
+ * for the scrape pass. */
+static int
+rs_pass_trim(struct opts_t * op, struct rs_ctl_t * rsp)
+{
+    int k, res;
+    int64_t pos, lo, hi;
+
+    for (pos = rsp->skip0; pos < rsp->end; ) {
+        k = rs_find(rsp, pos);
+        lo = pos;
+        hi = rsp->ext[k].lba + rsp->ext[k].num;     /* one past the end */
+        pos = hi;
+        if (RS_UNTRIMMED != rsp->ext[k].st)
+            continue;
+        for (res = 0; (0 == res) && (lo < hi); ++lo)
+            if ((res = rs_copy_blks(op, rsp, lo, 1, RS_BAD)) > 1)
+                return res;
+        for (res = 0; (0 == res) && (lo < hi); --hi)
+            if ((res = rs_copy_blks(op, rsp, hi - 1, 1, RS_BAD)) > 1)
+                return res;
+        if (lo < hi) {
+            if ((res = rs_mark(rsp, lo, hi - lo, RS_UNSCRAPED)))
+                return res;
+        }
+    }
+    return 0;
+}
+
+/* Scrape pass: reads every block of the unscraped extents one at a time */
+static int
+rs_pass_scrape(struct opts_t * op, struct rs_ctl_t * rsp)
+{
+    int k, res;
+    int64_t pos, e_end;
+
+    for (pos = rsp->skip0; pos < rsp->end; ) {
+        k = rs_find(rsp, pos);
+        e_end = rsp->ext[k].lba + rsp->ext[k].num;
+        if (RS_UNSCRAPED != rsp->ext[k].st) {
+            pos = e_end;
+            continue;
+        }
+        if ((res = rs_copy_blks(op, rsp, pos, 1, RS_BAD)) > 1)
+            return res;
+        ++pos;
+    }
+    return 0;
+}
+
+/* Blocks in the map with status st */
+static int64_t
+rs_count(const struct rs_ctl_t * rsp, char st)
+{
+    int k;
+    int64_t n = 0;
+
+    for (k = 0; k < rsp->n; ++k) {
+        if (st == rsp->ext[k].st)
+            n += rsp->ext[k].num;
+    }
+    return n;
+}
+
+/* Called once the count is known and the files are open. Checks that
+ * rescue= can be used with them and loads MAP. Returns 0 on success. */
+int
+rs_start(struct opts_t * op)
+{
+    struct rs_ctl_t * rsp = op->rsp;
+    const char * cp = NULL;
+
+    if (op->reading_fifo ||
+        (! ((FT_PT | FT_BLOCK | FT_REG) & op->idip->d_type)))
+        cp = "IFILE must be pt, block device or regular file";
+    else if (! ((FT_PT | FT_BLOCK | FT_REG | FT_DEV_NULL) &
+                op->odip->d_type))
+        cp = "OFILE must be pt, block device, regular file or /dev/null";
+    else if (op->dd_count <= 0)
+        cp = "needs a known count";
+    else if (op->ibs != op->obs)
+        cp = "needs IBS and OBS to be equal";
+    else if (op->rdprotect || op->wrprotect)
+        cp = "can't be used with protect=";
+    else if ((op->num_threads > 1) || (op->num_bufs > 1))
+        cp = "can't be used with thr= or bufs=";
+    else if ((op->in_sgl_elems > 1) || (op->o2dip->fd >= 0))
+        cp = "can't be used with skip= and seek= lists or of2=";
+    if (cp) {
+        pr2serr("rescue=: %s\n", cp);
+        return SG_LIB_SYNTAX_ERROR;
+    }
+    if (op->hashp) {
+        pr2serr("rescue=: hash= ignored as IFILE isn't read in order\n");
+        hash_free(op);
+    }
+    if (op->iflagp->coe || op->oflagp->sparse || op->oflagp->sparing) {
+        if (op->verbose)
+            pr2serr("rescue=: coe, sparse and sparing flags ignored\n");
+        op->iflagp->coe = false;
+        op->oflagp->coe = false;
+    }
+    rsp->skip0 = op->skip;
+    rsp->seek0 = op->seek;
+    rsp->end = op->skip + op->dd_count;
+    return rs_read(op, rsp);
+}
+
+/* The copy for rescue=: runs the copy, retry, trim and scrape passes over
+ * the map then saves it. Blocks that can't be read aren't written. On
+ * return dd_count is 0 once every pass is done; returns 0 if no blocks
+ * are bad, SG_LIB_CAT_MEDIUM_HARD if some are, else an error. */
+int
+do_rescue(struct opts_t * op)
+{
+    int k, res;
+    int ret = 0;
+    int64_t bad;
+    struct rs_ctl_t * rsp = op->rsp;
+
+    rsp->last_us = mono_time_us();
+    if (op->verbose)
+        pr2serr("rescue: %s: %" PRId64 " blocks to read, %" PRId64 " done "
+                "before\n", rsp->fn, rsp->end - rsp->skip0 -
+                rs_count(rsp, RS_DONE) - rs_count(rsp, RS_BAD),
+                rs_count(rsp, RS_DONE));
+    for (k = RS_PASS_COPY; k <= RS_PASS_SCRAPE; ++k) {
+        if (op->verbose)
+            pr2serr("rescue: %s pass\n", rs_pass_s[k]);
+        switch (k) {
+        case RS_PASS_COPY:
+            ret = rs_pass_copy(op, rsp, true);
+            break;
+        case RS_PASS_RETRY:
+            ret = rs_pass_copy(op, rsp, false);
+            break;
+        case RS_PASS_TRIM:
+            ret = rs_pass_trim(op, rsp);
+            break;
+        default:
+            ret = rs_pass_scrape(op, rsp);
+            break;
+        }
+        if (ret)
+            break;
+    }
+    res = rs_write(op, rsp);
+    if (0 == ret)
+        ret = res;
+    bad = rs_count(rsp, RS_BAD);
+    if (0 == ret) {
+        op->dd_count = 0;
+        if (bad > 0)
+            ret = SG_LIB_CAT_MEDIUM_HARD;
+    }
+    if (! op->status_none)
+        pr2serr("rescue: %" PRId64 " blocks copied now, %" PRId64 " in all; "
+                "%" PRId64 " bad, %" PRId64 " left to read\n", rsp->good,
+                rs_count(rsp, RS_DONE), bad, rsp->end - rsp->skip0 -
+                rs_count(rsp, RS_DONE) - bad);
+    return ret;
+}
@@ -0,0 +1,594 @@
+/*
+ * Copyright (c) 2026 Douglas Gilbert.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ */
+
+/*
+ * This file contains the Linux io_uring backend used by ddpt for block
+ * devices and regular files when iflag=uring and/or oflag=uring is given.
+ * The io_uring system calls are invoked directly (i.e. liburing is not
+ * needed). Each copy segment is split into up to QD (see qd=QD) chunks
+ * which are submitted with a single io_uring_enter() call and reaped
+ * together.
+ */
+
+/* Need _GNU_SOURCE for O_DIRECT */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#define __STDC_FORMAT_MACROS 1
+#include <inttypes.h>
+
+/* N.B. config.h must precede anything that depends on HAVE_*  */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "ddpt.h"       /* includes <signal.h> */
+
+#ifdef DDPT_HAVE_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "sg_lib.h"
+#include "sg_pr2serr.h"
+
+#define URING_MIN_CHUNK (32 * 1024)     /* don't split segments finer */
+#define URING_MAX_FBUFS 2               /* registered (fixed) buffers */
+#define URING_CANCEL_TAG (1ULL << 63)   /* user_data of cancel requests */
+#define URING_DRAIN_TRIES 100           /* EAGAIN/EBUSY while draining */
+
+struct uring_chunk_t {
+    bool done;          /* completion reaped (or chunk never submitted) */
+    int len;
+    int res;
+    int64_t off;
+    unsigned char * bp;
+};
+
+struct ddpt_uring_t {
+    bool sqpoll;        /* kernel thread polls submission queue */
+    bool broken;        /* chunks may be in flight after a failed drain */
+    int ring_fd;
+    unsigned int sq_entries;
+    int nfbufs;         /* number of registered buffers */
+    int fd[2];          /* indexed by DDPT_ARG_IN and DDPT_ARG_OUT */
+    int fidx[2];        /* registered file index, -1 if not registered */
+    unsigned int * sq_head;
+    unsigned int * sq_tail;
+    unsigned int * sq_mask;
+    unsigned int * sq_flags;
+    unsigned int * sq_array;
+    unsigned int * cq_head;
+    unsigned int * cq_tail;
+    unsigned int * cq_mask;
+    struct io_uring_sqe * sqes;
+    struct io_uring_cqe * cqes;
+    void * sq_ring;
+    size_t sq_ring_sz;
+    void * cq_ring;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+    struct iovec fbufs[URING_MAX_FBUFS];
+    struct iovec * iovs;                /* one per chunk, for READV */
+    struct uring_chunk_t * chunks;
+};
+
+
+static int
+uring_setup(unsigned int entries, struct io_uring_params * p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete,
+            unsigned int flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                        min_complete, flags, NULL, 0);
+}
+
+static int
+uring_register(int ring_fd, unsigned int opcode, void * arg,
+               unsigned int nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg,
+                        nr_args);
+}
+
+static void
+uring_unmap(struct ddpt_uring_t * urp)
+{
+    if (urp->sqes && (MAP_FAILED != (void *)urp->sqes))
+        munmap(urp->sqes, urp->sqes_sz);
+    if (urp->cq_ring && (MAP_FAILED != urp->cq_ring) &&
+        (urp->cq_ring != urp->sq_ring))
+        munmap(urp->cq_ring, urp->cq_ring_sz);
+    if (urp->sq_ring && (MAP_FAILED != urp->sq_ring))
+        munmap(urp->sq_ring, urp->sq_ring_sz);
+}
+
+/* Maps the submission and completion rings plus the sqe array. Returns 0
+ * on success, else an errno value. */
+static int
+uring_map(struct ddpt_uring_t * urp, const struct io_uring_params * p)
+{
+    unsigned char * sqp;
+    unsigned char * cqp;
+
+    urp->sq_ring_sz = p->sq_off.array + (p->sq_entries * sizeof(unsigned));
+    urp->cq_ring_sz = p->cq_off.cqes +
+                      (p->cq_entries * sizeof(struct io_uring_cqe));
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (urp->cq_ring_sz > urp->sq_ring_sz)
+            urp->sq_ring_sz = urp->cq_ring_sz;
+    }
+    urp->sq_ring = mmap(NULL, urp->sq_ring_sz, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                        IORING_OFF_SQ_RING);
+    if (MAP_FAILED == urp->sq_ring)
+        return errno;
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+        urp->cq_ring = urp->sq_ring;
+    else {
+        urp->cq_ring = mmap(NULL, urp->cq_ring_sz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, urp->ring_fd,
+                            IORING_OFF_CQ_RING);
+        if (MAP_FAILED == urp->cq_ring)
+            return errno;
+    }
+    urp->sqes_sz = p->sq_entries * sizeof(struct io_uring_sqe);
+    urp->sqes = (struct io_uring_sqe *)mmap(NULL, urp->sqes_sz,
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE,
+                                            urp->ring_fd, IORING_OFF_SQES);
+    if (MAP_FAILED == (void *)urp->sqes)
+        return errno;
+    sqp = (unsigned char *)urp->sq_ring;
+    cqp = (unsigned char *)urp->cq_ring;
+    urp->sq_head = (unsigned int *)(sqp + p->sq_off.head);
+    urp->sq_tail = (unsigned int *)(sqp + p->sq_off.tail);
+    urp->sq_mask = (unsigned int *)(sqp + p->sq_off.ring_mask);
+    urp->sq_flags = (unsigned int *)(sqp + p->sq_off.flags);
+    urp->sq_array = (unsigned int *)(sqp + p->sq_off.array);
+    urp->cq_head = (unsigned int *)(cqp + p->cq_off.head);
+    urp->cq_tail = (unsigned int *)(cqp + p->cq_off.tail);
+    urp->cq_mask = (unsigned int *)(cqp + p->cq_off.ring_mask);
+    urp->cqes = (struct io_uring_cqe *)(cqp + p->cq_off.cqes);
+    return 0;
+}
+
+/* Releases the io_uring instance (if any) associated with op. */
+void
+uring_fini(struct opts_t * op)
+{
+    struct ddpt_uring_t * urp = op->urp;
+
+    if (NULL == urp)
+        return;
+    uring_unmap(urp);
+    if (urp->ring_fd >= 0)
+        close(urp->ring_fd);
+    if (urp->iovs)
+        free(urp->iovs);
+    if (urp->chunks)
+        free(urp->chunks);
+    free(urp);
+    op->urp = NULL;
+}
+
+/* Sets up an io_uring instance with op->queue_depth entries for IFILE
+ * and/or OFILE, as selected by iflag=uring and oflag=uring. The working
+ * buffers bp (and bp2 if non-NULL) of blen bytes are registered as fixed
+ * buffers and the file descriptors are registered as fixed files. Failure
+ * to register is not fatal. Returns 0 on success; on failure op->urp is
+ * left NULL and the caller falls back to read() and write(). */
+int
+uring_init(struct opts_t * op, unsigned char * bp, unsigned char * bp2,
+           int blen)
+{
+    int k, n, res, err;
+    int reg_fds[2];
+    struct ddpt_uring_t * urp;
+    struct io_uring_params params;
+
+    op->urp = NULL;
+    urp = (struct ddpt_uring_t *)calloc(1, sizeof(struct ddpt_uring_t));
+    if (NULL == urp) {
+        pr2serr("%s: calloc failed\n", __func__);
+        return SG_LIB_CAT_OTHER;
+    }
+    urp->ring_fd = -1;
+    urp->fd[DDPT_ARG_IN] = op->iflagp->uring ? op->idip->fd : -1;
+    urp->fd[DDPT_ARG_OUT] = op->oflagp->uring ? op->odip->fd : -1;
+    urp->fidx[DDPT_ARG_IN] = -1;
+    urp->fidx[DDPT_ARG_OUT] = -1;
+    urp->sqpoll = (op->iflagp->sqpoll || op->oflagp->sqpoll);
+
+    memset(&params, 0, sizeof(params));
+    if (urp->sqpoll) {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = 1000;   /* milliseconds */
+    }
+    urp->ring_fd = uring_setup(op->queue_depth, &params);
+    if ((urp->ring_fd < 0) && urp->sqpoll) {
+        err = errno;
+        pr2serr("io_uring with sqpoll: %s, try without\n",
+                safe_strerror(err));
+        urp->sqpoll = false;
+        memset(&params, 0, sizeof(params));
+        urp->ring_fd = uring_setup(op->queue_depth, &params);
+    }
+    if (urp->ring_fd < 0) {
+        err = errno;
+        pr2serr("io_uring_setup: %s, use read() and write() instead\n",
+                safe_strerror(err));
+        goto err_out;
+    }
+    if ((err = uring_map(urp, &params))) {
+        pr2serr("%s: mmap: %s\n", __func__, safe_strerror(err));
+        goto err_out;
+    }
+    urp->sq_entries = params.sq_entries;
+    urp->iovs = (struct iovec *)calloc(urp->sq_entries,
+                                       sizeof(struct iovec));
+    urp->chunks = (struct uring_chunk_t *)calloc(urp->sq_entries,
+                                                 sizeof(struct uring_chunk_t));
+    if ((NULL == urp->iovs) || (NULL == urp->chunks)) {
+        pr2serr("%s: calloc failed\n", __func__);
+        goto err_out;
+    }
+
+    /* fixed buffers save the kernel mapping user pages on each IO */
+    urp->fbufs[0].iov_base = bp;
+    urp->fbufs[0].iov_len = blen;
+    n = 1;
+    if (bp2) {
+        urp->fbufs[1].iov_base = bp2;
+        urp->fbufs[1].iov_len = blen;
+        ++n;
+    }
+    res = uring_register(urp->ring_fd, IORING_REGISTER_BUFFERS, urp->fbufs,
+                         n);
+    if (res < 0) {
+        if (op->verbose)
+            pr2serr("io_uring register buffers: %s, continue without\n",
+                    safe_strerror(errno));
+    } else
+        urp->nfbufs = n;
+
+    /* fixed files save an fget()/fput() per IO, needed by sqpoll on
+     * older kernels */
+    for (k = 0, n = 0; k < 2; ++k) {
+        if (urp->fd[k] >= 0)
+            reg_fds[n++] = urp->fd[k];
+    }
+    res = uring_register(urp->ring_fd, IORING_REGISTER_FILES, reg_fds, n);
+    if (res < 0) {
+        if (op->verbose)
+            pr2serr("io_uring register files: %s, continue without\n",
+                    safe_strerror(errno));
+    } else {
+        for (k = 0, n = 0; k < 2; ++k) {
+            if (urp->fd[k] >= 0)
+                urp->fidx[k] = n++;
+        }
+    }
+    if (op->verbose > 1)
+        pr2serr("io_uring: sq_entries=%u, fixed buffers=%d, fixed files=%s"
+                "%s\n", urp->sq_entries, urp->nfbufs,
+                (res < 0) ? "no" : "yes", urp->sqpoll ? ", sqpoll" : "");
+    op->urp = urp;
+    return 0;
+
+err_out:
+    op->urp = urp;
+    uring_fini(op);
+    return SG_LIB_CAT_OTHER;
+}
+
+/* Returns index of the registered buffer containing [bp, bp+len) or -1 */
+static int
+uring_fbuf_index(const struct ddpt_uring_t * urp, const unsigned char * bp,
+                 int len)
+{
+    int k;
+    const unsigned char * fbp;
+
+    for (k = 0; k < urp->nfbufs; ++k) {
+        fbp = (const unsigned char *)urp->fbufs[k].iov_base;
+        if ((bp >= fbp) &&
+            ((bp + len) <= (fbp + urp->fbufs[k].iov_len)))
+            return k;
+    }
+    return -1;
+}
+
+/* Completes a transfer synchronously from byte offset 'done', used after
+ * a short or failed chunk. Returns bytes transferred in total, or -1 (with
+ * errno set) if nothing was transferred. */
+static int
+uring_sync_finish(struct opts_t * op, int fd, bool wr, unsigned char * bp,
+                  int numbytes, int64_t offset, int done)
+{
+    int res;
+
+    while (done < numbytes) {
+        if (wr)
+            res = pwrite(fd, bp + done, numbytes - done, offset + done);
+        else
+            res = pread(fd, bp + done, numbytes - done, offset + done);
+        if (res < 0) {
+            if (EINTR == errno) {
+                ++op->interrupted_retries;
+                continue;
+            }
+            return (done > 0) ? done : -1;
+        } else if (0 == res)
+            break;      /* EOF on read */
+        done += res;
+    }
+    return done;
+}
+
+/* After io_uring_enter() fails part way through uring_rw(), takes back
+ * the n chunks' submission entries that the kernel has not consumed (not
+ * possible with sqpoll), asks for the rest to be cancelled and reaps until
+ * none is in flight, so the ring and buffer can be used again. Returns 0
+ * on success, -1 if chunks may still be in flight. */
+static int
+uring_drain(struct opts_t * op, struct ddpt_uring_t * urp, int n)
+{
+    int k, res, tries;
+    unsigned int tail, head, mask, to_submit, pending, flags;
+    struct io_uring_sqe * sqep;
+    struct io_uring_cqe * cqep;
+
+    tail = *urp->sq_tail;
+    mask = *urp->sq_mask;
+    if (! urp->sqpoll) {
+        head = __atomic_load_n(urp->sq_head, __ATOMIC_ACQUIRE);
+        k = n - (int)(tail - head);     /* our last entries not consumed */
+        for (k = (k < 0) ? 0 : k; k < n; ++k) {
+            urp->chunks[k].done = true;
+            urp->chunks[k].res = -ECANCELED;
+        }
+        tail = head;
+        __atomic_store_n(urp->sq_tail, tail, __ATOMIC_RELEASE);
+    }
+    for (k = 0, pending = 0, to_submit = 0; k < n; ++k) {
+        if (urp->chunks[k].done)
+            continue;
+        ++pending;
+        head = __atomic_load_n(urp->sq_head, __ATOMIC_ACQUIRE);
+        if ((tail - head) >= urp->sq_entries)
+            continue;   /* no room, wait for it to complete */
+        sqep = urp->sqes + (tail & mask);
+        memset(sqep, 0, sizeof(*sqep));
+        sqep->opcode = IORING_OP_ASYNC_CANCEL;
+        sqep->fd = -1;
+        sqep->addr = k;         /* user_data of the chunk to cancel */
+        sqep->user_data = URING_CANCEL_TAG | k;
+        urp->sq_array[tail & mask] = tail & mask;
+        ++tail;
+        ++to_submit;
+    }
+    __atomic_store_n(urp->sq_tail, tail, __ATOMIC_RELEASE);
+    if (urp->sqpoll)
+        to_submit = 0;
+    if (op->verbose > 1)
+        pr2serr("io_uring: cancel %u chunks in flight\n", pending);
+    for (tries = 0; pending > 0; ) {
+        flags = IORING_ENTER_GETEVENTS;
+        if (urp->sqpoll &&
+            (__atomic_load_n(urp->sq_flags, __ATOMIC_ACQUIRE) &
+             IORING_SQ_NEED_WAKEUP))
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        res = uring_enter(urp->ring_fd, to_submit, 1, flags);
+        if (res < 0) {
+            if (EINTR == errno) {
+                ++op->interrupted_retries;
+                continue;
+            }
+            if (((EAGAIN == errno) || (EBUSY == errno)) &&
+                (++tries < URING_DRAIN_TRIES))
+                continue;
+            return -1;
+        } else if (to_submit > 0)
+            to_submit = ((unsigned int)res >= to_submit) ? 0 :
+                        to_submit - res;
+        head = *urp->cq_head;
+        while (head != __atomic_load_n(urp->cq_tail, __ATOMIC_ACQUIRE)) {
+            cqep = urp->cqes + (head & *urp->cq_mask);
+            /* results of the cancel requests themselves are ignored */
+            if ((cqep->user_data < (uint64_t)n) &&
+                (! urp->chunks[cqep->user_data].done)) {
+                urp->chunks[cqep->user_data].done = true;
+                urp->chunks[cqep->user_data].res = cqep->res;
+                --pending;
+            }
+            ++head;
+        }
+        __atomic_store_n(urp->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/* Reads (wr false) or writes (wr true) numbytes at byte offset of the file
+ * selected by which_arg (DDPT_ARG_IN or DDPT_ARG_OUT) using io_uring. The
+ * transfer is split into chunks that are multiples of blk_sz bytes and
+ * all are in flight together. Like read() and write() returns the number
+ * of bytes transferred (which may be short at EOF) or -1 with errno set.
+ * The file position (i.e. lseek()) is not used or changed. */
+int
+uring_rw(struct opts_t * op, int which_arg, bool wr, unsigned char * bp,
+         int numbytes, int64_t offset, int blk_sz)
+{
+    bool fixed_file;
+    int k, n, res, chunk, min_chunk, off, fbi, done, err;
+    unsigned int tail, head, mask, to_submit, pending, flags;
+    struct ddpt_uring_t * urp = op->urp;
+    struct uring_chunk_t * ckp;
+    struct io_uring_sqe * sqep;
+    struct io_uring_cqe * cqep;
+
+    if (numbytes <= 0)
+        return 0;
+    if (urp->broken) {
+        errno = EIO;
+        return -1;
+    }
+    if (blk_sz <= 0)
+        blk_sz = 1;
+    min_chunk = ((URING_MIN_CHUNK + blk_sz - 1) / blk_sz) * blk_sz;
+    n = numbytes / min_chunk;
+    if (n < 1)
+        n = 1;
+    else if (n > (int)urp->sq_entries)
+        n = urp->sq_entries;
+    chunk = numbytes / n;
+    chunk = ((chunk + blk_sz - 1) / blk_sz) * blk_sz;
+    fixed_file = (urp->fidx[which_arg] >= 0);
+
+    /* fill submission queue entries, one per chunk */
+    tail = *urp->sq_tail;
+    mask = *urp->sq_mask;
+    for (k = 0, off = 0; off < numbytes; ++k, off += chunk) {
+        ckp = urp->chunks + k;
+        ckp->bp = bp + off;
+        ckp->off = offset + off;
+        ckp->len = ((numbytes - off) < chunk) ? (numbytes - off) : chunk;
+        ckp->res = 0;
+        ckp->done = false;
+        sqep = urp->sqes + (tail & mask);
+        memset(sqep, 0, sizeof(*sqep));
+        fbi = uring_fbuf_index(urp, ckp->bp, ckp->len);
+        if (fbi >= 0) {
+            sqep->opcode = wr ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqep->addr = (uint64_t)(uintptr_t)ckp->bp;
+            sqep->len = ckp->len;
+            sqep->buf_index = fbi;
+        } else {
+            urp->iovs[k].iov_base = ckp->bp;
+            urp->iovs[k].iov_len = ckp->len;
+            sqep->opcode = wr ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqep->addr = (uint64_t)(uintptr_t)(urp->iovs + k);
+            sqep->len = 1;
+        }
+        if (fixed_file) {
+            sqep->fd = urp->fidx[which_arg];
+            sqep->flags = IOSQE_FIXED_FILE;
+        } else
+            sqep->fd = urp->fd[which_arg];
+        sqep->off = ckp->off;
+        sqep->user_data = k;
+        urp->sq_array[tail & mask] = tail & mask;
+        ++tail;
+    }
+    n = k;
+    __atomic_store_n(urp->sq_tail, tail, __ATOMIC_RELEASE);
+
+    /* submit and wait for all chunks with as few syscalls as possible */
+    to_submit = urp->sqpoll ? 0 : n;
+    pending = n;
+    while (pending > 0) {
+        flags = IORING_ENTER_GETEVENTS;
+        if (urp->sqpoll &&
+            (__atomic_load_n(urp->sq_flags, __ATOMIC_ACQUIRE) &
+             IORING_SQ_NEED_WAKEUP))
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        res = uring_enter(urp->ring_fd, to_submit, pending, flags);
+        if (res < 0) {
+            if ((EINTR == errno) || (EAGAIN == errno) || (EBUSY == errno)) {
+                if (EINTR == errno)
+                    ++op->interrupted_retries;
+                else
+                    ++op->io_eagains;
+            } else {
+                err = errno;
+                pr2serr("io_uring_enter: %s\n", safe_strerror(err));
+                if (uring_drain(op, urp, n)) {
+                    /* chunks may still be in flight into bp, so neither
+                     * the ring nor the buffer can be used again; the ring
+                     * is released by uring_fini() when the copy ends */
+                    pr2serr("io_uring: could not reap all chunks\n");
+                    urp->broken = true;
+                }
+                errno = err;
+                return -1;
+            }
+        } else if (to_submit > 0)
+            to_submit = ((unsigned int)res >= to_submit) ? 0 :
+                        to_submit - res;
+        head = *urp->cq_head;
+        while (head != __atomic_load_n(urp->cq_tail, __ATOMIC_ACQUIRE)) {
+            cqep = urp->cqes + (head & *urp->cq_mask);
+            if ((cqep->user_data < (uint64_t)n) &&
+                (! urp->chunks[cqep->user_data].done)) {
+                urp->chunks[cqep->user_data].done = true;
+                urp->chunks[cqep->user_data].res = cqep->res;
+                --pending;
+            }
+            ++head;
+        }
+        __atomic_store_n(urp->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    /* count contiguous bytes from the start, tidy up any short chunk */
+    for (k = 0, done = 0; k < n; ++k) {
+        ckp = urp->chunks + k;
+        if (ckp->res == ckp->len) {
+            done += ckp->len;
+            continue;
+        }
+        if (op->verbose > 2)
+            pr2serr("io_uring %s: chunk at offset=%" PRId64 " len=%d: "
+                    "res=%d\n", wr ? "write" : "read", ckp->off, ckp->len,
+                    ckp->res);
+        if (ckp->res < 0) {
+            errno = -ckp->res;
+            if (EAGAIN == errno)
+                ++op->io_eagains;
+        }
+        return uring_sync_finish(op, urp->fd[which_arg], wr, bp, numbytes,
+                                 offset, done);
+    }
+    return done;
+}
+
+#endif  /* DDPT_HAVE_URING */
@@ -859,9 +859,19 @@ do_xcopy_lid1(struct opts_t * op)
         op->seek += oblocks;
         op->num_xcopy++;
         op->dd_count -= blocks;
+        if (op->jrnlp && jrnl_due(op) &&
+            (res = jrnl_checkpoint(op, op->skip - op->jrnl_skip0, false)))
+            break;
         if (op->dd_count > 0)
             signals_process_delay(op, DELAY_COPY_SEGMENT);
     }
+    if (op->jrnlp) {
+        int r = jrnl_checkpoint(op, op->skip - op->jrnl_skip0,
+                                (0 == res) && (0 == op->dd_count));
+
+        if (0 == res)
+            res = r;
+    }
     return res;
 }
 
@@ -1325,6 +1335,7 @@ get_3pc_vpd_blkdev_lims(struct opts_t * op, struct dev_info_t * dip)
 {
     bool found = false;
     int res, verb, n, len, bump, desc_type, desc_len, k;
+    uint32_t u;
     uint32_t max_ito = 0;
     unsigned char * rp;
     unsigned char * bp;
@@ -1374,6 +1385,17 @@ get_3pc_vpd_blkdev_lims(struct opts_t * op, struct dev_info_t * dip)
             dip->odxp->max_tok_xfer_size = sg_get_unaligned_be64(bp + 20);
             dip->odxp->optimal_xfer_count = sg_get_unaligned_be64(bp + 28);
             break;
+        case 0x8001:    /* General Copy Operations */
+            if (desc_len < 8)
+                break;
+            /* prefer Maximum Identified Concurrent Copies (we set list_id)
+             * unless Total Concurrent Copies is smaller */
+            dip->odxp->max_conc_copies = sg_get_unaligned_be32(bp + 8);
+            u = sg_get_unaligned_be32(bp + 4);
+            if ((u > 0) && ((0 == dip->odxp->max_conc_copies) ||
+                            (u < dip->odxp->max_conc_copies)))
+                dip->odxp->max_conc_copies = u;
+            break;
         default:
             break;
         }
@@ -1726,12 +1748,97 @@ do_rcs(struct opts_t * op, bool in0_out1, struct rrti_resp_t * rrp, int verb)
     return 0;
 }
 
+/* Prepares *pp for polling a command (just sent with IMMED) that should
+ * transfer want blocks (0 if not known). */
+void
+odx_poll_init(struct odx_poll_t * pp, uint64_t want)
+{
+    memset(pp, 0, sizeof(*pp));
+    pp->backoff = ODX_POLL_MIN_MS;
+    pp->want = want;
+}
+
+/* Called after a poll that found the command still in progress, returns
+ * the delay (ms) before the next poll. Uses the remaining time suggested
+ * by the advance of the transfer count when that is known, then the copy
+ * manager's estimated status update delay, else an exponential backoff
+ * from ODX_POLL_MIN_MS up to DEF_ODX_POLL_DELAY_MS. */
+uint32_t
+odx_poll_next(struct opts_t * op, struct odx_poll_t * pp,
+              const struct rrti_resp_t * rrp)
+{
+    bool advanced = false;
+    uint32_t delay = 0;
+    uint32_t esu = rrp->esu_del;
+    double d;
+
+    ++op->odx_polls;
+    if ((pp->waited > 0) && (rrp->tc > pp->last_tc)) {
+        pp->ms_per_blk = (double)pp->waited / (rrp->tc - pp->last_tc);
+        advanced = true;
+    }
+    pp->last_tc = rrp->tc;
+    pp->waited = 0;
+    if ((pp->ms_per_blk > 0.0) && (pp->want > rrp->tc)) {
+        d = (pp->want - rrp->tc) * pp->ms_per_blk;
+        delay = (d < (double)DEF_ODX_POLL_DELAY_MS) ? (uint32_t)d + 1 :
+                                                      DEF_ODX_POLL_DELAY_MS;
+    }
+    if ((esu > 0) && (esu < 0xfffffffe) && ((0 == delay) || (esu < delay)))
+        delay = esu;
+    if (0 == delay) {
+        delay = pp->backoff;
+        if ((! advanced) && (pp->backoff < DEF_ODX_POLL_DELAY_MS)) {
+            pp->backoff *= 2;
+            if (pp->backoff > DEF_ODX_POLL_DELAY_MS)
+                pp->backoff = DEF_ODX_POLL_DELAY_MS;
+        }
+    }
+    if (delay < ODX_POLL_MIN_MS)
+        delay = ODX_POLL_MIN_MS;
+    return delay;
+}
+
+/* Sleeps delay ms on behalf of *pp (when not NULL) and counts it. */
+void
+odx_poll_sleep(struct opts_t * op, struct odx_poll_t * pp, uint32_t delay)
+{
+    if (0 == delay)
+        return;
+    sleep_ms(delay);
+    op->odx_poll_wait_ms += delay;
+    if (pp)
+        pp->waited += delay;
+}
+
+/* Called after the poll that found the command finished. Estimates how
+ * much of the last wait came after completion: all of it unless the
+ * transfer rate is known. */
+void
+odx_poll_done(struct opts_t * op, struct odx_poll_t * pp,
+              const struct rrti_resp_t * rrp)
+{
+    double d;
+
+    if (0 == pp->waited)
+        return;
+    if ((pp->ms_per_blk > 0.0) && (rrp->tc > pp->last_tc)) {
+        d = pp->waited - ((rrp->tc - pp->last_tc) * pp->ms_per_blk);
+        if (d > 0.0)
+            op->odx_poll_idle_ms += (int64_t)d;
+    } else
+        op->odx_poll_idle_ms += pp->waited;
+    pp->waited = 0;
+}
+
 int
-process_after_poptok(struct opts_t * op, uint64_t * tcp, int vb_a)
+process_after_poptok(struct opts_t * op, uint64_t * tcp, uint64_t want_blks,
+                     int vb_a)
 {
     int res, len, vb_b, err, cont;
     uint32_t delay;
     uint64_t rod_sz;
+    struct odx_poll_t poll;
     struct rrti_resp_t r;
     char b[400];
     unsigned char uc[8];
@@ -1740,6 +1847,7 @@ process_after_poptok(struct opts_t * op, uint64_t * tcp, int vb_a)
         vb_b = op->verbose;
     else
         vb_b = (vb_a > 0) ? (vb_a - 1) : 0;
+    odx_poll_init(&poll, want_blks);
     do {
         res = do_rrti(op, DDPT_ARG_IN, &r, vb_b);
         if (res)
@@ -1752,19 +1860,13 @@ process_after_poptok(struct opts_t * op, uint64_t * tcp, int vb_a)
         }
         cont = ((r.cstat >= 0x10) && (r.cstat <= 0x12));
         if (cont) {
-            delay = r.esu_del;
-            if ((delay < 0xfffffffe) && (delay > 0)) {
-                if (vb_b > 1)
-                    pr2serr("[%d] using copy manager recommended delay of %"
-                            PRIu32 " milliseconds\n", rrti_num, delay);
-            } else {
-                delay = DEF_ODX_POLL_DELAY_MS;
-                if (vb_b > 1)
-                    pr2serr("[%d] using default for poll delay\n", rrti_num);
-            }
-            if (delay)
-                sleep_ms(delay);
-        }
+            delay = odx_poll_next(op, &poll, &r);
+            if (vb_b > 1)
+                pr2serr("[%d] poll again in %" PRIu32 " milliseconds\n",
+                        rrti_num, delay);
+            odx_poll_sleep(op, &poll, delay);
+        } else
+            odx_poll_done(op, &poll, &r);
     } while (cont);
     if ((! ((0x1 == r.cstat) || (0x3 == r.cstat))) || (vb_b > 1))
         pr2serr("RRTI [%d] after PT: %s\n", rrti_num,
@@ -1954,7 +2056,7 @@ do_wut(struct opts_t * op, unsigned char * tokp, uint64_t blk_off,
 
 int
 process_after_wut(struct opts_t * op, uint64_t * tcp /* transfer count */,
-                  int vb_a)
+                  uint64_t want_blks, int vb_a)
 {
     bool changed_pref = false;
     bool cont;
@@ -1964,11 +2066,13 @@ process_after_wut(struct opts_t * op, uint64_t * tcp /* transfer count */,
     const char * cmd_name;
     char b[80];
     struct rrti_resp_t r;
+    struct odx_poll_t poll;
 
     if (op->verbose == vb_a)
         vb_b = op->verbose;
     else
         vb_b = (vb_a > 0) ? (vb_a - 1) : 0;
+    odx_poll_init(&poll, want_blks);
     do {
 resend_cmd:
         if (prefer_rcs) {
@@ -1996,19 +2100,12 @@ resend_cmd:
         }
         cont = ((r.cstat >= 0x10) && (r.cstat <= 0x12));
         if (cont) {
-            delay = r.esu_del;
-            if ((delay < 0xfffffffe) && (delay > 0)) {
-                if (vb_b > 1)
-                    pr2serr("using copy manager recommended delay of %"
-                            PRIu32 " milliseconds\n", delay);
-            } else {
-                delay = DEF_ODX_POLL_DELAY_MS;
-                if (vb_b > 1)
-                    pr2serr("using default for poll delay\n");
-            }
-            if (delay)
-                sleep_ms(delay);
-        }
+            delay = odx_poll_next(op, &poll, &r);
+            if (vb_b > 1)
+                pr2serr("poll again in %" PRIu32 " milliseconds\n", delay);
+            odx_poll_sleep(op, &poll, delay);
+        } else
+            odx_poll_done(op, &poll, &r);
     } while (cont);
 
     if ((! ((0x1 == r.cstat) || (0x3 == r.cstat))) || (vb_b > 1))
@@ -2161,7 +2258,7 @@ odx_full_zero_copy(struct opts_t * op)
         if ((res = do_wut(op, local_rod_token, out_blk_off, num, 0, 0,
                           ! op->list_id_given, vb3)))
             return res;
-        if ((res = process_after_wut(op, &tc, vb3)))
+        if ((res = process_after_wut(op, &tc, num, vb3)))
             return res;
         if (tc != num) {
             pr2serr("%s: number requested differs from transfer count\n",
@@ -2248,7 +2345,7 @@ odx_read_into_rods(struct opts_t * op)
 
         if ((res = do_pop_tok(op, in_blk_off, num, ! op->list_id_given, vb3)))
             return res;
-        if ((res = process_after_poptok(op, &tc_i, vb3)))
+        if ((res = process_after_poptok(op, &tc_i, num, vb3)))
             return res;
         if (tc_i != num) {
             pr2serr("%s: number requested (in) differs from transfer "
@@ -2394,7 +2491,7 @@ odx_write_from_rods(struct opts_t * op)
                          (r_o_num < o_num), ! op->list_id_given, vb3);
             if (res)
                 return res;
-            if ((res = process_after_wut(op, &tc_o, vb3)))
+            if ((res = process_after_wut(op, &tc_o, r_o_num, vb3)))
                 return res;
             if (tc_o != r_o_num) {
                 pr2serr("%s: number requested (out) differs from transfer "
@@ -2409,6 +2506,315 @@ odx_write_from_rods(struct opts_t * op)
     return 0;
 }
 
+/* Works out the size of the next odx_full_copy() segment: *nump blocks
+ * from IFILE (at in_blk_off blocks past skip) that give *o_nump blocks on
+ * OFILE. Returns 0 if okay, -1 when only trailing blocks that cannot be
+ * copied remain, else an SG_LIB_* error. */
+static int
+odx_seg_nums(struct opts_t * op, int64_t in_num_blks, int in_num_elems,
+             uint64_t in_blk_off, int in_mult, int out_mult, uint64_t * nump,
+             uint64_t * o_nump)
+{
+    uint64_t num, o_num;
+    struct dev_info_t * idip = op->idip;
+
+    num = in_num_blks;
+    if (op->bpt_given && ((uint64_t)op->bpt_i < num))
+        num = op->bpt_i;
+    if ((idip->odxp->max_tok_xfer_size > 0) &&
+        (num > idip->odxp->max_tok_xfer_size))
+        num = idip->odxp->max_tok_xfer_size;
+    if (op->in_sgl)
+        num = count_restricted_sgl_blocks(op->in_sgl, in_num_elems,
+                                          in_blk_off, num,
+                                          idip->odxp->max_range_desc);
+    if (in_mult) {
+        o_num = num / in_mult;
+        num = o_num * in_mult;
+        if (0 == num) {
+            if (in_num_blks < in_mult) {
+                pr2serr("%s: unable to copy trailing blocks due to "
+                        "block size mismatch\n", __func__);
+                return -1;
+            } else {
+                pr2serr("%s: block size mismatch problem, perhaps "
+                        "BPT value too small\n", __func__);
+                return SG_LIB_SYNTAX_ERROR;
+            }
+        }
+    } else if (out_mult)        /* out_mult must be >= 2 */
+        o_num = num * out_mult;
+    else
+        o_num = num;
+    *nump = num;
+    *o_nump = o_num;
+    return 0;
+}
+
+/* Number of blocks (of the o_num remaining from a ROD) the next WRITE USING
+ * TOKEN should write at out_blk_off. */
+static uint64_t
+odx_wut_num(struct opts_t * op, uint64_t o_num, int out_num_elems,
+            uint64_t out_blk_off)
+{
+    uint64_t r_o_num = o_num;
+    struct dev_info_t * odip = op->odip;
+
+    if ((op->obpch > 0) && ((uint64_t)op->obpch < r_o_num))
+        r_o_num = op->obpch;
+    if ((odip->odxp->max_tok_xfer_size > 0) &&
+        (r_o_num > odip->odxp->max_tok_xfer_size))
+        r_o_num = odip->odxp->max_tok_xfer_size;
+    if (op->out_sgl)
+        r_o_num = count_restricted_sgl_blocks(op->out_sgl, out_num_elems,
+                                              out_blk_off, r_o_num,
+                                              odip->odxp->max_range_desc);
+    return r_o_num;
+}
+
+#define ODX_SEG_IDLE 0
+#define ODX_SEG_PT 1    /* POPULATE TOKEN in progress */
+#define ODX_SEG_WUT 2   /* WRITE USING TOKEN in progress */
+
+/* One offloaded segment of odx_full_copy_par(), has its own list_id */
+struct odx_seg_t {
+    int state;                  /* ODX_SEG_* */
+    uint32_t list_id;
+    uint64_t in_blk_off;        /* of PT, journal= counts up to here */
+    uint64_t num;               /* blocks from IFILE */
+    uint64_t out_blk_off;       /* of next WUT */
+    uint64_t o_num;             /* blocks still to write from ROD */
+    uint64_t oir;               /* offset in ROD of next WUT */
+    uint64_t r_o_num;           /* blocks in WUT in progress */
+    uint32_t due;               /* ms until this segment is polled */
+    struct odx_poll_t poll;
+    unsigned char tok[512];
+};
+
+/* Sends the next WRITE USING TOKEN for the segment at sp. */
+static int
+odx_seg_wut(struct opts_t * op, struct odx_seg_t * sp, int out_num_elems,
+            int vb_a)
+{
+    sp->r_o_num = odx_wut_num(op, sp->o_num, out_num_elems, sp->out_blk_off);
+    op->list_id = sp->list_id;
+    sp->state = ODX_SEG_WUT;
+    sp->due = 0;
+    odx_poll_init(&sp->poll, sp->r_o_num);
+    return do_wut(op, sp->tok, sp->out_blk_off, sp->r_o_num, sp->oir,
+                  (sp->r_o_num < sp->o_num), false, vb_a);
+}
+
+/* Fetches the status of the segment at sp with one RRTI (or RCS for WUT
+ * with *prefer_rcsp). Returns 0 with *rrp filled, else an SG_LIB_* error. */
+static int
+odx_seg_status(struct opts_t * op, struct odx_seg_t * sp, bool * prefer_rcsp,
+               struct rrti_resp_t * rrp, int vb_b)
+{
+    bool changed_pref = false;
+    int res;
+
+    op->list_id = sp->list_id;
+    if (ODX_SEG_PT == sp->state)
+        return do_rrti(op, DDPT_ARG_IN, rrp, vb_b);
+    while (true) {
+        if (*prefer_rcsp)
+            res = do_rcs(op, DDPT_ARG_OUT, rrp, vb_b);
+        else
+            res = do_rrti(op, DDPT_ARG_OUT, rrp, vb_b);
+        if ((SG_LIB_CAT_ILLEGAL_REQ == res) && ! changed_pref) {
+            changed_pref = true;
+            *prefer_rcsp = ! *prefer_rcsp;
+        } else
+            return res;
+    }
+}
+
+/* journal=: every input block below the lowest segment still in flight
+ * (or below in_blk_off when none are) has been written. */
+static uint64_t
+odx_jrnl_done(const struct odx_seg_t * segs, int nseg, uint64_t in_blk_off)
+{
+    int k;
+
+    for (k = 0; k < nseg; ++k) {
+        if ((ODX_SEG_IDLE != segs[k].state) &&
+            (segs[k].in_blk_off < in_blk_off))
+            in_blk_off = segs[k].in_blk_off;
+    }
+    return in_blk_off;
+}
+
+/* Like the loop at the end of odx_full_copy() but with up to qd=QD
+ * segments in flight, each under its own list_id starting at op->list_id.
+ * The IMMED bit is set on POPULATE TOKEN and WRITE USING TOKEN so they
+ * return promptly, then each segment is polled when its own poller says
+ * so, sleeping until the earliest of those. Segment boundaries are
+ * decided when each is started so a transfer count shorter than asked for
+ * is an error here. Returns 0 on success. */
+static int
+odx_full_copy_par(struct opts_t * op, int64_t in_num_blks,
+                  uint64_t in_blk_off, uint64_t out_blk_off, int in_num_elems,
+                  int out_num_elems, int in_mult, int out_mult)
+{
+    bool prefer_rcs = op->oflagp->prefer_rcs;
+    int k, res, nseg, active, vb3, vb_b;
+    uint32_t delay;
+    uint32_t base_lid = op->list_id;
+    uint64_t num, o_num;
+    struct odx_seg_t * sp;
+    struct odx_seg_t * segs;
+    struct rrti_resp_t r;
+    char b[400];
+
+    vb3 = (op->verbose > 1) ? (op->verbose - 2) : 0;
+    vb_b = (vb3 > 0) ? (vb3 - 1) : 0;
+    nseg = op->queue_depth;
+    if ((op->idip->odxp->max_conc_copies > 0) &&
+        ((uint32_t)nseg > op->idip->odxp->max_conc_copies))
+        nseg = op->idip->odxp->max_conc_copies;
+    if ((op->odip->odxp->max_conc_copies > 0) &&
+        ((uint32_t)nseg > op->odip->odxp->max_conc_copies))
+        nseg = op->odip->odxp->max_conc_copies;
+    segs = (struct odx_seg_t *)calloc(nseg, sizeof(*segs));
+    if (NULL == segs) {
+        pr2serr("Not enough user memory for %s\n", __func__);
+        return SG_LIB_CAT_OTHER;
+    }
+    for (k = 0; k < nseg; ++k)
+        segs[k].list_id = base_lid + k;
+    op->iflagp->immed = true;
+    op->oflagp->immed = true;
+    if (op->verbose)
+        pr2serr("%s: up to %d segments in flight, list_id %" PRIu32 " to %"
+                PRIu32 "\n", __func__, nseg, base_lid, base_lid + nseg - 1);
+
+    active = 0;
+    res = 0;
+    while (true) {
+        /* start segments in idle slots */
+        for (k = 0, sp = segs; (k < nseg) && (in_num_blks > 0); ++k, ++sp) {
+            if (ODX_SEG_IDLE != sp->state)
+                continue;
+            res = odx_seg_nums(op, in_num_blks, in_num_elems, in_blk_off,
+                               in_mult, out_mult, &num, &o_num);
+            if (res < 0) {
+                res = 0;
+                in_num_blks = 0;        /* only trailing blocks left */
+                break;
+            } else if (res)
+                goto fini;
+            if (in_blk_off > 0)
+                signals_process_delay(op, DELAY_COPY_SEGMENT);
+            if (op->verbose > 2)
+                pr2serr("%s: list_id=%" PRIu32 ", in_blk_off=0x%" PRIx64
+                        ", i_num=%" PRIu64 ", out_blk_off=0x%" PRIx64 ", "
+                        "o_num=%" PRIu64 "\n", __func__, sp->list_id,
+                        in_blk_off, num, out_blk_off, o_num);
+            op->list_id = sp->list_id;
+            if ((res = do_pop_tok(op, in_blk_off, num, false, vb3)))
+                goto fini;
+            sp->state = ODX_SEG_PT;
+            sp->due = 0;
+            odx_poll_init(&sp->poll, num);
+            sp->in_blk_off = in_blk_off;
+            sp->num = num;
+            sp->out_blk_off = out_blk_off;
+            sp->o_num = o_num;
+            sp->oir = 0;
+            in_blk_off += num;
+            out_blk_off += o_num;
+            in_num_blks -= num;
+            ++active;
+        }
+        if (0 == active) {
+            if (op->jrnlp)
+                res = jrnl_checkpoint(op, in_blk_off, 0 == op->dd_count);
+            break;
+        }
+        if (op->jrnlp && jrnl_due(op) &&
+            (res = jrnl_checkpoint(op, odx_jrnl_done(segs, nseg, in_blk_off),
+                                   false)))
+            goto fini;
+
+        /* poll each segment in flight that is due */
+        for (k = 0, sp = segs; k < nseg; ++k, ++sp) {
+            if ((ODX_SEG_IDLE == sp->state) || (sp->due > 0))
+                continue;
+            if ((res = odx_seg_status(op, sp, &prefer_rcs, &r, vb_b)))
+                goto fini;
+            if ((r.cstat >= 0x10) && (r.cstat <= 0x12)) {
+                sp->due = odx_poll_next(op, &sp->poll, &r);
+                continue;
+            }
+            odx_poll_done(op, &sp->poll, &r);
+            if (! ((0x1 == r.cstat) || (0x3 == r.cstat))) {
+                pr2serr("%s: list_id=%" PRIu32 " after %s: %s\n", __func__,
+                        sp->list_id, (ODX_SEG_PT == sp->state) ? "PT" :
+                        "WUT", cpy_op_status_str(r.cstat, b, sizeof(b)));
+                res = SG_LIB_CAT_OTHER;
+                goto fini;
+            }
+            if (ODX_SEG_PT == sp->state) {
+                if (r.tc != sp->num) {
+                    pr2serr("%s: list_id=%" PRIu32 " PT transfer count=%"
+                            PRIu64 ", expected %" PRIu64 "\n", __func__,
+                            sp->list_id, r.tc, sp->num);
+                    res = SG_LIB_CAT_OTHER;
+                    goto fini;
+                }
+                op->in_full += r.tc;
+                memcpy(sp->tok, r.rod_tok,
+                       ((r.rt_len > 512) ? 512 : r.rt_len));
+            } else {
+                if (r.tc != sp->r_o_num) {
+                    pr2serr("%s: list_id=%" PRIu32 " WUT transfer count=%"
+                            PRIu64 ", expected %" PRIu64 "\n", __func__,
+                            sp->list_id, r.tc, sp->r_o_num);
+                    res = SG_LIB_CAT_OTHER;
+                    goto fini;
+                }
+                op->out_full += r.tc;
+                sp->out_blk_off += r.tc;
+                sp->oir += r.tc;
+                sp->o_num -= r.tc;
+                if (0 == sp->o_num) {
+                    op->dd_count -= sp->num;
+                    sp->state = ODX_SEG_IDLE;
+                    --active;
+                    continue;
+                }
+            }
+            signals_process_delay(op, DELAY_WRITE);
+            if ((res = odx_seg_wut(op, sp, out_num_elems, vb3)))
+                goto fini;
+        }
+        /* sleep until the next segment is due, if none is now */
+        delay = 0;
+        for (k = 0, sp = segs; k < nseg; ++k, ++sp) {
+            if (ODX_SEG_IDLE == sp->state)
+                continue;
+            if ((0 == sp->due) || (0 == delay) || (sp->due < delay))
+                delay = sp->due;
+            if (0 == delay)
+                break;
+        }
+        if (delay > 0) {
+            odx_poll_sleep(op, NULL, delay);
+            for (k = 0, sp = segs; k < nseg; ++k, ++sp) {
+                if (ODX_SEG_IDLE == sp->state)
+                    continue;
+                sp->due -= delay;
+                sp->poll.waited += delay;
+            }
+        }
+    }
+fini:
+    op->list_id = base_lid;
+    free(segs);
+    return res;
+}
+
 /* This function is designed to copy large amounts (terabytes) with
  * potentially different block sizes on input and output. Returns
  * 0 on success. */
@@ -2419,9 +2825,7 @@ odx_full_copy(struct opts_t * op)
     int k, res, in_blk_sz, out_blk_sz, in_mult, out_mult;
     int in_num_elems, out_num_elems, vb3;
     uint64_t in_blk_off, out_blk_off, num, o_num, r_o_num, oir, tc_i, tc_o;
-    int64_t in_num_blks, out_num_blks, u, uu, v, vv;
-    struct dev_info_t * idip = op->idip;
-    struct dev_info_t * odip = op->odip;
+    int64_t in_num_blks, out_num_blks, u, uu, v, vv, done;
 
     vb3 = (op->verbose > 1) ? (op->verbose - 2) : 0;
     got_count = (op->dd_count > 0);
@@ -2551,44 +2955,50 @@ odx_full_copy(struct opts_t * op)
     in_blk_off = 0;
     out_blk_off = 0;
     op->dd_count = in_num_blks;
+    if (op->jrnlp) {
+        /* offsets are into the gather and scatter lists, if given */
+        if ((res = jrnl_start(op, &done)))
+            return res;
+        if (done >= in_num_blks) {
+            pr2serr("journal finds copy complete, exiting\n");
+            op->dd_count = 0;
+            return 0;
+        }
+        in_blk_off = done;
+        if (in_mult)
+            out_blk_off = done / in_mult;
+        else
+            out_blk_off = out_mult ? (done * out_mult) : done;
+        in_num_blks -= done;
+        op->dd_count = in_num_blks;
+        if (done > 0)
+            pr2serr("journal resuming at input block offset %" PRIu64
+                    ", output block offset %" PRIu64 "\n", in_blk_off,
+                    out_blk_off);
+    }
     op->dd_count_start = op->dd_count;
     if (op->verbose > 1)
         pr2serr("%s: about to copy %" PRIi64 " blocks (seen from input)\n",
                     __func__, in_num_blks);
 
+    if (op->qd_given && (op->queue_depth > 1)) {
+        if (op->rtf_fd < 0)
+            return odx_full_copy_par(op, in_num_blks, in_blk_off,
+                                     out_blk_off, in_num_elems,
+                                     out_num_elems, in_mult, out_mult);
+        pr2serr("%s: qd=QD ignored when rtf=RTF is given\n", __func__);
+    }
+
     /* copy using PT, WUT, [WUT, ...], PT, WUT, [WUT, ...] sequence */
     for (k = 0; in_num_blks > 0; in_num_blks -= num, ++k) {
         if (k > 0)
             signals_process_delay(op, DELAY_COPY_SEGMENT);
-        num = in_num_blks;
-        if (op->bpt_given && ((uint64_t)op->bpt_i < num))
-            num = op->bpt_i;
-        if ((idip->odxp->max_tok_xfer_size > 0) &&
-            (num > idip->odxp->max_tok_xfer_size))
-            num = idip->odxp->max_tok_xfer_size;
-        if (op->in_sgl)
-            num = count_restricted_sgl_blocks(op->in_sgl, in_num_elems,
-                                              in_blk_off, num,
-                                              idip->odxp->max_range_desc);
-        if (! oneto1) {
-            if (in_mult) {
-                o_num = num / in_mult;
-                num = o_num * in_mult;
-                if (0 == num) {
-                    if (in_num_blks < in_mult) {
-                        pr2serr("%s: unable to copy trailing blocks due to "
-                                "block size mismatch\n", __func__);
-                        return 0;
-                    } else {
-                        pr2serr("%s: block size mismatch problem, perhaps "
-                                "BPT value too small\n", __func__);
-                        return SG_LIB_SYNTAX_ERROR;
-                    }
-                }
-            } else      /* out_mult must be >= 2 */
-                o_num = num * out_mult;
-        } else
-            o_num = num;
+        res = odx_seg_nums(op, in_num_blks, in_num_elems, in_blk_off,
+                           in_mult, out_mult, &num, &o_num);
+        if (res < 0)
+            return 0;
+        else if (res)
+            return res;
         if (op->verbose > 2)
             pr2serr("%s: k=%d, in_blk_off=0x%" PRIx64 ", i_num=%" PRIu64 ", "
                     "out_blk_off=0x%" PRIx64 ", o_num=%" PRIu64 "\n",
@@ -2596,7 +3006,7 @@ odx_full_copy(struct opts_t * op)
 
         if ((res = do_pop_tok(op, in_blk_off, num, ! op->list_id_given, vb3)))
             return res;
-        if ((res = process_after_poptok(op, &tc_i, vb3)))
+        if ((res = process_after_poptok(op, &tc_i, num, vb3)))
             return res;
         if (tc_i != num) {
             pr2serr("%s: number requested (in) differs from transfer "
@@ -2611,21 +3021,12 @@ odx_full_copy(struct opts_t * op)
              * WUT calls (latter ones using offset in ROD) may be needed */
             if (k > 0)
                 signals_process_delay(op, DELAY_WRITE);
-            r_o_num = o_num;
-            if ((op->obpch > 0) && ((uint64_t)op->obpch < r_o_num))
-                r_o_num = op->obpch;
-            if ((odip->odxp->max_tok_xfer_size > 0) &&
-                (r_o_num > odip->odxp->max_tok_xfer_size))
-                r_o_num = odip->odxp->max_tok_xfer_size;
-            if (op->out_sgl)
-                r_o_num = count_restricted_sgl_blocks(op->out_sgl,
-                                out_num_elems, out_blk_off, r_o_num,
-                                odip->odxp->max_range_desc);
+            r_o_num = odx_wut_num(op, o_num, out_num_elems, out_blk_off);
             res = do_wut(op, local_rod_token, out_blk_off, r_o_num, oir,
                          (r_o_num < o_num), ! op->list_id_given, vb3);
             if (res)
                 return res;
-            if ((res = process_after_wut(op, &tc_o, vb3)))
+            if ((res = process_after_wut(op, &tc_o, r_o_num, vb3)))
                 return res;
             if (tc_o != r_o_num) {
                 pr2serr("%s: number requested (out) differs from transfer "
@@ -2636,10 +3037,41 @@ odx_full_copy(struct opts_t * op)
             out_blk_off += tc_o;
         }
         op->dd_count -= tc_i;
+        if (op->jrnlp && jrnl_due(op) &&
+            (res = jrnl_checkpoint(op, in_blk_off, false)))
+            return res;
     }
+    if (op->jrnlp)
+        return jrnl_checkpoint(op, in_blk_off, 0 == op->dd_count);
     return 0;
 }
 
+/* bpt=auto (or cal) with odx: use the smaller OPTIMAL TRANSFER COUNT from
+ * the Block Device ROD Token Limits descriptors of IFILE and OFILE (the
+ * latter scaled to IBS sized blocks). */
+static void
+odx_bpt_auto(struct opts_t * op)
+{
+    uint64_t u = 0;
+    uint64_t v;
+
+    if (op->idip->odxp && op->idip->odxp->optimal_xfer_count)
+        u = op->idip->odxp->optimal_xfer_count;
+    if (op->odip->odxp && op->odip->odxp->optimal_xfer_count) {
+        v = (uint64_t)op->odip->odxp->optimal_xfer_count * op->obs /
+            op->ibs;
+        if ((0 == u) || ((v > 0) && (v < u)))
+            u = v;
+    }
+    if ((u > 0) && (u <= INT_MAX)) {
+        op->bpt_i = (int)u;
+        op->bpt_given = true;
+    }
+    if (op->verbose)
+        pr2serr("bpt=auto: odx optimal transfer count %" PRIu64 "%s\n", u,
+                (op->bpt_given ? "" : ", keep default"));
+}
+
 /* *whop<=0 for both in+out, *whop==1 for in, *whop==2 for out */
 static int
 odx_setup_and_run(struct opts_t * op, int * whop)
@@ -2691,6 +3123,12 @@ odx_setup_and_run(struct opts_t * op, int * whop)
             return res;
     }
 
+    if (op->bpt_auto && (! op->bpt_given))
+        odx_bpt_auto(op);
+    if (op->jrnlp && ((ODX_COPY != req) ||
+                      (op->rod_type_given && (RODT_BLK_ZERO == op->rod_type))))
+        pr2serr("journal= ignored, odx only journals a full copy\n");
+
     if (ODX_READ_INTO_RODS == req) {
         if (whop)
             *whop = 1;
@@ -2739,6 +3177,10 @@ do_odx(struct opts_t * op)
     ret = odx_setup_and_run(op, &who);
     if (0 == op->status_none)
         print_stats("", op, who);
+    if (op->verbose && (op->odx_polls > 0))
+        pr2serr("ODX: %" PRId64 " status polls while busy, %" PRId64 " ms "
+                "waiting, about %" PRId64 " ms of that after completion\n",
+                op->odx_polls, op->odx_poll_wait_ms, op->odx_poll_idle_ms);
     if (op->do_time)
         calc_duration_throughput("", false /* contin */, op);
     if (op->rtf_fd >= 0) {
@@ -124,8 +124,6 @@ const char * ddptctl_version_str = "0.96 20171106 [svn: r333]";
 #define DEF_ROD_TOK_FILE "ddptctl_rod_tok.bin"
 
 
-static struct scat_gath_elem fixed_sgl[MAX_FIXED_SGL_ELEMS];
-
 static struct option long_options[] = {
         {"abort", no_argument, 0, 'A'},
         {"all-toks", no_argument, 0, 'a'},
@@ -563,14 +561,13 @@ do_sgl(struct opts_t * op, const char * opt, const char * buf)
 
     len = (int)strlen(buf);
     if ((('-' == buf[0]) && (1 == len)) || ((len > 1) && ('@' == buf[0]))) {
-        res = file_to_sgl(((len > 1) ? (buf + 1) : buf), fixed_sgl, &got,
-                          MAX_FIXED_SGL_ELEMS);
+        res = file_to_sgl(((len > 1) ? (buf + 1) : buf), &op->in_sgl, &got);
         if (res) {
             pr2serr("bad argument to '%s'\n", opt);
             return SG_LIB_SYNTAX_ERROR;
         }
     } else if (num_chs_in_str(buf, len, ',') > 0) {
-        res = cl_to_sgl(buf, fixed_sgl, &got, MAX_FIXED_SGL_ELEMS);
+        res = cl_to_sgl(buf, &op->in_sgl, &got);
         if (res) {
             pr2serr("bad argument to '%s'\n", opt);
             return SG_LIB_SYNTAX_ERROR;
@@ -580,9 +577,8 @@ do_sgl(struct opts_t * op, const char * opt, const char * buf)
                  opt);
         return SG_LIB_SYNTAX_ERROR;
     }
-    op->in_sgl = fixed_sgl;
     op->in_sgl_elems = got;
-    op->out_sgl = fixed_sgl;
+    op->out_sgl = op->in_sgl;
     op->out_sgl_elems = got;
     if (op->verbose > 3) {
         pr2serr("scatter-gather list (%d elements):\n", op->in_sgl_elems);
@@ -623,6 +619,7 @@ main(int argc, char * argv[])
     struct dev_info_t ids, ods, o2ds;
     struct sg_simple_inquiry_resp sir;
     struct rrti_resp_t rrti_rsp;
+    struct odx_poll_t poll;
     char b[80];
     char bb[80];
     unsigned char rt[512];
@@ -920,6 +917,7 @@ main(int argc, char * argv[])
         if (ret)
             goto clean_up;
     } else if (do_poll) {
+        odx_poll_init(&poll, 0);
         do {
             if (prefer_rcs)
                 ret = do_rcs(op, DDPT_ARG_IN, &rrti_rsp, op->verbose);
@@ -929,18 +927,11 @@ main(int argc, char * argv[])
                 goto clean_up;
             cont = ((rrti_rsp.cstat >= 0x10) && (rrti_rsp.cstat <= 0x12));
             if (cont) {
-                delay = rrti_rsp.esu_del;
-                if ((delay < 0xfffffffe) && (delay > 0)) {
-                    if (op->verbose > 1)
-                        pr2serr("using copy manager recommended delay of %"
-                                PRIu32 " milliseconds\n", delay);
-                } else {
-                    delay = DEF_ODX_POLL_DELAY_MS;
-                    if (op->verbose > 1)
-                        pr2serr("using default for poll delay\n");
-                }
-                if (delay)
-                    sleep_ms(delay);
+                delay = odx_poll_next(op, &poll, &rrti_rsp);
+                if (op->verbose > 1)
+                    pr2serr("poll again in %" PRIu32 " milliseconds\n",
+                            delay);
+                odx_poll_sleep(op, &poll, delay);
             }
         } while (cont);
         sg_get_opcode_sa_name(THIRD_PARTY_COPY_OUT_CMD, rrti_rsp.for_sa, 0,
@@ -962,7 +953,7 @@ main(int argc, char * argv[])
             goto clean_up;
         else if (op->iflagp->immed)
             goto clean_up;
-        if ((ret = process_after_poptok(op, &tc, op->verbose)))
+        if ((ret = process_after_poptok(op, &tc, 0, op->verbose)))
             goto clean_up;
         printf("PT completes with a transfer count of %" PRIu64 " [0x%"
                PRIx64 "]\n", tc, tc);
@@ -1020,7 +1011,7 @@ main(int argc, char * argv[])
             goto clean_up;
         else if (op->oflagp->immed)
             goto clean_up;
-        if ((ret = process_after_wut(op, &tc, op->verbose)))
+        if ((ret = process_after_wut(op, &tc, 0, op->verbose)))
             goto clean_up;
         printf("WUT completes with a transfer count of %" PRIu64 " [0x%"
                PRIx64 "]\n", tc, tc);